@@ -123,6 +123,39 @@ public:
         networkType_ = networkType;
     }
 
+    /* bandwidth limits in KiB per second, 0 means unlimited */
+    uint32_t GetPeerUploadLimit() const {
+        return peerUploadLimit_;
+    }
+
+    void SetPeerUploadLimit(uint32_t limit) {
+        peerUploadLimit_ = limit;
+    }
+
+    uint32_t GetPeerDownloadLimit() const {
+        return peerDownloadLimit_;
+    }
+
+    void SetPeerDownloadLimit(uint32_t limit) {
+        peerDownloadLimit_ = limit;
+    }
+
+    uint32_t GetTotalUploadLimit() const {
+        return totalUploadLimit_;
+    }
+
+    void SetTotalUploadLimit(uint32_t limit) {
+        totalUploadLimit_ = limit;
+    }
+
+    uint32_t GetTotalDownloadLimit() const {
+        return totalDownloadLimit_;
+    }
+
+    void SetTotalDownloadLimit(uint32_t limit) {
+        totalDownloadLimit_ = limit;
+    }
+
     void SetExternAddress(const std::string& address) {
         external_address_ = address;
     }
@@ -139,6 +172,14 @@ public:
         dbPath_ = dbPath;
     }
 
+    void SetIndex(bool index) {
+        index_ = index;
+    }
+
+    bool IsIndex() const {
+        return index_;
+    }
+
     void AddSeedByIP(const std::string& ip, const uint16_t& port) {
         auto address = NetAddress::GetByIP(ip, port);
         if (address) {
@@ -210,13 +251,21 @@ public:
         ss << "bind port = " << bindPort_ << std::endl;
         ss << "external address = " << external_address_ << std::endl;
         ss << "network type = " << networkType_ << std::endl;
+        ss << "bandwidth limits per peer = " << peerUploadLimit_ << " KiB/s upload, " << peerDownloadLimit_
+           << " KiB/s download" << std::endl;
+        ss << "total bandwidth limits = " << totalUploadLimit_ << " KiB/s upload, " << totalDownloadLimit_
+           << " KiB/s download" << std::endl;
         ss << "dbpath = " << GetDBPath() << std::endl;
+        ss << "tx and address index = " << (index_ ? "yes" : "no") << std::endl;
         ss << "disable rpc = " << (disableRPC_ ? "yes" : "no") << std::endl;
         ss << "rpc port = " << rpcPort_ << std::endl;
         ss << "wallet path = " << GetWalletPath() << " with backup period " << GetWalletBackup()
            << ", login session time " << GetWalletLogin() << std::endl;
         ss << "solver addr = " << GetSolverAddr() << std::endl;
         ss << "number of solver threads = " << GetSolverThreads() << std::endl;
+        ss << "mempool max size = " << mempoolMaxSize_ << " MiB, min fee rate " << minFeeRate_ << " per kB"
+           << std::endl;
+        ss << "persist mempool = " << (persistMempool_ ? "yes" : "no") << std::endl;
         ss << "seeds = [" << std::endl;
 
         for (const NetAddress& addr : seeds_) {
@@ -275,6 +324,37 @@ public:
         return solver_threads;
     }
 
+    /* the budget of the memory pool in MiB */
+    void SetMempoolMaxSize(uint32_t size) {
+        mempoolMaxSize_ = std::max(size, 1u);
+    }
+
+    uint32_t GetMempoolMaxSize() const {
+        return mempoolMaxSize_;
+    }
+
+    /* the min fee per 1000 bytes of the transactions relayed */
+    void SetMinFeeRate(uint64_t feeRate) {
+        minFeeRate_ = feeRate;
+    }
+
+    uint64_t GetMinFeeRate() const {
+        return minFeeRate_;
+    }
+
+    /* whether the memory pool is dumped on shutdown and loaded on startup */
+    void SetPersistMempool(bool persist) {
+        persistMempool_ = persist;
+    }
+
+    bool IsPersistMempool() const {
+        return persistMempool_;
+    }
+
+    std::string GetMempoolFilePath() const {
+        return GetRoot() + mempoolFilename_;
+    }
+
     void SetAmISeed(bool seed) {
         amISeed_ = seed;
     }
@@ -324,10 +404,15 @@ private:
     bool amISeed_            = false;
     std::vector<NetAddress> seeds_;
     std::string external_address_;
+    uint32_t peerUploadLimit_    = 0;
+    uint32_t peerDownloadLimit_  = 0;
+    uint32_t totalUploadLimit_   = 0;
+    uint32_t totalDownloadLimit_ = 0;
 
     // db
     bool startWithNewDB = false;
     std::string dbPath_ = "db/";
+    bool index_         = false;
 
     // rpc
     bool disableRPC_;
@@ -345,6 +430,12 @@ private:
     std::string solver_addr = "";
     int solver_threads      = 1;
 
+    // mempool
+    uint32_t mempoolMaxSize_     = 300;
+    uint64_t minFeeRate_         = 0;
+    bool persistMempool_         = true;
+    std::string mempoolFilename_ = "mempool.dat";
+
     // file sanity
     bool prune_ = false;
 };
@@ -219,6 +219,7 @@ VertexPtr Chain::Verify(const ConstBlockPtr& pblock) {
     std::vector<VertexWPtr> wvtcs;
     RegChange regChange;
     TXOC txoc;
+    std::vector<std::pair<ConstTxPtr, bool>> confirmedTxns;
     vtcs.reserve(blocksToValidate.size());
     wvtcs.reserve(blocksToValidate.size());
     verifying_.clear();
@@ -259,6 +260,13 @@ VertexPtr Chain::Verify(const ConstBlockPtr& pblock) {
                 assert(v);
             }
 
+            if (MEMPOOL) {
+                const auto& txns = vtx->cblock->GetTransactions();
+                for (size_t i = 0; i < txns.size(); ++i) {
+                    confirmedTxns.emplace_back(txns[i], vtx->validity[i] == Vertex::Validity::VALID);
+                }
+            }
+
             vtx->UpdateReward(GetPrevReward(*vtx));
         }
         verifying_.insert({vtx->cblock->GetHash(), vtx});
@@ -267,6 +275,10 @@ VertexPtr Chain::Verify(const ConstBlockPtr& pblock) {
         }
     }
 
+    if (MEMPOOL && !confirmedTxns.empty()) {
+        MEMPOOL->ReleaseTxsFromConfirmed(confirmedTxns);
+    }
+
     CreateNextMilestone(GetChainHead(), *vtcs.back(), std::move(wvtcs), std::move(regChange), std::move(txoc));
     const auto& ms = vtcs.back()->snapshot;
     spdlog::debug("[Validation] New milestone {} has milestone difficulty target in compact form {} as difficulty {}",
@@ -339,10 +351,6 @@ std::pair<TXOC, TXOC> Chain::Validate(Vertex& vertex, RegChange& regChange) {
                 vertex.validity[i] = Vertex::Validity::INVALID;
                 invalidTXOC.Merge(CreateTXOCFromInvalid(*txns[i], i));
             }
-
-            if (MEMPOOL) {
-                MEMPOOL->ReleaseTxFromConfirmed(txns[i], vertex.validity[i] == Vertex::Validity::VALID);
-            }
         }
     }
 
@@ -588,6 +596,27 @@ bool Chain::IsTxFitsLedger(const ConstTxPtr& tx) const {
     return true;
 }
 
+std::optional<Coin> Chain::GetTxFee(const ConstTxPtr& tx) const {
+    Coin valueIn{};
+    for (const auto& input : tx->GetInputs()) {
+        auto prevOut = ledger_.FindSpendable(input.outpoint.GetOutKey());
+        if (!prevOut) {
+            return {};
+        }
+        valueIn += prevOut->GetOutput().value;
+    }
+
+    Coin valueOut{};
+    for (const auto& output : tx->GetOutputs()) {
+        valueOut += output.value;
+    }
+
+    if (valueIn < valueOut) {
+        return {};
+    }
+    return valueIn - valueOut;
+}
+
 ////////////////////
 // Cumulator
 ////////////////////
@@ -127,6 +127,12 @@ public:
     bool IsMilestone(const uint256&) const;
     bool IsTxFitsLedger(const ConstTxPtr& tx) const;
 
+    /**
+     * Returns the fee paid by the transaction if all of its inputs are spendable
+     * in the ledger and are no less than its outputs, std::nullopt otherwise
+     */
+    std::optional<Coin> GetTxFee(const ConstTxPtr& tx) const;
+
     friend class Chains;
 
 private:
@@ -7,7 +7,8 @@
 #include "peer_manager.h"
 #include "rpc_server.h"
 
-DAGManager::DAGManager() : verifyThread_(1), syncPool_(1), storagePool_(1) {
+DAGManager::DAGManager()
+    : verifyThread_(1), syncPool_(1), storagePool_(1), headerPool_(std::max(1u, std::thread::hardware_concurrency())) {
     milestoneChains_.push(std::make_unique<Chain>());
     msVertices_.emplace(GENESIS->GetHash(), GENESIS_VERTEX);
 
@@ -15,6 +16,7 @@ DAGManager::DAGManager() : verifyThread_(1), syncPool_(1), storagePool_(1) {
     verifyThread_.Start();
     syncPool_.Start();
     storagePool_.Start();
+    headerPool_.Start();
 }
 
 bool DAGManager::Init() {
@@ -49,11 +51,7 @@ void DAGManager::CallbackRequestInv(std::unique_ptr<Inv> inv, PeerPtr peer) {
         if (result.empty()) {
             spdlog::info("Received an empty inv, which means we have reached the same height as the peer's {}.",
                          peer->address.ToString());
-            auto task = std::make_shared<GetDataTask>(GetDataTask::PENDING_SET, sync_task_timeout);
-            peer->AddPendingGetDataTask(task);
-            auto pending_request = std::make_unique<GetData>(task->type);
-            pending_request->AddPendingSetNonce(task->nonce);
-            peer->SendMessage(std::move(pending_request));
+            RequestPendingSet(peer);
         } else if (result.size() == 1 && result.at(0) == GENESIS->GetHash()) {
             if (peer->GetLastGetInvEnd() == GENESIS->GetHash()) {
                 spdlog::info("peer {} response fork to genesis hash request", peer->address.ToString());
@@ -144,16 +142,38 @@ void DAGManager::RespondRequestLVS(const std::vector<uint256>& hashes,
                                    const std::vector<uint32_t>& nonces,
                                    PeerPtr peer) {
     assert(hashes.size() == nonces.size());
-    auto hs_iter = hashes.begin();
-    auto nc_iter = nonces.begin();
-    while (hs_iter != hashes.end() && nc_iter != nonces.end()) {
-        syncPool_.Execute([n = *nc_iter, h = *hs_iter, peer, this]() {
+    syncPool_.Execute([hashes, nonces, peer, this]() {
+        // Level sets in db are read in one batch of overlapped reads
+        std::vector<size_t> dbHeights;
+        std::vector<bool> inDB(hashes.size(), false);
+        size_t leastHeightCached = GetBestChain()->GetLeastHeightCached();
+        for (size_t i = 0; i < hashes.size(); ++i) {
+            auto height = GetHeight(hashes[i]);
+            if (height < leastHeightCached) {
+                dbHeights.push_back(height);
+                inDB[i] = true;
+            }
+        }
+
+        std::vector<VStream> dbPayloads;
+        try {
+            dbPayloads = STORE->GetRawLevelSetsAsync(dbHeights).get();
+        } catch (const std::exception&) {
+            // the reader is stopped
+            return;
+        }
+
+        auto dbPayload = dbPayloads.begin();
+        for (size_t i = 0; i < hashes.size(); ++i) {
+            const auto& h = hashes[i];
+            const auto& n = nonces[i];
+
             auto bundle  = std::make_unique<Bundle>(n);
-            auto payload = GetMainChainRawLevelSet(h);
+            auto payload = inDB[i] ? std::move(*dbPayload++) : GetMainChainRawLevelSet(h);
             if (payload.empty()) {
                 spdlog::debug("Milestone {} cannot be found. Sending a Not Found Message instead", h.to_substr());
                 peer->SendMessage(std::make_unique<NotFound>(h, n));
-                return;
+                continue;
             }
 
             bundle->SetPayload(std::move(payload));
@@ -161,36 +181,285 @@ void DAGManager::RespondRequestLVS(const std::vector<uint256>& hashes,
                           peer->address.ToString());
             peer->SetLastSentBundleHash(h);
             peer->SendMessage(std::move(bundle));
-        });
-        hs_iter++;
-        nc_iter++;
+        }
+    });
+}
+
+void DAGManager::RespondRequestLvsRange(const uint256& startHash,
+                                        const uint256& endHash,
+                                        uint32_t nonce,
+                                        PeerPtr peer) {
+    syncPool_.Execute([startHash, endHash, nonce, peer, this]() {
+        if (!IsMainChainMS(startHash) || !IsMainChainMS(endHash)) {
+            spdlog::debug("Range {} to {} is not on the main chain. Sending a Not Found Message instead",
+                          startHash.to_substr(), endHash.to_substr());
+            peer->SendMessage(std::make_unique<NotFound>(startHash, nonce));
+            return;
+        }
+
+        size_t start = GetHeight(startHash);
+        size_t end   = GetHeight(endHash);
+        if (end < start || end - start >= GetLvsRange::kMaxRangeSize) {
+            spdlog::debug("Bad level set range {} to {} requested by {}", start, end, peer->address.ToString());
+            peer->SendMessage(std::make_unique<NotFound>(startHash, nonce));
+            return;
+        }
+
+        auto [payload, count] = GetMainChainRawLevelSets(start, end, LvsRange::kMaxPayloadSize);
+        if (payload.empty()) {
+            peer->SendMessage(std::make_unique<NotFound>(startHash, nonce));
+            return;
+        }
+
+        spdlog::debug("Sending {} level sets from height {} with nonce {} to peer {}", count, start, nonce,
+                      peer->address.ToString());
+        if (start + count > end) {
+            peer->SetLastSentBundleHash(endHash);
+        }
+
+        auto range = std::make_unique<LvsRange>(nonce);
+        range->SetPayload(std::move(payload));
+        peer->SendMessage(std::move(range));
+    });
+}
+
+std::pair<VStream, size_t> DAGManager::GetMainChainRawLevelSets(size_t start, size_t end, size_t maxBytes) const {
+    // take as many stored level sets as fit into the payload and read them at once
+    size_t leastHeightCached = GetBestChain()->GetLeastHeightCached();
+    size_t height            = start;
+    size_t bytes             = 0;
+    for (; height <= end && height < leastHeightCached; ++height) {
+        auto region = STORE->GetLevelSetRegionAt(height, file::FileType::BLK);
+        if (!region || (height > start && bytes + region->second > maxBytes)) {
+            break;
+        }
+        bytes += region->second;
     }
+
+    VStream payload;
+    if (height > start) {
+        payload = STORE->GetRawLevelSetBetween(start, height - 1);
+    }
+
+    // then the cached ones
+    if (height >= leastHeightCached) {
+        for (; height <= end; ++height) {
+            auto lvs = GetMainChainRawLevelSet(height);
+            if (lvs.empty() || (height > start && bytes + lvs.size() > maxBytes)) {
+                break;
+            }
+            bytes += lvs.size();
+            payload.write(lvs.data(), lvs.size());
+        }
+    }
+
+    return {std::move(payload), height - start};
+}
+
+void DAGManager::RequestMsHeaders(PeerPtr peer) {
+    syncPool_.Execute([peer = std::move(peer), this]() {
+        std::vector<uint256> locator;
+        if (!peer->msSkeleton.Empty()) {
+            // continue from the last header verified
+            locator.push_back(peer->msSkeleton.tip.hash);
+        } else {
+            locator = ConstructLocator(uint256(), ms_locator_length, peer);
+            if (locator.empty()) {
+                spdlog::debug("RequestMsHeaders return: locator is null");
+                return;
+            }
+            if (locator.back() != GENESIS->GetHash()) {
+                locator.push_back(GENESIS->GetHash());
+            }
+        }
+
+        auto task = std::make_shared<GetInvTask>(sync_task_timeout);
+        peer->AddPendingGetInvTask(task);
+        peer->SendMessage(std::make_unique<GetMsHeaders>(std::move(locator), task->nonce));
+    });
+}
+
+void DAGManager::CallbackRequestMsHeaders(std::unique_ptr<MsHeaders> msg, PeerPtr peer) {
+    syncPool_.Execute([msg = std::move(msg), peer = std::move(peer), this]() {
+        if (!peer->RemovePendingGetInvTask(msg->nonce)) {
+            spdlog::debug("Unknown milestone headers: nonce = {}, msg from {}", msg->nonce, peer->address.ToString());
+            return;
+        }
+
+        auto& skeleton      = peer->msSkeleton;
+        const auto& headers = msg->headers;
+        if (headers.empty()) {
+            if (skeleton.Empty()) {
+                spdlog::info("Received no milestone header, which means we have reached the same height as the "
+                             "peer's {}.",
+                             peer->address.ToString());
+                RequestPendingSet(peer);
+            } else {
+                DownloadSkeleton(peer);
+            }
+            return;
+        }
+
+        const uint256& forkHash = headers.front().header.milestoneBlockHash;
+        if (skeleton.Empty() || forkHash != skeleton.tip.hash) {
+            skeleton = {};
+
+            auto state = IsMainChainMS(forkHash) ? GetMsHeaderState(forkHash) : std::nullopt;
+            if (!state) {
+                spdlog::info("Milestone headers from {} do not follow our main chain", peer->address.ToString());
+                peer->Disconnect();
+                return;
+            }
+
+            auto localWork = GetMainChainWorkAfter(forkHash, max_get_inv_length);
+            if (!localWork) {
+                // too far from our head to compare the work, fall back to the inventory
+                spdlog::debug("Milestone headers from {} fork too deep, requesting inv instead",
+                              peer->address.ToString());
+                RequestInv(uint256(), 5, peer);
+                return;
+            }
+
+            skeleton.tip       = std::move(*state);
+            skeleton.localWork = std::move(*localWork);
+        }
+
+        if (!VerifyMsHeaders(headers, skeleton.tip, headerPool_, skeleton.hashes)) {
+            spdlog::warn("Received invalid milestone headers from {}, disconnecting", peer->address.ToString());
+            skeleton = {};
+            peer->Disconnect();
+            return;
+        }
+
+        spdlog::debug("Verified {} milestone headers from {} up to height {}", headers.size(),
+                      peer->address.ToString(), skeleton.tip.height);
+
+        if (headers.size() == MsHeaders::kMaxHeaders && skeleton.hashes.size() < max_skeleton_size) {
+            RequestMsHeaders(peer);
+        } else {
+            DownloadSkeleton(peer);
+        }
+    });
+}
+
+void DAGManager::RespondRequestMsHeaders(std::vector<uint256>& locator, uint32_t nonce, PeerPtr peer) {
+    syncPool_.Execute([peer = std::move(peer), locator = std::move(locator), nonce, this]() {
+        auto msg = std::make_unique<MsHeaders>(nonce);
+        for (const uint256& start : locator) {
+            if (!IsMainChainMS(start)) {
+                continue;
+            }
+
+            auto startMs = GetMsVertex(start, false);
+            if (!startMs) {
+                continue;
+            }
+
+            auto hashes = TraverseMilestoneForward(startMs, MsHeaders::kMaxHeaders);
+            if (hashes.size() > MsHeaders::kMaxHeaders) {
+                hashes.resize(MsHeaders::kMaxHeaders);
+            }
+
+            msg->headers.reserve(hashes.size());
+            for (const auto& h : hashes) {
+                auto vtx = GetMsVertex(h);
+                if (!vtx || !vtx->cblock) {
+                    break;
+                }
+                msg->headers.emplace_back(*vtx->cblock);
+            }
+            break;
+        }
+
+        spdlog::debug("Sending {} milestone headers to {}", msg->headers.size(), peer->address.ToString());
+        peer->SendMessage(std::move(msg));
+    });
+}
+
+void DAGManager::RequestPendingSet(const PeerPtr& peer) {
+    auto task = std::make_shared<GetDataTask>(GetDataTask::PENDING_SET, sync_task_timeout);
+    peer->AddPendingGetDataTask(task);
+    auto pending_request = std::make_unique<GetData>(task->type);
+    pending_request->AddPendingSetNonce(task->nonce);
+    peer->SendMessage(std::move(pending_request));
+}
+
+void DAGManager::DownloadSkeleton(const PeerPtr& peer) {
+    auto skeleton    = std::move(peer->msSkeleton);
+    peer->msSkeleton = {};
+
+    if (skeleton.tip.work <= skeleton.localWork) {
+        spdlog::info("Milestone headers from {} up to height {} have no more work than our chain",
+                     peer->address.ToString(), skeleton.tip.height);
+        return;
+    }
+
+    spdlog::info("Downloading the level sets of {} milestones from {} up to height {}", skeleton.hashes.size(),
+                 peer->address.ToString(), skeleton.tip.height);
+    RequestData(skeleton.hashes, peer);
+}
+
+std::optional<MsHeaderState> DAGManager::GetMsHeaderState(const uint256& msHash) const {
+    auto vtx = GetMsVertex(msHash);
+    if (!vtx || !vtx->snapshot) {
+        return {};
+    }
+
+    const auto& ms          = vtx->snapshot;
+    uint32_t lastUpdateTime = ms->lastUpdateTime;
+    if (lastUpdateTime == 0) {
+        // not kept for milestones loaded from the db; find the last difficulty transition
+        auto cursor = vtx;
+        while (cursor && cursor->cblock && cursor->height % GetParams().interval != 0) {
+            cursor = GetMsVertex(cursor->cblock->GetMilestoneHash());
+        }
+        if (!cursor || !cursor->cblock) {
+            return {};
+        }
+        lastUpdateTime = cursor->cblock->GetTime();
+    }
+
+    return MsHeaderState(msHash, vtx->height, ms->milestoneTarget, lastUpdateTime);
+}
+
+std::optional<arith_uint256> DAGManager::GetMainChainWorkAfter(const uint256& msHash, size_t maxDepth) const {
+    arith_uint256 work;
+    auto cursor = GetMilestoneHead();
+    for (size_t i = 0; i <= maxDepth && cursor && cursor->cblock; ++i) {
+        if (cursor->cblock->GetHash() == msHash) {
+            return work;
+        }
+
+        cursor = GetMsVertex(cursor->cblock->GetMilestoneHash());
+        if (!cursor || !cursor->snapshot) {
+            break;
+        }
+        work += GetParams().maxTarget / cursor->snapshot->milestoneTarget;
+    }
+
+    return {};
 }
 
 void DAGManager::RequestData(std::vector<uint256>& requests, const PeerPtr& requestFrom) {
-    auto message = std::make_unique<GetData>(GetDataTask::LEVEL_SET);
+    std::vector<uint256> toDownload;
+    // whether each level set directly follows the previous one to download
+    std::vector<bool> consecutive;
+    bool skipped = true;
     for (auto& h : requests) {
         if (downloading_.contains(h) || STORE->DAGExists(h)) {
+            skipped = true;
             continue;
         }
 
-        auto task = std::make_shared<GetDataTask>(GetDataTask::LEVEL_SET, h, sync_task_timeout);
-        message->AddItem(h, task->nonce);
-        requestFrom->AddPendingGetDataTask(task);
         downloading_.insert(h);
-
-        if (message->hashes.size() >= maxGetDataSize) {
-            spdlog::debug("Requesting lvs {} to {}", message->hashes.front().to_substr(),
-                          message->hashes.back().to_substr());
-            requestFrom->SendMessage(std::move(message));
-            message = std::make_unique<GetData>(GetDataTask::LEVEL_SET);
-        }
+        toDownload.push_back(h);
+        consecutive.push_back(!skipped);
+        skipped = false;
     }
 
-    if (!message->hashes.empty()) {
-        spdlog::debug("Requesting lvs {} to {}", message->hashes.front().to_substr(),
-                      message->hashes.back().to_substr());
-        requestFrom->SendMessage(std::move(message));
+    if (!toDownload.empty()) {
+        downloader_.Enqueue(toDownload, consecutive, requestFrom,
+                            PEERMAN ? PEERMAN->GetSyncPeers() : std::vector<PeerPtr>{});
     }
 }
 
@@ -230,7 +499,7 @@ std::vector<uint256> DAGManager::TraverseMilestoneForward(const VertexPtr cursor
 
     // If the cursor height is less than the least height in cache, traverse DB.
     while (cursorHeight <= STORE->GetHeadHeight() && result.size() <= length) {
-        result.push_back(STORE->GetMilestoneAt(cursorHeight)->cblock->GetHash());
+        result.push_back(STORE->GetMilestoneHashAt(cursorHeight));
         ++cursorHeight;
     }
 
@@ -261,96 +530,112 @@ void DAGManager::EnableOBC() {
 //
 
 void DAGManager::AddNewBlock(ConstBlockPtr blk, PeerPtr peer) {
-    verifyThread_.Execute([=, blk = std::move(blk), peer = std::move(peer)]() mutable {
-        spdlog::trace("[Verify Thread] Adding blocks to pending {}", blk->GetHash().to_substr());
-        if (*blk == *GENESIS) {
-            spdlog::trace("[Syntax] Abort adding the genesis block.");
-            return;
-        }
-
-        if (STORE->Exists(blk->GetHash())) {
-            spdlog::trace("[Syntax] Abort adding existed block [{}].", std::to_string(blk->GetHash()));
-            return;
-        }
+    verifyThread_.Execute(
+        [=, blk = std::move(blk), peer = std::move(peer)]() mutable { VerifyNewBlock(std::move(blk), peer); });
+}
 
-        /////////////////////////////////
-        // Start of online verification
+void DAGManager::AddNewBlocks(std::vector<ConstBlockPtr> blocks, PeerPtr peer) {
+    if (blocks.empty()) {
+        return;
+    }
 
-        if (!blk->Verify()) {
-            return;
+    verifyThread_.Execute([=, blocks = std::move(blocks), peer = std::move(peer)]() mutable {
+        spdlog::trace("[Verify Thread] Adding a batch of {} blocks", blocks.size());
+        for (auto& blk : blocks) {
+            VerifyNewBlock(std::move(blk), peer);
         }
+    });
+}
 
-        // Check solidity ///////////////
-        const uint256& msHash   = blk->GetMilestoneHash();
-        const uint256& prevHash = blk->GetPrevHash();
-        const uint256& tipHash  = blk->GetTipHash();
-
-        auto mask = [msHash, prevHash, tipHash]() {
-            return ((!STORE->DAGExists(msHash) << 0) | (!STORE->DAGExists(prevHash) << 2) |
-                    (!STORE->DAGExists(tipHash) << 1));
-        };
+void DAGManager::VerifyNewBlock(ConstBlockPtr blk, const PeerPtr& peer) {
+    spdlog::trace("[Verify Thread] Adding blocks to pending {}", blk->GetHash().to_substr());
+    if (*blk == *GENESIS) {
+        spdlog::trace("[Syntax] Abort adding the genesis block.");
+        return;
+    }
 
-        // First, check if we already received its preceding blocks
-        if (STORE->IsWeaklySolid(blk)) {
-            if (STORE->AnyLinkIsOrphan(blk)) {
-                spdlog::info("[Syntax] Block is not solid (link in obc) with mask {} [{}]", mask(),
-                             blk->GetHash().to_substr());
-                STORE->AddBlockToOBC(std::move(blk), mask());
-                return;
-            }
-        } else {
-            // We have not received at least one of its parents.
+    if (STORE->Exists(blk->GetHash())) {
+        spdlog::trace("[Syntax] Abort adding existed block [{}].", std::to_string(blk->GetHash()));
+        return;
+    }
 
-            // Drop if the block is too old
-            VertexPtr ms = GetMsVertex(msHash, false);
-            if (ms && !CheckPuntuality(blk, ms)) {
-                return;
-            }
-            // Abort and send GetBlock requests.
-            spdlog::info("[Syntax] Block is not solid with mask {} [{}] prev {} tip {} ms {}", mask(),
-                         std::to_string(blk->GetHash()), prevHash.to_substr(), tipHash.to_substr(), msHash.to_substr());
-            STORE->AddBlockToOBC(std::move(blk), mask());
+    /////////////////////////////////
+    // Start of online verification
 
-            if (peer) {
-                peer->StartSync();
-            }
+    if (!blk->Verify()) {
+        return;
+    }
 
+    // Check solidity ///////////////
+    const uint256& msHash   = blk->GetMilestoneHash();
+    const uint256& prevHash = blk->GetPrevHash();
+    const uint256& tipHash  = blk->GetTipHash();
+
+    auto mask = [msHash, prevHash, tipHash]() {
+        return ((!STORE->DAGExists(msHash) << 0) | (!STORE->DAGExists(prevHash) << 2) |
+                (!STORE->DAGExists(tipHash) << 1));
+    };
+
+    // First, check if we already received its preceding blocks
+    if (STORE->IsWeaklySolid(blk)) {
+        if (STORE->AnyLinkIsOrphan(blk)) {
+            spdlog::info("[Syntax] Block is not solid (link in obc) with mask {} [{}]", mask(),
+                         blk->GetHash().to_substr());
+            STORE->AddBlockToOBC(std::move(blk), mask());
             return;
         }
+    } else {
+        // We have not received at least one of its parents.
 
-        // Check difficulty target //////
-
+        // Drop if the block is too old
         VertexPtr ms = GetMsVertex(msHash, false);
-        if (!ms) {
-            spdlog::warn("[Syntax] Block has missing or invalid milestone link [{}]", blk->GetHash().to_substr());
+        if (ms && !CheckPuntuality(blk, ms)) {
             return;
         }
+        // Abort and send GetBlock requests.
+        spdlog::info("[Syntax] Block is not solid with mask {} [{}] prev {} tip {} ms {}", mask(),
+                     std::to_string(blk->GetHash()), prevHash.to_substr(), tipHash.to_substr(), msHash.to_substr());
+        STORE->AddBlockToOBC(std::move(blk), mask());
 
-        uint32_t expectedTarget = ms->snapshot->blockTarget.GetCompact();
-        if (blk->GetDifficultyTarget() != expectedTarget) {
-            spdlog::warn("[Syntax] Block has unexpected change in difficulty: current {} v.s. expected {} [{}]",
-                         blk->GetDifficultyTarget(), expectedTarget, blk->GetHash().to_substr());
-            return;
+        if (peer) {
+            peer->StartSync();
         }
 
-        // Check punctuality ////////////
+        return;
+    }
 
-        if (!CheckPuntuality(blk, ms)) {
-            return;
-        }
+    // Check difficulty target //////
 
-        // End of online verification
-        /////////////////////////////////
+    VertexPtr ms = GetMsVertex(msHash, false);
+    if (!ms) {
+        spdlog::warn("[Syntax] Block has missing or invalid milestone link [{}]", blk->GetHash().to_substr());
+        return;
+    }
 
-        STORE->Cache(blk);
+    uint32_t expectedTarget = ms->snapshot->blockTarget.GetCompact();
+    if (blk->GetDifficultyTarget() != expectedTarget) {
+        spdlog::warn("[Syntax] Block has unexpected change in difficulty: current {} v.s. expected {} [{}]",
+                     blk->GetDifficultyTarget(), expectedTarget, blk->GetHash().to_substr());
+        return;
+    }
 
-        if (peer) {
-            PEERMAN->RelayBlock(blk, peer);
-        }
+    // Check punctuality ////////////
 
-        AddBlockToPending(blk);
-        STORE->ReleaseBlocks(blk->GetHash());
-    });
+    if (!CheckPuntuality(blk, ms)) {
+        return;
+    }
+
+    // End of online verification
+    /////////////////////////////////
+
+    STORE->Cache(blk);
+
+    if (peer) {
+        PEERMAN->RelayBlock(blk, peer);
+    }
+
+    AddBlockToPending(blk);
+    STORE->ReleaseBlocks(blk->GetHash());
 }
 
 bool DAGManager::CheckPuntuality(const ConstBlockPtr& blk, const VertexPtr& ms) const {
@@ -541,6 +826,7 @@ void DAGManager::Stop() {
     syncPool_.Stop();
     verifyThread_.Stop();
     storagePool_.Stop();
+    headerPool_.Stop();
     spdlog::info("DAG stopped");
 }
 
@@ -608,6 +894,7 @@ void DAGManager::FlushToSTORE(MilestonePtr ms) {
         const auto& ms = *vtxToStore.back().lock();
         STORE->StoreLevelSet(vtxToStore);
         STORE->UpdatePrevRedemHashes(ms.snapshot->GetRegChange());
+        STORE->IndexLevelSet(vtxToStore, utxoToStore, utxoToRemove);
 
         for (auto& vtx : vtxToStore) {
             blocksToListener.emplace_back(vtx.lock());
@@ -6,6 +6,8 @@
 #define EPIC_DAG_MANAGER_H
 
 #include "chains.h"
+#include "level_set_downloader.h"
+#include "ms_header_chain.h"
 #include "sync_messages.h"
 #include "threadpool.h"
 
@@ -49,6 +51,31 @@ public:
     void RespondRequestLVS(const std::vector<uint256>&, const std::vector<uint32_t>&, PeerPtr);
     void RespondRequestPending(uint32_t, const PeerPtr&) const;
 
+    /**
+     * Responds to GetLvsRange with the main chain level sets between the two milestones,
+     * reading the stored ones with a single sequential read
+     */
+    void RespondRequestLvsRange(const uint256& startHash, const uint256& endHash, uint32_t nonce, PeerPtr);
+
+    /**
+     * Concatenates the raw main chain level sets from height start to end inclusively,
+     * cut short at a level set boundary before the payload exceeds maxBytes,
+     * though the first one is taken whatever its size
+     * @return the payload and the number of level sets in it
+     */
+    std::pair<VStream, size_t> GetMainChainRawLevelSets(size_t start, size_t end, size_t maxBytes) const;
+
+    /**
+     * Headers-first sync: requests the milestone headers following our main chain,
+     * or following the headers received so far from the peer. The level sets are
+     * downloaded only after the headers are verified and have more work than our chain
+     */
+    void RequestMsHeaders(PeerPtr peer);
+    void CallbackRequestMsHeaders(std::unique_ptr<MsHeaders> msg, PeerPtr peer);
+
+    /** Responds with the main chain milestone headers after the first known hash in the locator */
+    void RespondRequestMsHeaders(std::vector<uint256>&, uint32_t, PeerPtr);
+
     /////////////////////////////// Verification /////////////////////////////////////
 
     /**
@@ -58,6 +85,12 @@ public:
      */
     void AddNewBlock(ConstBlockPtr block, PeerPtr peer);
 
+    /**
+     * Submits a batch of blocks to the verification thread as a single task.
+     * The blocks are checked in the given order, so parents should go first.
+     */
+    void AddNewBlocks(std::vector<ConstBlockPtr> blocks, PeerPtr peer);
+
     /**
      * Checks whether the block links to an old milestone
      */
@@ -122,6 +155,10 @@ public:
         return downloading_.erase(h);
     }
 
+    LevelSetDownloader& GetDownloader() {
+        return downloader_;
+    }
+
     StatData GetStatData() const;
 
     /**
@@ -137,16 +174,29 @@ private:
     const uint32_t sync_task_timeout  = 180; // in seconds
     const uint32_t max_get_inv_length = 1000;
 
+    // number of our milestones in the locator of GetMsHeaders
+    const size_t ms_locator_length = 32;
+    // max number of headers verified before the level sets are requested
+    const size_t max_skeleton_size = 10000;
+
     ThreadPool verifyThread_;
     ThreadPool syncPool_;
     ThreadPool storagePool_;
 
+    // verifies the proofs of milestone headers in parallel
+    ThreadPool headerPool_;
+
     /**
      * A list of hashes we've sent out in GetData requests.
      * Should be thread-safe.
      */
     ConcurrentHashSet<uint256> downloading_;
 
+    /**
+     * Spreads the level set requests over the sync peers
+     */
+    LevelSetDownloader downloader_{maxGetDataSize};
+
     /**
      * A list of milestone chains, with first element being
      * the main chain and others being forked chains.
@@ -176,13 +226,33 @@ private:
     std::vector<uint256> ConstructLocator(const uint256& fromHash, size_t length, const PeerPtr&);
 
     /**
-     * Start a new thread and create a list of GetData tasks that is either added
-     * to preDownloading (if it's not empty) or a peer's task queue. If preDownloading
-     * is not empty, drain certain amount of tasks from preDownloading to peer's task queue.
-     * Whenever a task is sent to peer, add the hash of the task in the downloading list.
+     * Adds the hashes that are neither downloaded nor being downloaded to the
+     * downloading list and queues them in the downloader, which requests them
+     * from the peer sending the Inv together with the other sync peers.
      */
     void RequestData(std::vector<uint256>& requests, const PeerPtr& requestFrom);
 
+    /** Requests the pending set once we have reached the same height as the peer */
+    void RequestPendingSet(const PeerPtr& peer);
+
+    /**
+     * Requests the level sets of the verified milestone headers from
+     * the peer if they have more work than our main chain
+     */
+    void DownloadSkeleton(const PeerPtr& peer);
+
+    /**
+     * Returns the difficulty state at the given main chain milestone,
+     * std::nullopt if it is not found
+     */
+    std::optional<MsHeaderState> GetMsHeaderState(const uint256& msHash) const;
+
+    /**
+     * Returns the work of our main chain after the given milestone, std::nullopt
+     * if it is not found within maxDepth milestones back from the head
+     */
+    std::optional<arith_uint256> GetMainChainWorkAfter(const uint256& msHash, size_t maxDepth) const;
+
     /** Delete the chain who loses in the race competition */
     void DeleteFork();
 
@@ -192,6 +262,9 @@ private:
      */
     void AddBlockToPending(const ConstBlockPtr& block);
 
+    /** Online verification of a new block, run on the verification thread */
+    void VerifyNewBlock(ConstBlockPtr block, const PeerPtr& peer);
+
     void ProcessMilestone(const ChainPtr&, const ConstBlockPtr&);
 
     bool IsMainChainMS(const uint256&) const;
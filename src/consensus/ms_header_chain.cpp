@@ -0,0 +1,114 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "ms_header_chain.h"
+#include "params.h"
+#include "spdlog.h"
+
+#include <ctime>
+
+void MsHeaderState::Next(const uint256& nextHash, uint32_t timestamp) {
+    work += GetParams().maxTarget / milestoneTarget;
+    hash = nextHash;
+    height++;
+
+    if (height % GetParams().interval != 0) {
+        return;
+    }
+
+    // the same adjustment as in Milestone::UpdateDifficulty
+    const auto targetTimespan = GetParams().targetTimespan;
+    uint32_t timespan         = timestamp - lastUpdateTime;
+    if (timespan < targetTimespan / 4) {
+        timespan = targetTimespan / 4;
+    }
+    if (timespan > targetTimespan * 4) {
+        timespan = targetTimespan * 4;
+    }
+    if (height == 1) {
+        timespan = GetParams().timeInterval;
+    }
+
+    milestoneTarget = milestoneTarget / targetTimespan * timespan;
+    milestoneTarget.Round(sizeof(uint32_t));
+    if (milestoneTarget > GetParams().maxTarget) {
+        milestoneTarget = GetParams().maxTarget;
+    }
+
+    lastUpdateTime = timestamp;
+}
+
+bool VerifyMsHeaders(const std::vector<MsHeader>& headers,
+                     MsHeaderState& state,
+                     ThreadPool& pool,
+                     std::vector<uint256>& verified) {
+    // number of proofs verified by a task
+    static constexpr size_t kChunkSize = 64;
+
+    const size_t nHeaders = headers.size();
+    std::vector<uint256> hashes(nHeaders);
+    std::vector<uint256> proofHashes(nHeaders);
+    std::vector<uint8_t> valid(nHeaders, false);
+
+    const time_t allowedTime = std::time(nullptr) + ALLOWED_TIME_DRIFT;
+    auto verify              = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Block block    = headers[i].GetHeaderBlock();
+            hashes[i]      = block.GetHash();
+            proofHashes[i] = block.GetProofHash();
+            valid[i]       = block.GetTime() <= allowedTime && block.CheckPOW();
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    for (size_t begin = kChunkSize; begin < nHeaders; begin += kChunkSize) {
+        auto end = std::min(nHeaders, begin + kChunkSize);
+        if (auto f = pool.Submit([&verify, begin, end]() { verify(begin, end); })) {
+            futures.emplace_back(std::move(*f));
+        } else {
+            verify(begin, end);
+        }
+    }
+    verify(0, std::min(nHeaders, kChunkSize));
+
+    bool dropped = false;
+    for (auto& f : futures) {
+        try {
+            f.get();
+        } catch (const std::future_error&) {
+            // the task is dropped by a stopped pool
+            dropped = true;
+        }
+    }
+    if (dropped) {
+        return false;
+    }
+
+    MsHeaderState next = state;
+    for (size_t i = 0; i < nHeaders; ++i) {
+        if (!valid[i]) {
+            spdlog::info("[Sync] Invalid milestone header at height {} [{}]", next.height + 1,
+                         hashes[i].to_substr());
+            return false;
+        }
+
+        if (headers[i].header.milestoneBlockHash != next.hash) {
+            spdlog::info("[Sync] Milestone header at height {} does not link to the previous one [{}]",
+                         next.height + 1, hashes[i].to_substr());
+            return false;
+        }
+
+        if (UintToArith256(proofHashes[i]) > next.milestoneTarget) {
+            spdlog::info("[Sync] Milestone header at height {} does not meet the milestone target [{}]",
+                         next.height + 1, hashes[i].to_substr());
+            return false;
+        }
+
+        next.Next(hashes[i], headers[i].header.timestamp);
+    }
+
+    state = std::move(next);
+    verified.insert(verified.end(), hashes.begin(), hashes.end());
+    return true;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_MS_HEADER_CHAIN_H
+#define EPIC_MS_HEADER_CHAIN_H
+
+#include "arith_uint256.h"
+#include "sync_messages.h"
+#include "threadpool.h"
+
+/**
+ * The difficulty along a chain of milestone headers. It follows the
+ * milestone target adjustment in Milestone, which depends only on the
+ * heights and times of the milestones, so no level set is needed
+ */
+class MsHeaderState {
+public:
+    uint256 hash;
+    uint64_t height = 0;
+
+    // the work of the milestones added since the state was created
+    arith_uint256 work;
+
+    arith_uint256 milestoneTarget;
+    uint32_t lastUpdateTime = 0;
+
+    MsHeaderState() = default;
+
+    /**
+     * @param lastUpdateTime the time of the last milestone at a difficulty transition
+     */
+    MsHeaderState(const uint256& hash_, uint64_t height_, const arith_uint256& target, uint32_t lastUpdateTime_)
+        : hash(hash_), height(height_), milestoneTarget(target), lastUpdateTime(lastUpdateTime_) {}
+
+    /**
+     * Moves the state to the next milestone
+     */
+    void Next(const uint256& nextHash, uint32_t timestamp);
+};
+
+/**
+ * Checks that the headers are a chain of milestones following the state and
+ * that each proof of work meets the target of the previous milestone. The
+ * proofs are verified in batches on the pool and the rest in order.
+ *
+ * @param verified receives the hashes of the headers if all of them are valid
+ * @return true and moves the state to the last header if all of them are valid
+ */
+bool VerifyMsHeaders(const std::vector<MsHeader>& headers,
+                     MsHeaderState& state,
+                     ThreadPool& pool,
+                     std::vector<uint256>& verified);
+
+/**
+ * The milestone headers received from a peer in the headers-first sync,
+ * which are verified but whose level sets are not requested yet
+ */
+struct MsSkeleton {
+    // the work of our main chain after the fork point of the headers
+    arith_uint256 localWork;
+
+    // the state at the last verified header
+    MsHeaderState tip;
+
+    std::vector<uint256> hashes;
+
+    bool Empty() const {
+        return hashes.empty();
+    }
+};
+
+#endif // EPIC_MS_HEADER_CHAIN_H
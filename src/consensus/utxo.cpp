@@ -70,7 +70,7 @@ UTXOPtr ChainLedger::GetFromPending(const uint256& xorkey) {
     return nullptr;
 }
 
-UTXOPtr ChainLedger::FindSpendable(const uint256& xorkey) {
+UTXOPtr ChainLedger::FindSpendable(const uint256& xorkey) const {
     auto query = removed_.find(xorkey);
     if (query != removed_.end()) {
         return nullptr; // nullptr as it is found in map of removed utxos
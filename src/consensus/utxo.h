@@ -136,7 +136,7 @@ public:
 
     void AddToPending(UTXOPtr);
     UTXOPtr FindFromLedger(const uint256&); // for created and spent UTXOs
-    UTXOPtr FindSpendable(const uint256&);
+    UTXOPtr FindSpendable(const uint256&) const;
     UTXOPtr GetFromPending(const uint256&);
     void Invalidate(const TXOC&);
     void Update(const TXOC&);
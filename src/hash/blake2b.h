@@ -52,6 +52,7 @@ public:
     BLAKE2B& Reset();
 
     friend bool BLAKE2BSelfTest();
+    friend class BLAKE2BMidstate;
 
 private:
     state s;
@@ -61,6 +62,12 @@ private:
     void InitializeKey(size_t outlen, const unsigned char* key, size_t keylen);
 };
 
+extern const uint64_t blake2b_IV[8];
+extern const uint8_t blake2b_sigma[12][16];
+
+// compresses a block into the state
+void blake2b_compress(BLAKE2B::state& S, const uint8_t block[BLAKE2B::BLOCKBYTES]);
+
 void HashBLAKE2(const char* pin, uint32_t inlen, const unsigned char* out, uint32_t outlen);
 
 // checks if the implementation is correct
@@ -0,0 +1,240 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blake2bxN.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#define HAVE_BLAKE2B_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+constexpr size_t LANES = BLAKE2BMidstate::LANES;
+
+using Block  = uint8_t[BLAKE2B::BLOCKBYTES];
+using Kernel = void (*)(const uint64_t h[8], uint64_t counter, const Block blocks[LANES], uint64_t out[LANES][8]);
+
+/*
+ * compresses the last blocks of the messages, with the counter of their total size
+ * and the flag of the last block, writing the resulting state words of each message
+ */
+void CompressLastStandard(const uint64_t h[8], uint64_t counter, const Block blocks[LANES], uint64_t out[LANES][8]) {
+    for (size_t lane = 0; lane < LANES; ++lane) {
+        BLAKE2B::state S;
+        memcpy(S.h, h, sizeof(S.h));
+        S.t[0] = counter;
+        S.t[1] = 0;
+        S.f[0] = (uint64_t) -1;
+        S.f[1] = 0;
+        blake2b_compress(S, blocks[lane]);
+        memcpy(out[lane], S.h, sizeof(S.h));
+    }
+}
+
+#ifdef HAVE_BLAKE2B_SIMD
+
+#define G(r, i, a, b, c, d)                                   \
+    do {                                                      \
+        a = ADD(ADD(a, b), m[blake2b_sigma[r][2 * i + 0]]); \
+        d = ROT32(XOR(d, a));                                 \
+        c = ADD(c, d);                                        \
+        b = ROT24(XOR(b, c));                                 \
+        a = ADD(ADD(a, b), m[blake2b_sigma[r][2 * i + 1]]); \
+        d = ROT16(XOR(d, a));                                 \
+        c = ADD(c, d);                                        \
+        b = ROT63(XOR(b, c));                                 \
+    } while (0)
+
+#define ROUND(r)                           \
+    do {                                   \
+        G(r, 0, v[0], v[4], v[8], v[12]);  \
+        G(r, 1, v[1], v[5], v[9], v[13]);  \
+        G(r, 2, v[2], v[6], v[10], v[14]); \
+        G(r, 3, v[3], v[7], v[11], v[15]); \
+        G(r, 4, v[0], v[5], v[10], v[15]); \
+        G(r, 5, v[1], v[6], v[11], v[12]); \
+        G(r, 6, v[2], v[7], v[8], v[13]);  \
+        G(r, 7, v[3], v[4], v[9], v[14]);  \
+    } while (0)
+
+#define ROUNDS    \
+    do {          \
+        ROUND(0);  \
+        ROUND(1);  \
+        ROUND(2);  \
+        ROUND(3);  \
+        ROUND(4);  \
+        ROUND(5);  \
+        ROUND(6);  \
+        ROUND(7);  \
+        ROUND(8);  \
+        ROUND(9);  \
+        ROUND(10); \
+        ROUND(11); \
+    } while (0)
+
+/*
+ * 4-way kernel keeping a state word of each of the 4 messages in a vector
+ */
+#define ADD(a, b) _mm256_add_epi64(a, b)
+#define XOR(a, b) _mm256_xor_si256(a, b)
+#define ROT32(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1))
+#define ROT24(x) _mm256_shuffle_epi8(x, rotate24)
+#define ROT16(x) _mm256_shuffle_epi8(x, rotate16)
+#define ROT63(x) _mm256_xor_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x))
+
+__attribute__((target("avx2"))) void CompressLastAVX2(const uint64_t h[8],
+                                                      uint64_t counter,
+                                                      const Block blocks[LANES],
+                                                      uint64_t out[LANES][8]) {
+    static_assert(LANES == 4, "a vector of the avx2 kernel holds 4 state words");
+    const __m256i rotate24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 3, 4, 5, 6, 7, 0,
+                                              1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    const __m256i rotate16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 2, 3, 4, 5, 6, 7,
+                                              0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+
+    __m256i m[16];
+    for (size_t i = 0; i < 16; ++i) {
+        m[i] = _mm256_set_epi64x(ReadLE64(blocks[3] + i * 8), ReadLE64(blocks[2] + i * 8),
+                                 ReadLE64(blocks[1] + i * 8), ReadLE64(blocks[0] + i * 8));
+    }
+
+    __m256i v[16];
+    for (size_t i = 0; i < 8; ++i) {
+        v[i]     = _mm256_set1_epi64x(h[i]);
+        v[i + 8] = _mm256_set1_epi64x(blake2b_IV[i]);
+    }
+    v[12] = XOR(v[12], _mm256_set1_epi64x(counter));
+    v[14] = XOR(v[14], _mm256_set1_epi64x(-1));
+
+    ROUNDS;
+
+    alignas(32) uint64_t words[LANES];
+    for (size_t i = 0; i < 8; ++i) {
+        _mm256_store_si256((__m256i*) words, XOR(_mm256_set1_epi64x(h[i]), XOR(v[i], v[i + 8])));
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            out[lane][i] = words[lane];
+        }
+    }
+}
+
+#undef ADD
+#undef XOR
+#undef ROT32
+#undef ROT24
+#undef ROT16
+#undef ROT63
+
+/*
+ * 2-way kernel keeping a state word of each of 2 messages in a vector, run twice
+ */
+#define ADD(a, b) _mm_add_epi64(a, b)
+#define XOR(a, b) _mm_xor_si128(a, b)
+#define ROT32(x) _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1))
+#define ROT24(x) _mm_shuffle_epi8(x, rotate24)
+#define ROT16(x) _mm_shuffle_epi8(x, rotate16)
+#define ROT63(x) _mm_xor_si128(_mm_srli_epi64(x, 63), _mm_add_epi64(x, x))
+
+__attribute__((target("sse4.1"))) void CompressLastSSE41(const uint64_t h[8],
+                                                         uint64_t counter,
+                                                         const Block blocks[LANES],
+                                                         uint64_t out[LANES][8]) {
+    const __m128i rotate24 = _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    const __m128i rotate16 = _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+
+    for (size_t first = 0; first < LANES; first += 2) {
+        __m128i m[16];
+        for (size_t i = 0; i < 16; ++i) {
+            m[i] = _mm_set_epi64x(ReadLE64(blocks[first + 1] + i * 8), ReadLE64(blocks[first] + i * 8));
+        }
+
+        __m128i v[16];
+        for (size_t i = 0; i < 8; ++i) {
+            v[i]     = _mm_set1_epi64x(h[i]);
+            v[i + 8] = _mm_set1_epi64x(blake2b_IV[i]);
+        }
+        v[12] = XOR(v[12], _mm_set1_epi64x(counter));
+        v[14] = XOR(v[14], _mm_set1_epi64x(-1));
+
+        ROUNDS;
+
+        alignas(16) uint64_t words[2];
+        for (size_t i = 0; i < 8; ++i) {
+            _mm_store_si128((__m128i*) words, XOR(_mm_set1_epi64x(h[i]), XOR(v[i], v[i + 8])));
+            out[first][i]     = words[0];
+            out[first + 1][i] = words[1];
+        }
+    }
+}
+
+#undef ADD
+#undef XOR
+#undef ROT32
+#undef ROT24
+#undef ROT16
+#undef ROT63
+#undef ROUNDS
+#undef ROUND
+#undef G
+
+#endif // HAVE_BLAKE2B_SIMD
+
+struct KernelChoice {
+    Kernel kernel;
+    const char* name;
+};
+
+KernelChoice ChooseKernel() {
+#ifdef HAVE_BLAKE2B_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {CompressLastAVX2, "avx2(4way)"};
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return {CompressLastSSE41, "sse41(2way)"};
+    }
+#endif
+    return {CompressLastStandard, "standard"};
+}
+
+const KernelChoice& GetKernel() {
+    static const KernelChoice choice = ChooseKernel();
+    return choice;
+}
+} // namespace
+
+BLAKE2BMidstate::BLAKE2BMidstate(size_t outlen, const unsigned char* msg, size_t len) {
+    // the hasher keeps the last block in its buffer until finalized
+    BLAKE2B hasher(outlen);
+    hasher.Write(msg, len);
+    memcpy(h_, hasher.s.h, sizeof(h_));
+    counter_ = hasher.s.t[0] + hasher.s.buflen;
+    tailLen_ = hasher.s.buflen;
+    outlen_  = outlen;
+}
+
+void BLAKE2BMidstate::Hash(const unsigned char* const tails[LANES], unsigned char* const outs[LANES]) const {
+    Block blocks[LANES];
+    for (size_t lane = 0; lane < LANES; ++lane) {
+        memcpy(blocks[lane], tails[lane], tailLen_);
+        memset(blocks[lane] + tailLen_, 0, BLAKE2B::BLOCKBYTES - tailLen_);
+    }
+
+    uint64_t words[LANES][8];
+    GetKernel().kernel(h_, counter_, blocks, words);
+
+    for (size_t lane = 0; lane < LANES; ++lane) {
+        unsigned char digest[BLAKE2B::OUTBYTES];
+        for (size_t i = 0; i < 8; ++i) {
+            WriteLE64(digest + i * 8, words[lane][i]);
+        }
+        memcpy(outs[lane], digest, outlen_);
+    }
+}
+
+const char* BLAKE2BMidstate::KernelName() {
+    return GetKernel().name;
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_BLAKE2BXN_H
+#define EPIC_BLAKE2BXN_H
+
+#include "blake2b.h"
+
+/*
+ * The state of BLAKE2b after compressing the blocks of a message but its last one,
+ * from which several messages differing only in the last block are hashed at once
+ * with the widest SIMD kernel available on this cpu, i.e.,
+ * avx2 for 4 messages per vector, sse4.1 for 2 messages per vector, or the scalar one
+ */
+class BLAKE2BMidstate {
+public:
+    // number of messages hashed by a call
+    static constexpr size_t LANES = 4;
+
+    /*
+     * @param outlen the size of the digests
+     * @param msg one of the messages to hash, of which all but the last block are compressed
+     */
+    BLAKE2BMidstate(size_t outlen, const unsigned char* msg, size_t len);
+
+    /* the size of the last blocks of the messages, which are the only bytes passed to Hash */
+    size_t TailSize() const {
+        return tailLen_;
+    }
+
+    /*
+     * hashes LANES messages, each of the compressed prefix followed by a tail of TailSize() bytes
+     * @param outs the digests of outlen bytes
+     */
+    void Hash(const unsigned char* const tails[LANES], unsigned char* const outs[LANES]) const;
+
+    /* the name of the kernel chosen for this cpu */
+    static const char* KernelName();
+
+private:
+    uint64_t h_[8];
+    uint64_t counter_;
+    size_t tailLen_;
+    size_t outlen_;
+};
+
+#endif // EPIC_BLAKE2BXN_H
@@ -153,6 +153,9 @@ int Init(int argc, char* argv[]) {
         spdlog::error("Failed to pass the file sanity check, quit");
         return STORAGE_INIT_FAILURE;
     }
+    if (CONFIG->IsIndex()) {
+        STORE->EnableIndex();
+    }
     DAG = std::make_unique<DAGManager>();
     if (!DAG->Init()) {
         return DAG_INIT_FAILURE;
@@ -165,7 +168,13 @@ int Init(int argc, char* argv[]) {
     DAG->RegisterOnLvsConfirmedCallback(
         [&](auto vec, auto map1, auto map2) { WALLET->OnLvsConfirmed(vec, map1, map2); });
 
-    MEMPOOL = std::make_unique<MemPool>();
+    MEMPOOL = std::make_unique<MemPool>((size_t) CONFIG->GetMempoolMaxSize() * 1024 * 1024, CONFIG->GetMinFeeRate());
+    if (CONFIG->IsPersistMempool() && !CONFIG->IsStartWithNewDB()) {
+        ThreadPool loadPool(std::max(1U, std::thread::hardware_concurrency()));
+        loadPool.Start();
+        MEMPOOL->Load(CONFIG->GetMempoolFilePath(), loadPool);
+        loadPool.Stop();
+    }
 
     /*
      * Create network instance
@@ -321,6 +330,11 @@ void LoadConfigFile() {
         }
         CONFIG->SetNetworkType(*networkType);
 
+        CONFIG->SetPeerUploadLimit(network_config->get_as<uint32_t>("peer_upload_limit").value_or(0));
+        CONFIG->SetPeerDownloadLimit(network_config->get_as<uint32_t>("peer_download_limit").value_or(0));
+        CONFIG->SetTotalUploadLimit(network_config->get_as<uint32_t>("total_upload_limit").value_or(0));
+        CONFIG->SetTotalDownloadLimit(network_config->get_as<uint32_t>("total_download_limit").value_or(0));
+
         if (extern_address) {
             if (NetAddress::GetByIP(*extern_address)) {
                 CONFIG->SetExternAddress(*extern_address);
@@ -364,6 +378,10 @@ void LoadConfigFile() {
         if (db_path) {
             CONFIG->SetDBPath(*db_path);
         }
+        auto index = db_config->get_as<bool>("index");
+        if (index) {
+            CONFIG->SetIndex(*index);
+        }
     }
 
     // rpc
@@ -400,6 +418,18 @@ void LoadConfigFile() {
         if (solver_threads) {
             CONFIG->SetSolverThreads(*solver_threads);
         }
+        auto solver_addr = miner_config->get_as<std::string>("solver_addr");
+        if (solver_addr) {
+            CONFIG->SetSolverAddr(*solver_addr);
+        }
+    }
+
+    // mempool
+    auto mempool_config = configContent->get_table("mempool");
+    if (mempool_config) {
+        CONFIG->SetMempoolMaxSize(mempool_config->get_as<uint32_t>("max_size").value_or(300));
+        CONFIG->SetMinFeeRate(mempool_config->get_as<uint64_t>("min_fee_rate").value_or(0));
+        CONFIG->SetPersistMempool(mempool_config->get_as<bool>("persist").value_or(true));
     }
 }
 
@@ -467,6 +497,10 @@ void ShutDown() {
     DAG->Stop();
     STORE->Stop();
 
+    if (CONFIG->IsPersistMempool()) {
+        MEMPOOL->Dump(CONFIG->GetMempoolFilePath());
+    }
+
     WALLET.reset();
     STORE.reset();
     DAG.reset();
@@ -262,6 +262,18 @@ void Block::AddTransactions(std::vector<ConstTxPtr>&& txns) {
                          std::make_move_iterator(txns.end()));
 }
 
+ConstTxPtr Block::RemoveTransaction(size_t index) {
+    assert(index < transactions_.size());
+
+    UnCache();
+    ConstTxPtr tx = std::move(transactions_[index]);
+    if (index + 1 < transactions_.size()) {
+        transactions_[index] = std::move(transactions_.back());
+    }
+    transactions_.pop_back();
+    return tx;
+}
+
 bool Block::HasTransaction() const {
     return !transactions_.empty();
 }
@@ -120,6 +120,8 @@ public:
     void AddTransaction(const Transaction&);
     void AddTransaction(ConstTxPtr);
     void AddTransactions(std::vector<ConstTxPtr>&&);
+    // removes the transaction at the index, moving the last one in its place
+    ConstTxPtr RemoveTransaction(size_t index);
     bool HasTransaction() const;
     const std::vector<ConstTxPtr>& GetTransactions() const;
     std::vector<ConstTxPtr> GetTransactions();
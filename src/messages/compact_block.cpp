@@ -0,0 +1,48 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "compact_block.h"
+#include "hash.h"
+
+CompactBlock::CompactBlock(const Block& block, uint64_t salt_)
+    : NetMessage(COMPACT_BLOCK), header(block.GetHeader()), proof(block.GetProof()), salt(salt_) {
+    SetKeys();
+
+    const auto& txns = block.GetTransactions();
+    shortIDs.reserve(txns.size());
+    for (size_t i = 0; i < txns.size(); ++i) {
+        if (i == 0 || txns[i]->IsRegistration()) {
+            prefilledIndexes.push_back(i);
+            prefilledTxns.push_back(txns[i]);
+        } else {
+            shortIDs.push_back(GetShortID(txns[i]->GetHash()));
+        }
+    }
+}
+
+CompactBlock::CompactBlock(VStream& stream) : NetMessage(COMPACT_BLOCK) {
+    Deserialize(stream);
+}
+
+void CompactBlock::SetKeys() {
+    VStream s(header, salt);
+    uint256 key = HashSHA2<1>(s);
+    keys_.setkeys((const char*) key.begin());
+}
+
+uint64_t CompactBlock::GetShortID(const uint256& txHash) const {
+    // chain the keyed hash through all the words of the hash
+    uint64_t h = 0;
+    for (int i = 0; i < 4; ++i) {
+        h = keys_.siphash24(h ^ txHash.GetUint64(i));
+    }
+    return h & 0xffffffffffff;
+}
+
+Block CompactBlock::GetHeaderBlock() const {
+    Block block(header.version, header.milestoneBlockHash, header.prevBlockHash, header.tipBlockHash, header.merkleRoot,
+                header.timestamp, header.diffTarget, header.nonce, proof);
+    block.FinalizeHash();
+    return block;
+}
@@ -0,0 +1,154 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_COMPACT_BLOCK_H
+#define EPIC_COMPACT_BLOCK_H
+
+#include "block.h"
+#include "net_message.h"
+
+#include <vector>
+
+/**
+ * A block relayed as its header and proof together with short IDs of its
+ * transactions, which the receiver looks up in its own memory pool
+ */
+class CompactBlock : public NetMessage {
+public:
+    // number of bytes of a short transaction ID on the wire
+    static constexpr size_t kShortIDSize = 6;
+
+    BlockHeader header;
+    std::vector<word_t> proof;
+
+    // chosen by the sender to salt the short IDs
+    uint64_t salt = 0;
+
+    // short IDs of the transactions which are not prefilled, in the block order
+    std::vector<uint64_t> shortIDs;
+
+    // transactions sent in full and their indexes in the block in ascending order
+    std::vector<uint32_t> prefilledIndexes;
+    std::vector<ConstTxPtr> prefilledTxns;
+
+    /**
+     * Prefills the first transaction and the registrations,
+     * which are not relayed on their own
+     */
+    CompactBlock(const Block& block, uint64_t salt);
+
+    explicit CompactBlock(VStream& stream);
+
+    size_t GetTransactionSize() const {
+        return shortIDs.size() + prefilledTxns.size();
+    }
+
+    uint64_t GetShortID(const uint256& txHash) const;
+
+    /**
+     * Returns the block without transactions, which has the
+     * same hash as the full block as the header is unchanged
+     */
+    Block GetHeaderBlock() const;
+
+    ADD_SERIALIZE_METHODS
+    ADD_NET_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(header);
+
+        if (ser_action.ForRead()) {
+            proof.resize(GetParams().cycleLen);
+            for (auto& i : proof) {
+                ::Deserialize(s, i);
+            }
+        } else {
+            for (auto& i : proof) {
+                ::Serialize(s, i);
+            }
+        }
+
+        READWRITE(salt);
+
+        uint64_t nShortIDs = shortIDs.size();
+        READWRITE(VARINT(nShortIDs));
+        if (ser_action.ForRead()) {
+            if (nShortIDs > MAX_BLOCK_SIZE / kShortIDSize) {
+                throw std::ios_base::failure("too many short IDs");
+            }
+            shortIDs.resize(nShortIDs);
+        }
+        for (auto& id : shortIDs) {
+            uint32_t low  = id & 0xffffffff;
+            uint16_t high = (id >> 32) & 0xffff;
+            READWRITE(low);
+            READWRITE(high);
+            id = low | ((uint64_t) high << 32);
+        }
+
+        READWRITE(prefilledIndexes);
+        READWRITE(prefilledTxns);
+
+        if (ser_action.ForRead()) {
+            SetKeys();
+        }
+    }
+
+private:
+    siphash_keys keys_;
+
+    void SetKeys();
+};
+
+/**
+ * Requests the transactions of a compact block which are missing in the memory pool
+ */
+class GetBlockTxn : public NetMessage {
+public:
+    uint256 blockHash;
+
+    // indexes of the transactions in the block
+    std::vector<uint32_t> indexes;
+
+    GetBlockTxn(const uint256& blockHash_, std::vector<uint32_t> indexes_)
+        : NetMessage(GET_BLOCK_TXN), blockHash(blockHash_), indexes(std::move(indexes_)) {}
+
+    explicit GetBlockTxn(VStream& stream) : NetMessage(GET_BLOCK_TXN) {
+        Deserialize(stream);
+    }
+
+    ADD_SERIALIZE_METHODS
+    ADD_NET_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(blockHash);
+        READWRITE(indexes);
+    }
+};
+
+/**
+ * Responds to GetBlockTxn with the transactions in the requested order
+ */
+class BlockTxn : public NetMessage {
+public:
+    uint256 blockHash;
+    std::vector<ConstTxPtr> txns;
+
+    BlockTxn(const uint256& blockHash_, std::vector<ConstTxPtr> txns_)
+        : NetMessage(BLOCK_TXN), blockHash(blockHash_), txns(std::move(txns_)) {}
+
+    explicit BlockTxn(VStream& stream) : NetMessage(BLOCK_TXN) {
+        Deserialize(stream);
+    }
+
+    ADD_SERIALIZE_METHODS
+    ADD_NET_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(blockHash);
+        READWRITE(txns);
+    }
+};
+
+#endif // EPIC_COMPACT_BLOCK_H
@@ -4,9 +4,11 @@
 
 #include "net_message.h"
 #include "address_message.h"
+#include "compact_block.h"
 #include "ping.h"
 #include "pong.h"
 #include "sync_messages.h"
+#include "tx_inventory.h"
 #include "version_message.h"
 
 unique_message_t NetMessage::MessageFactory(uint8_t type, uint8_t countDown, VStream& s) {
@@ -52,6 +54,36 @@ unique_message_t NetMessage::MessageFactory(uint8_t type, uint8_t countDown, VSt
             case NOT_FOUND:
                 msg = std::make_unique<NotFound>(s);
                 break;
+            case COMPACT_BLOCK:
+                msg = std::make_unique<CompactBlock>(s);
+                break;
+            case GET_BLOCK_TXN:
+                msg = std::make_unique<GetBlockTxn>(s);
+                break;
+            case BLOCK_TXN:
+                msg = std::make_unique<BlockTxn>(s);
+                break;
+            case TX_INV:
+                msg = std::make_unique<TxInv>(s);
+                break;
+            case GET_TX_DATA:
+                msg = std::make_unique<GetTxData>(s);
+                break;
+            case GET_LVS_RANGE:
+                msg = std::make_unique<GetLvsRange>(s);
+                break;
+            case LVS_RANGE:
+                msg = std::make_unique<LvsRange>(s);
+                break;
+            case GET_MS_HEADERS:
+                msg = std::make_unique<GetMsHeaders>(s);
+                break;
+            case MS_HEADERS:
+                msg = std::make_unique<MsHeaders>(s);
+                break;
+            case TX_DATA:
+                msg = std::make_unique<TxData>(s);
+                break;
             default:
                 msg = std::make_unique<NetMessage>(NONE);
                 break;
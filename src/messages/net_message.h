@@ -7,17 +7,18 @@
 
 #include "stream.h"
 
-#define ADD_NET_SERIALIZE_METHODS             \
-    virtual void NetSerialize(VStream& s) {   \
-        Serialize(s);                         \
-    }                                         \
-    virtual void NetDeserialize(VStream& s) { \
-        Deserialize(s);                       \
+#define ADD_NET_SERIALIZE_METHODS                 \
+    virtual void NetSerialize(VStream& s) const { \
+        Serialize(s);                             \
+    }                                             \
+    virtual void NetDeserialize(VStream& s) {     \
+        Deserialize(s);                           \
     }
 
 class NetMessage;
 
 typedef std::unique_ptr<NetMessage> unique_message_t;
+typedef std::shared_ptr<const NetMessage> shared_message_t;
 
 class NetMessage {
 public:
@@ -35,6 +36,16 @@ public:
         INV,
         GET_DATA,
         NOT_FOUND,
+        COMPACT_BLOCK,
+        GET_BLOCK_TXN,
+        BLOCK_TXN,
+        TX_INV,
+        GET_TX_DATA,
+        GET_LVS_RANGE,
+        LVS_RANGE,
+        GET_MS_HEADERS,
+        MS_HEADERS,
+        TX_DATA,
         NONE,
     };
 
@@ -56,7 +67,7 @@ public:
         return countDown_;
     }
 
-    virtual void NetSerialize(VStream& s) {}
+    virtual void NetSerialize(VStream& s) const {}
     virtual void NetDeserialize(VStream& s) {}
 
 protected:
@@ -168,6 +168,185 @@ private:
     VStream payload_;
 };
 
+/**
+ * Requests the main chain level sets of the milestones from startHash to
+ * endHash inclusively, which are answered with a single LvsRange
+ */
+class GetLvsRange : public NetMessage {
+public:
+    // max number of level sets requested at once
+    constexpr static size_t kMaxRangeSize = 500;
+
+    explicit GetLvsRange(VStream& stream) : NetMessage(GET_LVS_RANGE) {
+        Deserialize(stream);
+    }
+
+    GetLvsRange(const uint256& start, const uint256& end, uint32_t nonce_)
+        : NetMessage(GET_LVS_RANGE), startHash(start), endHash(end), nonce(nonce_) {}
+
+    uint256 startHash;
+    uint256 endHash;
+    uint32_t nonce;
+
+    ADD_SERIALIZE_METHODS
+    ADD_NET_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(startHash);
+        READWRITE(endHash);
+        READWRITE(nonce);
+    }
+};
+
+/**
+ * The raw level sets requested by GetLvsRange concatenated in the chain order,
+ * each starting with its milestone. The range is cut short at a level set
+ * boundary once the payload exceeds kMaxPayloadSize.
+ */
+class LvsRange : public NetMessage {
+public:
+    constexpr static size_t kMaxPayloadSize = 8 * 1024 * 1024;
+
+    explicit LvsRange(VStream& stream) : NetMessage(LVS_RANGE) {
+        Deserialize(stream);
+    }
+
+    explicit LvsRange(uint32_t nonce_) : NetMessage(LVS_RANGE), nonce(nonce_) {}
+
+    void SetPayload(VStream s) {
+        payload_ = std::move(s);
+    }
+
+    std::vector<ConstBlockPtr> blocks;
+
+    uint32_t nonce;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        s << nonce;
+        if (payload_.empty()) {
+            for (const auto& b : blocks) {
+                s << b;
+            }
+        } else {
+            s << payload_;
+        }
+    }
+
+    template <typename Stream>
+    void Deserialize(Stream& s) {
+        s >> nonce;
+        while (s.in_avail()) {
+            blocks.emplace_back(std::make_shared<const Block>(s));
+        }
+    }
+
+    ADD_NET_SERIALIZE_METHODS
+
+private:
+    VStream payload_;
+};
+
+/**
+ * Requests the headers of the main chain milestones following the first
+ * hash of the locator which is on the main chain of the receiver
+ */
+class GetMsHeaders : public NetMessage {
+public:
+    // local milestone hashes from the head backwards
+    std::vector<uint256> locator;
+
+    uint32_t nonce;
+
+    GetMsHeaders(std::vector<uint256> locator_, uint32_t nonce_)
+        : NetMessage(GET_MS_HEADERS), locator(std::move(locator_)), nonce(nonce_) {}
+
+    explicit GetMsHeaders(VStream& stream) : NetMessage(GET_MS_HEADERS) {
+        Deserialize(stream);
+    }
+
+    ADD_SERIALIZE_METHODS
+    ADD_NET_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nonce);
+        READWRITE(locator);
+    }
+};
+
+/**
+ * The header of a milestone together with its proof,
+ * which is all it takes to check the proof of work
+ */
+class MsHeader {
+public:
+    BlockHeader header;
+    std::vector<word_t> proof;
+
+    MsHeader() = default;
+
+    explicit MsHeader(const Block& block) : header(block.GetHeader()), proof(block.GetProof()) {}
+
+    /**
+     * Returns the block without transactions, which has the
+     * same hash as the milestone as the header is unchanged
+     */
+    Block GetHeaderBlock() const {
+        Block block(header.version, header.milestoneBlockHash, header.prevBlockHash, header.tipBlockHash,
+                    header.merkleRoot, header.timestamp, header.diffTarget, header.nonce, proof);
+        block.FinalizeHash();
+        return block;
+    }
+
+    ADD_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(header);
+
+        if (ser_action.ForRead()) {
+            proof.resize(GetParams().cycleLen);
+            for (auto& i : proof) {
+                ::Deserialize(s, i);
+            }
+        } else {
+            for (auto& i : proof) {
+                ::Serialize(s, i);
+            }
+        }
+    }
+};
+
+/**
+ * Responds to GetMsHeaders with consecutive milestone headers, where the
+ * first one links to the milestone which the locator is found at. An empty
+ * response means the sender has no milestone beyond the locator.
+ */
+class MsHeaders : public NetMessage {
+public:
+    // max number of headers sent at once
+    constexpr static size_t kMaxHeaders = 2000;
+
+    uint32_t nonce = 0;
+    std::vector<MsHeader> headers;
+
+    explicit MsHeaders(uint32_t nonce_) : NetMessage(MS_HEADERS), nonce(nonce_) {}
+
+    explicit MsHeaders(VStream& stream) : NetMessage(MS_HEADERS) {
+        Deserialize(stream);
+    }
+
+    ADD_SERIALIZE_METHODS
+    ADD_NET_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nonce);
+        READWRITE(headers);
+        if (ser_action.ForRead() && headers.size() > kMaxHeaders) {
+            throw std::ios_base::failure("too many milestone headers");
+        }
+    }
+};
+
 class NotFound : public NetMessage {
 public:
     explicit NotFound(VStream& stream) : NetMessage(NOT_FOUND) {
@@ -0,0 +1,82 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_TX_INVENTORY_H
+#define EPIC_TX_INVENTORY_H
+
+#include "big_uint.h"
+#include "net_message.h"
+#include "transaction.h"
+
+#include <vector>
+
+/**
+ * Announces the hashes of transactions newly accepted to the memory pool
+ */
+class TxInv : public NetMessage {
+public:
+    // max number of hashes in a single announcement
+    const static size_t kMaxTxInventorySize = 1000;
+
+    std::vector<uint256> hashes;
+
+    TxInv() : NetMessage(TX_INV) {}
+
+    explicit TxInv(std::vector<uint256> hashes_) : NetMessage(TX_INV), hashes(std::move(hashes_)) {}
+
+    explicit TxInv(VStream& stream) : NetMessage(TX_INV) {
+        Deserialize(stream);
+    }
+
+    ADD_SERIALIZE_METHODS
+    ADD_NET_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashes);
+    }
+};
+
+/**
+ * Requests the announced transactions, which are answered with a TxData message
+ */
+class GetTxData : public NetMessage {
+public:
+    std::vector<uint256> hashes;
+
+    explicit GetTxData(std::vector<uint256> hashes_) : NetMessage(GET_TX_DATA), hashes(std::move(hashes_)) {}
+
+    explicit GetTxData(VStream& stream) : NetMessage(GET_TX_DATA) {
+        Deserialize(stream);
+    }
+
+    ADD_SERIALIZE_METHODS
+    ADD_NET_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashes);
+    }
+};
+
+/**
+ * Responds to GetTxData with the requested transactions still held for relay
+ */
+class TxData : public NetMessage {
+public:
+    std::vector<ConstTxPtr> txns;
+
+    explicit TxData(std::vector<ConstTxPtr> txns_) : NetMessage(TX_DATA), txns(std::move(txns_)) {}
+
+    explicit TxData(VStream& stream) : NetMessage(TX_DATA) {
+        Deserialize(stream);
+    }
+
+    ADD_SERIALIZE_METHODS
+    ADD_NET_SERIALIZE_METHODS
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txns);
+    }
+};
+
+#endif // EPIC_TX_INVENTORY_H
@@ -9,6 +9,27 @@
 #include "net_message.h"
 #include "serialize.h"
 
+/* bitmask of the optional services announced in local_service */
+enum ServiceFlags : uint64_t {
+    // relays blocks as CompactBlock and answers GetBlockTxn
+    SERVICE_COMPACT_BLOCKS = 1 << 0,
+    // announces transactions with TxInv and answers GetTxData
+    SERVICE_TX_INV = 1 << 1,
+    // answers GetLvsRange
+    SERVICE_LVS_RANGE = 1 << 2,
+    // decompresses the frames flagged as lz4 in the message header
+    SERVICE_COMPRESS_LZ4 = 1 << 3,
+    // decompresses the frames flagged as zstd in the message header
+    SERVICE_COMPRESS_ZSTD = 1 << 4,
+    // answers GetMsHeaders
+    SERVICE_MS_HEADERS = 1 << 5,
+};
+
+// the services provided by this node regardless of the build,
+// which are announced together with the available codecs
+static constexpr uint64_t kLocalServices =
+    SERVICE_COMPACT_BLOCKS | SERVICE_TX_INV | SERVICE_LVS_RANGE | SERVICE_MS_HEADERS;
+
 class VersionMessage : public NetMessage {
 public:
     int client_version     = 0;
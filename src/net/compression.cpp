@@ -0,0 +1,152 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "compression.h"
+#include "version_message.h"
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+
+/* a low level keeps the compression of a full bundle within a few milliseconds */
+static constexpr int kZstdLevel = 1;
+
+/* the max size of the content of a zstd block */
+static constexpr size_t kZstdMaxBlockSize = 128 * 1024;
+
+/* the contexts are reused by each of the worker threads to avoid allocating them per frame */
+static ZSTD_CCtx* ThreadCCtx() {
+    thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    return cctx.get();
+}
+
+static ZSTD_DCtx* ThreadDCtx() {
+    thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    return dctx.get();
+}
+#endif
+
+bool IsCodecAvailable(uint16_t codec) {
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case CODEC_LZ4:
+            return true;
+#endif
+#ifdef HAVE_ZSTD
+        case CODEC_ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+uint64_t GetCompressionServices() {
+    uint64_t services = 0;
+    if (IsCodecAvailable(CODEC_LZ4)) {
+        services |= SERVICE_COMPRESS_LZ4;
+    }
+    if (IsCodecAvailable(CODEC_ZSTD)) {
+        services |= SERVICE_COMPRESS_ZSTD;
+    }
+    return services;
+}
+
+uint16_t NegotiateCodec(uint64_t remoteServices) {
+    uint64_t common = GetCompressionServices() & remoteServices;
+    if (common & SERVICE_COMPRESS_ZSTD) {
+        return CODEC_ZSTD;
+    }
+    if (common & SERVICE_COMPRESS_LZ4) {
+        return CODEC_LZ4;
+    }
+    return CODEC_NONE;
+}
+
+size_t CompressBound(uint16_t codec, size_t size) {
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case CODEC_LZ4:
+            return size > LZ4_MAX_INPUT_SIZE ? 0 : LZ4_compressBound(size);
+#endif
+#ifdef HAVE_ZSTD
+        case CODEC_ZSTD:
+            return ZSTD_compressBound(size);
+#endif
+        default:
+            return 0;
+    }
+}
+
+size_t Compress(uint16_t codec, const char* src, size_t srcSize, char* dst, size_t dstCapacity) {
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case CODEC_LZ4: {
+            if (srcSize > LZ4_MAX_INPUT_SIZE) {
+                return 0;
+            }
+            int n = LZ4_compress_default(src, dst, srcSize, std::min<size_t>(dstCapacity, INT_MAX));
+            return n > 0 ? n : 0;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case CODEC_ZSTD: {
+            size_t n = ZSTD_compressCCtx(ThreadCCtx(), dst, dstCapacity, src, srcSize, kZstdLevel);
+            return ZSTD_isError(n) ? 0 : n;
+        }
+#endif
+        default:
+            return 0;
+    }
+}
+
+size_t DecompressBound(uint16_t codec, size_t srcSize) {
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case CODEC_LZ4:
+            /* a byte of the sequence is able to extend a match by 255 bytes at most */
+            return srcSize * 255;
+#endif
+#ifdef HAVE_ZSTD
+        case CODEC_ZSTD:
+            /* an rle block of 4 bytes restores a full block of 128KB at most */
+            return (srcSize / 4 + 1) * kZstdMaxBlockSize;
+#endif
+        default:
+            return 0;
+    }
+}
+
+bool Decompress(uint16_t codec, const char* src, size_t srcSize, char* dst, size_t rawSize) {
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case CODEC_LZ4: {
+            if (srcSize > INT_MAX || rawSize > INT_MAX) {
+                return false;
+            }
+            int n = LZ4_decompress_safe(src, dst, srcSize, rawSize);
+            return n >= 0 && (size_t) n == rawSize;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case CODEC_ZSTD: {
+            /* the frames we send declare their content size */
+            if (ZSTD_getFrameContentSize(src, srcSize) != rawSize) {
+                return false;
+            }
+            size_t n = ZSTD_decompressDCtx(ThreadDCtx(), dst, rawSize, src, srcSize);
+            return !ZSTD_isError(n) && n == rawSize;
+        }
+#endif
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_COMPRESSION_H
+#define EPIC_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* the codec of a frame payload, written into the reserved field of the message header */
+enum CompressionCodec : uint16_t {
+    CODEC_NONE = 0,
+    CODEC_LZ4  = 1,
+    CODEC_ZSTD = 2,
+    CODEC_NUM,
+};
+
+/* payloads shorter than this are always sent as they are */
+static constexpr size_t kCompressionThreshold = 4096;
+
+/* whether this build is able to compress and decompress with the codec */
+bool IsCodecAvailable(uint16_t codec);
+
+/* the service flags announcing the codecs available in this build */
+uint64_t GetCompressionServices();
+
+/*
+ * choose the codec used for the frames sent to a peer,
+ * preferring zstd for its ratio over lz4 for its speed
+ * @param remoteServices the services announced by the peer
+ * @return CODEC_NONE if there is no codec both sides are able to handle
+ */
+uint16_t NegotiateCodec(uint64_t remoteServices);
+
+/*
+ * the max size of the compressed data
+ * @return 0 if the codec is not available
+ */
+size_t CompressBound(uint16_t codec, size_t size);
+
+/*
+ * @return the size of the compressed data written into dst, 0 if failed
+ */
+size_t Compress(uint16_t codec, const char* src, size_t srcSize, char* dst, size_t dstCapacity);
+
+/*
+ * the max size of the data restored from srcSize compressed bytes,
+ * given by the max expansion ratio of the codec
+ * @return 0 if the codec is not available
+ */
+size_t DecompressBound(uint16_t codec, size_t srcSize);
+
+/*
+ * @return true only if exactly rawSize bytes are restored into dst
+ */
+bool Decompress(uint16_t codec, const char* src, size_t srcSize, char* dst, size_t rawSize);
+
+#endif // EPIC_COMPRESSION_H
@@ -6,7 +6,10 @@
 #define EPIC_CONNECTION_H
 
 #include "net_message.h"
+#include "threadpool.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <event2/bufferevent.h>
 
@@ -18,8 +21,23 @@ typedef std::shared_ptr<Connection> shared_connection_t;
 
 class Connection {
 public:
-    Connection(bufferevent_t* bev, bool inbound, std::string& remote, ConnectionManager* cmptr)
-        : valid_(true), bev_(bev), inbound_(inbound), length_(0), cmptr_(cmptr), remote_(remote) {
+    /* the bytes on the wire including the message headers, and the number of messages, by message type */
+    struct Traffic {
+        std::array<std::atomic_size_t, NetMessage::NONE + 1> sentBytes{};
+        std::array<std::atomic_size_t, NetMessage::NONE + 1> sentMessages{};
+        std::array<std::atomic_size_t, NetMessage::NONE + 1> receivedBytes{};
+        std::array<std::atomic_size_t, NetMessage::NONE + 1> receivedMessages{};
+    };
+
+    Connection(bufferevent_t* bev, bool inbound, std::string& remote, ConnectionManager* cmptr, ThreadPool& workers)
+        : valid_(true),
+          bev_(bev),
+          inbound_(inbound),
+          length_(0),
+          cmptr_(cmptr),
+          remote_(remote),
+          send_strand_(std::make_shared<Strand>(workers)),
+          receive_strand_(std::make_shared<Strand>(workers)) {
         connection_ = shared_connection_t(this);
     }
 
@@ -55,6 +73,42 @@ public:
         return connection_;
     }
 
+    /* serializes and writes the outgoing messages in order */
+    Strand& GetSendStrand() {
+        return *send_strand_;
+    }
+
+    /* deserializes the incoming messages in order */
+    Strand& GetReceiveStrand() {
+        return *receive_strand_;
+    }
+
+    /* the codec of the frames sent through the connection, negotiated with the version messages */
+    uint16_t GetCodec() const {
+        return codec_;
+    }
+
+    void SetCodec(uint16_t codec) {
+        codec_ = codec;
+    }
+
+    const Traffic& GetTraffic() const {
+        return traffic_;
+    }
+
+    /* unknown message types are counted as NONE */
+    void CountSent(uint8_t type, size_t bytes) {
+        type = std::min<uint8_t>(type, NetMessage::NONE);
+        traffic_.sentBytes[type] += bytes;
+        traffic_.sentMessages[type] += 1;
+    }
+
+    void CountReceived(uint8_t type, size_t bytes) {
+        type = std::min<uint8_t>(type, NetMessage::NONE);
+        traffic_.receivedBytes[type] += bytes;
+        traffic_.receivedMessages[type] += 1;
+    }
+
     void Release();
 
     void Disconnect();
@@ -63,11 +117,15 @@ public:
 
 private:
     std::atomic_bool valid_;
+    std::atomic_uint16_t codec_ = 0;
     bufferevent_t* bev_;
     bool inbound_;
     size_t length_;
     ConnectionManager* cmptr_;
     std::string remote_;
+    std::shared_ptr<Strand> send_strand_;
+    std::shared_ptr<Strand> receive_strand_;
+    Traffic traffic_;
     shared_connection_t connection_;
 };
 
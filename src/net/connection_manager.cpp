@@ -3,15 +3,19 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "connection_manager.h"
+#include "compression.h"
 #include "crc32.h"
 #include "message_header.h"
 #include "params.h"
 #include "spdlog.h"
 
+#include <algorithm>
 #include <arpa/inet.h>
+#include <chrono>
 #include <event2/buffer.h>
 #include <event2/listener.h>
 #include <event2/thread.h>
+#include <mutex>
 
 typedef struct sockaddr sockaddr_t;
 typedef struct sockaddr_in sockaddr_in_t;
@@ -58,12 +62,6 @@ static std::string Address2String(sockaddr_t* addr) {
     return std::string(buf) + ":" + std::to_string(ntohs(sin->sin_port));
 }
 
-static Connection* NewConnectionHandle(bufferevent_t* bev, bool inbound, std::string& remote, void* cmptr) {
-    auto handle = new Connection(bev, inbound, remote, (ConnectionManager*) cmptr);
-    ((ConnectionManager*) cmptr)->IncreaseNum(inbound);
-    return handle;
-}
-
 /**
  * read callback called by bufferevent
  * @param bev bufferevent
@@ -116,18 +114,26 @@ static void AcceptCallback(evconnlistener_t* listener, evutil_socket_t fd, socka
     std::string address = Address2String(addr);
     spdlog::info("[net] Socket accepted: {}", address);
 
-    /* create bufferevent and set callback */
-    event_base_t* base = evconnlistener_get_base(listener);
-    bufferevent_t* bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
-    auto handle        = NewConnectionHandle(bev, true, address, ctx);
-    ((ConnectionManager*) ctx)->NewConnectionCallback(handle->GetHandlePtr());
+    /* create bufferevent on one of the event loops and set callback */
+    auto cmptr         = (ConnectionManager*) ctx;
+    bufferevent_t* bev = bufferevent_socket_new(cmptr->NextBase(), fd, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
+    auto handle        = cmptr->NewConnectionHandle(bev, true, address);
+    cmptr->NewConnectionCallback(handle->GetHandlePtr());
     bufferevent_setcb(bev, ReadCallback, nullptr, EventCallback, handle);
     bufferevent_enable(bev, EV_READ);
 }
 
-ConnectionManager::ConnectionManager() : serialize_pool_(1), deserialize_pool_(1) {
+static size_t DefaultLoopNum() {
+    return std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+}
+
+ConnectionManager::ConnectionManager(size_t loop_num)
+    : worker_pool_(loop_num == 0 ? DefaultLoopNum() : loop_num) {
     evthread_use_pthreads();
-    base_ = event_base_new();
+    bases_.resize(worker_pool_.GetThreadSize());
+    for (auto& base : bases_) {
+        base = event_base_new();
+    }
 }
 
 ConnectionManager::~ConnectionManager() {
@@ -136,9 +142,65 @@ ConnectionManager::~ConnectionManager() {
         evconnlistener_free(listener_);
     }
 
-    if (base_) {
-        event_base_free(base_);
+    if (total_rate_group_) {
+        bufferevent_rate_limit_group_free(total_rate_group_);
+    }
+
+    if (peer_rate_cfg_) {
+        ev_token_bucket_cfg_free(peer_rate_cfg_);
+    }
+
+    for (auto base : bases_) {
+        if (base) {
+            event_base_free(base);
+        }
+    }
+}
+
+event_base_t* ConnectionManager::NextBase() {
+    return bases_[next_base_++ % bases_.size()];
+}
+
+Connection* ConnectionManager::NewConnectionHandle(bufferevent_t* bev, bool inbound, std::string& remote) {
+    auto handle = new Connection(bev, inbound, remote, this, worker_pool_);
+    IncreaseNum(inbound);
+
+    if (peer_rate_cfg_) {
+        bufferevent_set_rate_limit(bev, peer_rate_cfg_);
+    }
+    if (total_rate_group_) {
+        bufferevent_add_to_rate_limit_group(bev, total_rate_group_);
+    }
+    return handle;
+}
+
+/**
+ * create the config of token buckets refilled every second with one second of traffic
+ * @param download bytes per second, 0 means unlimited
+ * @param upload bytes per second, 0 means unlimited
+ */
+static ev_token_bucket_cfg_t* NewTokenBucketCfg(size_t download, size_t upload) {
+    download = download == 0 ? EV_RATE_LIMIT_MAX : std::min<size_t>(download, EV_RATE_LIMIT_MAX);
+    upload   = upload == 0 ? EV_RATE_LIMIT_MAX : std::min<size_t>(upload, EV_RATE_LIMIT_MAX);
+    return ev_token_bucket_cfg_new(download, download, upload, upload, nullptr);
+}
+
+void ConnectionManager::SetRateLimits(const RateLimits& limits) {
+    if (limits.peerUpload != 0 || limits.peerDownload != 0) {
+        /* the bufferevents refer to the config, so it lives as long as the connection manager */
+        peer_rate_cfg_ = NewTokenBucketCfg(limits.peerDownload, limits.peerUpload);
+    }
+
+    if (limits.totalUpload != 0 || limits.totalDownload != 0) {
+        /* the group copies the config */
+        auto cfg          = NewTokenBucketCfg(limits.totalDownload, limits.totalUpload);
+        total_rate_group_ = bufferevent_rate_limit_group_new(bases_.front(), cfg);
+        ev_token_bucket_cfg_free(cfg);
     }
+
+    spdlog::info("[net] Rate limits per peer: upload {} B/s, download {} B/s; total: upload {} B/s, download {} B/s "
+                 "(0 means unlimited)",
+                 limits.peerUpload, limits.peerDownload, limits.totalUpload, limits.totalDownload);
 }
 
 bool ConnectionManager::Bind(uint32_t ip) {
@@ -155,7 +217,7 @@ bool ConnectionManager::Bind(uint32_t ip) {
 bool ConnectionManager::Listen(uint16_t port) {
     sockaddr_t sock_addr;
     MakeSockaddr(&sock_addr, bind_ip_, port);
-    listener_ = evconnlistener_new_bind(base_, AcceptCallback, this,
+    listener_ = evconnlistener_new_bind(bases_.front(), AcceptCallback, this,
                                         LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE | LEV_OPT_THREADSAFE, -1, &sock_addr,
                                         sizeof(sock_addr));
 
@@ -180,8 +242,8 @@ bool ConnectionManager::Connect(uint32_t ip, uint16_t port) {
     std::string remote = Address2String(&sock_addr);
 
     /* create bufferevent and set callback */
-    bufferevent_t* bev = bufferevent_socket_new(base_, fd, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
-    auto handle        = NewConnectionHandle(bev, false, remote, this);
+    bufferevent_t* bev = bufferevent_socket_new(NextBase(), fd, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
+    auto handle        = NewConnectionHandle(bev, false, remote);
     bufferevent_setcb(bev, ReadCallback, nullptr, EventCallback, handle);
 
     if (bufferevent_socket_connect(bev, &sock_addr, sizeof(sock_addr)) != 0) {
@@ -195,11 +257,12 @@ bool ConnectionManager::Connect(uint32_t ip, uint16_t port) {
 }
 
 void ConnectionManager::Start() {
-    serialize_pool_.Start();
-    deserialize_pool_.Start();
-    /* thread for listen accept event callback and receive message to the queue */
-    thread_event_base_ = std::thread(event_base_loop, base_, EVLOOP_NO_EXIT_ON_EMPTY);
-    spdlog::info("[net] Connection manager start");
+    worker_pool_.Start();
+    /* threads for listen accept event callback and receive message to the queue */
+    for (auto base : bases_) {
+        loop_threads_.emplace_back(event_base_loop, base, EVLOOP_NO_EXIT_ON_EMPTY);
+    }
+    spdlog::info("[net] Connection manager start with {} event loops", bases_.size());
 }
 
 void ConnectionManager::QuitQueue() {
@@ -213,16 +276,18 @@ void ConnectionManager::Stop() {
         evconnlistener_disable(listener_);
     }
 
-    if (base_) {
-        event_base_loopexit(base_, nullptr);
+    for (auto base : bases_) {
+        event_base_loopexit(base, nullptr);
     }
 
-    if (thread_event_base_.joinable()) {
-        thread_event_base_.join();
+    for (auto& thread : loop_threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
     }
+    loop_threads_.clear();
 
-    serialize_pool_.Stop();
-    deserialize_pool_.Stop();
+    worker_pool_.Stop();
 
     spdlog::info("[net] Connection manager stopped.");
 }
@@ -231,43 +296,186 @@ bool ConnectionManager::ReceiveMessage(connection_message_t& message) {
     return receive_message_queue_.Take(message);
 }
 
+/**
+ * cleanup callback called by evbuffer when the referenced frame is no longer used
+ * @param extra the heap allocated reference to the frame
+ */
+static void ReleaseFrame(const void*, size_t, void* extra) {
+    delete (shared_frame_t*) extra;
+}
+
 void ConnectionManager::WriteOneMessage_(shared_connection_t connection, unique_message_t& message) {
-    serialize_pool_.Execute([connection, message = std::move(message), this]() {
-        VStream s;
-        message->NetSerialize(s);
-        if (!s.empty()) {
-            s << crc32c((uint8_t*) s.data(), s.size());
+    connection->GetSendStrand().Execute([connection, message = std::move(message), this]() {
+        auto frame = SerializeFrame_(*message, message->GetCount(), connection->GetCodec());
+        if (frame) {
+            WriteFrame_(connection, frame);
         }
+    });
+}
 
-        message_header_t header;
-        header.magic     = GetParams().magic;
-        header.type      = message->GetType();
-        header.countDown = message->GetCount();
-        header.length    = s.size();
-        header.checksum  = header.magic + header.type + header.countDown + header.length;
+void ConnectionManager::Broadcast(std::vector<shared_connection_t> connections, shared_message_t message) {
+    if (connections.empty()) {
+        return;
+    }
 
-        if (header.length + MESSAGE_HEADER_LENGTH > MAX_MESSAGE_LENGTH) {
-            spdlog::info("[net] Ignoring message with length {} exceeds max bytes {}",
-                         header.length + MESSAGE_HEADER_LENGTH, MAX_MESSAGE_LENGTH);
-            return;
+    /* the first connection that gets to the message serializes it for all the others using the same codec,
+     * so that the frame is still ordered with the other messages sent to each of the connections */
+    struct SharedFrame {
+        std::array<std::once_flag, CODEC_NUM> once;
+        std::array<shared_frame_t, CODEC_NUM> frames;
+    };
+    auto shared    = std::make_shared<SharedFrame>();
+    auto countDown = message->GetCount();
+    size_t fanout  = 0;
+
+    for (auto& connection : connections) {
+        if (!connection->IsValid()) {
+            continue;
         }
 
-        evbuffer_t* send_buffer = evbuffer_new();
+        connection->GetSendStrand().Execute([connection, message, shared, countDown, this]() {
+            uint16_t codec = connection->GetCodec();
+            std::call_once(shared->once[codec],
+                           [&]() { shared->frames[codec] = SerializeFrame_(*message, countDown, codec); });
+            if (shared->frames[codec]) {
+                WriteFrame_(connection, shared->frames[codec]);
+            }
+        });
+        fanout++;
+    }
 
-        /* write message header bytes */
-        evbuffer_add(send_buffer, &header, sizeof(message_header_t));
+    broadcast_num_[message->GetType()] += 1;
+    broadcast_fanout_[message->GetType()] += fanout;
+    spdlog::trace("[net] Broadcast message type {} to {} connections", message->GetType(), fanout);
+}
 
-        /* write message payload bytes */
-        if (header.length != 0) {
-            evbuffer_add(send_buffer, s.data(), header.length);
-        }
+shared_frame_t ConnectionManager::SerializeFrame_(const NetMessage& message, uint8_t countDown, uint16_t codec) {
+    auto frame = std::make_shared<VStream>();
 
-        bufferevent_write_buffer(connection->GetBev(), send_buffer);
-        send_bytes_ += header.length;
-        send_packages_ += 1;
+    /* reserve the header and fill it in after the payload is known */
+    message_header_t header{};
+    frame->write((char*) &header, sizeof(message_header_t));
 
+    message.NetSerialize(*frame);
+    size_t payload_length = frame->size() - sizeof(message_header_t);
+    if (codec != CODEC_NONE && payload_length >= kCompressionThreshold && CompressPayload_(*frame, codec)) {
+        header.reserved = codec;
+        payload_length  = frame->size() - sizeof(message_header_t);
+    }
+    if (payload_length != 0) {
+        *frame << crc32c((uint8_t*) frame->data() + sizeof(message_header_t), payload_length);
+    }
+
+    header.magic     = GetParams().magic;
+    header.type      = message.GetType();
+    header.countDown = countDown;
+    header.length    = frame->size() - sizeof(message_header_t);
+    header.checksum  = header.magic + header.type + header.countDown + header.reserved + header.length;
+
+    if (header.length + MESSAGE_HEADER_LENGTH > MAX_MESSAGE_LENGTH) {
+        spdlog::info("[net] Ignoring message with length {} exceeds max bytes {}",
+                     header.length + MESSAGE_HEADER_LENGTH, MAX_MESSAGE_LENGTH);
+        return nullptr;
+    }
+
+    memcpy(frame->data(), &header, sizeof(message_header_t));
+    return frame;
+}
+
+bool ConnectionManager::CompressPayload_(VStream& frame, uint16_t codec) {
+    const size_t header_length = sizeof(message_header_t);
+    uint32_t raw_length        = frame.size() - header_length;
+    size_t bound               = CompressBound(codec, raw_length);
+    if (bound == 0) {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    VStream compressed;
+    compressed.resize(header_length + sizeof(raw_length) + bound);
+    memcpy(compressed.data() + header_length, &raw_length, sizeof(raw_length));
+    size_t compressed_length = Compress(codec, frame.data() + header_length, raw_length,
+                                        compressed.data() + header_length + sizeof(raw_length), bound);
+
+    compress_micros_ +=
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    if (compressed_length == 0 || compressed_length + sizeof(raw_length) >= raw_length) {
+        incompressible_frames_ += 1;
+        return false;
+    }
+
+    compressed.resize(header_length + sizeof(raw_length) + compressed_length);
+    frame = std::move(compressed);
+
+    compressed_frames_ += 1;
+    compress_raw_bytes_ += raw_length;
+    compressed_bytes_ += compressed_length + sizeof(raw_length);
+    return true;
+}
+
+std::unique_ptr<VStream> ConnectionManager::DecompressPayload_(uint16_t codec, const VStream& payload) {
+    uint32_t raw_length = 0;
+    if (payload.size() < sizeof(raw_length)) {
+        return nullptr;
+    }
+    memcpy(&raw_length, payload.data(), sizeof(raw_length));
+
+    /* bound the memory taken by a forged raw size before allocating it, both in the same way as
+     * an uncompressed message and by what the codec is able to restore from the payload */
+    size_t compressed_length = payload.size() - sizeof(raw_length);
+    if (!IsCodecAvailable(codec) || raw_length > MAX_MESSAGE_LENGTH ||
+        raw_length > DecompressBound(codec, compressed_length)) {
+        return nullptr;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto raw = std::make_unique<VStream>();
+    raw->resize(raw_length);
+    bool success = Decompress(codec, payload.data() + sizeof(raw_length), compressed_length, raw->data(), raw_length);
+
+    decompress_micros_ +=
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    if (!success) {
+        return nullptr;
+    }
+    decompressed_frames_ += 1;
+    return raw;
+}
+
+void ConnectionManager::WriteFrame_(const shared_connection_t& connection, const shared_frame_t& frame) {
+    evbuffer_t* send_buffer = evbuffer_new();
+
+    /* the evbuffer holds a reference of the frame until the bytes are sent */
+    auto reference = new shared_frame_t(frame);
+    if (evbuffer_add_reference(send_buffer, frame->data(), frame->size(), ReleaseFrame, reference) != 0) {
+        delete reference;
         evbuffer_free(send_buffer);
-    });
+        return;
+    }
+
+    bufferevent_write_buffer(connection->GetBev(), send_buffer);
+    send_bytes_ += frame->size() - sizeof(message_header_t);
+    send_packages_ += 1;
+    connection->CountSent(((const message_header_t*) frame->data())->type, frame->size());
+
+    evbuffer_free(send_buffer);
+}
+
+size_t ConnectionManager::GetBroadcastNum(NetMessage::Type type) const {
+    return broadcast_num_.at(type);
+}
+
+size_t ConnectionManager::GetBroadcastFanout(NetMessage::Type type) const {
+    return broadcast_fanout_.at(type);
+}
+
+ConnectionManager::CompressionStats ConnectionManager::GetCompressionStats() const {
+    return {compressed_frames_, compress_raw_bytes_,  compressed_bytes_,    incompressible_frames_,
+            compress_micros_,   decompressed_frames_, decompress_failures_, decompress_micros_};
 }
 
 void ConnectionManager::ReadMessages(bufferevent_t* bev, Connection* handle) {
@@ -356,6 +564,7 @@ bool ConnectionManager::ReadOneMessage_(bufferevent_t* bev, Connection* handle)
         if (receive_length >= read_length) {
             message_header_t header;
             bufferevent_read(bev, &header, sizeof(header));
+            handle->CountReceived(header.type, read_length);
 
             auto payload   = std::make_unique<VStream>();
             uint32_t crc32 = 0;
@@ -365,12 +574,29 @@ bool ConnectionManager::ReadOneMessage_(bufferevent_t* bev, Connection* handle)
                 bufferevent_read(bev, &crc32, sizeof(crc32));
             }
 
-            deserialize_pool_.Execute(
+            handle->GetReceiveStrand().Execute(
                 [header, payload = std::move(payload), crc32, handle = handle->GetHandlePtr(), this]() {
                     if (header.length == 0 || crc32c((uint8_t*) payload->data(), payload->size()) == crc32) {
                         receive_bytes_ += header.length + MESSAGE_HEADER_LENGTH;
                         receive_packages_ += 1;
-                        unique_message_t message = NetMessage::MessageFactory(header.type, header.countDown, *payload);
+
+                        /* decompress on the worker thread as the checksum covers the bytes on the wire */
+                        VStream* raw = payload.get();
+                        std::unique_ptr<VStream> decompressed;
+                        if (header.reserved != CODEC_NONE) {
+                            decompressed = DecompressPayload_(header.reserved, *payload);
+                            if (!decompressed) {
+                                /* only a faulty or malicious peer sends a frame we are unable to restore */
+                                decompress_failures_ += 1;
+                                spdlog::warn("[net] Failed to decompress a frame of codec {} from {}, disconnect it",
+                                             header.reserved, handle->GetRemote());
+                                handle->Disconnect();
+                                return;
+                            }
+                            raw = decompressed.get();
+                        }
+
+                        unique_message_t message = NetMessage::MessageFactory(header.type, header.countDown, *raw);
                         if (message->GetType() != NetMessage::NONE) {
                             receive_message_queue_.Put(std::make_pair(handle, std::move(message)));
                         }
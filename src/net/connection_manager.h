@@ -8,17 +8,52 @@
 #include "connection.h"
 #include "threadpool.h"
 
+#include <array>
+
 typedef std::pair<shared_connection_t, unique_message_t> connection_message_t;
 typedef std::function<void(shared_connection_t&)> connection_callback_t;
+typedef std::shared_ptr<const VStream> shared_frame_t;
 
 typedef struct event_base event_base_t;
 typedef struct evconnlistener evconnlistener_t;
 typedef struct evbuffer evbuffer_t;
+typedef struct ev_token_bucket_cfg ev_token_bucket_cfg_t;
+typedef struct bufferevent_rate_limit_group bufferevent_rate_limit_group_t;
 
 
 class ConnectionManager {
 public:
-    ConnectionManager();
+    struct CompressionStats {
+        // frames sent compressed and their payload bytes before and after the compression
+        size_t compressedFrames;
+        size_t rawBytes;
+        size_t compressedBytes;
+        // frames above the threshold which did not get any smaller
+        size_t incompressibleFrames;
+        uint64_t compressMicros;
+
+        size_t decompressedFrames;
+        size_t decompressFailures;
+        uint64_t decompressMicros;
+
+        double Ratio() const {
+            return rawBytes == 0 ? 1.0 : (double) compressedBytes / rawBytes;
+        }
+    };
+
+    /* in bytes per second, 0 means unlimited */
+    struct RateLimits {
+        size_t peerUpload    = 0;
+        size_t peerDownload  = 0;
+        size_t totalUpload   = 0;
+        size_t totalDownload = 0;
+    };
+
+    /*
+     * @param loop_num the number of event loops sharing the connections,
+     * 0 means choosing it by the hardware concurrency
+     */
+    explicit ConnectionManager(size_t loop_num = 0);
     virtual ~ConnectionManager();
 
     /**
@@ -45,6 +80,13 @@ public:
     void Start();
     void Stop();
 
+    /*
+     * limit the bandwidth of each connection and of all the connections together with token buckets,
+     * which refill every second up to one second of traffic; must be called before any connection is created
+     * @param limits
+     */
+    void SetRateLimits(const RateLimits& limits);
+
     /*
      * set the callback function when a new socket accepted or connected
      * @param callback_func
@@ -96,6 +138,17 @@ public:
      */
     void ReadMessages(bufferevent_t* bev, Connection* handle);
 
+    /*
+     * the internal function to pick the event loop of a new connection in round-robin
+     * @return event_base
+     */
+    event_base_t* NextBase();
+
+    /*
+     * the internal function to create the handle of a new connection
+     */
+    Connection* NewConnectionHandle(bufferevent_t* bev, bool inbound, std::string& remote);
+
     void IncreaseNum(bool inbound) {
         inbound ? inbound_num_++ : outbound_num_++;
     }
@@ -110,15 +163,41 @@ public:
 
     uint32_t GetConnectionNum() const;
 
+    size_t GetLoopNum() const {
+        return bases_.size();
+    }
+
     void QuitQueue();
 
+    /*
+     * serialize the message only once and write the same immutable bytes to all the connections;
+     * the countdown of the message is taken when this function is called
+     * @param connections
+     * @param message
+     */
+    void Broadcast(std::vector<shared_connection_t> connections, shared_message_t message);
+
+    /*
+     * the number of broadcasts of the given message type
+     */
+    size_t GetBroadcastNum(NetMessage::Type type) const;
+
+    /*
+     * the number of connections that the broadcasts of the given message type were written to
+     */
+    size_t GetBroadcastFanout(NetMessage::Type type) const;
+
+    CompressionStats GetCompressionStats() const;
+
 private:
-    event_base_t* base_                               = nullptr;
     evconnlistener_t* listener_                       = nullptr;
     connection_callback_t new_connection_callback_    = nullptr;
     connection_callback_t delete_connection_callback_ = nullptr;
 
-    std::thread thread_event_base_;
+    /* the listener runs on the first event loop */
+    std::vector<event_base_t*> bases_;
+    std::vector<std::thread> loop_threads_;
+    std::atomic_size_t next_base_ = 0;
 
     BlockingQueue<connection_message_t> receive_message_queue_;
 
@@ -135,13 +214,58 @@ private:
     std::atomic_size_t checksum_error_bytes_    = 0;
     std::atomic_size_t checksum_error_packages_ = 0;
 
-    ThreadPool serialize_pool_;
+    std::array<std::atomic_size_t, NetMessage::NONE + 1> broadcast_num_{};
+    std::array<std::atomic_size_t, NetMessage::NONE + 1> broadcast_fanout_{};
+
+    std::atomic_size_t compressed_frames_     = 0;
+    std::atomic_size_t compress_raw_bytes_    = 0;
+    std::atomic_size_t compressed_bytes_      = 0;
+    std::atomic_size_t incompressible_frames_ = 0;
+    std::atomic_uint64_t compress_micros_     = 0;
+    std::atomic_size_t decompressed_frames_   = 0;
+    std::atomic_size_t decompress_failures_   = 0;
+    std::atomic_uint64_t decompress_micros_   = 0;
 
-    ThreadPool deserialize_pool_;
+    ev_token_bucket_cfg_t* peer_rate_cfg_             = nullptr;
+    bufferevent_rate_limit_group_t* total_rate_group_ = nullptr;
 
+    /* the shared pool running the ordered per-connection serialization and deserialization */
+    ThreadPool worker_pool_;
 
     void WriteOneMessage_(shared_connection_t connection, unique_message_t& message);
 
+    /*
+     * serialize a message into a complete frame including the message header
+     * @param message
+     * @param countDown the countdown written into the header
+     * @param codec the codec negotiated with the receiver, used if the payload is large enough
+     * @return nullptr if the message exceeds the max length
+     */
+    shared_frame_t SerializeFrame_(const NetMessage& message, uint8_t countDown, uint16_t codec);
+
+    /*
+     * replace the payload following the header with its raw size and the compressed bytes
+     * @param frame
+     * @param codec
+     * @return false if the frame is left as it is because the compression does not pay off
+     */
+    bool CompressPayload_(VStream& frame, uint16_t codec);
+
+    /*
+     * restore the payload of a compressed frame
+     * @param codec the codec in the header
+     * @param payload the raw size followed by the compressed bytes
+     * @return nullptr if the payload is malformed
+     */
+    std::unique_ptr<VStream> DecompressPayload_(uint16_t codec, const VStream& payload);
+
+    /*
+     * append a reference to the frame to the output buffer of the connection without copying it
+     * @param connection
+     * @param frame
+     */
+    void WriteFrame_(const shared_connection_t& connection, const shared_frame_t& frame);
+
     /*
      * read one message from the input buffer, if success then put the message into receive queue
      * @param bev bufferevent
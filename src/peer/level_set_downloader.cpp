@@ -0,0 +1,368 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "level_set_downloader.h"
+#include "dag_manager.h"
+#include "peer.h"
+
+#include <algorithm>
+
+void LevelSetDownloader::Enqueue(const std::vector<uint256>& hashes,
+                                 const std::vector<bool>& consecutive,
+                                 const PeerPtr& from,
+                                 const std::vector<PeerPtr>& peers) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    AddPeer(from);
+    for (const auto& p : peers) {
+        AddPeer(p);
+    }
+
+    // only runs of consecutive milestones may be requested by a single GetLvsRange
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        queue_.push_back({nextSeq_++, hashes[i], i > 0 && i < consecutive.size() && consecutive[i], {}});
+    }
+
+    Schedule();
+}
+
+bool LevelSetDownloader::OnBundle(const std::shared_ptr<Bundle>& bundle, const PeerPtr& peer) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = inflight_.find(bundle->nonce);
+    if (it == inflight_.end() || it->second.peer.lock() != peer) {
+        return false;
+    }
+
+    Batch batch = std::move(it->second);
+    inflight_.erase(it);
+
+    // a level set starts with the milestone we asked for; anything else is taken as not found
+    std::vector<std::shared_ptr<Bundle>> bundles;
+    if (!bundle->blocks.empty()) {
+        if (bundle->blocks.front()->GetHash() == batch.requests.front().hash) {
+            bundles.push_back(bundle);
+        } else {
+            spdlog::debug("Unexpected level set {} in bundle from {}", bundle->blocks.front()->GetHash().to_substr(),
+                          peer->address.ToString());
+        }
+    }
+    OnResponse(batch, peer, std::move(bundles));
+    return true;
+}
+
+bool LevelSetDownloader::OnLvsRange(const std::shared_ptr<LvsRange>& range, const PeerPtr& peer) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = inflight_.find(range->nonce);
+    if (it == inflight_.end() || it->second.peer.lock() != peer) {
+        return false;
+    }
+
+    Batch batch = std::move(it->second);
+    inflight_.erase(it);
+
+    // each level set starts with the milestone we asked for
+    std::vector<std::shared_ptr<Bundle>> bundles;
+    auto& blocks = range->blocks;
+    size_t pos   = 0;
+    for (size_t i = 0; i < batch.requests.size() && pos < blocks.size(); ++i) {
+        if (blocks[pos]->GetHash() != batch.requests[i].hash) {
+            spdlog::debug("Unexpected level set {} in range from {}", blocks[pos]->GetHash().to_substr(),
+                          peer->address.ToString());
+            break;
+        }
+
+        auto bundle = std::make_shared<Bundle>(range->nonce);
+        bundle->AddBlock(blocks[pos++]);
+        while (pos < blocks.size() &&
+               (i + 1 == batch.requests.size() || blocks[pos]->GetHash() != batch.requests[i + 1].hash)) {
+            bundle->AddBlock(blocks[pos++]);
+        }
+        bundles.push_back(std::move(bundle));
+    }
+
+    OnResponse(batch, peer, std::move(bundles));
+    return true;
+}
+
+bool LevelSetDownloader::OnNotFound(uint32_t nonce, const PeerPtr& peer) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = inflight_.find(nonce);
+    if (it == inflight_.end() || it->second.peer.lock() != peer) {
+        return false;
+    }
+
+    Batch batch = std::move(it->second);
+    inflight_.erase(it);
+
+    spdlog::debug("Level set {} not found by {}", batch.requests.front().hash.to_substr(), peer->address.ToString());
+    OnResponse(batch, peer, {});
+    return true;
+}
+
+void LevelSetDownloader::RemovePeer(const Peer* peer) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    DropPeer(peer);
+    GiveUpUnavailable();
+    DeliverReady();
+    Schedule();
+}
+
+void LevelSetDownloader::Expire(const std::vector<PeerPtr>& peers) {
+    std::vector<PeerPtr> toDisconnect;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        for (const auto& p : peers) {
+            AddPeer(p);
+        }
+
+        std::vector<const Peer*> gone;
+        for (auto& [key, state] : peers_) {
+            auto p = state.peer.lock();
+            if (!p || !p->IsVaild()) {
+                gone.push_back(key);
+            }
+        }
+        for (auto key : gone) {
+            DropPeer(key);
+        }
+
+        auto now = clock::now();
+        for (auto it = inflight_.begin(); it != inflight_.end();) {
+            if (now - it->second.sent < requestTimeout_) {
+                ++it;
+                continue;
+            }
+
+            Batch batch = std::move(it->second);
+            it          = inflight_.erase(it);
+
+            auto p = batch.peer.lock();
+            if (p) {
+                auto& state = AddPeer(p);
+                state.inflight -= std::min(state.inflight, batch.requests.size());
+                state.timeouts++;
+                state.window = std::max(1.0, state.window / 2);
+                if (++state.strikes == kMaxStrikes) {
+                    toDisconnect.push_back(p);
+                }
+                spdlog::debug("Level set {} timed out at {}", batch.requests.front().hash.to_substr(),
+                              p->address.ToString());
+            }
+
+            for (auto& request : batch.requests) {
+                if (p) {
+                    request.failed.insert(p.get());
+                }
+                Requeue(std::move(request));
+            }
+        }
+
+        GiveUpUnavailable();
+        DeliverReady();
+        Schedule();
+    }
+
+    for (auto& p : toDisconnect) {
+        spdlog::info("Peer {} keeps timing out on level set requests. Disconnect it", p->address.ToString());
+        p->Disconnect();
+    }
+}
+
+bool LevelSetDownloader::Empty() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return queue_.empty() && inflight_.empty() && received_.empty();
+}
+
+std::vector<LevelSetDownloader::PeerStats> LevelSetDownloader::GetStats() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    std::vector<PeerStats> stats;
+    for (const auto& [key, state] : peers_) {
+        if (auto p = state.peer.lock()) {
+            stats.push_back({p->address.ToString(), static_cast<size_t>(state.window), state.inflight, state.latency,
+                             state.received, state.timeouts});
+        }
+    }
+    return stats;
+}
+
+LevelSetDownloader::PeerState& LevelSetDownloader::AddPeer(const PeerPtr& peer) {
+    auto& state = peers_[peer.get()];
+    if (state.peer.lock() != peer) {
+        // a new peer, possibly allocated at the address of a removed one
+        state      = PeerState();
+        state.peer = peer;
+    }
+    return state;
+}
+
+void LevelSetDownloader::OnResponse(Batch& batch, const PeerPtr& peer, std::vector<std::shared_ptr<Bundle>> bundles) {
+    auto& state = AddPeer(peer);
+    state.inflight -= std::min(state.inflight, batch.requests.size());
+
+    if (!bundles.empty()) {
+        double sample = std::chrono::duration<double>(clock::now() - batch.sent).count();
+        state.latency = state.received ? 0.8 * state.latency + 0.2 * sample : sample;
+        state.strikes = 0;
+        state.received += bundles.size();
+
+        // the window that keeps the peer busy for the target latency at the rate it responds
+        double desired = (state.inflight + bundles.size()) * kTargetLatency / std::max(state.latency, 0.001);
+        double limit   = peer->SupportsLvsRange() ? kMaxRangeWindow : kMaxWindow;
+        state.window   = std::clamp(0.75 * state.window + 0.25 * desired, 1.0, limit);
+    }
+
+    // the level sets not provided go to other peers
+    for (size_t i = 0; i < batch.requests.size(); ++i) {
+        auto& request = batch.requests[i];
+        if (i < bundles.size()) {
+            received_.emplace(request.seq, std::make_pair(std::move(bundles[i]), std::weak_ptr<Peer>(peer)));
+        } else {
+            // a range may be cut short, which does not mean the rest is missing
+            if (bundles.empty()) {
+                request.failed.insert(peer.get());
+            }
+            Requeue(std::move(request));
+        }
+    }
+
+    GiveUpUnavailable();
+    DeliverReady();
+    Schedule();
+}
+
+void LevelSetDownloader::Requeue(Request&& request) {
+    auto pos = std::upper_bound(queue_.begin(), queue_.end(), request.seq,
+                                [](uint64_t seq, const Request& r) { return seq < r.seq; });
+    queue_.insert(pos, std::move(request));
+}
+
+void LevelSetDownloader::DropPeer(const Peer* peer) {
+    for (auto it = inflight_.begin(); it != inflight_.end();) {
+        auto p = it->second.peer.lock();
+        if (!p || p.get() == peer) {
+            for (auto& request : it->second.requests) {
+                Requeue(std::move(request));
+            }
+            it = inflight_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    peers_.erase(peer);
+}
+
+void LevelSetDownloader::GiveUpUnavailable() {
+    std::vector<const Peer*> live;
+    for (auto& [key, state] : peers_) {
+        auto p = state.peer.lock();
+        if (p && p->IsVaild()) {
+            live.push_back(key);
+        }
+    }
+
+    for (auto it = queue_.begin(); it != queue_.end();) {
+        bool available = std::any_of(live.begin(), live.end(), [&](const Peer* p) { return !it->failed.count(p); });
+        if (available) {
+            ++it;
+            continue;
+        }
+
+        // none of the peers can provide it; let the next round of sync request it again
+        spdlog::debug("Giving up level set {}", it->hash.to_substr());
+        DAG->EraseDownloading(it->hash);
+        received_.emplace(it->seq, std::make_pair(nullptr, std::weak_ptr<Peer>()));
+        it = queue_.erase(it);
+    }
+}
+
+void LevelSetDownloader::Schedule() {
+    // hand out batches to the peers in turn until the windows are full
+    bool progress = true;
+    while (progress && !queue_.empty()) {
+        progress = false;
+        for (auto& [key, state] : peers_) {
+            auto peer = state.peer.lock();
+            if (!peer || !peer->IsVaild()) {
+                continue;
+            }
+
+            bool range    = peer->SupportsLvsRange();
+            size_t window = state.window;
+            size_t room   = window > state.inflight ? window - state.inflight : 0;
+            room          = std::min(room, range ? GetLvsRange::kMaxRangeSize : batchSize_);
+            if (room == 0) {
+                continue;
+            }
+
+            Batch batch;
+            for (auto it = queue_.begin(); it != queue_.end() && batch.requests.size() < room;) {
+                bool eligible = !it->failed.count(key);
+                if (range && !batch.requests.empty()) {
+                    // a range must be a run of consecutive milestones
+                    if (!eligible || !it->consecutive || it->seq != batch.requests.back().seq + 1) {
+                        break;
+                    }
+                } else if (!eligible) {
+                    ++it;
+                    continue;
+                }
+
+                batch.requests.push_back(std::move(*it));
+                it = queue_.erase(it);
+            }
+
+            if (batch.requests.empty()) {
+                continue;
+            }
+
+            batch.peer = peer;
+            batch.sent = clock::now();
+            state.inflight += batch.requests.size();
+            spdlog::debug("Requesting lvs {} to {} from {}", batch.requests.front().hash.to_substr(),
+                          batch.requests.back().hash.to_substr(), peer->address.ToString());
+
+            if (range) {
+                uint32_t nonce = GetNewNonce();
+                peer->SendMessage(std::make_unique<GetLvsRange>(batch.requests.front().hash,
+                                                                batch.requests.back().hash, nonce));
+                inflight_.emplace(nonce, std::move(batch));
+            } else {
+                // level sets requested with GetData are answered one bundle each
+                auto message = std::make_unique<GetData>(GetDataTask::LEVEL_SET);
+                for (auto& request : batch.requests) {
+                    uint32_t nonce = GetNewNonce();
+                    message->AddItem(request.hash, nonce);
+                    inflight_.emplace(nonce, Batch{{std::move(request)}, batch.peer, batch.sent});
+                }
+                peer->SendMessage(std::move(message));
+            }
+            progress = true;
+        }
+    }
+}
+
+void LevelSetDownloader::DeliverReady() {
+    while (!received_.empty() && received_.begin()->first == nextDeliver_) {
+        auto& [bundle, weakPeer] = received_.begin()->second;
+        if (bundle) {
+            auto peer = weakPeer.lock();
+            if (peer) {
+                peer->last_bundle_ms_time = bundle->blocks.front()->GetTime();
+            }
+
+            if (deliver_) {
+                deliver_(bundle, peer);
+            } else {
+                // the milestone comes first in the bundle and is added last
+                for (size_t i = 1; i < bundle->blocks.size(); ++i) {
+                    DAG->AddNewBlock(bundle->blocks[i], peer);
+                }
+                DAG->AddNewBlock(bundle->blocks[0], peer);
+            }
+            spdlog::info("Received levelset ms {}", bundle->blocks.front()->GetHash().to_substr());
+        }
+
+        received_.erase(received_.begin());
+        nextDeliver_++;
+    }
+}
@@ -0,0 +1,176 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_LEVEL_SET_DOWNLOADER_H
+#define EPIC_LEVEL_SET_DOWNLOADER_H
+
+#include "sync_messages.h"
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Peer;
+using PeerPtr = std::shared_ptr<Peer>;
+
+/**
+ * Downloads the level sets announced in an Inv from all the sync-capable peers.
+ *
+ * Peers supporting GetLvsRange are asked for runs of consecutive level sets
+ * in one message, the others with GetData batches. Each peer has a sliding
+ * window of outstanding level sets, sized to the
+ * bandwidth-delay product measured from its responses. Requests that time
+ * out or are not found are moved to other peers, and the bundles are handed
+ * to the DAG in the order of the Inv no matter which peer sent them.
+ */
+class LevelSetDownloader {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // takes over a level set downloaded, whose milestone comes first in the bundle
+    using DeliverFunc = std::function<void(const std::shared_ptr<Bundle>&, const PeerPtr&)>;
+
+    struct PeerStats {
+        std::string address;
+        size_t window;
+        size_t inflight;
+        double latency; // in seconds
+        size_t received;
+        size_t timeouts;
+    };
+
+    /**
+     * @param batchSize max number of level sets requested by a GetData
+     * @param deliver receives the level sets in the order of the Inv; they are added to the DAG if not given
+     * @param requestTimeout time after which a request is moved to another peer
+     */
+    explicit LevelSetDownloader(size_t batchSize,
+                                DeliverFunc deliver            = {},
+                                clock::duration requestTimeout = kRequestTimeout)
+        : batchSize_(batchSize), deliver_(std::move(deliver)), requestTimeout_(requestTimeout) {}
+
+    /**
+     * queues the level sets with the given milestone hashes in the chain order
+     * @param consecutive whether each hash directly follows the previous one in the chain,
+     * i.e. none has been skipped in between
+     * @param from the peer sending the Inv, which is known to have them
+     * @param peers other peers to share the download
+     */
+    void Enqueue(const std::vector<uint256>& hashes,
+                 const std::vector<bool>& consecutive,
+                 const PeerPtr& from,
+                 const std::vector<PeerPtr>& peers);
+
+    /**
+     * @return false if the bundle does not answer a level set request to the peer
+     */
+    bool OnBundle(const std::shared_ptr<Bundle>& bundle, const PeerPtr& peer);
+
+    /**
+     * splits the range into level sets and moves the ones cut off to other peers
+     * @return false if the range does not answer a GetLvsRange to the peer
+     */
+    bool OnLvsRange(const std::shared_ptr<LvsRange>& range, const PeerPtr& peer);
+
+    /**
+     * moves the request to another peer
+     * @return false if the nonce does not belong to a level set request to the peer
+     */
+    bool OnNotFound(uint32_t nonce, const PeerPtr& peer);
+
+    /**
+     * moves the outstanding requests of the peer to the others
+     */
+    void RemovePeer(const Peer* peer);
+
+    /**
+     * moves the timed out requests to other peers, given the peers now available;
+     * peers that keep timing out are disconnected
+     */
+    void Expire(const std::vector<PeerPtr>& peers);
+
+    bool Empty() const;
+
+    std::vector<PeerStats> GetStats() const;
+
+private:
+    struct Request {
+        uint64_t seq;
+        uint256 hash;
+        // whether it directly follows the previous one in the chain
+        bool consecutive;
+        // peers that failed to provide it
+        std::unordered_set<const Peer*> failed;
+    };
+
+    // requests answered by a single message
+    struct Batch {
+        std::vector<Request> requests;
+        std::weak_ptr<Peer> peer;
+        clock::time_point sent;
+    };
+
+    struct PeerState {
+        std::weak_ptr<Peer> peer;
+        double window   = kInitialWindow;
+        size_t inflight = 0;
+        double latency  = 0;
+        size_t received = 0;
+        size_t timeouts = 0;
+        // consecutive timeouts, reset by a response
+        size_t strikes = 0;
+    };
+
+    constexpr static double kInitialWindow  = 8;
+    constexpr static double kMaxWindow      = 64;
+    constexpr static double kMaxRangeWindow = 4 * GetLvsRange::kMaxRangeSize;
+
+    // responses are expected within this time, which the windows are sized for
+    constexpr static double kTargetLatency = 2;
+
+    // default time after which a request is moved to another peer
+    constexpr static std::chrono::seconds kRequestTimeout{30};
+
+    // number of consecutive timeouts after which a peer is disconnected
+    const static size_t kMaxStrikes = 3;
+
+    const size_t batchSize_;
+    const DeliverFunc deliver_;
+    const clock::duration requestTimeout_;
+
+    mutable std::mutex mutex_;
+
+    // requests waiting for a peer, in the chain order
+    std::deque<Request> queue_;
+
+    // requests sent out, by the nonce of the response
+    std::unordered_map<uint32_t, Batch> inflight_;
+
+    std::unordered_map<const Peer*, PeerState> peers_;
+
+    // bundles received ahead of the next one to deliver, by sequence number;
+    // null for the level sets that have been given up
+    std::map<uint64_t, std::pair<std::shared_ptr<Bundle>, std::weak_ptr<Peer>>> received_;
+
+    uint64_t nextSeq_     = 0;
+    uint64_t nextDeliver_ = 0;
+
+    // The following methods require the mutex to be held
+    PeerState& AddPeer(const PeerPtr& peer);
+    void OnResponse(Batch& batch, const PeerPtr& peer, std::vector<std::shared_ptr<Bundle>> bundles);
+    void Requeue(Request&& request);
+    void DropPeer(const Peer* peer);
+    void GiveUpUnavailable();
+    void Schedule();
+    void DeliverReady();
+};
+
+#endif // EPIC_LEVEL_SET_DOWNLOADER_H
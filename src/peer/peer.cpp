@@ -4,8 +4,12 @@
 
 #include "peer.h"
 #include "block_store.h"
+#include "compression.h"
 #include "mempool.h"
 
+#include <chrono>
+#include <numeric>
+
 Peer::Peer(NetAddress& netAddress,
            shared_connection_t connection,
            bool isSeedPeer,
@@ -54,12 +58,51 @@ void Peer::ProcessMessage(unique_message_t& msg) {
                 ProcessBundle(std::shared_ptr<Bundle>(dynamic_cast<Bundle*>(msg.release())));
                 break;
             }
+            case NetMessage::GET_LVS_RANGE: {
+                auto* getRange = dynamic_cast<GetLvsRange*>(msg.get());
+                DAG->RespondRequestLvsRange(getRange->startHash, getRange->endHash, getRange->nonce,
+                                            weak_peer_.lock());
+                break;
+            }
+            case NetMessage::LVS_RANGE: {
+                auto range = std::shared_ptr<LvsRange>(dynamic_cast<LvsRange*>(msg.release()));
+                if (!DAG->GetDownloader().OnLvsRange(range, weak_peer_.lock())) {
+                    spdlog::debug("Unknown level set range: nonce = {}, msg from {}", range->nonce,
+                                  address.ToString());
+                }
+                break;
+            }
+            case NetMessage::GET_MS_HEADERS: {
+                auto* getHeaders = dynamic_cast<GetMsHeaders*>(msg.get());
+                if (getHeaders->locator.empty()) {
+                    throw ProtocolException("Locator size = 0, msg from " + address.ToString());
+                }
+                DAG->RespondRequestMsHeaders(getHeaders->locator, getHeaders->nonce, weak_peer_.lock());
+                break;
+            }
+            case NetMessage::MS_HEADERS: {
+                DAG->CallbackRequestMsHeaders(std::unique_ptr<MsHeaders>(dynamic_cast<MsHeaders*>(msg.release())),
+                                              weak_peer_.lock());
+                break;
+            }
             case NetMessage::NOT_FOUND: {
                 auto* notfound = dynamic_cast<NotFound*>(msg.get());
                 spdlog::warn("Block not found: {}", std::to_string(notfound->hash));
                 ProcessNotFound(notfound->nonce);
                 break;
             }
+            case NetMessage::COMPACT_BLOCK: {
+                ProcessCompactBlock(std::unique_ptr<CompactBlock>(dynamic_cast<CompactBlock*>(msg.release())));
+                break;
+            }
+            case NetMessage::GET_BLOCK_TXN: {
+                ProcessGetBlockTxn(*dynamic_cast<GetBlockTxn*>(msg.get()));
+                break;
+            }
+            case NetMessage::BLOCK_TXN: {
+                ProcessBlockTxn(*dynamic_cast<BlockTxn*>(msg.get()));
+                break;
+            }
             default: {
                 throw ProtocolException("undefined message");
             }
@@ -85,9 +128,25 @@ void Peer::ProcessPing(const Ping& ping) {
     SendMessage(std::make_unique<Pong>(ping.nonce));
 }
 
+static uint64_t SteadyMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
 void Peer::ProcessPong(const Pong& pong) {
     lastPongTime = time(nullptr);
     nPingFailed  = pong.nonce == lastNonce ? 0 : nPingFailed + 1;
+
+    // a pong of an earlier ping leaves the time of the outstanding one in place
+    uint64_t sent = pong.nonce == lastNonce ? pingSentMicros_.exchange(0) : 0;
+    if (sent != 0) {
+        uint64_t rtt = SteadyMicros() - sent;
+        lastPingRTT_ = rtt;
+        minPingRTT_  = minPingRTT_ == 0 ? rtt : std::min<uint64_t>(minPingRTT_, rtt);
+        avgPingRTT_  = avgPingRTT_ == 0 ? rtt : (avgPingRTT_ * 7 + rtt) / 8;
+        spdlog::trace("Ping round trip time to {} is {} us", address.ToString(), rtt);
+    }
     spdlog::trace("Received pong from {} with nonce = {}", address.ToString(), pong.nonce);
 }
 
@@ -116,6 +175,11 @@ void Peer::ProcessVersionMessage(VersionMessage& version) {
                  versionMessage->current_height);
     spdlog::info("Git version info: {}", versionMessage->version_info);
 
+    connection_->SetCodec(NegotiateCodec(versionMessage->local_service));
+    if (connection_->GetCodec() != CODEC_NONE) {
+        spdlog::debug("{}: compressing large messages with codec {}", address.ToString(), connection_->GetCodec());
+    }
+
     bool compareHeight = !(isSeed || CONFIG->AmISeed());
     if (compareHeight && versionMessage->current_height > DAG->GetBestMilestoneHeight()) {
         isSyncAvailable = true;
@@ -162,7 +226,8 @@ size_t Peer::GetNPingFailed() const {
 
 void Peer::SendPing() {
     if (isFullyConnected) {
-        lastNonce = time(nullptr);
+        lastNonce       = time(nullptr);
+        pingSentMicros_ = SteadyMicros();
         SendMessage(std::make_unique<Ping>(lastNonce));
         spdlog::trace("Sent ping to {} with nonce = {}", address.ToString(), lastNonce);
     }
@@ -182,6 +247,41 @@ void Peer::SendAddresses() {
 }
 
 
+void Peer::AddKnownTx(const uint256& hash) {
+    std::lock_guard<std::mutex> lk(tx_inventory_mutex_);
+    knownTxs.Insert(hash);
+}
+
+bool Peer::HasKnownTx(const uint256& hash) {
+    std::lock_guard<std::mutex> lk(tx_inventory_mutex_);
+    return knownTxs.Contains(hash);
+}
+
+bool Peer::QueueTxAnnouncement(const uint256& hash) {
+    std::lock_guard<std::mutex> lk(tx_inventory_mutex_);
+    if (knownTxs.Contains(hash)) {
+        return false;
+    }
+    knownTxs.Insert(hash);
+    txInvQueue.push_back(hash);
+    return true;
+}
+
+size_t Peer::SendTxAnnouncements() {
+    std::vector<uint256> hashes;
+    {
+        std::lock_guard<std::mutex> lk(tx_inventory_mutex_);
+        hashes.swap(txInvQueue);
+    }
+
+    for (size_t i = 0; i < hashes.size(); i += TxInv::kMaxTxInventorySize) {
+        auto end = hashes.begin() + std::min(i + TxInv::kMaxTxInventorySize, hashes.size());
+        SendMessage(std::make_unique<TxInv>(std::vector<uint256>(hashes.begin() + i, end)));
+    }
+
+    return hashes.size();
+}
+
 void Peer::ProcessGetInv(GetInv& getInv) {
     size_t locator_size = getInv.locator.size();
     if (locator_size == 0) {
@@ -231,6 +331,10 @@ void Peer::ProcessGetData(GetData& getData) {
 }
 
 void Peer::ProcessBundle(const std::shared_ptr<Bundle>& bundle) {
+    if (DAG->GetDownloader().OnBundle(bundle, weak_peer_.lock())) {
+        return;
+    }
+
     if (getDataTasks.Empty()) {
         spdlog::debug("No pending task");
         return;
@@ -266,6 +370,9 @@ void Peer::ProcessBundle(const std::shared_ptr<Bundle>& bundle) {
 }
 
 void Peer::ProcessNotFound(const uint32_t& nonce) {
+    if (DAG && DAG->GetDownloader().OnNotFound(nonce, weak_peer_.lock())) {
+        return;
+    }
     Disconnect();
 }
 
@@ -298,9 +405,174 @@ void Peer::SendMessage(unique_message_t&& message) {
     connection_->SendMessage(std::move(message));
 }
 
+void Peer::ProcessCompactBlock(std::unique_ptr<CompactBlock> compact) {
+    PartialBlock partial;
+    partial.hash = compact->GetHeaderBlock().GetHash();
+    if (STORE->Exists(partial.hash)) {
+        return;
+    }
+
+    size_t n = compact->GetTransactionSize();
+    if (compact->prefilledIndexes.size() != compact->prefilledTxns.size()) {
+        throw ProtocolException("Malformed compact block.");
+    }
+
+    partial.txns.resize(n);
+    partial.fromPool.resize(n);
+    for (size_t i = 0; i < compact->prefilledIndexes.size(); ++i) {
+        auto index = compact->prefilledIndexes[i];
+        if (index >= n || partial.txns[index]) {
+            throw ProtocolException("Bad prefilled transaction index in compact block.");
+        }
+        partial.txns[index] = compact->prefilledTxns[i];
+    }
+
+    // map the short IDs to the positions of the transactions left
+    std::unordered_map<uint64_t, uint32_t> positions;
+    positions.reserve(compact->shortIDs.size());
+    bool collision = false;
+    for (uint32_t index = 0, k = 0; index < n; ++index) {
+        if (!partial.txns[index] && !positions.emplace(compact->shortIDs[k++], index).second) {
+            collision = true;
+        }
+    }
+
+    partial.compact = std::move(compact);
+    if (collision) {
+        RequestBlockTxns(std::move(partial), true);
+        return;
+    }
+
+    // positions matched by more than one transaction in the memory pool are requested from the peer
+    std::vector<uint64_t> shortIDs;
+    shortIDs.reserve(positions.size());
+    for (const auto& [shortID, index] : positions) {
+        shortIDs.push_back(shortID);
+    }
+
+    const auto& cb = *partial.compact;
+    auto found     = MEMPOOL->FindByShortIDs(shortIDs, [&cb](const uint256& h) { return cb.GetShortID(h); });
+    for (size_t i = 0; i < shortIDs.size(); ++i) {
+        if (found[i]) {
+            auto index              = positions[shortIDs[i]];
+            partial.txns[index]     = std::move(found[i]);
+            partial.fromPool[index] = true;
+        }
+    }
+
+    for (uint32_t index = 0; index < n; ++index) {
+        if (!partial.txns[index]) {
+            partial.missing.push_back(index);
+        }
+    }
+
+    if (!partial.missing.empty()) {
+        spdlog::debug("Compact block {} from {} misses {} of {} transactions", partial.hash.to_substr(),
+                      address.ToString(), partial.missing.size(), n);
+        RequestBlockTxns(std::move(partial), false);
+    } else if (!CompleteCompactBlock(partial)) {
+        RequestBlockTxns(std::move(partial), true);
+    }
+}
+
+void Peer::ProcessGetBlockTxn(const GetBlockTxn& request) {
+    auto block = STORE->FindBlock(request.blockHash);
+    if (!block) {
+        spdlog::debug("Block {} requested by GetBlockTxn is not found", request.blockHash.to_substr());
+        return;
+    }
+
+    const auto& txns = block->GetTransactions();
+    std::vector<ConstTxPtr> response;
+    response.reserve(request.indexes.size());
+    for (const auto& index : request.indexes) {
+        if (index >= txns.size()) {
+            throw ProtocolException("Transaction index in GetBlockTxn out of range.");
+        }
+        response.push_back(txns[index]);
+    }
+
+    SendMessage(std::make_unique<BlockTxn>(request.blockHash, std::move(response)));
+}
+
+void Peer::ProcessBlockTxn(const BlockTxn& response) {
+    PartialBlock partial;
+    {
+        std::lock_guard<std::mutex> lk(partial_blocks_mutex_);
+        auto it = partialBlocks.find(response.blockHash);
+        if (it == partialBlocks.end()) {
+            return;
+        }
+        partial = std::move(it->second);
+        partialBlocks.erase(it);
+    }
+
+    if (response.txns.size() != partial.missing.size()) {
+        throw ProtocolException("Unexpected number of transactions in BlockTxn.");
+    }
+
+    for (size_t i = 0; i < response.txns.size(); ++i) {
+        partial.txns[partial.missing[i]]     = response.txns[i];
+        partial.fromPool[partial.missing[i]] = false;
+    }
+
+    if (CompleteCompactBlock(partial)) {
+        return;
+    }
+
+    if (partial.requestedAll) {
+        spdlog::info("Failed to rebuild compact block {} from {}", partial.hash.to_substr(), address.ToString());
+        return;
+    }
+
+    RequestBlockTxns(std::move(partial), true);
+}
+
+void Peer::RequestBlockTxns(PartialBlock&& partial, bool all) {
+    if (all) {
+        // fall back to all the transactions of the block
+        partial.missing.resize(partial.txns.size());
+        std::iota(partial.missing.begin(), partial.missing.end(), 0);
+        partial.requestedAll = true;
+    }
+
+    SendMessage(std::make_unique<GetBlockTxn>(partial.hash, partial.missing));
+
+    std::lock_guard<std::mutex> lk(partial_blocks_mutex_);
+    if (partialBlocks.size() >= kMaxPartialBlocks) {
+        partialBlocks.erase(partialBlocks.begin());
+    }
+    partialBlocks.insert_or_assign(partial.hash, std::move(partial));
+}
+
+bool Peer::CompleteCompactBlock(const PartialBlock& partial) {
+    std::vector<ConstTxPtr> txns;
+    txns.reserve(partial.txns.size());
+    for (size_t i = 0; i < partial.txns.size(); ++i) {
+        // transactions of the peer are owned by this block alone, while the ones in the memory pool
+        // may be claimed by other blocks as well and have to be copied to get their own parent
+        txns.push_back(partial.fromPool[i] ? std::make_shared<Transaction>(*partial.txns[i]) : partial.txns[i]);
+    }
+
+    Block block = partial.compact->GetHeaderBlock();
+    block.AddTransactions(std::move(txns));
+    block.FinalizeHash();
+    block.CalculateOptimalEncodingSize();
+    if (block.GetHash() != partial.hash) {
+        spdlog::debug("Rebuilt compact block {} does not match its header", partial.hash.to_substr());
+        return false;
+    }
+
+    block.SetCount(partial.compact->GetCount());
+    block.source = Block::NETWORK;
+    DAG->AddNewBlock(std::make_shared<const Block>(std::move(block)), weak_peer_.lock());
+    return true;
+}
+
 void Peer::SendVersion(uint64_t height, std::string versionInfo) {
     SendMessage(std::make_unique<VersionMessage>(address, addressManager_->GetBestLocalAddress(), height, myID_,
-                                                 versionInfo, GetParams().version, 0));
+                                                 versionInfo, GetParams().version,
+                                                 kLocalServices | GetCompressionServices()));
     spdlog::info("Sent version message to {}", address.ToString());
 }
 
@@ -321,7 +593,11 @@ void Peer::StartSync() {
 
     if (getDataTasks.Empty() && InvTaskEmpty()) {
         spdlog::info("Starting synchronization with {}", address.ToString());
-        DAG->RequestInv(uint256(), 5, weak_peer_.lock());
+        if (SupportsMsHeaders()) {
+            DAG->RequestMsHeaders(weak_peer_.lock());
+        } else {
+            DAG->RequestInv(uint256(), 5, weak_peer_.lock());
+        }
     }
 }
 
@@ -341,6 +617,9 @@ bool Peer::IsSyncTimeout() {
 
 void Peer::Disconnect() {
     connection_->Disconnect();
+    if (DAG) {
+        DAG->GetDownloader().RemovePeer(this);
+    }
     for (auto& task : getDataTasks.GetTasks()) {
         DAG->EraseDownloading(task->hash);
     }
@@ -9,15 +9,19 @@
 #include "address_message.h"
 #include "block.h"
 #include "blocking_queue.h"
+#include "compact_block.h"
 #include "concurrent_container.h"
 #include "connection_manager.h"
+#include "ms_header_chain.h"
 #include "net_address.h"
 #include "ping.h"
 #include "pong.h"
 #include "protocol_exception.h"
+#include "rolling_bloom_filter.h"
 #include "spdlog/spdlog.h"
 #include "sync_messages.h"
 #include "task.h"
+#include "tx_inventory.h"
 #include "version_message.h"
 
 #include <atomic>
@@ -57,6 +61,25 @@ public:
      */
     void SendAddresses();
 
+    /**
+     * remember that the peer has the transaction, which is then never announced to it
+     */
+    void AddKnownTx(const uint256& hash);
+
+    bool HasKnownTx(const uint256& hash);
+
+    /**
+     * queue the transaction for the next announcement
+     * @return false if the peer is known to have it already
+     */
+    bool QueueTxAnnouncement(const uint256& hash);
+
+    /**
+     * regularly send the queued transaction hashes to the peer
+     * @return the number of announced hashes
+     */
+    size_t SendTxAnnouncements();
+
     void SendVersion(uint64_t height, std::string versionInfo);
 
     void SendLocalAddress();
@@ -71,6 +94,19 @@ public:
 
     size_t GetNPingFailed() const;
 
+    /* round trip times measured with the ping messages in microseconds, 0 before the first pong */
+    uint64_t GetLastPingRTT() const {
+        return lastPingRTT_;
+    }
+
+    uint64_t GetMinPingRTT() const {
+        return minPingRTT_;
+    }
+
+    uint64_t GetAvgPingRTT() const {
+        return avgPingRTT_;
+    }
+
     void AddPendingGetInvTask(std::shared_ptr<GetInvTask> task);
 
     bool RemovePendingGetInvTask(uint32_t task_id);
@@ -129,6 +165,26 @@ public:
         return connection_->IsValid();
     }
 
+    bool SupportsCompactBlocks() const {
+        return versionMessage && (versionMessage->local_service & SERVICE_COMPACT_BLOCKS);
+    }
+
+    bool SupportsTxInventory() const {
+        return versionMessage && (versionMessage->local_service & SERVICE_TX_INV);
+    }
+
+    bool SupportsLvsRange() const {
+        return versionMessage && (versionMessage->local_service & SERVICE_LVS_RANGE);
+    }
+
+    bool SupportsMsHeaders() const {
+        return versionMessage && (versionMessage->local_service & SERVICE_MS_HEADERS);
+    }
+
+    const shared_connection_t& GetConnection() const {
+        return connection_;
+    }
+
     void StartSync();
 
     bool IsSyncTimeout();
@@ -160,6 +216,9 @@ public:
 
     std::atomic_uint64_t last_bundle_ms_time = 0;
 
+    // milestone headers received in the headers-first sync, only accessed by the sync thread of DAG
+    MsSkeleton msSkeleton;
+
 private:
     /*
      * read the nonce and send back pong message
@@ -210,12 +269,58 @@ private:
      */
     void ProcessNotFound(const uint32_t& nonce);
 
+    /**
+     * a compact block waiting for the transactions that are not found in the memory pool
+     */
+    struct PartialBlock {
+        uint256 hash;
+        std::unique_ptr<CompactBlock> compact;
+        std::vector<ConstTxPtr> txns;
+        // whether each transaction is taken from the memory pool
+        std::vector<bool> fromPool;
+        std::vector<uint32_t> missing;
+        bool requestedAll = false;
+    };
+
+    /**
+     * process compact block, rebuild the block from the memory pool and
+     * request the missing transactions with GetBlockTxn
+     */
+    void ProcessCompactBlock(std::unique_ptr<CompactBlock> compact);
+
+    /**
+     * process GetBlockTxn, respond with the transactions of a block we have
+     */
+    void ProcessGetBlockTxn(const GetBlockTxn& request);
+
+    /**
+     * process BlockTxn, complete the corresponding compact block
+     */
+    void ProcessBlockTxn(const BlockTxn& response);
+
+    /**
+     * request the missing transactions, or all of them if the block could not be rebuilt
+     */
+    void RequestBlockTxns(PartialBlock&& partial, bool all);
+
+    /**
+     * add the block to dag if it has been rebuilt correctly
+     * @return false if the rebuilt block does not match the header
+     */
+    bool CompleteCompactBlock(const PartialBlock& partial);
+
     /**
      * Parameters of network setting
      */
     // record at most 2000 net addresses
     const static int kMaxAddress = 2000;
 
+    // max number of compact blocks waiting for transactions
+    const static size_t kMaxPartialBlocks = 16;
+
+    // number of the latest transaction hashes remembered as known by the peer
+    const static uint32_t kMaxKnownTxs = 50000;
+
     // the lowest version number we're willing to accept. Lower than this will
     // result in an immediate disconnect
     // TODO to be set
@@ -235,6 +340,14 @@ private:
     // number of ping failures
     size_t nPingFailed;
 
+    // steady time in microseconds when the last ping was sent
+    std::atomic_uint64_t pingSentMicros_ = 0;
+
+    std::atomic_uint64_t lastPingRTT_ = 0;
+    std::atomic_uint64_t minPingRTT_  = 0;
+    // moving average with the weight 1/8 of the new sample
+    std::atomic_uint64_t avgPingRTT_ = 0;
+
     // if we have reply GetAddr to this peer
     bool haveRepliedGetAddr;
     std::unordered_set<uint64_t> sentAddresses;
@@ -261,6 +374,13 @@ private:
     std::unordered_map<uint32_t, std::shared_ptr<GetInvTask>> getInvsTasks;
     GetDataTaskManager getDataTasks;
 
+    std::mutex partial_blocks_mutex_;
+    std::unordered_map<uint256, PartialBlock> partialBlocks;
+
+    std::mutex tx_inventory_mutex_;
+    RollingBloomFilter knownTxs{kMaxKnownTxs, 0.000001};
+    std::vector<uint256> txInvQueue;
+
     std::weak_ptr<Peer> weak_peer_;
 
     /*
@@ -7,7 +7,13 @@
 #include "mempool.h"
 #include "subscription.h"
 
-PeerManager::PeerManager() {
+PeerManager::PeerManager()
+    : controlLane_("control", 1),
+      syncLane_("sync", 1),
+      txLane_("tx", std::max(1U, std::thread::hardware_concurrency() / 2)),
+      admissionLane_("admission", 1),
+      admissionPool_(std::max(1U, std::thread::hardware_concurrency())),
+      blockLane_("block", 1) {
     std::random_device rd;
     gen = std::default_random_engine(rd());
     std::uniform_int_distribution<long long unsigned> distribution(0, UINT64_MAX);
@@ -34,6 +40,12 @@ void PeerManager::Start() {
 
     connectionManager_->Start();
 
+    controlLane_.Start();
+    syncLane_.Start();
+    txLane_.Start();
+    admissionPool_.Start();
+    admissionLane_.Start();
+    blockLane_.Start();
     handleMessageTask_ = std::thread(std::bind(&PeerManager::HandleMessage, this));
     if (connect_.empty()) {
         if (CONFIG->AmISeed()) {
@@ -58,6 +70,13 @@ void PeerManager::Stop() {
         handleMessageTask_.join();
     }
 
+    controlLane_.Stop();
+    syncLane_.Stop();
+    txLane_.Stop();
+    admissionLane_.Stop();
+    admissionPool_.Stop();
+    blockLane_.Stop();
+
     if (openConnectionTask_.joinable()) {
         openConnectionTask_.join();
     }
@@ -72,6 +91,13 @@ void PeerManager::Stop() {
 }
 
 bool PeerManager::Init(std::unique_ptr<Config>& config) {
+    ConnectionManager::RateLimits limits;
+    limits.peerUpload    = (size_t) config->GetPeerUploadLimit() * 1024;
+    limits.peerDownload  = (size_t) config->GetPeerDownloadLimit() * 1024;
+    limits.totalUpload   = (size_t) config->GetTotalUploadLimit() * 1024;
+    limits.totalDownload = (size_t) config->GetTotalDownloadLimit() * 1024;
+    connectionManager_->SetRateLimits(limits);
+
     if (!Bind(config->GetBindAddress())) {
         spdlog::warn("Failed to bind ip [{}].", config->GetBindAddress());
         return false;
@@ -176,14 +202,15 @@ void PeerManager::HandleMessage() {
     while (!interrupt_) {
         connection_message_t msg;
         if (connectionManager_->ReceiveMessage(msg)) {
-            if (initial_sync_ && msg.second->GetType() == NetMessage::BLOCK) {
+            auto type = msg.second->GetType();
+            if (initial_sync_ && (type == NetMessage::BLOCK || type == NetMessage::COMPACT_BLOCK)) {
                 continue;
             }
             auto msg_from = GetPeer(msg.first);
             if (!msg_from || !msg_from->IsVaild()) {
                 continue;
             }
-            switch (msg.second->GetType()) {
+            switch (type) {
                 case NetMessage::BLOCK: {
                     auto* b   = dynamic_cast<Block*>(msg.second.release());
                     b->source = Block::NETWORK;
@@ -191,45 +218,274 @@ void PeerManager::HandleMessage() {
                     break;
                 }
                 case NetMessage::TX: {
-                    ProcessTransaction(std::shared_ptr<Transaction>(dynamic_cast<Transaction*>(msg.second.release())),
-                                       msg_from);
+                    txLane_.Dispatch([this, msg_from, msg = std::move(msg.second)]() mutable {
+                        ProcessTransaction(std::shared_ptr<Transaction>(dynamic_cast<Transaction*>(msg.release())),
+                                           msg_from);
+                    });
+                    break;
+                }
+                case NetMessage::TX_INV: {
+                    txLane_.Dispatch([this, msg_from, msg = std::move(msg.second)]() mutable {
+                        ProcessTxInv(*dynamic_cast<TxInv*>(msg.get()), msg_from);
+                    });
+                    break;
+                }
+                case NetMessage::GET_TX_DATA: {
+                    txLane_.Dispatch([this, msg_from, msg = std::move(msg.second)]() mutable {
+                        ProcessGetTxData(*dynamic_cast<GetTxData*>(msg.get()), msg_from);
+                    });
+                    break;
+                }
+                case NetMessage::TX_DATA: {
+                    txLane_.Dispatch([this, msg_from, msg = std::move(msg.second)]() mutable {
+                        ProcessTxData(*dynamic_cast<TxData*>(msg.get()), msg_from);
+                    });
                     break;
                 }
                 case NetMessage::ADDR: {
-                    ProcessAddressMessage(*dynamic_cast<AddressMessage*>(msg.second.get()), msg_from);
+                    controlLane_.Dispatch([this, msg_from, msg = std::move(msg.second)]() mutable {
+                        ProcessAddressMessage(*dynamic_cast<AddressMessage*>(msg.get()), msg_from);
+                    });
                     break;
                 }
                 case NetMessage::VERSION_MSG: {
-                    auto versionMsg = *dynamic_cast<VersionMessage*>(msg.second.get());
-                    if (CheckPeerID(versionMsg.id)) {
-                        msg_from->ProcessVersionMessage(versionMsg);
-                    } else {
-                        msg_from->Disconnect();
-                    }
+                    // the handshake goes through the sync lane so that it is done before the sync messages
+                    // sent after it by the same peer are processed
+                    syncLane_.Dispatch([this, msg_from, msg = std::move(msg.second)]() {
+                        auto versionMsg = *dynamic_cast<VersionMessage*>(msg.get());
+                        if (CheckPeerID(versionMsg.id)) {
+                            msg_from->ProcessVersionMessage(versionMsg);
+                        } else {
+                            msg_from->Disconnect();
+                        }
+                    });
                     break;
                 }
+                case NetMessage::COMPACT_BLOCK:
+                case NetMessage::GET_BLOCK_TXN:
+                case NetMessage::BLOCK_TXN: {
+                    blockLane_.Dispatch([msg_from, msg = std::move(msg.second)]() mutable {
+                        msg_from->ProcessMessage(msg);
+                    });
+                    break;
+                }
+                case NetMessage::PING:
+                case NetMessage::PONG:
+                case NetMessage::GET_ADDR: {
+                    controlLane_.Dispatch([msg_from, msg = std::move(msg.second)]() mutable {
+                        msg_from->ProcessMessage(msg);
+                    });
+                    break;
+                }
+                case NetMessage::VERSION_ACK:
                 default: {
-                    msg_from->ProcessMessage(msg.second);
+                    syncLane_.Dispatch([msg_from, msg = std::move(msg.second)]() mutable {
+                        msg_from->ProcessMessage(msg);
+                    });
                 }
             }
         }
     }
 }
 
+std::vector<DispatchLane::Stats> PeerManager::GetDispatchStats() const {
+    return {controlLane_.GetStats(), syncLane_.GetStats(), txLane_.GetStats(), admissionLane_.GetStats(),
+            blockLane_.GetStats()};
+}
+
 void PeerManager::ProcessBlock(const ConstBlockPtr& block, PeerPtr& peer) {
     DAG->AddNewBlock(block, peer);
 }
 
 void PeerManager::ProcessTransaction(const ConstTxPtr& tx, PeerPtr& peer) {
-    if (!tx->Verify()) {
+    const auto& hash = tx->GetHash();
+    peer->AddKnownTx(hash);
+
+    // the other announcers of this transaction do not need to send it
+    size_t spared = txRequests_.Receive(hash);
+    if (spared) {
+        txDuplicateBytesAvoided_ += spared * GetSerializeSize(*tx);
+    }
+
+    if (HasRecentTx(hash)) {
+        txDuplicates_++;
         return;
     }
-    if (MEMPOOL->ReceiveTx(tx)) {
-        RelayTransaction(tx, peer);
+
+    // a task is dispatched when the queue becomes non-empty,
+    // the transactions arriving while it is waiting join its batch
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lk(admissionLock_);
+        if (!admitting_.insert(hash).second) {
+            txDuplicates_++;
+            return;
+        }
+        idle = admissionQueue_.empty();
+        admissionQueue_.emplace_back(tx, peer);
+    }
+    if (idle) {
+        admissionLane_.Dispatch([this]() { AdmitTransactions(); });
+    }
+}
+
+void PeerManager::AdmitTransactions() {
+    std::vector<ConstTxPtr> txns;
+    std::vector<PeerPtr> senders;
+    {
+        std::lock_guard<std::mutex> lk(admissionLock_);
+        size_t n = std::min(admissionQueue_.size(), kMaxAdmissionBatch);
+        txns.reserve(n);
+        senders.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            txns.push_back(std::move(admissionQueue_.front().first));
+            senders.push_back(std::move(admissionQueue_.front().second));
+            admissionQueue_.pop_front();
+        }
+
+        if (!admissionQueue_.empty()) {
+            admissionLane_.Dispatch([this]() { AdmitTransactions(); });
+        }
+    }
+    if (txns.empty()) {
+        return;
+    }
+
+    auto start    = std::chrono::steady_clock::now();
+    auto admitted = MEMPOOL->ReceiveTxs(txns, admissionPool_);
+    txAdmissionMicros_ +=
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    txAdmissionBatches_++;
+
+    // only the admitted transactions are remembered; a rejected one is fetched again if announced
+    for (size_t i = 0; i < txns.size(); ++i) {
+        if (admitted[i]) {
+            AddRecentTx(txns[i]->GetHash());
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lk(admissionLock_);
+        for (const auto& tx : txns) {
+            admitting_.erase(tx->GetHash());
+        }
+    }
+
+    for (size_t i = 0; i < txns.size(); ++i) {
+        if (!admitted[i]) {
+            txRejected_++;
+            continue;
+        }
+
+        txAdmitted_++;
+        RelayTransaction(txns[i], senders[i]);
         if (PUBLISHER) {
-            PUBLISHER->PushMsg((void*) tx.get(), SubType::TX);
+            PUBLISHER->PushMsg((void*) txns[i].get(), SubType::TX);
+        }
+    }
+}
+
+void PeerManager::ProcessTxInv(const TxInv& txInv, PeerPtr& peer) {
+    if (txInv.hashes.size() > TxInv::kMaxTxInventorySize) {
+        spdlog::warn("Received too many transaction hashes from peer {}. Abort them", peer->address.ToString());
+        return;
+    }
+
+    auto now = TxRequestTracker::clock::now();
+    std::vector<uint256> toRequest;
+    for (const auto& hash : txInv.hashes) {
+        peer->AddKnownTx(hash);
+        if (!HasRecentTx(hash) && !IsAdmitting(hash) && txRequests_.Announce(hash, peer, now)) {
+            toRequest.push_back(hash);
+        } else {
+            txDuplicates_++;
+        }
+    }
+
+    if (!toRequest.empty()) {
+        txRequested_ += toRequest.size();
+        peer->SendMessage(std::make_unique<GetTxData>(std::move(toRequest)));
+    }
+}
+
+void PeerManager::ProcessGetTxData(const GetTxData& getTxData, PeerPtr& peer) {
+    if (getTxData.hashes.size() > TxInv::kMaxTxInventorySize) {
+        spdlog::warn("Received too many transaction requests from peer {}. Abort them", peer->address.ToString());
+        return;
+    }
+
+    std::vector<ConstTxPtr> txns;
+    {
+        std::lock_guard<std::mutex> lk(relayTxsLock_);
+        for (const auto& hash : getTxData.hashes) {
+            auto it = relayTxs_.find(hash);
+            if (it != relayTxs_.end()) {
+                txns.push_back(it->second);
+            }
+        }
+    }
+
+    if (!txns.empty()) {
+        peer->SendMessage(std::make_unique<TxData>(std::move(txns)));
+    }
+}
+
+void PeerManager::ProcessTxData(const TxData& txData, PeerPtr& peer) {
+    if (txData.txns.size() > TxInv::kMaxTxInventorySize) {
+        spdlog::warn("Received too many transactions from peer {}. Abort them", peer->address.ToString());
+        return;
+    }
+
+    for (const auto& tx : txData.txns) {
+        ProcessTransaction(tx, peer);
+    }
+}
+
+void PeerManager::FlushTxRelay() {
+    uint64_t now = time(nullptr);
+    {
+        std::lock_guard<std::mutex> lk(relayTxsLock_);
+        while (!relayTxsExpiry_.empty() && relayTxsExpiry_.front().first <= now) {
+            relayTxs_.erase(relayTxsExpiry_.front().second);
+            relayTxsExpiry_.pop_front();
         }
     }
+
+    {
+        std::shared_lock<std::shared_mutex> lk(peerLock_);
+        for (auto& it : peerMap_) {
+            txAnnounced_ += it.second->SendTxAnnouncements();
+        }
+    }
+
+    for (auto& [peer, hash] : txRequests_.Expire(TxRequestTracker::clock::now())) {
+        txRequested_++;
+        peer->SendMessage(std::make_unique<GetTxData>(std::vector<uint256>{hash}));
+    }
+}
+
+bool PeerManager::AddRecentTx(const uint256& hash) {
+    std::lock_guard<std::mutex> lk(recentTxsLock_);
+    if (recentTxs_.Contains(hash)) {
+        return false;
+    }
+    recentTxs_.Insert(hash);
+    return true;
+}
+
+bool PeerManager::HasRecentTx(const uint256& hash) {
+    std::lock_guard<std::mutex> lk(recentTxsLock_);
+    return recentTxs_.Contains(hash);
+}
+
+bool PeerManager::IsAdmitting(const uint256& hash) {
+    std::lock_guard<std::mutex> lk(admissionLock_);
+    return admitting_.count(hash);
+}
+
+PeerManager::TxRelayStats PeerManager::GetTxRelayStats() const {
+    return {txAnnounced_.load(), txFiltered_.load(), txRequested_.load(),
+            txDuplicates_.load(), txDuplicateBytesAvoided_.load(), txFullRelayed_.load(),
+            txAdmitted_.load(), txRejected_.load(), txAdmissionBatches_.load(), txAdmissionMicros_.load()};
 }
 
 void PeerManager::ProcessAddressMessage(AddressMessage& addressMessage, PeerPtr& peer) {
@@ -339,6 +595,19 @@ void PeerManager::CheckTimeout() {
             }
         }
     }
+
+    // move the timed out level set requests to the sync peers left
+    if (!DAG) {
+        return;
+    }
+
+    std::vector<PeerPtr> syncPeers;
+    for (auto& peer : peerMap_) {
+        if (peer.second->isFullyConnected && peer.second->isSyncAvailable) {
+            syncPeers.push_back(peer.second);
+        }
+    }
+    DAG->GetDownloader().Expire(syncPeers);
 }
 
 bool PeerManager::InitialSyncCompleted() const {
@@ -444,19 +713,37 @@ void PeerManager::RelayBlock(const ConstBlockPtr& block, const PeerPtr& msg_from
 
     auto peersToRelay = RandomlySelect(kMaxPeerToBroadcast, msg_from);
 
+    // peers that negotiated compact blocks receive the block as short transaction IDs
+    std::vector<shared_connection_t> compactConnections;
+    std::vector<shared_connection_t> fullConnections;
+    auto add = [&](const PeerPtr& p) {
+        (p->SupportsCompactBlocks() ? compactConnections : fullConnections).push_back(p->GetConnection());
+    };
+
     if (block->GetCount()) {
         block->SetCount(block->GetCount() - 1);
         for (auto& p : peersToRelay) {
-            p->SendMessage(std::make_unique<Block>(*block));
+            add(p);
         }
     } else {
         static std::uniform_real_distribution<float> dis(0, 1);
         for (auto& p : peersToRelay) {
             if (dis(gen) < kAlpha) {
-                p->SendMessage(std::make_unique<Block>(*block));
+                add(p);
             }
         }
     }
+
+    if (!compactConnections.empty()) {
+        static std::uniform_int_distribution<uint64_t> saltDis;
+        auto compact = std::make_shared<CompactBlock>(*block, saltDis(gen));
+        compact->SetCount(block->GetCount());
+        connectionManager_->Broadcast(std::move(compactConnections), std::move(compact));
+    }
+
+    if (!fullConnections.empty()) {
+        connectionManager_->Broadcast(std::move(fullConnections), block);
+    }
 }
 
 void PeerManager::RelayTransaction(const ConstTxPtr& tx, const PeerPtr& msg_from) {
@@ -465,11 +752,33 @@ void PeerManager::RelayTransaction(const ConstTxPtr& tx, const PeerPtr& msg_from
         return;
     }
 
+    {
+        std::lock_guard<std::mutex> lk(relayTxsLock_);
+        if (relayTxs_.emplace(tx->GetHash(), tx).second) {
+            relayTxsExpiry_.emplace_back(time(nullptr) + kRelayTxExpiry, tx->GetHash());
+        }
+    }
+
+    // peers supporting announcements get the hash in the next TxInv and
+    // fetch the transaction only if they have not got it from someone else
+    std::vector<shared_connection_t> connections;
     for (auto& it : peerMap_) {
-        if (it.second != msg_from) {
-            it.second->SendMessage(std::make_unique<Transaction>(*tx));
+        const auto& peer = it.second;
+        if (peer == msg_from) {
+            continue;
+        }
+
+        if (!peer->SupportsTxInventory()) {
+            connections.push_back(peer->GetConnection());
+        } else if (!peer->QueueTxAnnouncement(tx->GetHash())) {
+            txFiltered_++;
         }
     }
+
+    if (!connections.empty()) {
+        txFullRelayed_ += connections.size();
+        connectionManager_->Broadcast(std::move(connections), tx);
+    }
 }
 
 void PeerManager::RelayAddressMsg(AddressMessage& message, const PeerPtr& msg_from) {
@@ -507,6 +816,30 @@ void PeerManager::InitScheduleTask() {
         }
     });
 
+    scheduler_.AddPeriodTask(kTxAnnounceInterval, std::bind(&PeerManager::FlushTxRelay, this));
+
+    scheduler_.AddPeriodTask(kDispatchStatsInterval, [this]() {
+        for (const auto& lane : GetDispatchStats()) {
+            spdlog::debug("[Dispatch] lane {} with {} thread(s): depth = {}, peak = {}, processed = {}", lane.name,
+                          lane.threads, lane.depth, lane.peakDepth, lane.processed);
+        }
+
+        auto tx = GetTxRelayStats();
+        spdlog::debug("[TxRelay] announced = {}, filtered = {}, requested = {}, duplicates = {}, "
+                      "duplicate bytes avoided = {}, full relayed = {}",
+                      tx.announced, tx.filtered, tx.requested, tx.duplicates, tx.duplicateBytesAvoided, tx.fullRelayed);
+        spdlog::debug("[TxAdmission] admitted = {}, rejected = {} in {} batch(es), {:.0f} tx/s", tx.admitted,
+                      tx.rejected, tx.admissionBatches,
+                      tx.admissionMicros ? (tx.admitted + tx.rejected) * 1e6 / tx.admissionMicros : 0.0);
+
+        auto compression = connectionManager_->GetCompressionStats();
+        spdlog::debug("[Compression] compressed {} frame(s) from {} to {} bytes (ratio {:.3f}) in {} us, "
+                      "incompressible = {}, decompressed {} frame(s) in {} us, failures = {}",
+                      compression.compressedFrames, compression.rawBytes, compression.compressedBytes,
+                      compression.Ratio(), compression.compressMicros, compression.incompressibleFrames,
+                      compression.decompressedFrames, compression.decompressMicros, compression.decompressFailures);
+    });
+
     scheduler_.AddPeriodTask(CONFIG->GetSaveInterval(), [this]() {
         addressManager_->SaveAddress(CONFIG->GetAddressPath() + '/', CONFIG->GetAddressFilename());
     });
@@ -514,6 +847,19 @@ void PeerManager::InitScheduleTask() {
     scheduler_.Start();
 }
 
+std::vector<PeerPtr> PeerManager::GetSyncPeers() {
+    std::shared_lock<std::shared_mutex> lk(peerLock_);
+
+    std::vector<PeerPtr> result;
+    for (auto& peer : peerMap_) {
+        if (peer.second->IsVaild() && peer.second->isFullyConnected && peer.second->isSyncAvailable) {
+            result.push_back(peer.second);
+        }
+    }
+
+    return result;
+}
+
 PeerPtr PeerManager::GetSyncPeer() {
     std::shared_lock<std::shared_mutex> lk(peerLock_);
 
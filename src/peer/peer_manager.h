@@ -7,6 +7,61 @@
 
 #include "peer.h"
 #include "scheduler.h"
+#include "tx_request_tracker.h"
+
+#include <deque>
+#include <unordered_set>
+
+/**
+ * A typed lane processing inbound messages on its own workers,
+ * counting how many messages are waiting in it
+ */
+class DispatchLane {
+public:
+    struct Stats {
+        std::string name;
+        size_t threads;
+        size_t depth;
+        size_t peakDepth;
+        size_t processed;
+    };
+
+    DispatchLane(std::string name, size_t threads) : name_(std::move(name)), pool_(threads) {}
+
+    void Start() {
+        pool_.Start();
+    }
+
+    void Stop() {
+        pool_.Abort();
+        pool_.Stop();
+    }
+
+    template <typename FunctionType>
+    void Dispatch(FunctionType&& f) {
+        size_t depth = ++depth_;
+        size_t peak  = peakDepth_.load();
+        while (depth > peak && !peakDepth_.compare_exchange_weak(peak, depth)) {
+        }
+
+        pool_.Execute([this, f = std::forward<FunctionType>(f)]() mutable {
+            --depth_;
+            f();
+            ++processed_;
+        });
+    }
+
+    Stats GetStats() const {
+        return {name_, pool_.GetThreadSize(), depth_.load(), peakDepth_.load(), processed_.load()};
+    }
+
+private:
+    std::string name_;
+    ThreadPool pool_;
+    std::atomic_size_t depth_     = 0;
+    std::atomic_size_t peakDepth_ = 0;
+    std::atomic_size_t processed_ = 0;
+};
 
 class PeerManager {
 public:
@@ -129,6 +184,39 @@ public:
 
     std::vector<PeerPtr> RandomlySelect(size_t, const PeerPtr& excluded = nullptr);
 
+    /**
+     * get the fully connected peers that are ahead of us
+     */
+    std::vector<PeerPtr> GetSyncPeers();
+
+    /**
+     * get the queue depth and throughput of the message dispatch lanes
+     */
+    std::vector<DispatchLane::Stats> GetDispatchStats() const;
+
+    struct TxRelayStats {
+        // hashes announced with TxInv
+        size_t announced;
+        // announcements skipped as the peer already knows the transaction
+        size_t filtered;
+        // hashes requested with GetTxData
+        size_t requested;
+        // received announcements of transactions already known or being requested
+        size_t duplicates;
+        // bytes of the transactions that would have been received again with full relay
+        size_t duplicateBytesAvoided;
+        // transactions sent in full to peers not supporting announcements
+        size_t fullRelayed;
+        // transactions accepted and rejected by the memory pool
+        size_t admitted;
+        size_t rejected;
+        // batches taken by the admission pipeline and the time spent on them
+        size_t admissionBatches;
+        size_t admissionMicros;
+    };
+
+    TxRelayStats GetTxRelayStats() const;
+
 private:
     /*
      * create a peer after a new connection is setup
@@ -151,7 +239,7 @@ private:
     void AddPeer(shared_connection_t& connection, const PeerPtr& peer);
 
     /**
-     * a while loop function to receive and process messages
+     * a while loop function to receive messages and dispatch them to the lanes
      */
     void HandleMessage();
 
@@ -167,6 +255,45 @@ private:
      */
     void ProcessTransaction(const ConstTxPtr& tx, PeerPtr& peer);
 
+    /**
+     * take a batch of the queued transactions, admit them into the memory pool
+     * and relay the accepted ones
+     */
+    void AdmitTransactions();
+
+    /**
+     * process transaction announcements, request the new transactions
+     * from this peer unless they are requested from another one
+     */
+    void ProcessTxInv(const TxInv& txInv, PeerPtr& peer);
+
+    /**
+     * respond to GetTxData with the transactions relayed recently, all in a single TxData
+     */
+    void ProcessGetTxData(const GetTxData& getTxData, PeerPtr& peer);
+
+    /**
+     * process the transactions requested with GetTxData
+     */
+    void ProcessTxData(const TxData& txData, PeerPtr& peer);
+
+    /**
+     * send the queued announcements and move the timed out requests to other peers
+     */
+    void FlushTxRelay();
+
+    /**
+     * @return false if the transaction has already been admitted recently
+     */
+    bool AddRecentTx(const uint256& hash);
+
+    bool HasRecentTx(const uint256& hash);
+
+    /**
+     * @return true if the transaction is waiting for or going through the admission
+     */
+    bool IsAdmitting(const uint256& hash);
+
     /**
      * process address message, check, relay and save addresses
      * @param addressMessage
@@ -234,6 +361,21 @@ private:
 
     constexpr static uint32_t kCheckSyncInterval = 1800;
 
+    // interval of logging the statistics of the dispatch lanes
+    constexpr static uint32_t kDispatchStatsInterval = 60;
+
+    // interval of sending transaction announcements
+    constexpr static uint32_t kTxAnnounceInterval = 1;
+
+    // time during which relayed transactions can be requested with GetTxData
+    constexpr static uint32_t kRelayTxExpiry = 15 * 60;
+
+    // number of the latest processed transaction hashes to remember
+    constexpr static uint32_t kMaxRecentTxs = 120000;
+
+    // max number of transactions admitted into the memory pool at once
+    constexpr static size_t kMaxAdmissionBatch = 1000;
+
     /**
      * my own peer id, a random number used to identify peer
      */
@@ -262,6 +404,40 @@ private:
     // connection manager
     ConnectionManager* connectionManager_;
 
+    /*
+     * transaction relay
+     */
+
+    // transactions we announced, kept to answer GetTxData
+    std::mutex relayTxsLock_;
+    std::unordered_map<uint256, ConstTxPtr> relayTxs_;
+    std::deque<std::pair<uint64_t, uint256>> relayTxsExpiry_;
+
+    // transactions admitted into the memory pool recently
+    std::mutex recentTxsLock_;
+    RollingBloomFilter recentTxs_{kMaxRecentTxs, 0.000001};
+
+    TxRequestTracker txRequests_;
+
+    std::atomic_size_t txAnnounced_             = 0;
+    std::atomic_size_t txFiltered_              = 0;
+    std::atomic_size_t txRequested_             = 0;
+    std::atomic_size_t txDuplicates_            = 0;
+    std::atomic_size_t txDuplicateBytesAvoided_ = 0;
+    std::atomic_size_t txFullRelayed_           = 0;
+
+    // transactions waiting for the admission into the memory pool with their senders
+    std::mutex admissionLock_;
+    std::deque<std::pair<ConstTxPtr, PeerPtr>> admissionQueue_;
+
+    // hashes of the transactions queued or being admitted, not yet in recentTxs_
+    std::unordered_set<uint256> admitting_;
+
+    std::atomic_size_t txAdmitted_         = 0;
+    std::atomic_size_t txRejected_         = 0;
+    std::atomic_size_t txAdmissionBatches_ = 0;
+    std::atomic_size_t txAdmissionMicros_  = 0;
+
     /*
      * threads
      */
@@ -270,6 +446,29 @@ private:
     // handle message
     std::thread handleMessageTask_;
 
+    /*
+     * message dispatch lanes; full blocks are forwarded to the DAG directly from handleMessageTask_
+     */
+
+    // ping, pong and address messages, kept away from the heavy ones for low latency
+    DispatchLane controlLane_;
+
+    // the version handshake and the synchronization messages, processed on a single thread
+    // as their order per peer matters
+    DispatchLane syncLane_;
+
+    // transaction announcements and requests, queueing the received transactions for the admission
+    DispatchLane txLane_;
+
+    // admission of the queued transactions in batches, a single thread taking one batch at a time
+    DispatchLane admissionLane_;
+
+    // workers verifying the transactions of an admission batch in parallel
+    ThreadPool admissionPool_;
+
+    // compact blocks and the transactions exchanged to rebuild them, which may block on the memory pool
+    DispatchLane blockLane_;
+
     // continuously choose addresses and connect to them
     std::thread openConnectionTask_;
 
@@ -12,7 +12,7 @@
 #include <shared_mutex>
 #include <unordered_map>
 
-static uint32_t GetNewNonce() {
+inline uint32_t GetNewNonce() {
     static std::atomic_uint_fast32_t nonce_ = 0;
     return nonce_.fetch_add(1, std::memory_order_relaxed);
 }
@@ -0,0 +1,80 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "tx_request_tracker.h"
+
+bool TxRequestTracker::Announce(const uint256& hash, const std::shared_ptr<Peer>& peer, clock::time_point now) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = entries_.find(hash);
+    if (it == entries_.end()) {
+        if (entries_.size() >= kMaxTrackedTxs) {
+            return false;
+        }
+        auto& entry         = entries_[hash];
+        entry.requestedFrom = peer;
+        entry.expiry        = now + kRequestTimeout;
+        entry.nAnnouncers   = 1;
+        return true;
+    }
+
+    auto& entry = it->second;
+    if (entry.requestedFrom.lock() == peer) {
+        return false;
+    }
+
+    entry.nAnnouncers++;
+    if (entry.fallbacks.size() < kMaxFallbacks) {
+        entry.fallbacks.emplace_back(peer);
+    }
+    return false;
+}
+
+size_t TxRequestTracker::Receive(const uint256& hash) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = entries_.find(hash);
+    if (it == entries_.end()) {
+        return 0;
+    }
+
+    size_t spared = it->second.nAnnouncers - 1;
+    entries_.erase(it);
+    return spared;
+}
+
+std::vector<std::pair<std::shared_ptr<Peer>, uint256>> TxRequestTracker::Expire(clock::time_point now) {
+    std::vector<std::pair<std::shared_ptr<Peer>, uint256>> requests;
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        auto& entry = it->second;
+        if (entry.expiry > now) {
+            ++it;
+            continue;
+        }
+
+        // skip the fallbacks that have disconnected
+        std::shared_ptr<Peer> next;
+        while (!next && !entry.fallbacks.empty()) {
+            next = entry.fallbacks.front().lock();
+            entry.fallbacks.pop_front();
+        }
+
+        if (!next) {
+            it = entries_.erase(it);
+            continue;
+        }
+
+        entry.requestedFrom = next;
+        entry.expiry        = now + kRequestTimeout;
+        requests.emplace_back(std::move(next), it->first);
+        ++it;
+    }
+
+    return requests;
+}
+
+size_t TxRequestTracker::Size() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return entries_.size();
+}
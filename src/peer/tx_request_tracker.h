@@ -0,0 +1,71 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_TX_REQUEST_TRACKER_H
+#define EPIC_TX_REQUEST_TRACKER_H
+
+#include "big_uint.h"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class Peer;
+
+/**
+ * Schedules the download of announced transactions such that each of them
+ * is requested from a single peer at a time; the other peers announcing it
+ * are kept as fallbacks in case the request times out
+ */
+class TxRequestTracker {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * records that the peer announced the transaction
+     * @return true if the transaction should be requested from this peer now,
+     * false if it is being requested from another peer
+     */
+    bool Announce(const uint256& hash, const std::shared_ptr<Peer>& peer, clock::time_point now);
+
+    /**
+     * marks the transaction as received
+     * @return the number of the other peers that announced it and so
+     * were spared from sending it
+     */
+    size_t Receive(const uint256& hash);
+
+    /**
+     * moves the timed out requests on to the next announcers
+     * @return the new requests to send
+     */
+    std::vector<std::pair<std::shared_ptr<Peer>, uint256>> Expire(clock::time_point now);
+
+    size_t Size() const;
+
+private:
+    struct Entry {
+        std::weak_ptr<Peer> requestedFrom;
+        clock::time_point expiry;
+        std::deque<std::weak_ptr<Peer>> fallbacks;
+        size_t nAnnouncers = 0;
+    };
+
+    // time to wait for a requested transaction before asking another peer
+    constexpr static std::chrono::seconds kRequestTimeout{30};
+
+    // max number of transactions being downloaded
+    const static size_t kMaxTrackedTxs = 50000;
+
+    // max number of peers remembered as fallbacks of a single transaction
+    const static size_t kMaxFallbacks = 8;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint256, Entry> entries_;
+};
+
+#endif // EPIC_TX_REQUEST_TRACKER_H
@@ -0,0 +1,41 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "block_template.h"
+
+void BlockTemplate::AddTransaction(ConstTxPtr tx) {
+    if (!tx) {
+        return;
+    }
+
+    merkle_.Append(tx->GetHash());
+    block_.AddTransaction(std::move(tx));
+    block_.SetMerkle(merkle_.Root());
+}
+
+void BlockTemplate::AddTransactions(std::vector<ConstTxPtr>&& txns) {
+    for (const auto& tx : txns) {
+        merkle_.Append(tx->GetHash());
+    }
+    block_.AddTransactions(std::move(txns));
+    block_.SetMerkle(merkle_.Root());
+}
+
+std::vector<ConstTxPtr> BlockTemplate::RemoveTransactionsIf(size_t first,
+                                                            const std::function<bool(const ConstTxPtr&)>& pred) {
+    const auto& txns = static_cast<const Block&>(block_).GetTransactions();
+
+    std::vector<ConstTxPtr> removed;
+    for (size_t i = first; i < txns.size();) {
+        if (pred(txns[i])) {
+            removed.emplace_back(block_.RemoveTransaction(i));
+            merkle_.Remove(i);
+        } else {
+            ++i;
+        }
+    }
+
+    block_.SetMerkle(merkle_.Root());
+    return removed;
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_BLOCK_TEMPLATE_H
+#define EPIC_BLOCK_TEMPLATE_H
+
+#include "block.h"
+#include "merkle.h"
+
+#include <functional>
+
+/*
+ * The block a miner is solving, whose transactions may change while it is solved;
+ * the merkle root follows them with a merkle tree rehashed along the paths changed
+ */
+class BlockTemplate {
+public:
+    explicit BlockTemplate(uint16_t version) : block_(version) {}
+
+    Block& GetBlock() {
+        return block_;
+    }
+
+    void AddTransaction(ConstTxPtr tx);
+    void AddTransactions(std::vector<ConstTxPtr>&& txns);
+
+    /*
+     * removes the transactions from the first index on that satisfy the predicate,
+     * moving the last ones in their places
+     * @return the transactions removed
+     */
+    std::vector<ConstTxPtr> RemoveTransactionsIf(size_t first, const std::function<bool(const ConstTxPtr&)>& pred);
+
+private:
+    Block block_;
+    MerkleTree merkle_;
+};
+
+#endif // EPIC_BLOCK_TEMPLATE_H
@@ -2,6 +2,7 @@
 // Copyright (c) 2013-2016 John Tromp
 
 #include "cuckaroo.h"
+#include "siphashxN.h"
 
 uint64_t sipblock(const siphash_keys& keys, word_t edge, uint64_t* buf) {
     siphash_state<> shs(keys);
@@ -20,23 +21,68 @@ uint64_t sipblock(const siphash_keys& keys, word_t edge, uint64_t* buf) {
     return buf[edge & EDGE_BLOCK_MASK];
 }
 
+void sipblockxN(const siphash_keys& keys, const uint64_t* edges, uint64_t* buf) {
+    alignas(32) uint64_t edges0[NSIPHASH];
+    for (uint32_t b = 0; b < NSIPHASH; b++) {
+        edges0[b] = edges[b] & ~(uint64_t) EDGE_BLOCK_MASK;
+    }
+    siphash24xNchain(&keys, edges0, EDGE_BLOCK_SIZE, buf);
+
+    const uint64_t* last = buf + EDGE_BLOCK_MASK * NSIPHASH;
+    for (uint32_t i = 0; i < EDGE_BLOCK_MASK; i++) {
+        for (uint32_t b = 0; b < NSIPHASH; b++) {
+            buf[i * NSIPHASH + b] ^= last[b];
+        }
+    }
+}
+
 int VerifyProof(const word_t *edges, const siphash_keys &keys, uint32_t cycle_length) {
+    return VerifyProof(edges, keys, cycle_length, EDGEBITS);
+}
+
+int VerifyProof(const word_t *edges, const siphash_keys &keys, uint32_t cycle_length, uint32_t edgebits) {
+    const word_t edgemask = ((word_t) 1 << edgebits) - 1;
     word_t xor0 = 0, xor1 = 0;
-    uint64_t sips[EDGE_BLOCK_SIZE];
     word_t uvs[2 * cycle_length];
 
     for (uint32_t n = 0; n < cycle_length; n++) {
-        if (edges[n] > EDGEMASK) {
+        if (edges[n] > edgemask) {
             return POW_TOO_BIG;
         }
 
         if (n && edges[n] <= edges[n - 1]) {
             return POW_TOO_SMALL;
         }
+    }
+
+    // as the edges are ascending, the ones in the same block are next to each other,
+    // so each batch hashes the blocks of a run of edges on the NSIPHASH lanes
+    alignas(32) uint64_t blocks[NSIPHASH];
+    alignas(32) uint64_t sips[NSIPHASH * EDGE_BLOCK_SIZE];
+    for (uint32_t first = 0, last; first < cycle_length; first = last) {
+        uint32_t nblocks = 0;
+        for (last = first; last < cycle_length; last++) {
+            const uint64_t block = edges[last] & ~EDGE_BLOCK_MASK;
+            if (nblocks == 0 || blocks[nblocks - 1] != block) {
+                if (nblocks == NSIPHASH) {
+                    break;
+                }
+                blocks[nblocks++] = block;
+            }
+        }
+        for (uint32_t b = nblocks; b < NSIPHASH; b++) {
+            blocks[b] = blocks[nblocks - 1];
+        }
+        sipblockxN(keys, blocks, sips);
 
-        uint64_t edge          = sipblock(keys, edges[n], sips);
-        xor0 ^= uvs[2 * n]     = edge & EDGEMASK;
-        xor1 ^= uvs[2 * n + 1] = (edge >> 32) & EDGEMASK;
+        for (uint32_t n = first, b = 0; n < last; n++) {
+            if ((edges[n] & ~EDGE_BLOCK_MASK) != blocks[b]) {
+                b++;
+            }
+            uint64_t edge          = sips[(edges[n] & EDGE_BLOCK_MASK) * NSIPHASH + b];
+            xor0 ^= uvs[2 * n]     = edge & edgemask;
+            xor1 ^= uvs[2 * n + 1] = (edge >> 32) & edgemask;
+        }
     }
 
     if (xor0 | xor1) {
@@ -82,8 +82,19 @@ static const std::string ErrStr[] = {"OK",
                                      "cycle dead ends",
                                      "cycle too short"};
 
-// verify that edges are ascending and form a cycle in header-generated graph
+// verify that edges are ascending and form a cycle in header-generated graph,
+// hashing the blocks of the edges NSIPHASH at a time
 int VerifyProof(const uint32_t *edges, const siphash_keys &keys, uint32_t cycle_length);
 
+// the same on a graph of 2^edgebits edges, for the smaller graphs solved on the cpu
+int VerifyProof(const uint32_t *edges, const siphash_keys &keys, uint32_t cycle_length, uint32_t edgebits);
+
+// siphashes of the block of edges containing edge into buf of EDGE_BLOCK_SIZE words; returns the one of edge
+uint64_t sipblock(const siphash_keys& keys, word_t edge, uint64_t* buf);
+
+// siphashes of the NSIPHASH blocks of edges containing edges[0..NSIPHASH) at once (see siphashxN.h),
+// into buf of NSIPHASH * EDGE_BLOCK_SIZE words aligned to 32 bytes, edge i of block b at i * NSIPHASH + b
+void sipblockxN(const siphash_keys& keys, const uint64_t* edges, uint64_t* buf);
+
 // convenience function for extracting siphash keys from header
 void SetHeader(const char* header, uint32_t headerlen, siphash_keys* keys);
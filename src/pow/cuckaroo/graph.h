@@ -35,7 +35,12 @@ public:
     word_t** sols = nullptr;
     uint32_t nsols;
 
-    graph(word_t maxedges, word_t maxnodes, uint32_t maxsols, uint32_t compressbits, int cyclelen)
+    graph(word_t maxedges,
+          word_t maxnodes,
+          uint32_t maxsols,
+          uint32_t compressbits,
+          int cyclelen,
+          uint32_t nodebits = EDGEBITS)
         : visited(2 * maxnodes) {
         cycle_len = cyclelen;
         maxEdges  = maxedges;
@@ -43,8 +48,8 @@ public:
         maxSols   = maxsols;
         adjlist   = new word_t[2 * maxNodes]; // index into links array
         links     = new link[2 * maxEdges];
-        compressu = new compressor<word_t>(EDGEBITS, compressbits);
-        compressv = new compressor<word_t>(EDGEBITS, compressbits);
+        compressu = new compressor<word_t>(nodebits, compressbits);
+        compressv = new compressor<word_t>(nodebits, compressbits);
         sharedmem = false;
         sols      = new word_t*[maxSols + 1];
         for (int i = 0; i < maxSols + 1; ++i) {
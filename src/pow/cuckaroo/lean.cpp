@@ -0,0 +1,321 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "lean.h"
+#include "siphashxN.h"
+
+#include <algorithm>
+#include <thread>
+
+static_assert(EDGE_BLOCK_SIZE == 64, "a word of the alive bitmap holds the edges of a block");
+
+namespace {
+// bits of the node dropped by the compressors of the cycle finding graph
+uint32_t CompressBits(uint32_t edgebits) {
+    return std::min<uint32_t>(12, edgebits / 3);
+}
+
+word_t MaxEdges(uint32_t edgebits) {
+    return (word_t) 1 << (edgebits - CompressBits(edgebits));
+}
+
+// marks the node as seen, and as seen twice if it has been seen before
+inline void MarkNode(bitmap<uint64_t>& once, bitmap<uint64_t>& twice, word_t node) {
+    const uint64_t bit = (uint64_t) 1 << (node % 64);
+    if (__atomic_fetch_or(&once.bits[node / 64], bit, __ATOMIC_RELAXED) & bit) {
+        if (!(__atomic_load_n(&twice.bits[node / 64], __ATOMIC_RELAXED) & bit)) {
+            __atomic_fetch_or(&twice.bits[node / 64], bit, __ATOMIC_RELAXED);
+        }
+    }
+}
+} // namespace
+
+LeanSolverCtx::LeanSolverCtx(uint32_t nthreads_, int cyclelen, uint32_t edgebits, uint32_t ntrims_)
+    : cycle_len(cyclelen),
+      nalive(0),
+      nrounds(0),
+      nthreads(std::max<uint32_t>(nthreads_, 1)),
+      ntrims(ntrims_),
+      edgeBits(edgebits),
+      nedges((word_t) 1 << edgebits),
+      edgeMask(nedges - 1),
+      alive(nedges),
+      seenOnce(nedges),
+      seenTwice(nedges),
+      cg(MaxEdges(edgebits), MaxEdges(edgebits), MAXSOLS, CompressBits(edgebits), cyclelen, edgebits),
+      aborted(false),
+      jobSize(0),
+      generation(0),
+      pending(0),
+      stopping(false) {
+    assert(EDGE_BLOCK_BITS <= edgebits && edgebits <= EDGEBITS);
+
+    for (uint32_t t = 1; t < nthreads; t++) {
+        workers.emplace_back(&LeanSolverCtx::Work, this, t);
+    }
+}
+
+LeanSolverCtx::~LeanSolverCtx() {
+    {
+        std::lock_guard<std::mutex> lk(jobLock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void LeanSolverCtx::Work(uint32_t t) {
+    uint64_t done = 0;
+
+    std::unique_lock<std::mutex> lk(jobLock);
+    while (true) {
+        jobReady.wait(lk, [&] { return stopping || generation != done; });
+        if (stopping) {
+            return;
+        }
+        done = generation;
+
+        const size_t chunk = (jobSize + nthreads - 1) / nthreads;
+        const size_t begin = std::min(jobSize, t * chunk);
+        const size_t end   = std::min(jobSize, (t + 1) * chunk);
+        lk.unlock();
+
+        if (begin < end) {
+            job(t, begin, end);
+        }
+
+        lk.lock();
+        if (--pending == 0) {
+            jobDone.notify_one();
+        }
+    }
+}
+
+template <typename F>
+void LeanSolverCtx::ForEachRange(size_t n, F&& f) {
+    {
+        std::lock_guard<std::mutex> lk(jobLock);
+        job     = std::ref(f);
+        jobSize = n;
+        pending = workers.size();
+        generation++;
+    }
+    jobReady.notify_all();
+
+    f(0, 0, std::min(n, (n + nthreads - 1) / nthreads));
+
+    // the job refers to f, so it is dropped only once all the workers are done with it
+    std::unique_lock<std::mutex> lk(jobLock);
+    jobDone.wait(lk, [this] { return pending == 0; });
+    job = nullptr;
+}
+
+template <typename F>
+void LeanSolverCtx::ForEachAliveBlock(size_t begin, size_t end, F&& f) {
+    alignas(32) uint64_t edges0[NSIPHASH];
+    alignas(32) uint64_t buf[NSIPHASH * EDGE_BLOCK_SIZE];
+    size_t words[NSIPHASH];
+
+    uint32_t n = 0;
+    for (size_t w = begin; w < end && !aborted; w++) {
+        if (alive.bits[w]) {
+            words[n]    = w;
+            edges0[n++] = w * EDGE_BLOCK_SIZE;
+        }
+        if (n == NSIPHASH || (n > 0 && w + 1 == end)) {
+            // the lanes left over at the end of the range hash the last block again
+            for (uint32_t b = n; b < NSIPHASH; b++) {
+                edges0[b] = edges0[n - 1];
+            }
+            sipblockxN(sipkeys, edges0, buf);
+            for (uint32_t b = 0; b < n; b++) {
+                f(words[b], buf + b);
+            }
+            n = 0;
+        }
+    }
+}
+
+int LeanSolverCtx::solve() {
+    const size_t nwords = alive.BITMAP_WORDS;
+    ForEachRange(nwords, [this](uint32_t, size_t begin, size_t end) {
+        memset(alive.bits + begin, 0xff, (end - begin) * sizeof(uint64_t));
+    });
+    edges.clear();
+    nalive = nedges;
+
+    bool listed   = false;
+    uint32_t idle = 0; // consecutive rounds killing no edge, after which the graph is fully trimmed
+    for (nrounds = 0; nrounds < ntrims && idle < 2 && !aborted; nrounds++) {
+        const uint32_t side = nrounds & 1;
+        const word_t killed = listed ? TrimListRound(side) : TrimBitmapRound(side);
+
+        nalive -= killed;
+        idle = killed ? 0 : idle + 1;
+
+        if (!listed && nalive <= nedges >> LEAN_COMPACTBITS) {
+            CompactEdges();
+            listed = true;
+        }
+    }
+
+    if (aborted) {
+        return 0;
+    }
+    if (!listed) {
+        CompactEdges();
+    }
+    spdlog::trace("{} edges left after {} trimming rounds", nalive, nrounds);
+
+    return FindCycles();
+}
+
+word_t LeanSolverCtx::TrimBitmapRound(uint32_t side) {
+    const size_t nwords  = alive.BITMAP_WORDS;
+    const uint32_t shift = side ? 32 : 0;
+
+    ForEachRange(nwords, [this](uint32_t, size_t begin, size_t end) {
+        memset(seenOnce.bits + begin, 0, (end - begin) * sizeof(uint64_t));
+        memset(seenTwice.bits + begin, 0, (end - begin) * sizeof(uint64_t));
+    });
+
+    ForEachRange(nwords, [this, shift](uint32_t, size_t begin, size_t end) {
+        ForEachAliveBlock(begin, end, [this, shift](size_t w, const uint64_t* hashes) {
+            for (uint64_t word = alive.bits[w]; word; word &= word - 1) {
+                MarkNode(seenOnce, seenTwice, (hashes[__builtin_ctzll(word) * NSIPHASH] >> shift) & edgeMask);
+            }
+        });
+    });
+
+    std::vector<word_t> killed(nthreads);
+    ForEachRange(nwords, [this, shift, &killed](uint32_t t, size_t begin, size_t end) {
+        word_t nkilled = 0;
+        ForEachAliveBlock(begin, end, [this, shift, &nkilled](size_t w, const uint64_t* hashes) {
+            uint64_t word = alive.bits[w];
+            for (uint64_t bits = word; bits; bits &= bits - 1) {
+                const uint32_t i = __builtin_ctzll(bits);
+                if (!seenTwice.test((hashes[i * NSIPHASH] >> shift) & edgeMask)) {
+                    word &= ~((uint64_t) 1 << i);
+                    nkilled++;
+                }
+            }
+            alive.bits[w] = word;
+        });
+        killed[t] = nkilled;
+    });
+
+    word_t total = 0;
+    for (auto n : killed) {
+        total += n;
+    }
+    return total;
+}
+
+void LeanSolverCtx::CompactEdges() {
+    const size_t nwords = alive.BITMAP_WORDS;
+
+    // counting the alive edges of each range first lets the ranges be listed in place
+    std::vector<size_t> offsets(nthreads + 1);
+    ForEachRange(nwords, [this, &offsets](uint32_t t, size_t begin, size_t end) {
+        size_t n = 0;
+        for (size_t w = begin; w < end; w++) {
+            n += __builtin_popcountll(alive.bits[w]);
+        }
+        offsets[t + 1] = n;
+    });
+    for (uint32_t t = 0; t < nthreads; t++) {
+        offsets[t + 1] += offsets[t];
+    }
+
+    // the ranges are in order, so the edges are listed by ascending index
+    edges.resize(offsets.back());
+    ForEachRange(nwords, [this, &offsets](uint32_t t, size_t begin, size_t end) {
+        edge* out = edges.data() + offsets[t];
+        ForEachAliveBlock(begin, end, [this, &out](size_t w, const uint64_t* hashes) {
+            for (uint64_t word = alive.bits[w]; word; word &= word - 1) {
+                const uint32_t i    = __builtin_ctzll(word);
+                const uint64_t hash = hashes[i * NSIPHASH];
+                *out++ = {(word_t)(w * EDGE_BLOCK_SIZE + i), (word_t)(hash & edgeMask),
+                          (word_t)((hash >> 32) & edgeMask)};
+            }
+        });
+    });
+
+    ForEachRange(nwords, [this](uint32_t, size_t begin, size_t end) {
+        memset(seenOnce.bits + begin, 0, (end - begin) * sizeof(uint64_t));
+        memset(seenTwice.bits + begin, 0, (end - begin) * sizeof(uint64_t));
+    });
+}
+
+word_t LeanSolverCtx::TrimListRound(uint32_t side) {
+    ForEachRange(edges.size(), [this, side](uint32_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            MarkNode(seenOnce, seenTwice, side ? edges[i].v : edges[i].u);
+        }
+    });
+
+    // the edges left in each range are moved to its front, keeping the killed ones behind them
+    // so that the nodes of all the edges are still there to be reset
+    std::vector<size_t> kept(nthreads);
+    ForEachRange(edges.size(), [this, side, &kept](uint32_t t, size_t begin, size_t end) {
+        size_t out = begin;
+        for (size_t i = begin; i < end; i++) {
+            if (seenTwice.test(side ? edges[i].v : edges[i].u)) {
+                std::swap(edges[out++], edges[i]);
+            }
+        }
+        kept[t] = out - begin;
+    });
+
+    // only the nodes of the listed edges have been marked, so resetting their words clears the bitmaps
+    ForEachRange(edges.size(), [this, side](uint32_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const word_t node = side ? edges[i].v : edges[i].u;
+            __atomic_store_n(&seenOnce.bits[node / 64], 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&seenTwice.bits[node / 64], 0, __ATOMIC_RELAXED);
+        }
+    });
+
+    // the ranges are as split by ForEachRange, and each is moved behind the edges left in the former ones
+    const word_t before = edges.size();
+    const size_t chunk  = (edges.size() + nthreads - 1) / nthreads;
+    auto out            = edges.begin();
+    for (uint32_t t = 0; t < nthreads && t * chunk < edges.size(); t++) {
+        const auto first = edges.begin() + t * chunk;
+        out              = out == first ? out + kept[t] : std::move(first, first + kept[t], out);
+    }
+    edges.erase(out, edges.end());
+    return before - edges.size();
+}
+
+int LeanSolverCtx::FindCycles() {
+    if (edges.size() > cg.maxEdges) {
+        spdlog::trace("{} edges left, only the first {} are searched for cycles", edges.size(), cg.maxEdges);
+        edges.resize(cg.maxEdges);
+    }
+
+    cg.reset();
+    for (const auto& e : edges) {
+        cg.add_compress_edge(e.u, e.v);
+    }
+
+    for (uint32_t s = 0; s < cg.nsols; s++) {
+        // the cycle holds the ordinals of the edges added to the graph
+        std::vector<uint32_t> proof(cycle_len);
+        for (int j = 0; j < cycle_len; j++) {
+            proof[j] = edges[cg.sols[s][j]].index;
+        }
+        std::sort(proof.begin(), proof.end());
+
+        // compressed nodes may collide and close cycles that are not in the graph
+        if (VerifyProof(proof.data(), sipkeys, cycle_len, edgeBits) == POW_OK) {
+            sols.insert(sols.end(), proof.begin(), proof.end());
+        }
+    }
+
+    return sols.size() / cycle_len;
+}
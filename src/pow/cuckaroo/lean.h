@@ -0,0 +1,123 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_CUCKAROO_LEAN_H
+#define EPIC_CUCKAROO_LEAN_H
+
+#include "bitmap.h"
+#include "cuckaroo.h"
+#include "graph.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef LEAN_NTRIMS
+#define LEAN_NTRIMS 176
+#endif
+
+// the trimming moves from the edge bitmap to a list of the edges
+// once at most a fraction 2^-LEAN_COMPACTBITS of the edges is alive,
+// so that the list takes no more memory than a bitmap of the nodes
+#ifndef LEAN_COMPACTBITS
+#define LEAN_COMPACTBITS 7
+#endif
+
+/*
+ * Cuckaroo solver on the cpu, with the same interface as the SolverCtx of the cuda mean miner.
+ *
+ * Edges are trimmed in lean rounds, keeping a bit per edge for whether it is alive and
+ * two bits per node for whether it has been seen once and twice on the side of the round;
+ * the siphashes of the blocks holding alive edges are recomputed NSIPHASH at a time.
+ * When few enough edges are left they are moved to a list and trimmed there without
+ * hashing, and the cycles are finally looked for in the graph of the remaining edges.
+ */
+struct LeanSolverCtx {
+    siphash_keys sipkeys;
+    std::vector<uint32_t> sols; // concatenation of all proof's indices
+    int cycle_len;
+
+    /*
+     * @param nthreads the number of threads trimming a graph
+     * @param edgebits the 2-log of the number of edges, at most EDGEBITS
+     */
+    LeanSolverCtx(uint32_t nthreads, int cyclelen, uint32_t edgebits = EDGEBITS, uint32_t ntrims = LEAN_NTRIMS);
+    ~LeanSolverCtx();
+
+    LeanSolverCtx(const LeanSolverCtx&) = delete;
+    LeanSolverCtx& operator=(const LeanSolverCtx&) = delete;
+
+    void SetHeader(const char* header, uint32_t len) {
+        ::SetHeader(header, len, &sipkeys);
+        sols.clear();
+    }
+
+    int solve();
+
+    void abort() {
+        aborted = true;
+    }
+
+    // lets the graphs after an aborted one be solved
+    void resume() {
+        aborted = false;
+    }
+
+    // number of edges left and of rounds run by the last trimming
+    word_t nalive;
+    uint32_t nrounds;
+
+private:
+    struct edge {
+        word_t index;
+        word_t u;
+        word_t v;
+    };
+
+    uint32_t nthreads;
+    uint32_t ntrims;
+    uint32_t edgeBits;
+    word_t nedges;
+    word_t edgeMask;
+
+    bitmap<uint64_t> alive;
+    bitmap<uint64_t> seenOnce;
+    bitmap<uint64_t> seenTwice;
+    std::vector<edge> edges;
+    graph<word_t> cg;
+    std::atomic_bool aborted;
+
+    // the threads other than the calling one, kept for the lifetime of the context,
+    // run their ranges of the job of each generation
+    std::vector<std::thread> workers;
+    std::mutex jobLock;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    std::function<void(uint32_t, size_t, size_t)> job;
+    size_t jobSize;
+    uint64_t generation;
+    uint32_t pending;
+    bool stopping;
+
+    void Work(uint32_t t);
+
+    word_t TrimBitmapRound(uint32_t side);
+    word_t TrimListRound(uint32_t side);
+    void CompactEdges();
+    int FindCycles();
+
+    // runs f(thread, begin, end) on nthreads contiguous ranges of [0, n)
+    template <typename F>
+    void ForEachRange(size_t n, F&& f);
+
+    // runs f(w, hashes) on the words w in [begin, end) of the alive bitmap holding alive edges,
+    // with the siphash of edge i of the block at hashes[i * NSIPHASH]
+    template <typename F>
+    void ForEachAliveBlock(size_t begin, size_t end, F&& f);
+};
+
+#endif // EPIC_CUCKAROO_LEAN_H
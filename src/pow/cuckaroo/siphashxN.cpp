@@ -126,6 +126,39 @@ void siphash24x8(const siphash_keys* keys, const uint64_t* indices, uint64_t* ha
     _mm256_store_si256((__m256i*) (hashes + 4), XOR(XOR(v4, v5), XOR(v6, v7)));
 }
 
+// 8-way chains of sipHash-2-4 over count consecutive nonces from each of the 8 starts,
+// where the state is carried over from the previous nonce of the chain
+void siphash24x8chain(const siphash_keys* keys, const uint64_t* starts, uint32_t count, uint64_t* hashes) {
+    __m256i packet0 = _mm256_load_si256((__m256i*) starts);
+    __m256i packet4 = _mm256_load_si256((__m256i*) (starts + 4));
+    __m256i v0, v1, v2, v3, v4, v5, v6, v7;
+    v7 = v3 = _mm256_set1_epi64x(keys->k3);
+    v4 = v0 = _mm256_set1_epi64x(keys->k0);
+    v5 = v1 = _mm256_set1_epi64x(keys->k1);
+    v6 = v2 = _mm256_set1_epi64x(keys->k2);
+    const __m256i ff  = _mm256_set1_epi64x(0xffLL);
+    const __m256i one = _mm256_set1_epi64x(1);
+
+    for (uint32_t i = 0; i < count; i++) {
+        v3 = XOR(v3, packet0);
+        v7 = XOR(v7, packet4);
+        SIPROUNDX2N;
+        SIPROUNDX2N;
+        v0 = XOR(v0, packet0);
+        v4 = XOR(v4, packet4);
+        v2 = XOR(v2, ff);
+        v6 = XOR(v6, ff);
+        SIPROUNDX2N;
+        SIPROUNDX2N;
+        SIPROUNDX2N;
+        SIPROUNDX2N;
+        _mm256_store_si256((__m256i*) (hashes + i * 8), XOR(XOR(v0, v1), XOR(v2, v3)));
+        _mm256_store_si256((__m256i*) (hashes + i * 8 + 4), XOR(XOR(v4, v5), XOR(v6, v7)));
+        packet0 = ADD(packet0, one);
+        packet4 = ADD(packet4, one);
+    }
+}
+
 // 16-way sipHash-2-4 specialized to precomputed key and 8 byte nonces
 void siphash24x16(const siphash_keys* keys, const uint64_t* indices, uint64_t* hashes) {
     const __m256i packet0 = _mm256_load_si256((__m256i*) indices);
@@ -218,6 +251,40 @@ void siphash24x4(const siphash_keys* keys, const uint64_t* indices, uint64_t* ha
     _mm_store_si128((__m128i*) hashes, mi);
     _mm_store_si128((__m128i*) (hashes + 2), m2);
 }
+
+// 4-way chains of sipHash-2-4 over count consecutive nonces from each of the 4 starts,
+// where the state is carried over from the previous nonce of the chain
+void siphash24x4chain(const siphash_keys* keys, const uint64_t* starts, uint32_t count, uint64_t* hashes) {
+    __m128i v0, v1, v2, v3, mi, v4, v5, v6, v7, m2;
+    v4 = v0 = _mm_set1_epi64x(keys->k0);
+    v5 = v1 = _mm_set1_epi64x(keys->k1);
+    v6 = v2 = _mm_set1_epi64x(keys->k2);
+    v7 = v3 = _mm_set1_epi64x(keys->k3);
+    const __m128i ff  = _mm_set1_epi64x(0xffLL);
+    const __m128i one = _mm_set1_epi64x(1);
+
+    mi = _mm_load_si128((__m128i*) starts);
+    m2 = _mm_load_si128((__m128i*) (starts + 2));
+
+    for (uint32_t i = 0; i < count; i++) {
+        v3 = XOR(v3, mi);
+        v7 = XOR(v7, m2);
+        SIPROUNDX2N;
+        SIPROUNDX2N;
+        v0 = XOR(v0, mi);
+        v4 = XOR(v4, m2);
+        v2 = XOR(v2, ff);
+        v6 = XOR(v6, ff);
+        SIPROUNDX2N;
+        SIPROUNDX2N;
+        SIPROUNDX2N;
+        SIPROUNDX2N;
+        _mm_store_si128((__m128i*) (hashes + i * 4), XOR(XOR(v0, v1), XOR(v2, v3)));
+        _mm_store_si128((__m128i*) (hashes + i * 4 + 2), XOR(XOR(v4, v5), XOR(v6, v7)));
+        mi = ADD(mi, one);
+        m2 = ADD(m2, one);
+    }
+}
 #endif
 
 #ifndef NSIPHASH
@@ -243,3 +310,19 @@ void siphash24xN(const siphash_keys* keys, const uint64_t* indices, uint64_t* ha
 #error not implemented
 #endif
 }
+
+void siphash24xNchain(const siphash_keys* keys, const uint64_t* starts, uint32_t count, uint64_t* hashes) {
+#if NSIPHASH == 8 && defined __AVX2__
+    siphash24x8chain(keys, starts, count, hashes);
+#elif NSIPHASH == 4 && defined __SSE2__ && !defined __AVX2__
+    siphash24x4chain(keys, starts, count, hashes);
+#else
+    for (uint32_t n = 0; n < NSIPHASH; n++) {
+        siphash_state<> shs(*keys);
+        for (uint32_t i = 0; i < count; i++) {
+            shs.hash24(starts[n] + i);
+            hashes[i * NSIPHASH + n] = shs.xor_lanes();
+        }
+    }
+#endif
+}
@@ -79,6 +79,9 @@ void siphash24x8(const siphash_keys* keys, const uint64_t* indices, uint64_t* ha
 // 16-way sipHash-2-4 specialized to precomputed key and 8 byte nonces
 void siphash24x16(const siphash_keys* keys, const uint64_t* indices, uint64_t* hashes);
 
+// 8-way chains of sipHash-2-4 over consecutive nonces
+void siphash24x8chain(const siphash_keys* keys, const uint64_t* starts, uint32_t count, uint64_t* hashes);
+
 #elif defined __SSE2__
 #define NSIPHASH 4
 
@@ -87,6 +90,9 @@ void siphash24x2(const siphash_keys* keys, const uint64_t* indices, uint64_t* ha
 
 // 4-way sipHash-2-4 specialized to precomputed key and 8 byte nonces
 void siphash24x4(const siphash_keys* keys, const uint64_t* indices, uint64_t* hashes);
+
+// 4-way chains of sipHash-2-4 over consecutive nonces
+void siphash24x4chain(const siphash_keys* keys, const uint64_t* starts, uint32_t count, uint64_t* hashes);
 #endif
 
 #ifndef NSIPHASH
@@ -99,4 +105,9 @@ void siphash24x4(const siphash_keys* keys, const uint64_t* indices, uint64_t* ha
 
 void siphash24xN(const siphash_keys* keys, const uint64_t* indices, uint64_t* hashes);
 
+// NSIPHASH chains of sipHash-2-4, each over count consecutive nonces from one of the starts
+// and carrying the state over from the previous nonce, as cuckaroo hashes a block of edges;
+// the hash of nonce i of chain n is written to hashes[i * NSIPHASH + n]
+void siphash24xNchain(const siphash_keys* keys, const uint64_t* starts, uint32_t count, uint64_t* hashes);
+
 #endif // ifdef INCLUDE_SIPHASHXN_H
@@ -3,27 +3,200 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "mempool.h"
+#include "crc32.h"
 #include "dag_manager.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
 
 #define READER_LOCK(mu) std::shared_lock<std::shared_mutex> reader(mu);
 #define WRITER_LOCK(mu) std::unique_lock<std::shared_mutex> writer(mu);
 
+/*
+ * An integer bound of the distances d with d.GetDouble() < threshold,
+ * with a margin for the rounding of GetDouble
+ */
+static arith_uint256 DistanceBound(double threshold) {
+    int exp;
+    double mantissa = std::frexp(threshold, &exp);
+    if (!std::isfinite(threshold) || exp >= 256) {
+        return ~arith_uint256();
+    }
+
+    // threshold = mantissa * 2^exp, where the mantissa has 53 significant bits
+    arith_uint256 bound = (uint64_t) std::ldexp(mantissa, 53);
+    if (exp >= 53) {
+        bound <<= exp - 53;
+    } else {
+        bound >>= 53 - exp;
+    }
+    arith_uint256 margin = (bound >> 32) + 1;
+    return bound > ~margin ? ~arith_uint256() : bound + margin;
+}
+
+/*
+ * Calls f(lo, hi) for each range of keys whose xor distances to the base are
+ * at most the bound, in the ascending order of the distances. For each set bit
+ * of the bound, the keys of a range have the distances equal to the bound above
+ * the bit and the bit unset, which leaves the bits below it free.
+ */
+template <typename F>
+static void ForEachRangeWithin(const arith_uint256& base, const arith_uint256& bound, F&& f) {
+    const arith_uint256 one   = 1;
+    const arith_uint256 match = base ^ bound;
+    for (int i = 255; i >= 0; --i) {
+        if (((bound >> i) & one) == 0) {
+            continue;
+        }
+
+        arith_uint256 lower = (one << i) - 1;
+        arith_uint256 lo    = ((match >> (i + 1)) << (i + 1)) | (base & (one << i));
+        if (!f(lo, lo | lower)) {
+            return;
+        }
+    }
+    f(match, match);
+}
+
+uint64_t GetFeeRate(uint64_t fee, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    return fee / size * 1000 + fee % size * 1000 / size;
+}
+
+/* the fee a transaction pays according to the ledger of the best chain, 0 if unknown */
+static uint64_t LookupFee(const ConstTxPtr& tx) {
+    if (!DAG) {
+        return 0;
+    }
+    auto fee = DAG->GetBestChain()->GetTxFee(tx);
+    return fee ? fee->GetValue() : 0;
+}
+
+bool MemPool::Add(ConstTxPtr tx, uint64_t fee) {
+    const auto& hash = tx->GetHash();
+    auto [it, added] = mempool_.emplace(UintToArith256(hash), tx);
+    if (!added) {
+        return false;
+    }
+
+    for (const auto& input : tx->GetInputs()) {
+        spenders_.emplace(input.outpoint.GetOutKey(), hash);
+    }
+
+    size_t size      = GetSerializeSize(*tx);
+    uint64_t feeRate = GetFeeRate(fee, size);
+    byFeeRate_.emplace(feeRate, hash);
+    feeRateAndSize_.emplace(hash, std::make_pair(feeRate, size));
+    bytes_ += size;
+
+    if (bytes_ > maxBytes_) {
+        TrimToSize();
+        return mempool_.find(UintToArith256(hash)) != mempool_.end();
+    }
+    return true;
+}
+
+bool MemPool::Remove(const uint256& txHash) {
+    auto it = mempool_.find(UintToArith256(txHash));
+    if (it == mempool_.end()) {
+        return false;
+    }
+
+    for (const auto& input : it->second->GetInputs()) {
+        auto range = spenders_.equal_range(input.outpoint.GetOutKey());
+        for (auto spender = range.first; spender != range.second; ++spender) {
+            if (spender->second == txHash) {
+                spenders_.erase(spender);
+                break;
+            }
+        }
+    }
+    mempool_.erase(it);
+
+    auto entry = feeRateAndSize_.find(txHash);
+    if (entry != feeRateAndSize_.end()) {
+        byFeeRate_.erase({entry->second.first, txHash});
+        bytes_ -= entry->second.second;
+        feeRateAndSize_.erase(entry);
+    }
+    return true;
+}
+
+void MemPool::TrimToSize() {
+    const time_t now = std::time(nullptr);
+    size_t nEvicted  = 0;
+    uint64_t maxRate = 0;
+    while (bytes_ > maxBytes_ && !byFeeRate_.empty()) {
+        auto [feeRate, hash] = *byFeeRate_.begin();
+        evictedBytes_ += feeRateAndSize_[hash].second;
+        Remove(hash);
+        maxRate = std::max(maxRate, feeRate);
+        nEvicted++;
+    }
+
+    if (nEvicted > 0) {
+        // new transactions have to pay more than the evicted ones
+        rollingMinFeeRate_ = std::max<double>(GetMinFeeRateLocked(now), maxRate + kIncrementalFeeRate);
+        lastEvictionTime_  = now;
+        nEvicted_ += nEvicted;
+        spdlog::debug("[MemPool] Evicted {} transactions with fee rates up to {}, {} bytes left", nEvicted, maxRate,
+                      bytes_);
+    }
+}
+
+uint64_t MemPool::GetMinFeeRateLocked(time_t now) const {
+    double rolling = rollingMinFeeRate_;
+    if (rolling > 0 && now > lastEvictionTime_) {
+        rolling /= std::pow(2.0, (double) (now - lastEvictionTime_) / kMinFeeRateHalfLife);
+    }
+    if (rolling < kIncrementalFeeRate) {
+        rolling = 0;
+    }
+    return std::max(minFeeRate_, (uint64_t) rolling);
+}
+
+uint64_t MemPool::GetMinFeeRate() const {
+    READER_LOCK(mutex_)
+    return GetMinFeeRateLocked(std::time(nullptr));
+}
+
+MemPool::Stats MemPool::GetStats() const {
+    READER_LOCK(mutex_)
+    Stats stats;
+    stats.count        = mempool_.size();
+    stats.bytes        = bytes_;
+    stats.maxBytes     = maxBytes_;
+    stats.minFeeRate   = GetMinFeeRateLocked(std::time(nullptr));
+    stats.nEvicted     = nEvicted_;
+    stats.evictedBytes = evictedBytes_;
+    return stats;
+}
+
 bool MemPool::Insert(ConstTxPtr value) {
+    uint64_t fee = LookupFee(value);
+    return Insert(std::move(value), fee);
+}
+
+bool MemPool::Insert(ConstTxPtr value, uint64_t fee) {
     WRITER_LOCK(mutex_)
-    return std::get<1>(mempool_.emplace(std::move(value)));
+    return Add(std::move(value), fee);
 }
 
 bool MemPool::Contains(const ConstTxPtr& value) const {
     READER_LOCK(mutex_)
-    return mempool_.find(value) != mempool_.end();
+    return mempool_.find(UintToArith256(value->GetHash())) != mempool_.end();
 }
 
 bool MemPool::Erase(const ConstTxPtr& value) {
     if (value) {
         WRITER_LOCK(mutex_)
-        return mempool_.erase(value) > 0;
+        return Remove(value->GetHash());
     }
     return false;
 }
@@ -31,7 +204,7 @@ bool MemPool::Erase(const ConstTxPtr& value) {
 void MemPool::Erase(const std::vector<ConstTxPtr>& values) {
     WRITER_LOCK(mutex_)
     for (const auto& v : values) {
-        mempool_.erase(v);
+        Remove(v->GetHash());
     }
 }
 
@@ -52,60 +225,158 @@ bool MemPool::ReceiveTx(const ConstTxPtr& tx) {
 
     // note that we allow transactions that have double spending with other tx in mempool
     // check the transaction is not from no spent TXOs
-    if (!DAG->GetBestChain()->IsTxFitsLedger(tx)) {
+    auto fee = DAG->GetBestChain()->GetTxFee(tx);
+    if (!fee) {
         return false;
     }
 
-    return Insert(tx);
+    auto feeRate = GetFeeRate(fee->GetValue(), GetSerializeSize(*tx));
+    WRITER_LOCK(mutex_)
+    if (feeRate < GetMinFeeRateLocked(std::time(nullptr))) {
+        spdlog::debug("[MemPool] Rejected tx {} with fee rate {} below the min", tx->GetHash().to_substr(), feeRate);
+        return false;
+    }
+
+    return Add(tx, fee->GetValue());
 }
 
-void MemPool::ReleaseTxFromConfirmed(const ConstTxPtr& tx, bool valid) {
-    // first erase this transaction
-    Erase(tx);
-    if (!valid) {
-        return;
+std::vector<uint8_t> MemPool::ReceiveTxs(const std::vector<ConstTxPtr>& txns, ThreadPool& pool) {
+    // number of transactions checked by a task
+    static constexpr size_t kChunkSize = 32;
+
+    const size_t nTxns = txns.size();
+    std::vector<uint8_t> admitted(nTxns, false);
+    std::vector<uint64_t> fees(nTxns, 0);
+    std::vector<size_t> sizes(nTxns, 0);
+
+    const auto chain = DAG->GetBestChain();
+    auto check       = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            // mempool only receives normal transaction
+            const auto& tx = txns[i];
+            if (tx->IsRegistration() || !tx->Verify()) {
+                continue;
+            }
+
+            auto fee = chain->GetTxFee(tx);
+            if (!fee) {
+                continue;
+            }
+
+            fees[i]     = fee->GetValue();
+            sizes[i]    = GetSerializeSize(*tx);
+            admitted[i] = true;
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    for (size_t begin = kChunkSize; begin < nTxns; begin += kChunkSize) {
+        auto end = std::min(nTxns, begin + kChunkSize);
+        if (auto f = pool.Submit([&check, begin, end]() { check(begin, end); })) {
+            futures.emplace_back(std::move(*f));
+        } else {
+            check(begin, end);
+        }
+    }
+    check(0, std::min(nTxns, kChunkSize));
+
+    // every task has to be waited for, as they refer to the locals of this frame
+    bool dropped = false;
+    for (auto& f : futures) {
+        try {
+            f.get();
+        } catch (const std::future_error&) {
+            // the task is dropped by a stopped pool
+            dropped = true;
+        }
+    }
+    if (dropped) {
+        return std::vector<uint8_t>(nTxns, false);
     }
 
-    // then prepare inputs data for searching
-    auto& inputs = tx->GetInputs();
-    std::unordered_set<uint256> fromTXOs;
-    fromTXOs.reserve(inputs.size());
-    for (const auto& input : inputs) {
-        fromTXOs.emplace(input.outpoint.GetOutKey());
+    WRITER_LOCK(mutex_)
+    const uint64_t minFeeRate = GetMinFeeRateLocked(std::time(nullptr));
+    const size_t nEvicted     = nEvicted_;
+    for (size_t i = 0; i < nTxns; ++i) {
+        if (admitted[i]) {
+            admitted[i] = GetFeeRate(fees[i], sizes[i]) >= minFeeRate && Add(txns[i], fees[i]);
+        }
     }
 
-    // finally erase conflicting transactions
+    if (nEvicted_ != nEvicted) {
+        // the earlier ones in the batch may have been evicted by the later ones
+        for (size_t i = 0; i < nTxns; ++i) {
+            admitted[i] = admitted[i] && mempool_.find(UintToArith256(txns[i]->GetHash())) != mempool_.end();
+        }
+    }
+    return admitted;
+}
+
+void MemPool::ReleaseTxFromConfirmed(const ConstTxPtr& tx, bool valid) {
+    ReleaseTxsFromConfirmed({{tx, valid}});
+}
+
+void MemPool::ReleaseTxsFromConfirmed(const std::vector<std::pair<ConstTxPtr, bool>>& txns) {
+    std::vector<uint256> conflicts;
+
     WRITER_LOCK(mutex_)
-    for (auto iter = mempool_.cbegin(); iter != mempool_.cend();) {
-        bool flag = false;
-        for (const auto& input : (*iter)->GetInputs()) {
-            if (fromTXOs.find(input.outpoint.GetOutKey()) != fromTXOs.end()) {
-                flag = true;
-                break;
+    for (const auto& [tx, valid] : txns) {
+        // first erase this transaction
+        Remove(tx->GetHash());
+        if (!valid) {
+            continue;
+        }
+
+        // then erase the ones spending the same outputs
+        conflicts.clear();
+        for (const auto& input : tx->GetInputs()) {
+            auto range = spenders_.equal_range(input.outpoint.GetOutKey());
+            for (auto spender = range.first; spender != range.second; ++spender) {
+                conflicts.push_back(spender->second);
             }
         }
-        if (flag) {
-            iter = mempool_.erase(iter);
-        } else {
-            iter++;
+        for (const auto& h : conflicts) {
+            Remove(h);
         }
     }
 }
 
 std::vector<ConstTxPtr> MemPool::ExtractTransactions(const uint256& blkHash, double threshold, size_t limit) {
-    arith_uint256 base_hash = UintToArith256(blkHash);
     std::vector<ConstTxPtr> result;
-    WRITER_LOCK(mutex_)
+    if (!(threshold > 0) || limit == 0) {
+        return result;
+    }
 
-    auto it = mempool_.begin();
-    while (it != mempool_.end() && result.size() < limit) {
-        auto dist = base_hash ^ UintToArith256((*it)->GetHash());
-        if (PartitionCmp(dist, threshold)) {
-            result.emplace_back(*it);
-            it = mempool_.erase(it);
-        } else {
-            ++it;
-        }
+    const arith_uint256 base_hash = UintToArith256(blkHash);
+    const arith_uint256 bound     = DistanceBound(threshold);
+
+    // look up the candidates under the reader lock, so that only
+    // the removal of the extracted ones blocks the other threads
+    {
+        READER_LOCK(mutex_)
+        ForEachRangeWithin(base_hash, bound, [&](const arith_uint256& lo, const arith_uint256& hi) {
+            for (auto it = mempool_.lower_bound(lo); it != mempool_.end() && it->first <= hi; ++it) {
+                if (result.size() >= limit) {
+                    return false;
+                }
+                if (PartitionCmp(base_hash ^ it->first, threshold)) {
+                    result.emplace_back(it->second);
+                }
+            }
+            return true;
+        });
+    }
+
+    if (result.empty()) {
+        return result;
+    }
+
+    {
+        // drop the ones taken by another thread in between
+        WRITER_LOCK(mutex_)
+        result.erase(std::remove_if(result.begin(), result.end(),
+                                    [this](const ConstTxPtr& tx) { return !Remove(tx->GetHash()); }),
+                     result.end());
     }
 
     if (!result.empty()) {
@@ -122,6 +393,52 @@ std::vector<ConstTxPtr> MemPool::ExtractTransactions(const uint256& blkHash, dou
     return result;
 }
 
+std::vector<ConstTxPtr> MemPool::GetTransactions() const {
+    READER_LOCK(mutex_)
+    std::vector<ConstTxPtr> result;
+    result.reserve(mempool_.size());
+    for (const auto& entry : mempool_) {
+        result.emplace_back(entry.second);
+    }
+    return result;
+}
+
+std::vector<ConstTxPtr> MemPool::FindByShortIDs(const std::vector<uint64_t>& shortIDs,
+                                                const std::function<uint64_t(const uint256&)>& shortID) const {
+    std::unordered_map<uint64_t, size_t> positions;
+    positions.reserve(shortIDs.size());
+    for (size_t i = 0; i < shortIDs.size(); ++i) {
+        positions.emplace(shortIDs[i], i);
+    }
+
+    std::vector<ConstTxPtr> result(shortIDs.size());
+    std::vector<bool> ambiguous(shortIDs.size());
+    size_t found = 0;
+
+    READER_LOCK(mutex_)
+    for (const auto& entry : mempool_) {
+        auto it = positions.find(shortID(entry.second->GetHash()));
+        if (it == positions.end() || ambiguous[it->second]) {
+            continue;
+        }
+
+        auto& slot = result[it->second];
+        if (slot) {
+            slot                  = nullptr;
+            ambiguous[it->second] = true;
+            found--;
+        } else {
+            slot = entry.second;
+            if (++found == shortIDs.size()) {
+                // a wrong match is caught by the merkle root of the block
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
 void MemPool::PushRedemptionTx(ConstTxPtr redemption) {
     READER_LOCK(mutex_)
     redemptionTxQueue_.Put(redemption);
@@ -155,3 +472,84 @@ ConstTxPtr MemPool::GetFirstReg() {
 void MemPool::ClearRedemptions() {
     redemptionTxQueue_.Clear();
 }
+
+bool MemPool::Dump(const std::string& filePath) const {
+    std::vector<ConstTxPtr> txns        = GetTransactions();
+    std::vector<ConstTxPtr> redemptions = redemptionTxQueue_.Snapshot();
+
+    VStream stream;
+    stream << kDumpVersion << txns << redemptions;
+    uint32_t checksum = crc32c((uint8_t*) stream.data(), stream.size());
+    stream << checksum;
+
+    // replace the old file only when the new one is complete
+    std::string tmpPath = filePath + ".tmp";
+    std::ofstream output{tmpPath, std::ios::out | std::ios::binary | std::ios::trunc};
+    output.write(stream.data(), stream.size());
+    output.close();
+    if (!output || std::rename(tmpPath.c_str(), filePath.c_str()) != 0) {
+        spdlog::warn("[MemPool] Failed to dump the transactions into {}", filePath);
+        return false;
+    }
+
+    spdlog::info("[MemPool] Dumped {} transaction(s) and {} redemption(s) of {} bytes into {}", txns.size(),
+                 redemptions.size(), stream.size(), filePath);
+    return true;
+}
+
+size_t MemPool::Load(const std::string& filePath, ThreadPool& pool) {
+    std::ifstream input{filePath, std::ios::in | std::ios::binary};
+    if (!input) {
+        spdlog::info("[MemPool] No dumped transactions to load from {}", filePath);
+        return 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<char> bytes{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    input.close();
+
+    std::vector<ConstTxPtr> txns;
+    std::vector<ConstTxPtr> redemptions;
+    try {
+        if (bytes.size() < sizeof(uint32_t)) {
+            throw std::ios_base::failure("truncated file");
+        }
+
+        const char* end = bytes.data() + bytes.size() - sizeof(uint32_t);
+        VStream stream{(const char*) bytes.data(), end};
+        VStream tail{end, end + sizeof(uint32_t)};
+        uint32_t checksum;
+        tail >> checksum;
+        if (checksum != crc32c((uint8_t*) stream.data(), stream.size())) {
+            throw std::ios_base::failure("checksum mismatch");
+        }
+
+        uint32_t version;
+        stream >> version;
+        if (version != kDumpVersion) {
+            throw std::ios_base::failure("unknown version " + std::to_string(version));
+        }
+        stream >> txns >> redemptions;
+    } catch (const std::exception& e) {
+        spdlog::warn("[MemPool] Discarded the dumped transactions in {}: {}", filePath, e.what());
+        return 0;
+    }
+
+    auto admitted    = ReceiveTxs(txns, pool);
+    size_t nAdmitted = std::count(admitted.begin(), admitted.end(), true);
+
+    // redemptions spend the rewards of their own chain, so only their syntax is checked here
+    size_t nRedemptions = 0;
+    for (auto& redemption : redemptions) {
+        if (redemption->Verify()) {
+            PushRedemptionTx(std::move(redemption));
+            nRedemptions++;
+        }
+    }
+
+    auto elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("[MemPool] Loaded {} of {} transaction(s) and {} of {} redemption(s) from {} in {} ms", nAdmitted,
+                 txns.size(), nRedemptions, redemptions.size(), filePath, elapsed);
+    return nAdmitted;
+}
@@ -7,58 +7,118 @@
 
 #include "arith_uint256.h"
 #include "blocking_queue.h"
+#include "threadpool.h"
 #include "transaction.h"
 
+#include <ctime>
+#include <functional>
+#include <map>
+#include <set>
 #include <shared_mutex>
-#include <unordered_set>
+#include <unordered_map>
 
 class MemPool {
 public:
-    MemPool()
-        : mempool_(
-              16,
-              [](const ConstTxPtr& t) {
-                  assert(t);
-                  return t->GetHash().GetCheapHash();
-              },
-              [](const ConstTxPtr& a, const ConstTxPtr& b) {
-                  if (!a || !b) {
-                      return false;
-                  }
-                  assert(!a->GetHash().IsNull() && !b->GetHash().IsNull());
-                  return *a == *b;
-              }) {}
-
-    MemPool(const MemPool& m) : mempool_(m.mempool_) {}
+    // default budget of the serialized transactions in the pool
+    static constexpr size_t kDefaultMaxBytes = 300 * 1024 * 1024;
+
+    // the min fee rate raised by evictions halves every half life
+    static constexpr uint32_t kMinFeeRateHalfLife = 3600;
+
+    // the min fee rate is raised by this much above the fee rate of an evicted transaction
+    static constexpr uint64_t kIncrementalFeeRate = 1;
+
+    struct Stats {
+        size_t count        = 0;
+        size_t bytes        = 0;
+        size_t maxBytes     = 0;
+        uint64_t minFeeRate = 0;
+        size_t nEvicted     = 0;
+        size_t evictedBytes = 0;
+    };
 
     /**
-     * basic operations for memory pool
+     * @param maxBytes the budget of the serialized transactions
+     * @param minFeeRate the min fee per 1000 bytes of the transactions received from peers
+     */
+    explicit MemPool(size_t maxBytes = kDefaultMaxBytes, uint64_t minFeeRate = 0)
+        : maxBytes_(maxBytes), minFeeRate_(minFeeRate) {}
+
+    MemPool(const MemPool& m)
+        : mempool_(m.mempool_), spenders_(m.spenders_), byFeeRate_(m.byFeeRate_), feeRateAndSize_(m.feeRateAndSize_),
+          bytes_(m.bytes_), maxBytes_(m.maxBytes_), minFeeRate_(m.minFeeRate_),
+          rollingMinFeeRate_(m.rollingMinFeeRate_), lastEvictionTime_(m.lastEvictionTime_), nEvicted_(m.nEvicted_),
+          evictedBytes_(m.evictedBytes_) {}
+
+    /**
+     * basic operations for memory pool; the fee of an inserted
+     * transaction is looked up in the ledger of the best chain if any
      */
     bool Insert(ConstTxPtr);
+    bool Insert(ConstTxPtr, uint64_t fee);
     bool Contains(const ConstTxPtr&) const;
     bool Erase(const ConstTxPtr&);
     void Erase(const std::vector<ConstTxPtr>&);
     bool Empty() const;
 
     /**
-     * processes transactions received from other nodes(memory pool)
+     * processes transactions received from other nodes(memory pool),
+     * rejecting the ones paying less than the min fee rate
      */
     bool ReceiveTx(const ConstTxPtr& tx);
 
+    /**
+     * admits a batch of transactions received from other nodes: the signatures and
+     * the fees are checked in parallel on the pool against the ledger of the same
+     * best chain, and the survivors are inserted with a single lock acquisition
+     * @return whether each of the transactions is admitted
+     */
+    std::vector<uint8_t> ReceiveTxs(const std::vector<ConstTxPtr>& txns, ThreadPool& pool);
+
     /**
      *  removes all conflicting transactions if this transaction is valid,
      *  otherwise simply remove it
      */
     void ReleaseTxFromConfirmed(const ConstTxPtr& tx, bool valid);
 
+    /**
+     * releases the transactions of a confirmed level set at once,
+     * each paired with whether it is valid
+     */
+    void ReleaseTxsFromConfirmed(const std::vector<std::pair<ConstTxPtr, bool>>& txns);
+
     std::size_t Size() const;
 
+    /**
+     * the min fee per 1000 bytes of the transactions received from peers,
+     * raised above the configured one while the pool has to evict
+     */
+    uint64_t GetMinFeeRate() const;
+
+    Stats GetStats() const;
+
     /**
      * retrives the transactions from the pool that has
-     * sortition distances less than the given threshold
+     * sortition distances less than the given threshold,
+     * preferring the closer ones if there are more than limit
      */
     std::vector<ConstTxPtr> ExtractTransactions(const uint256&, double threshold, size_t limit = -1);
 
+    /**
+     * returns a snapshot of all the transactions in the pool
+     */
+    std::vector<ConstTxPtr> GetTransactions() const;
+
+    /**
+     * looks up the transactions with the given short IDs under the reader lock,
+     * stopping as soon as all of them are found
+     * @param shortID the short ID of a transaction hash
+     * @return the transactions in the order of the short IDs; null for the ones
+     * not found or matched by more than one transaction
+     */
+    std::vector<ConstTxPtr> FindByShortIDs(const std::vector<uint64_t>& shortIDs,
+                                           const std::function<uint64_t(const uint256&)>& shortID) const;
+
     void PushRedemptionTx(ConstTxPtr redemption);
 
     ConstTxPtr GetRedemptionTx();
@@ -66,16 +126,68 @@ public:
 
     void ClearRedemptions();
 
+    /**
+     * writes the transactions in the pool and the queued redemptions
+     * into the file, followed by their crc32c checksum
+     */
+    bool Dump(const std::string& filePath) const;
+
+    /**
+     * reads the transactions dumped into the file and admits the ones still valid
+     * against the ledger of the best chain, verifying them in parallel on the pool
+     * @return the number of the transactions admitted into the pool
+     */
+    size_t Load(const std::string& filePath, ThreadPool& pool);
+
 private:
-    std::unordered_set<ConstTxPtr,
-                       std::function<size_t(const ConstTxPtr&)>,
-                       std::function<bool(const ConstTxPtr&, const ConstTxPtr&)>>
-        mempool_;
+    // version of the format of the dumped file
+    static constexpr uint32_t kDumpVersion = 1;
+
+    /**
+     * transactions ordered by their hashes as integers, so that the ones within
+     * a sortition distance of a block fall into at most 257 ranges of keys
+     */
+    std::map<arith_uint256, ConstTxPtr> mempool_;
+
+    /**
+     * maps the key of each output spent by the transactions in the pool
+     * to the hashes of the spending ones, which may be more than one
+     */
+    std::unordered_multimap<uint256, uint256> spenders_;
+
+    /**
+     * the fee rates and the serialized sizes of the transactions,
+     * where the ones with the lowest fee rates are evicted first
+     */
+    std::set<std::pair<uint64_t, uint256>> byFeeRate_;
+    std::unordered_map<uint256, std::pair<uint64_t, size_t>> feeRateAndSize_;
+
+    size_t bytes_ = 0;
+    size_t maxBytes_;
+    uint64_t minFeeRate_;
+
+    // the min fee rate at the last eviction, decaying since then
+    double rollingMinFeeRate_ = 0;
+    time_t lastEvictionTime_  = 0;
+
+    size_t nEvicted_     = 0;
+    size_t evictedBytes_ = 0;
 
     BlockingQueue<ConstTxPtr> redemptionTxQueue_;
     mutable std::shared_mutex mutex_;
+
+    // The following methods require the writer lock to be held
+    bool Add(ConstTxPtr tx, uint64_t fee);
+    bool Remove(const uint256& txHash);
+    void TrimToSize();
+
+    // requires the reader lock to be held
+    uint64_t GetMinFeeRateLocked(time_t now) const;
 };
 
+/* the fee per 1000 bytes */
+uint64_t GetFeeRate(uint64_t fee, size_t size);
+
 extern std::unique_ptr<MemPool> MEMPOOL;
 
 #endif // EPIC_MEMPOOL_H
@@ -2,13 +2,17 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "config.h"
 #include "miner.h"
 #include "wallet.h"
 
 const size_t headsCacheLimit = 20;
+// interval between packing the transactions received into the template being solved
+const auto templateRefreshInterval = std::chrono::seconds(1);
 
 Miner::Miner(size_t nThreads) : selfChainHeads_(headsCacheLimit) {
-    if (GetParams().cycleLen) {
+    // cycles are searched on the cpu unless a remote solver is configured
+    if (GetParams().cycleLen && CONFIG && !CONFIG->GetSolverAddr().empty()) {
         solver = new RemoteGPUSolver();
     } else {
         solver = new CPUSolver(nThreads);
@@ -38,10 +42,14 @@ bool Miner::Stop() {
     DAG->RegisterOnChainUpdatedCallback(nullptr);
     enabled_ = false;
     continue_.notify_all();
+    refresh_.notify_all();
 
     if (runner_.joinable()) {
         runner_.join();
     }
+    if (refresher_.joinable()) {
+        refresher_.join();
+    }
 
     spdlog::info("Miner stopped");
     return solver->Stop();
@@ -79,7 +87,9 @@ void Miner::Run() {
 
         while (enabled_.load()) {
             auto ms_head = DAG->GetMilestoneHead();
-            Block b(GetParams().version);
+            template_    = std::make_unique<BlockTemplate>(GetParams().version);
+            templateMs_  = ms_head;
+            Block& b     = template_->GetBlock();
 
             if (!selfChainHead_) {
                 spdlog::info("[Miner] Paused. Waiting for the first registration...");
@@ -89,7 +99,7 @@ void Miner::Run() {
                 spdlog::info("[Miner] Got the first registration. Start mining.");
 
                 prevHash = GENESIS->GetHash();
-                b.AddTransaction(std::move(firstRegTx));
+                template_->AddTransaction(std::move(firstRegTx));
             } else {
                 prevHash     = selfChainHead_->GetHash();
                 auto max_ntx = GetParams().blockCapacity;
@@ -104,7 +114,7 @@ void Miner::Run() {
                         selfChainHeads_.clear();
                         distanceCal_.Clear();
                     } else {
-                        b.AddTransaction(std::move(tx));
+                        template_->AddTransaction(std::move(tx));
                         max_ntx--;
                     }
                 }
@@ -117,11 +127,10 @@ void Miner::Run() {
                     }
 
                     auto allowed = CalculateAllowedDist(distanceCal_, ms_head->snapshot->hashRate);
-                    b.AddTransactions(MEMPOOL->ExtractTransactions(prevHash, allowed, max_ntx));
+                    template_->AddTransactions(MEMPOOL->ExtractTransactions(prevHash, allowed, max_ntx));
                 }
             }
 
-            b.SetMerkle();
             b.SetMilestoneHash(ms_head->cblock->GetHash());
             b.SetPrevHash(prevHash);
             b.SetTipHash(SelectTip());
@@ -164,7 +173,8 @@ void Miner::Run() {
                 DAG->AddNewBlock(bPtr, nullptr);
                 STORE->SaveMinerChainHeads(selfChainHeads_);
 
-                if (CheckMsPOW(bPtr, ms_head->snapshot)) {
+                // the template may have been pointed to a later milestone while it was solved
+                if (CheckMsPOW(bPtr, templateMs_->snapshot)) {
                     spdlog::info("🚀 Mined a milestone {}, ms {} prev {} tip {} blockTarget {}",
                                  bPtr->GetHash().to_substr(), bPtr->GetMilestoneHash().to_substr(),
                                  bPtr->GetPrevHash().to_substr(), bPtr->GetTipHash().to_substr(),
@@ -182,6 +192,66 @@ void Miner::Run() {
             }
         }
     });
+
+    refresher_ = std::thread([&]() {
+        while (enabled_.load()) {
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                refresh_.wait_for(lock, templateRefreshInterval, [this] { return msUpdated_ || !enabled_; });
+                msUpdated_ = false;
+            }
+
+            // the template is updated in place, only while it is being solved
+            if (enabled_.load()) {
+                solver->UpdateTemplate([this]() { return RefreshTemplate(); });
+            }
+        }
+    });
+}
+
+bool Miner::RefreshTemplate() {
+    Block& b     = template_->GetBlock();
+    auto ms_head = DAG->GetMilestoneHead();
+    bool changed = false;
+
+    const bool msChanged = b.GetMilestoneHash() != ms_head->cblock->GetHash();
+    if (msChanged) {
+        templateMs_ = ms_head;
+        b.SetMilestoneHash(ms_head->cblock->GetHash());
+        b.SetTipHash(SelectTip());
+        b.SetDifficultyTarget(ms_head->snapshot->blockTarget.GetCompact());
+        changed = true;
+    }
+
+    // transactions are packed only on the peer chain of the miner
+    if (!selfChainHead_ || b.GetPrevHash() != selfChainHead_->GetHash() || !distanceCal_.Full()) {
+        return changed;
+    }
+
+    const auto allowed = CalculateAllowedDist(distanceCal_, ms_head->snapshot->hashRate);
+    if (msChanged) {
+        const auto base = UintToArith256(b.GetPrevHash());
+        auto removed    = template_->RemoveTransactionsIf(b.IsRegistration() ? 1 : 0, [&](const ConstTxPtr& tx) {
+            return !PartitionCmp(base ^ UintToArith256(tx->GetHash()), allowed);
+        });
+        for (auto& tx : removed) {
+            MEMPOOL->Insert(std::move(tx));
+        }
+        changed |= !removed.empty();
+    }
+
+    const size_t ntx = b.GetTransactionSize();
+    if (ntx < GetParams().blockCapacity) {
+        auto txns = MEMPOOL->ExtractTransactions(b.GetPrevHash(), allowed, GetParams().blockCapacity - ntx);
+        changed |= !txns.empty();
+        template_->AddTransactions(std::move(txns));
+    }
+
+    if (changed) {
+        spdlog::debug("[Miner] Updated the block being solved: {} transactions, merkle root {}, ms {}",
+                      b.GetTransactionSize(), b.GetMerkleRoot().to_substr(), b.GetMilestoneHash().to_substr());
+    }
+    return changed;
 }
 
 uint256 Miner::SelectTip() {
@@ -211,8 +281,9 @@ void Miner::WaitChainUpdate() {
 void Miner::OnChainUpdate(ConstBlockPtr chain_ms_head, bool isMainchain) {
     std::unique_lock<std::mutex> lock(mtx_);
     if (isMainchain && chain_ms_head->source != Block::MINER) {
-        solver->Abort();
-        spdlog::debug("[Miner] Milestone chain head changed {}. Abort the current task.",
+        msUpdated_ = true;
+        refresh_.notify_all();
+        spdlog::debug("[Miner] Milestone chain head changed {}. Update the current task.",
                       chain_ms_head->GetHash().to_substr());
     }
 
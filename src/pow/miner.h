@@ -6,6 +6,7 @@
 #define EPIC_MINER_H
 
 #include "block_store.h"
+#include "block_template.h"
 #include "circular_queue.h"
 #include "key.h"
 #include "mempool.h"
@@ -39,10 +40,20 @@ protected:
     std::atomic_bool enabled_ = false;
     std::thread runner_;
 
+    // refreshes the template being solved, on a milestone and periodically
+    std::thread refresher_;
+
 private:
     uint256 SelectTip();
     void WaitChainUpdate();
 
+    /*
+     * points the template to the latest milestone, drops the transactions
+     * out of the distance it allows and packs the ones received since
+     * @return whether the header of the template has changed
+     */
+    bool RefreshTemplate();
+
     Solver* solver;
     ConstBlockPtr selfChainHead_ = nullptr;
     Cumulator distanceCal_;
@@ -50,6 +61,13 @@ private:
     std::mutex mtx_;
     std::condition_variable continue_;
     std::atomic_bool dag_updated_;
+
+    // the block being mined, only changed by the solver's updates while it is solved,
+    // and the milestone it points to
+    std::unique_ptr<BlockTemplate> template_;
+    VertexPtr templateMs_;
+    std::condition_variable refresh_;
+    bool msUpdated_ = false;
 };
 
 extern std::unique_ptr<Miner> MINER;
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "solver.h"
+#include "blake2bxN.h"
 #include "config.h"
 #include "cpptoml.h"
 #include "net_address.h"
@@ -18,6 +19,13 @@ inline void SetTimestamp(VStream& vs, uint32_t t) {
 
 bool CPUSolver::Start() {
     solverPool_.Start();
+    if (GetParams().cycleLen) {
+        spdlog::info("[Solver] Searching {}-cycles on cuckaroo{} with {} trimming thread(s)", GetParams().cycleLen,
+                     EDGEBITS, solverPool_.GetThreadSize());
+    } else {
+        spdlog::info("[Solver] Hashing with the {} BLAKE2b kernel on {} thread(s)", BLAKE2BMidstate::KernelName(),
+                     solverPool_.GetThreadSize());
+    }
     return true;
 }
 
@@ -30,6 +38,11 @@ bool CPUSolver::Stop() {
 void CPUSolver::Abort() {
     enabled = false;
     solutions.Quit();
+
+    std::lock_guard<std::mutex> lk(cycleCtxLock_);
+    if (cycleCtx_) {
+        cycleCtx_->abort();
+    }
 }
 
 void CPUSolver ::Enable() {
@@ -37,33 +50,126 @@ void CPUSolver ::Enable() {
     solutions.Enable();
 }
 
+bool Solver::UpdateTemplate(const std::function<bool()>& update) {
+    std::function<void()> push;
+    {
+        std::lock_guard<std::mutex> lk(templateLock_);
+        if (!template_ || solved_ || !update()) {
+            return false;
+        }
+        push = PushHeader(*template_);
+    }
+
+    if (push) {
+        push();
+    }
+    return true;
+}
+
+std::function<void()> CPUSolver::PushHeader(const Block& b) {
+    task_ = {GetTaskID(), VStream(b.GetHeader()), b.GetTargetAsInteger(), b.GetTime()};
+
+    // leaves the graph of the former header for one of the new header
+    std::lock_guard<std::mutex> lk(cycleCtxLock_);
+    if (cycleCtx_) {
+        cycleCtx_->abort();
+    }
+    return {};
+}
+
+CPUSolver::Task CPUSolver::LoadTask() {
+    std::lock_guard<std::mutex> lk(templateLock_);
+    return task_;
+}
+
+bool CPUSolver::PutSolution(Solution&& solution) {
+    std::lock_guard<std::mutex> lk(templateLock_);
+    if (solution.first != current_task_id.load()) {
+        return false;
+    }
+
+    solved_ = true;
+    solutions.Put(std::move(solution));
+    return true;
+}
+
 uint32_t CPUSolver::Solve(Block& b) {
     Enable();
 
     size_t nthreads = solverPool_.GetThreadSize();
-    auto task_id    = GetTaskID();
-    VStream vs(b.GetHeader());
+    {
+        std::lock_guard<std::mutex> lk(templateLock_);
+        template_ = &b;
+        solved_   = false;
+        PushHeader(b);
+    }
+    hashes_    = 0;
+    auto start = std::chrono::steady_clock::now();
 
-    for (std::size_t i = 0; i < nthreads; ++i) {
-        solverPool_.Execute([i, nthreads, target = b.GetTargetAsInteger(), task_id, nonce = b.GetNonce() + i,
-                             timestamp = b.GetTime(), vs, this]() mutable {
-            while (enabled.load()) {
-                SetNonce(vs, nonce);
+    if (GetParams().cycleLen) {
+        // a single task trims each graph on as many threads as the pool has
+        solverPool_.Execute([nonce = b.GetNonce(), this]() { SearchCycles(nonce); });
+    } else {
+        for (std::size_t i = 0; i < nthreads; ++i) {
+            solverPool_.Execute([nthreads, nonce = uint32_t(b.GetNonce() + i), this]() mutable {
+                constexpr size_t lanes = BLAKE2BMidstate::LANES;
+                const uint32_t step    = lanes * nthreads;
 
-                if (nonce >= i - nthreads) {
-                    timestamp = time(nullptr);
-                    SetTimestamp(vs, timestamp);
-                }
+                // only the last block of the header, which holds the nonce, is hashed for each nonce
+                Task task = LoadTask();
+                BLAKE2BMidstate midstate(256 / 8, (const unsigned char*) task.header.data(), task.header.size());
+                const size_t tailSize = midstate.TailSize();
+                assert(tailSize >= sizeof(uint32_t));
 
-                uint256 blkHash = HashBLAKE2<256>(vs.data(), vs.size());
-                if (UintToArith256(blkHash) <= target) {
-                    solutions.Put({task_id, {timestamp, nonce, std::vector<uint32_t>{}}});
-                    break;
+                unsigned char tails[lanes][BLAKE2B::BLOCKBYTES];
+                uint256 hashes[lanes];
+                const unsigned char* tailPtrs[lanes];
+                unsigned char* hashPtrs[lanes];
+                for (size_t lane = 0; lane < lanes; ++lane) {
+                    memcpy(tails[lane], task.header.data() + task.header.size() - tailSize, tailSize);
+                    tailPtrs[lane] = tails[lane];
+                    hashPtrs[lane] = hashes[lane].begin();
                 }
 
-                nonce += nthreads;
-            }
-        });
+                while (enabled.load()) {
+                    // start over on the header of the updated block,
+                    // or move the timestamp forward before the nonces run out
+                    bool reset = false;
+                    if (task.id != current_task_id.load()) {
+                        task  = LoadTask();
+                        reset = true;
+                    } else if (nonce > UINT32_MAX - step) {
+                        task.time = time(nullptr);
+                        SetTimestamp(task.header, task.time);
+                        reset = true;
+                    }
+                    if (reset) {
+                        midstate = BLAKE2BMidstate(256 / 8, (const unsigned char*) task.header.data(),
+                                                   task.header.size());
+                        for (auto& tail : tails) {
+                            memcpy(tail, task.header.data() + task.header.size() - tailSize, tailSize);
+                        }
+                    }
+
+                    for (size_t lane = 0; lane < lanes; ++lane) {
+                        uint32_t laneNonce = nonce + lane * nthreads;
+                        memcpy(tails[lane] + tailSize - sizeof(uint32_t), &laneNonce, sizeof(uint32_t));
+                    }
+                    midstate.Hash(tailPtrs, hashPtrs);
+                    hashes_ += lanes;
+
+                    for (size_t lane = 0; lane < lanes; ++lane) {
+                        // a solution of a former header is dropped, and the search goes on with the new one
+                        if (UintToArith256(hashes[lane]) <= task.target &&
+                            PutSolution({task.id, {task.time, uint32_t(nonce + lane * nthreads), {}}})) {
+                            return;
+                        }
+                    }
+
+                    nonce += step;
+                }
+            });
+        }
     }
 
     // Block the main thread until a nonce is solved
@@ -71,10 +177,19 @@ uint32_t CPUSolver::Solve(Block& b) {
     bool ret;
     do {
         ret = solutions.Take(last_result);
-        if (ret && last_result.first == task_id) {
+
+        // only the solutions of the latest header of the block are taken
+        std::lock_guard<std::mutex> lk(templateLock_);
+        if (!ret) {
+            template_ = nullptr;
+        } else if (last_result.first == current_task_id.load()) {
+            template_ = nullptr;
             Abort();
             b.SetTime(std::get<0>(last_result.second));
             b.SetNonce(std::get<1>(last_result.second));
+            if (GetParams().cycleLen) {
+                b.SetProof(std::move(std::get<2>(last_result.second)));
+            }
             b.CalculateHash();
             b.CalculateOptimalEncodingSize();
 
@@ -84,6 +199,16 @@ uint32_t CPUSolver::Solve(Block& b) {
 
     solverPool_.Abort();
 
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds > 0) {
+        hashRate_ = hashes_.load() / seconds;
+    }
+    if (GetParams().cycleLen) {
+        spdlog::debug("[Solver] {} graphs in {:.3f} s, {:.3f} graphs/s", hashes_.load(), seconds, hashRate_.load());
+    } else {
+        spdlog::debug("[Solver] {} hashes in {:.3f} s, {:.0f} H/s", hashes_.load(), seconds, hashRate_.load());
+    }
+
     if (ret) {
         return SolverResult::ErrorCode::SUCCESS;
     } else {
@@ -91,6 +216,53 @@ uint32_t CPUSolver::Solve(Block& b) {
     }
 }
 
+void CPUSolver::SearchCycles(uint32_t nonce) {
+    const uint32_t cycleLen = GetParams().cycleLen;
+    {
+        std::lock_guard<std::mutex> lk(cycleCtxLock_);
+        if (!enabled.load()) {
+            return;
+        }
+        cycleCtx_ = std::make_unique<LeanSolverCtx>(solverPool_.GetThreadSize(), cycleLen);
+    }
+
+    bool found = false;
+    Task task{}; // loaded in the first round
+    while (!found && enabled.load()) {
+        if (task.id != current_task_id.load()) {
+            task = LoadTask();
+
+            // the graph of the former header may have been aborted
+            std::lock_guard<std::mutex> lk(cycleCtxLock_);
+            if (enabled.load()) {
+                cycleCtx_->resume();
+            }
+        } else if (nonce == UINT32_MAX) {
+            // move the timestamp forward before the nonces run out
+            task.time = time(nullptr);
+            SetTimestamp(task.header, task.time);
+        }
+        SetNonce(task.header, nonce);
+
+        cycleCtx_->SetHeader(task.header.data(), task.header.size());
+        int nsols = cycleCtx_->solve();
+        hashes_++;
+
+        for (int s = 0; s < nsols && !found; ++s) {
+            std::vector<uint32_t> proof(cycleCtx_->sols.begin() + s * cycleLen,
+                                        cycleCtx_->sols.begin() + (s + 1) * cycleLen);
+            if (UintToArith256(HashBLAKE2<256>(proof.data(), cycleLen * sizeof(word_t))) <= task.target) {
+                found = PutSolution({task.id, {task.time, nonce, std::move(proof)}});
+            }
+        }
+
+        nonce++;
+    }
+
+    std::lock_guard<std::mutex> lk(cycleCtxLock_);
+    cycleCtx_.reset();
+}
+
 bool RemoteGPUSolver::Start() {
     // Read config for remote solver socket
     auto miner_config = cpptoml::parse_file(CONFIG->GetConfigFilePath())->get_table("miner");
@@ -139,19 +311,45 @@ void RemoteGPUSolver::Abort() {
     client->AbortTask(&context, request, &response);
 }
 
-uint32_t RemoteGPUSolver::Solve(Block& b) {
-    arith_uint256 target = b.GetTargetAsInteger();
+namespace {
+void SetTask(rpc::POWTask& request, const Block& b) {
     VStream vs(b.GetHeader());
-    grpc::ClientContext context;
-    rpc::POWTask request;
-    rpc::POWResult reply;
-    request.set_task_id(GetTaskID());
     request.set_init_nonce(0);
     request.set_init_time(b.GetTime());
     request.set_step(1);
     request.set_cycle_length(GetParams().cycleLen);
-    request.set_target(target.GetHex());
+    request.set_target(b.GetTargetAsInteger().GetHex());
     request.set_header(vs.data(), vs.size());
+}
+} // namespace
+
+std::function<void()> RemoteGPUSolver::PushHeader(const Block& b) {
+    rpc::POWTask request;
+    request.set_task_id(current_task_id);
+    request.set_update_id(++update_id_);
+    SetTask(request, b);
+
+    return [this, request = std::move(request)]() {
+        grpc::ClientContext context;
+        rpc::POWResult reply;
+        auto status = client->UpdateTask(&context, request, &reply);
+        if (!status.ok() || reply.error_code() != SolverResult::ErrorCode::SUCCESS) {
+            spdlog::debug("Failed to update solver task: id = {}, update = {}", request.task_id(), request.update_id());
+        }
+    };
+}
+
+uint32_t RemoteGPUSolver::Solve(Block& b) {
+    grpc::ClientContext context;
+    rpc::POWTask request;
+    rpc::POWResult reply;
+    {
+        std::lock_guard<std::mutex> lk(templateLock_);
+        template_  = &b;
+        update_id_ = 0;
+        request.set_task_id(GetTaskID());
+        SetTask(request, b);
+    }
 
     if (!sent_task_) {
         sent_task_ = true;
@@ -159,6 +357,14 @@ uint32_t RemoteGPUSolver::Solve(Block& b) {
     spdlog::debug("Sending solver task: id = {}", request.task_id());
     auto status = client->SendTask(&context, request, &reply);
 
+    // the block is no longer updated once the task is done
+    std::lock_guard<std::mutex> lk(templateLock_);
+    template_ = nullptr;
+    if (status.ok() && reply.error_code() == SolverResult::ErrorCode::SUCCESS && reply.update_id() != update_id_) {
+        spdlog::warn("Solver task solved a former header of the block: id = {}", request.task_id());
+        return SolverResult::ErrorCode::TASK_CANCELED_BY_CLIENT;
+    }
+
     if (status.ok()) {
         switch (reply.error_code()) {
             case SolverResult::ErrorCode::SUCCESS: {
@@ -171,7 +377,8 @@ uint32_t RemoteGPUSolver::Solve(Block& b) {
                 b.SetTime(reply.time());
                 b.CalculateHash();
                 b.CalculateOptimalEncodingSize();
-                spdlog::info("Solver task succeeded, id = {}", request.task_id());
+                spdlog::info("Solver task succeeded, id = {}, queued {} ms, solved in {} ms", request.task_id(),
+                             reply.queue_micros() / 1000, reply.solve_micros() / 1000);
                 break;
             }
             case SolverResult::ErrorCode::SERVER_ABORT: {
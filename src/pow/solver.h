@@ -7,9 +7,11 @@
 
 #include "block.h"
 #include "concurrent_container.h"
+#include "lean.h"
 #include "service/solver.h"
 #include "threadpool.h"
 
+#include <functional>
 #include <rpc.pb.h>
 
 class Solver {
@@ -28,11 +30,32 @@ public:
         return current_task_id.load();
     }
 
+    /*
+     * runs the update on the block being solved, if any, and hands its new header
+     * to the search without restarting it; the solutions found on the former header
+     * are discarded from then on
+     * @param update changes the block, returning whether its header has changed
+     * @return whether the header has been handed to the search
+     */
+    bool UpdateTemplate(const std::function<bool()>& update);
+
 protected:
     std::atomic_bool enabled = false;
 
     std::atomic_uint32_t current_task_id = 0;
 
+    // the block being solved, set by Solve while it waits for solutions,
+    // and no longer updated once a solution of its current header is found
+    std::mutex templateLock_;
+    Block* template_ = nullptr;
+    bool solved_     = false;
+
+    /*
+     * hands the header of the updated block being solved to the search; requires templateLock_
+     * @return the rest of the handing over, to be run once the lock is released, if any
+     */
+    virtual std::function<void()> PushHeader(const Block& b) = 0;
+
     using Solution = std::pair<uint32_t, std::tuple<uint32_t, uint32_t, std::vector<uint32_t>>>;
     BlockingQueue<Solution> solutions;
 };
@@ -51,8 +74,38 @@ public:
     void Enable() override;
     uint32_t Solve(Block&) override;
 
+    /* hashes, or graphs searched for cycles, per second during the last solve */
+    double GetHashRate() const {
+        return hashRate_.load();
+    }
+
+protected:
+    std::function<void()> PushHeader(const Block& b) override;
+
 private:
     ThreadPool solverPool_;
+
+    // the header searched by the workers, replaced with a new task id when the block is updated
+    struct Task {
+        uint32_t id;
+        VStream header;
+        arith_uint256 target;
+        uint32_t time;
+    };
+    Task task_;
+    Task LoadTask();
+
+    // queues the solution if it is of the current header, returning whether it is
+    bool PutSolution(Solution&& solution);
+
+    std::atomic_uint64_t hashes_  = 0;
+    std::atomic<double> hashRate_ = 0;
+
+    // the context searching cycles, trimming each graph on as many threads as the pool has
+    std::mutex cycleCtxLock_;
+    std::unique_ptr<LeanSolverCtx> cycleCtx_;
+
+    void SearchCycles(uint32_t nonce);
 };
 
 class SolverRPCClient {
@@ -64,6 +117,10 @@ public:
         return stub.SendPOWTask(context, request, reply);
     }
 
+    grpc::Status UpdateTask(grpc::ClientContext* context, rpc::POWTask request, rpc::POWResult* reply) {
+        return stub.UpdatePOWTask(context, request, reply);
+    }
+
     grpc::Status AbortTask(grpc::ClientContext* context, rpc::StopTaskRequest request, rpc::StopTaskResponse* reply) {
         return stub.StopTask(context, request, reply);
     }
@@ -82,9 +139,16 @@ public:
     void Enable() override {}
     uint32_t Solve(Block&) override;
 
+protected:
+    // the update is sent to the solver without holding the template, as the call blocks
+    std::function<void()> PushHeader(const Block& b) override;
+
 private:
     std::unique_ptr<SolverRPCClient> client;
     std::atomic_bool sent_task_ = false;
+
+    // the number of headers pushed to the task sent
+    uint32_t update_id_ = 0;
 };
 
 #endif // EPIC_SOLVER_H
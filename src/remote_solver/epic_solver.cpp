@@ -41,7 +41,8 @@ int main(int argc, char* argv[]) {
     options.add_options()
     ("h,help", "print help message", cxxopts::value<bool>())
     ("addr", "ip address with port", cxxopts::value<std::string>())
-    ("size", "max size of threads", cxxopts::value<uint32_t>());
+    ("size", "max size of threads", cxxopts::value<uint32_t>())
+    ("cpu", "trim on the cpu instead of the gpus", cxxopts::value<bool>());
     // clang-format on
 
     auto parsed_options = options.parse(argc, argv);
@@ -64,13 +65,24 @@ int main(int argc, char* argv[]) {
     spdlog::info("Creating RPC server. IP address = {}", address);
     auto server = std::make_unique<BasicRPCServer>(address);
 
-    int nGPUDevices{};
-    gpuAssert(cudaGetDeviceCount(&nGPUDevices), (char*) __FILE__, __LINE__);
-    spdlog::info("Miner using GPU. Found {} GPU devices.", nGPUDevices);
+    bool cpu = parsed_options["cpu"].as<bool>();
+#ifdef __CUDA_ENABLED__
+    if (!cpu) {
+        int nGPUDevices{};
+        gpuAssert(cudaGetDeviceCount(&nGPUDevices), (char*) __FILE__, __LINE__);
+        spdlog::info("Miner using GPU. Found {} GPU devices.", nGPUDevices);
+
+        thread_size = thread_size < nGPUDevices ? thread_size : nGPUDevices;
+    }
+#else
+    cpu = true;
+#endif
+    if (cpu) {
+        spdlog::info("Miner using CPU.");
+    }
 
-    thread_size = thread_size < nGPUDevices ? thread_size : nGPUDevices;
     spdlog::info("Creating solver. Thread size = {}", thread_size);
-    auto solver = std::make_shared<SolverManager>(thread_size);
+    auto solver = std::make_shared<SolverManager>(thread_size, cpu);
 
     auto service = std::make_unique<SolverRPCServiceImpl>(solver);
     server->Start(std::vector<grpc::Service*>{service.get()});
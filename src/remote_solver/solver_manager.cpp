@@ -14,15 +14,25 @@ inline void SetTimestamp(VStream& vs, uint32_t t) {
     memcpy(vs.data() + vs.size() - 3 * sizeof(uint32_t), &t, sizeof(uint32_t));
 }
 
-SolverManager::SolverManager(size_t nThreads) : solverPool_(nThreads) {
-    FillDefaultGPUParams(solverParams_);
+#ifdef __CUDA_ENABLED__
+SolverManager::SolverManager(size_t nThreads, bool cpu) : cpu_(cpu), solverPool_(cpu ? 1 : nThreads) {
+    if (!cpu_) {
+        FillDefaultGPUParams(solverParams_);
+        return;
+    }
+#else
+SolverManager::SolverManager(size_t nThreads, bool) : cpu_(true), solverPool_(1) {
+#endif
+    // a single context trims each graph with all the threads
+    solverParams_.nthreads = nThreads;
+    solverParams_.ntrims   = LEAN_NTRIMS;
 }
 
 bool SolverManager::Start() {
     bool flag = false;
     if (enabled_.compare_exchange_strong(flag, true)) {
         solverPool_.Start();
-        spdlog::info("Solver started.");
+        spdlog::info("Solver started on the {}.", cpu_ ? "cpu" : "gpus");
         return true;
     }
 
@@ -33,6 +43,12 @@ bool SolverManager::Stop() {
     bool flag = true;
     if (enabled_.compare_exchange_strong(flag, false)) {
         spdlog::info("Stopping solver...");
+        {
+            // wakes up the waiting tasks and the one being solved
+            std::lock_guard<std::mutex> lk(lock_);
+            solutions.Quit();
+        }
+        scheduled_.notify_all();
         solverPool_.Stop();
 
         return true;
@@ -40,17 +56,38 @@ bool SolverManager::Stop() {
     return false;
 }
 
+void SolverManager::Cancel(const std::shared_ptr<SolverTask>& task) {
+    task->abort_ = true;
+    if (task == running_) {
+        solutions.Quit();
+    }
+}
+
 TaskStatus SolverManager::ProcessTask(const std::shared_ptr<SolverTask>& task) {
-    task_queue_.Put(task->id);
-    tasks.insert({task->id, task});
-    spdlog::info("Received task with id = {}", task->id);
-    while (!isIdle || task_queue_.Front() != task->id) {
-        sleep(1);
+    using namespace std::chrono;
+    const auto received = steady_clock::now();
+
+    std::unique_lock<std::mutex> lk(lock_);
+    spdlog::info("Received task with id = {} from {}", task->id, task->miner);
+    if (!task->miner.empty()) {
+        for (const auto& stale : waiting_) {
+            if (stale->miner == task->miner) {
+                Cancel(stale);
+            }
+        }
+        if (running_ && running_->miner == task->miner) {
+            spdlog::info("Task with id = {} preempts task with id = {}", task->id, running_->id);
+            Cancel(running_);
+        }
     }
+    waiting_.push_back(task);
+    scheduled_.notify_all();
+
+    scheduled_.wait(lk, [&] { return !enabled_ || task->abort_ || (!running_ && waiting_.front() == task); });
+    waiting_.erase(std::find(waiting_.begin(), waiting_.end(), task));
+    task->queueMicros = duration_cast<microseconds>(steady_clock::now() - received).count();
 
-    isIdle = false;
     TaskStatus result;
-    task_queue_.Take(task->id);
     if (task->abort_) {
         result.second = SolverResult::ErrorCode ::TASK_CANCELED_BY_CLIENT;
         spdlog::info("Aborting task with id = {}", task->id);
@@ -58,74 +95,134 @@ TaskStatus SolverManager::ProcessTask(const std::shared_ptr<SolverTask>& task) {
         result.second = SolverResult::ErrorCode ::SERVER_ABORT;
         spdlog::info("Server shutted down. Aborting task with id = {}", task->id);
     } else {
-        result = Solve(task);
-        spdlog::info("Finished task with id = {}", task->id);
+        running_ = task;
+        lk.unlock();
+
+        const auto start  = steady_clock::now();
+        result            = Solve(task);
+        task->solveMicros = duration_cast<microseconds>(steady_clock::now() - start).count();
+
+        lk.lock();
+        running_ = nullptr;
+        spdlog::info("Finished task with id = {}, waited {} ms, solved in {} ms", task->id, task->queueMicros / 1000,
+                     task->solveMicros / 1000);
     }
-    tasks.erase(task->id);
-    isIdle = true;
+
+    // the next task in the queue may be the one to run
+    scheduled_.notify_all();
     return result;
 }
 
+template <typename Ctx>
+void SolverManager::SearchNonces(Ctx* ctx, size_t i, size_t nthreads, const std::shared_ptr<SolverTask>& task) {
+    uint32_t nonce = task->init_nonce + i * task->step;
+    uint32_t timestamp, update;
+    VStream blkStream;
+    arith_uint256 target;
+    auto load = [&]() {
+        std::lock_guard<std::mutex> lk(task->headerLock);
+        update    = task->update_id;
+        timestamp = task->init_time;
+        blkStream = task->blockHeader;
+        target    = task->target;
+    };
+    load();
+
+    while (enabled_.load()) {
+        // go on with the next nonces on the header replacing the former one
+        if (update != task->update_id.load()) {
+            load();
+        }
+        SetNonce(blkStream, nonce);
+
+        // move the timestamp forward before the nonces wrap around
+        if (nonce > UINT32_MAX - nthreads * task->step) {
+            timestamp = time(nullptr);
+            SetTimestamp(blkStream, timestamp);
+        }
+
+        ctx->SetHeader(blkStream.data(), blkStream.size());
+
+        if (aborted_ || task->abort_.load()) {
+            return;
+        }
+
+        if (ctx->solve()) {
+            std::vector<uint32_t> sol(ctx->sols.end() - task->cycle_length,
+                                      ctx->sols.end()); // the last solution
+            uint256 cyclehash = HashBLAKE2<256>(sol.data(), (size_t) task->cycle_length * sizeof(word_t));
+            if (UintToArith256(cyclehash) <= target) {
+                // a solution of a replaced header is dropped, and the search goes on with the new one
+                std::lock_guard<std::mutex> lk(task->headerLock);
+                if (update == task->update_id) {
+                    task->solved = true;
+                    solutions.Put({task->id, {timestamp, nonce, std::move(sol), update}});
+                    spdlog::trace("Found solution: thread {}, nonce {}, time {}, cycle hash {}", i, nonce, timestamp,
+                                  cyclehash.to_substr());
+                    return;
+                }
+            }
+        }
+
+        nonce += nthreads * task->step;
+    }
+}
 
 TaskStatus SolverManager::Solve(std::shared_ptr<SolverTask> task) {
     aborted_ = false;
     solutions.Enable();
+    if (task->abort_ || !enabled_) {
+        // canceled before the queue of solutions is enabled
+        solutions.Quit();
+    }
     TaskStatus status;
 
     size_t nthreads = solverPool_.GetThreadSize();
+    std::vector<std::unique_ptr<LeanSolverCtx>> cpu_ctx_q(nthreads);
+#ifdef __CUDA_ENABLED__
+    // the gpu contexts are created on the threads of their devices, which may still be at it when they are aborted
+    std::mutex ctxLock;
     std::vector<SolverCtx*> ctx_q(nthreads);
+#endif
 
     try {
+        // the cpu contexts are created before any thread uses them, so that aborting them needs no lock
+        if (cpu_) {
+            for (auto& ctx : cpu_ctx_q) {
+                ctx = std::make_unique<LeanSolverCtx>(solverParams_.nthreads, task->cycle_length, EDGEBITS,
+                                                      solverParams_.ntrims);
+            }
+        }
+
         for (size_t i = 0; i < nthreads; ++i) {
-            solverPool_.Execute([i, nthreads, nonce = task->init_nonce + i * task->step, timestamp = task->init_time,
-                                 &task, &ctx_q, this]() mutable {
+            solverPool_.Execute([&, i]() {
+                if (cpu_) {
+                    SearchNonces(cpu_ctx_q[i].get(), i, nthreads, task);
+                    return;
+                }
+#ifdef __CUDA_ENABLED__
                 auto params    = solverParams_;
                 params.device  = i;
                 SolverCtx* ctx = nullptr;
                 while (!aborted_ && !task->abort_ && !ctx) {
                     ctx = CreateSolverCtx(params, task->cycle_length);
                 }
-                ctx_q[i] = ctx;
-
-                auto blkStream = task->blockHeader;
-
-                while (enabled_.load()) {
-                    SetNonce(blkStream, nonce);
-
-                    if (nonce >= (i - nthreads) * task->step) {
-                        timestamp = time(nullptr);
-                        SetTimestamp(blkStream, timestamp);
-                    }
-
-                    ctx->SetHeader(blkStream.data(), blkStream.size());
-
-                    if (aborted_ || task->abort_.load()) {
-                        delete ctx;
-                        return;
-                    }
-
-                    if (ctx->solve()) {
-                        std::vector<uint32_t> sol(ctx->sols.end() - task->cycle_length,
-                                                  ctx->sols.end()); // the last solution
-                        uint256 cyclehash = HashBLAKE2<256>(sol.data(), (size_t) task->cycle_length * sizeof(word_t));
-                        if (UintToArith256(cyclehash) <= task->target) {
-                            solutions.Put({task->id, {timestamp, nonce, std::move(sol)}});
-                            spdlog::trace("Found solution: thread {}, nonce {}, time {}, cycle hash {}", i, nonce,
-                                          timestamp, cyclehash.to_substr());
-                            delete ctx;
-                            break;
-                        }
-                    }
-
-                    nonce += nthreads * task->step;
+                {
+                    std::lock_guard<std::mutex> lk(ctxLock);
+                    ctx_q[i] = ctx;
+                }
+                if (ctx) {
+                    SearchNonces(ctx, i, nthreads, task);
                 }
+#endif
             });
         }
 
         // Block the main thread until a nonce is solved
         Solution last_result;
         while (solutions.Take(last_result)) {
-            if (last_result.first == task->id) {
+            // a solution of a replaced header is stale
+            if (last_result.first == task->id && std::get<3>(last_result.second) == task->update_id) {
                 // Abort unfinished tasks
                 aborted_ = true;
                 solutions.Quit();
@@ -134,13 +231,31 @@ TaskStatus SolverManager::Solve(std::shared_ptr<SolverTask> task) {
         }
 
         solverPool_.ClearAndDisableTasks();
-        for (const auto& ctx : ctx_q) {
+        for (const auto& ctx : cpu_ctx_q) {
             if (ctx) {
                 ctx->abort();
             }
         }
+#ifdef __CUDA_ENABLED__
+        {
+            std::lock_guard<std::mutex> lk(ctxLock);
+            for (const auto& ctx : ctx_q) {
+                if (ctx) {
+                    ctx->abort();
+                }
+            }
+        }
+#endif
         solverPool_.Abort();
 
+        // the contexts are released once none of the threads is using them
+        cpu_ctx_q.clear();
+#ifdef __CUDA_ENABLED__
+        for (const auto& ctx : ctx_q) {
+            delete ctx;
+        }
+#endif
+
         if (!enabled_) {
             status.second = SolverResult::ErrorCode ::SERVER_ABORT;
         } else if (task->abort_) {
@@ -151,6 +266,7 @@ TaskStatus SolverManager::Solve(std::shared_ptr<SolverTask> task) {
             status.first->final_time  = std::get<0>(last_result.second);
             status.first->final_nonce = std::get<1>(last_result.second);
             status.first->proof       = std::move(std::get<2>(last_result.second));
+            status.first->update_id   = std::get<3>(last_result.second);
             status.second             = SolverResult::ErrorCode::SUCCESS;
         }
 
@@ -160,11 +276,34 @@ TaskStatus SolverManager::Solve(std::shared_ptr<SolverTask> task) {
     return status;
 }
 
-void SolverManager::AbortTask(uint32_t task_id) {
-    auto it = tasks.find(task_id);
-    if (it != tasks.end()) {
-        it->second->abort_ = true;
+bool SolverManager::UpdateTask(const SolverTask& update) {
+    std::lock_guard<std::mutex> lk(lock_);
+    auto matches = [&update](const std::shared_ptr<SolverTask>& task) {
+        return task && task->id == update.id && task->miner == update.miner && !task->abort_;
+    };
+
+    if (matches(running_)) {
+        return running_->Update(update);
     }
+    for (const auto& task : waiting_) {
+        if (matches(task)) {
+            return task->Update(update);
+        }
+    }
+    return false;
+}
 
-    solutions.Quit();
+void SolverManager::AbortTask(uint32_t task_id) {
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        if (running_ && running_->id == task_id) {
+            Cancel(running_);
+        }
+        for (const auto& task : waiting_) {
+            if (task->id == task_id) {
+                Cancel(task);
+            }
+        }
+    }
+    scheduled_.notify_all();
 }
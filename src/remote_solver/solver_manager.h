@@ -10,28 +10,60 @@
 #include "solver_task.h"
 #include "threadpool.h"
 
+#include <condition_variable>
+#include <deque>
+
+/*
+ * Solves the tasks one at a time in the order they are received, except that a task
+ * cancels the stale ones of the same miner, preempting the one being solved
+ */
 class SolverManager {
 public:
-    explicit SolverManager(size_t nThreads);
+    /*
+     * @param nThreads the number of gpus to solve on,
+     *        or of threads trimming on the cpu if cpu is set or the gpus are not available
+     */
+    explicit SolverManager(size_t nThreads, bool cpu = false);
+
+    /*
+     * blocks until the task is solved or canceled, recording how long it
+     * waited in the queue and was solved in the task
+     */
     TaskStatus ProcessTask(const std::shared_ptr<SolverTask>& task);
     TaskStatus Solve(std::shared_ptr<SolverTask> task);
     void AbortTask(uint32_t task_id);
 
+    // replaces the header of the task of the same id, returning whether it is waiting or being solved
+    // and has no solution yet
+    bool UpdateTask(const SolverTask& update);
+
     bool Start();
     bool Stop();
 
 private:
     std::atomic_bool enabled_ = false;
     std::atomic_bool aborted_ = false;
-    BlockingQueue<uint32_t> task_queue_;
-    ConcurrentHashMap<uint32_t, std::shared_ptr<SolverTask>> tasks;
-    std::atomic_bool isIdle = true;
 
+    // signaled when the running task finishes, a task is canceled or the solver stops
+    std::mutex lock_;
+    std::condition_variable scheduled_;
+    std::deque<std::shared_ptr<SolverTask>> waiting_;
+    std::shared_ptr<SolverTask> running_;
+
+    bool cpu_;
     ThreadPool solverPool_;
     SolverParams solverParams_;
 
-    using Solution = std::pair<uint32_t, std::tuple<uint32_t, uint32_t, std::vector<uint32_t>>>;
+    // the task id, and the time, nonce, proof and update of the header of a solution
+    using Solution = std::pair<uint32_t, std::tuple<uint32_t, uint32_t, std::vector<uint32_t>, uint32_t>>;
     BlockingQueue<Solution> solutions;
+
+    // searches the nonces of the i-th of nthreads solver contexts until one of them solves the task
+    template <typename Ctx>
+    void SearchNonces(Ctx* ctx, size_t i, size_t nthreads, const std::shared_ptr<SolverTask>& task);
+
+    // cancels the task, interrupting it if it is running; requires lock_
+    void Cancel(const std::shared_ptr<SolverTask>& task);
 };
 
 
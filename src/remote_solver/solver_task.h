@@ -7,6 +7,7 @@
 
 #include "arith_uint256.h"
 #include "cuckaroo.h"
+#include "lean.h"
 #include "solver_protocol.h"
 #include "stream.h"
 #include "threadpool.h"
@@ -16,13 +17,19 @@ struct TaskResult {
     uint32_t final_nonce;
     uint32_t final_time;
     std::vector<word_t> proof;
+    uint32_t update_id; // of the header solved
 };
 
 struct SolverTask {
     // task meta data
     uint32_t id;
+    std::string miner; // tasks of a miner supersede its earlier ones
     std::atomic_bool abort_ = false;
 
+    // time spent waiting for the solver and solving, set when processed
+    uint64_t queueMicros = 0;
+    uint64_t solveMicros = 0;
+
     // task parameters
     uint32_t init_nonce;
     uint32_t init_time;
@@ -30,6 +37,25 @@ struct SolverTask {
     uint32_t cycle_length;
     VStream blockHeader;
     arith_uint256 target;
+
+    // the header, time and target are replaced under headerLock while the task is solved,
+    // until a solution of the current header is found
+    std::mutex headerLock;
+    std::atomic_uint32_t update_id = 0;
+    bool solved                    = false;
+
+    // returns whether the header is replaced
+    bool Update(const SolverTask& update) {
+        std::lock_guard<std::mutex> lk(headerLock);
+        if (solved) {
+            return false;
+        }
+        init_time   = update.init_time;
+        blockHeader = update.blockHeader;
+        target      = update.target;
+        update_id   = update.update_id.load();
+        return true;
+    }
 };
 
 using TaskStatus = std::pair<std::unique_ptr<TaskResult>, SolverResult::ErrorCode>;
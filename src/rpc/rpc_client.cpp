@@ -87,6 +87,30 @@ op_string RPCClient::GetLevelSetSize(std::string block_hash) {
         request, &response);
 }
 
+op_string RPCClient::GetTransaction(std::string tx_hash) {
+    GetTransactionRequest request;
+    request.set_hash(tx_hash);
+
+    GetTransactionResponse response;
+    return ProcessResponse(
+        [&](auto* context, const auto& request, auto* response) -> grpc::Status {
+            return be_stub_->GetTransaction(context, request, response);
+        },
+        request, &response);
+}
+
+op_string RPCClient::GetAddressUTXOs(std::string address) {
+    GetAddressUTXOsRequest request;
+    request.set_address(address);
+
+    GetAddressUTXOsResponse response;
+    return ProcessResponse(
+        [&](auto* context, const auto& request, auto* response) -> grpc::Status {
+            return be_stub_->GetAddressUTXOs(context, request, response);
+        },
+        request, &response);
+}
+
 op_string RPCClient::GetLatestMilestone() {
     EmptyMessage request;
     GetLatestMilestoneResponse response;
@@ -17,6 +17,8 @@ public:
     std::optional<std::string> GetBlock(std::string);
     std::optional<std::string> GetLevelSet(std::string);
     std::optional<std::string> GetLevelSetSize(std::string);
+    std::optional<std::string> GetTransaction(std::string);
+    std::optional<std::string> GetAddressUTXOs(std::string);
     std::optional<std::string> GetLatestMilestone();
     std::optional<std::string> GetNewMilestoneSince(std::string, size_t);
     std::optional<std::string> GetVertex(std::string);
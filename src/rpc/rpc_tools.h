@@ -10,11 +10,13 @@
 #include <rpc.pb.h>
 
 class Transaction;
+class TxOutPoint;
 class TxOutput;
 class Block;
 class Vertex;
 
 // functions below will pass the ownvership of the allocated object to rpc to handle its lifetime
+rpc::Outpoint* ToRPCOutPoint(const TxOutPoint& outpoint);
 rpc::Output* ToRPCOutput(const TxOutput& output);
 rpc::Transaction* ToRPCTx(const Transaction& tx); 
 rpc::Block* ToRPCBlock(const Block&);
@@ -6,6 +6,7 @@
 #include "block_store.h"
 #include "dag_manager.h"
 #include "mempool.h"
+#include "pubkey.h"
 #include "rpc_tools.h"
 
 #include <numeric>
@@ -47,6 +48,53 @@ grpc::Status BasicBlockExplorerRPCServiceImpl::GetLevelSetSize(grpc::ServerConte
     return grpc::Status::OK;
 }
 
+grpc::Status BasicBlockExplorerRPCServiceImpl::GetTransaction(grpc::ServerContext* context,
+                                                              const GetTransactionRequest* request,
+                                                              GetTransactionResponse* reply) {
+    auto pos = STORE->GetTxPos(uintS<256>(request->hash()));
+    if (!pos) {
+        return grpc::Status::OK;
+    }
+
+    const auto& [blkHash, txIndex] = *pos;
+    auto vertex                    = STORE->GetVertex(blkHash);
+    if (!vertex || txIndex >= vertex->cblock->GetTransactionSize()) {
+        return grpc::Status::OK;
+    }
+
+    reply->set_allocated_transaction(ToRPCTx(*vertex->cblock->GetTransactions()[txIndex]));
+    reply->set_blockhash(std::to_string(blkHash));
+    reply->set_txindex(txIndex);
+    reply->set_valid(vertex->validity[txIndex] == ::Vertex::Validity::VALID);
+    return grpc::Status::OK;
+}
+
+grpc::Status BasicBlockExplorerRPCServiceImpl::GetAddressUTXOs(grpc::ServerContext* context,
+                                                               const GetAddressUTXOsRequest* request,
+                                                               GetAddressUTXOsResponse* reply) {
+    auto addr = DecodeAddress(request->address());
+    if (!addr) {
+        return grpc::Status::OK;
+    }
+
+    auto outpoints = STORE->GetAddrOutPoints(*addr);
+    auto utxos     = reply->mutable_utxos();
+    utxos->Reserve(outpoints.size());
+    for (const auto& outpoint : outpoints) {
+        // entries written by the background indexer may be
+        // stale, so check them against the utxo set
+        auto utxo = STORE->GetUTXO(outpoint.GetOutKey());
+        if (!utxo) {
+            continue;
+        }
+
+        auto rpc_utxo = utxos->Add();
+        rpc_utxo->set_allocated_outpoint(ToRPCOutPoint(outpoint));
+        rpc_utxo->set_money(utxo->GetOutput().value.GetValue());
+    }
+    return grpc::Status::OK;
+}
+
 grpc::Status BasicBlockExplorerRPCServiceImpl::GetNewMilestoneSince(grpc::ServerContext* context,
                                                                     const GetNewMilestoneSinceRequest* request,
                                                                     GetNewMilestoneSinceResponse* reply) {
@@ -164,10 +212,16 @@ grpc::Status BasicBlockExplorerRPCServiceImpl::Statistic(grpc::ServerContext* co
         const auto tEnd = STORE->GetLevelSetBlksAt(bestchain->GetMilestones().front()->height - 1).front()->GetTime();
         auto tps        = response->ntxs() / static_cast<double>(tEnd - stat.tStart);
         response->set_tps(tps);
+    }
 
-        if (MEMPOOL) {
-            response->set_mempool(MEMPOOL->Size());
-        }
+    if (MEMPOOL) {
+        const auto stats = MEMPOOL->GetStats();
+        response->set_mempool(stats.count);
+        response->set_mempool_bytes(stats.bytes);
+        response->set_mempool_max_bytes(stats.maxBytes);
+        response->set_mempool_min_fee_rate(stats.minFeeRate);
+        response->set_mempool_evicted(stats.nEvicted);
+        response->set_mempool_evicted_bytes(stats.evictedBytes);
     }
     return grpc::Status::OK;
 }
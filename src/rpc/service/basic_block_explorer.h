@@ -31,6 +31,14 @@ public:
                                  const rpc::GetLevelSetSizeRequest* request,
                                  rpc::GetLevelSetSizeResponse* reply) override;
 
+    grpc::Status GetTransaction(grpc::ServerContext* context,
+                                const rpc::GetTransactionRequest* request,
+                                rpc::GetTransactionResponse* reply) override;
+
+    grpc::Status GetAddressUTXOs(grpc::ServerContext* context,
+                                 const rpc::GetAddressUTXOsRequest* request,
+                                 rpc::GetAddressUTXOsResponse* reply) override;
+
     grpc::Status GetVertex(grpc::ServerContext* context,
                            const rpc::GetVertexRequest* request,
                            rpc::GetVertexResponse* response) override;
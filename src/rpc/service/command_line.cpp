@@ -412,6 +412,34 @@ void CommanderRPCServiceImpl::AddPeer(rpc::ShowPeerResponse* response, PeerPtr p
         rpc_peer->set_local_service(peer->versionMessage->local_service);
         rpc_peer->set_app_version(peer->versionMessage->version_info);
     }
+
+    rpc_peer->set_last_ping_rtt(peer->GetLastPingRTT());
+    rpc_peer->set_min_ping_rtt(peer->GetMinPingRTT());
+    rpc_peer->set_avg_ping_rtt(peer->GetAvgPingRTT());
+
+    const auto& traffic = peer->GetConnection()->GetTraffic();
+    uint64_t sentBytes = 0, receivedBytes = 0, sentMessages = 0, receivedMessages = 0;
+    for (uint32_t type = 0; type <= NetMessage::NONE; ++type) {
+        if (traffic.sentMessages[type] == 0 && traffic.receivedMessages[type] == 0) {
+            continue;
+        }
+
+        auto rpc_traffic = rpc_peer->add_traffic();
+        rpc_traffic->set_type(type);
+        rpc_traffic->set_sent_bytes(traffic.sentBytes[type]);
+        rpc_traffic->set_received_bytes(traffic.receivedBytes[type]);
+        rpc_traffic->set_sent_messages(traffic.sentMessages[type]);
+        rpc_traffic->set_received_messages(traffic.receivedMessages[type]);
+
+        sentBytes += rpc_traffic->sent_bytes();
+        receivedBytes += rpc_traffic->received_bytes();
+        sentMessages += rpc_traffic->sent_messages();
+        receivedMessages += rpc_traffic->received_messages();
+    }
+    rpc_peer->set_sent_bytes(sentBytes);
+    rpc_peer->set_received_bytes(receivedBytes);
+    rpc_peer->set_sent_messages(sentMessages);
+    rpc_peer->set_received_messages(receivedMessages);
 }
 
 grpc::Status CommanderRPCServiceImpl::ShowPeer(grpc::ServerContext* context,
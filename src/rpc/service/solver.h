@@ -15,23 +15,38 @@
 class SolverRPCServiceImpl final : public rpc::RemoteSolver::Service {
 public:
     grpc::Status SendPOWTask(grpc::ServerContext* context, const rpc::POWTask* task, rpc::POWResult* result) override {
-        auto solverTask = CreateTask(task);
+        auto solverTask = CreateTask(context, task);
         if (!solverTask) {
             result->set_error_code(SolverResult::ErrorCode::INVALID_PARAM);
         } else {
             auto calResult = blockSolver_->ProcessTask(solverTask);
             result->set_error_code(calResult.second);
+            result->set_queue_micros(solverTask->queueMicros);
+            result->set_solve_micros(solverTask->solveMicros);
             if (calResult.second == SolverResult::ErrorCode::SUCCESS) {
                 for (auto& proof_element : calResult.first->proof) {
                     result->add_proof(proof_element);
                     result->set_nonce(calResult.first->final_nonce);
                     result->set_time(calResult.first->final_time);
                 }
+                result->set_update_id(calResult.first->update_id);
             }
         }
         return grpc::Status::OK;
     }
 
+    grpc::Status UpdatePOWTask(grpc::ServerContext* context,
+                               const rpc::POWTask* task,
+                               rpc::POWResult* result) override {
+        auto update = CreateTask(context, task);
+        if (!update || !blockSolver_->UpdateTask(*update)) {
+            result->set_error_code(SolverResult::ErrorCode::INVALID_PARAM);
+        } else {
+            result->set_error_code(SolverResult::ErrorCode::SUCCESS);
+        }
+        return grpc::Status::OK;
+    }
+
     grpc::Status StopTask(grpc::ServerContext* context,
                           const rpc::StopTaskRequest* request,
                           rpc::StopTaskResponse* reply) override {
@@ -62,18 +77,20 @@ private:
         return true;
     }
 
-    std::shared_ptr<SolverTask> CreateTask(const rpc::POWTask* task) {
+    std::shared_ptr<SolverTask> CreateTask(grpc::ServerContext* context, const rpc::POWTask* task) {
         if (!checkParams(task)) {
             return nullptr;
         }
         auto solverTask          = std::make_shared<SolverTask>();
         solverTask->id           = task->task_id();
+        solverTask->miner        = context ? context->peer() : "";
         solverTask->init_nonce   = task->init_nonce();
         solverTask->init_time    = task->init_time();
         solverTask->step         = task->step() == 0 ? 1 : task->step();
         solverTask->cycle_length = task->cycle_length();
         solverTask->blockHeader  = VStream(task->header().data(), task->header().data() + task->header().length());
         solverTask->target.SetHex(task->target());
+        solverTask->update_id    = task->update_id();
 
         return solverTask;
     }
@@ -0,0 +1,283 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "async_reader.h"
+#include "spdlog/spdlog.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <unordered_map>
+
+static int OpenForRead(const ReadRequest& request) {
+    return ::open(file::GetFilePath(request.type, request.pos).c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+static bool PreadFull(int fd, char* buf, size_t size, off_t offset) {
+    while (size > 0) {
+        auto n = ::pread(fd, buf, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+AsyncReader::AsyncReader(size_t nThreads, unsigned queueDepth)
+    : pool_(nThreads),
+      queueDepth_(queueDepth),
+      running_(false)
+#ifdef HAVE_LIBURING
+      ,
+      ringInitialized_(false),
+      ringEnabled_(false)
+#endif
+{
+}
+
+AsyncReader::~AsyncReader() {
+    Stop();
+}
+
+void AsyncReader::Start() {
+    bool flag = false;
+    if (!running_.compare_exchange_strong(flag, true)) {
+        return;
+    }
+
+#ifdef HAVE_LIBURING
+    ringInitialized_ = io_uring_queue_init(queueDepth_, &ring_, 0) == 0;
+    ringEnabled_     = ringInitialized_;
+    if (!ringInitialized_) {
+        spdlog::warn("[STORE] Failed to set up io_uring, reading files with a thread pool");
+    }
+#endif
+    pool_.Start();
+}
+
+void AsyncReader::Stop() {
+    bool flag = true;
+    if (!running_.compare_exchange_strong(flag, false)) {
+        return;
+    }
+
+    pool_.Stop();
+#ifdef HAVE_LIBURING
+    if (ringInitialized_) {
+        io_uring_queue_exit(&ring_);
+        ringInitialized_ = false;
+        ringEnabled_     = false;
+    }
+#endif
+}
+
+std::future<std::vector<VStream>> AsyncReader::Read(std::vector<ReadRequest> requests, Transform transform) {
+    auto batch       = std::make_shared<Batch>();
+    batch->requests  = std::move(requests);
+    batch->transform = std::move(transform);
+    batch->results.resize(batch->requests.size());
+    batch->remaining = batch->requests.size();
+
+    auto result = batch->promise.get_future();
+    if (batch->requests.empty()) {
+        batch->promise.set_value({});
+        return result;
+    }
+
+    if (!running_.load()) {
+        for (size_t i = 0; i < batch->requests.size(); ++i) {
+            ReadOne(*batch, i);
+        }
+        return result;
+    }
+
+#ifdef HAVE_LIBURING
+    if (ringEnabled_) {
+        pool_.Execute([this, batch]() { ReadWithRing(*batch); });
+        return result;
+    }
+#endif
+
+    for (size_t i = 0; i < batch->requests.size(); ++i) {
+        pool_.Execute([this, batch, i]() { ReadOne(*batch, i); });
+    }
+    return result;
+}
+
+void AsyncReader::ReadOne(Batch& batch, size_t index) {
+    const auto& request = batch.requests[index];
+
+    VStream vs;
+    if (request.size > 0) {
+        int fd = OpenForRead(request);
+        vs.resize(request.size);
+        if (fd < 0 || !PreadFull(fd, vs.data(), request.size, request.pos.nOffset)) {
+            spdlog::debug("[STORE] Failed to read {} bytes at {}", request.size, std::to_string(request.pos));
+            vs.clear();
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    Finish(batch, index, std::move(vs));
+}
+
+void AsyncReader::Finish(Batch& batch, size_t index, VStream&& result) {
+    if (batch.transform && !result.empty()) {
+        result = batch.transform(std::move(result));
+    }
+    batch.results[index] = std::move(result);
+
+    if (batch.remaining.fetch_sub(1) == 1) {
+        batch.promise.set_value(std::move(batch.results));
+    }
+}
+
+#ifdef HAVE_LIBURING
+void AsyncReader::ReadWithRing(Batch& batch) {
+    const auto nRequests = batch.requests.size();
+    std::vector<VStream> buffers(nRequests);
+    std::vector<int> fdOf(nRequests, -1);
+    std::vector<bool> done(nRequests, false);
+    std::unordered_map<std::string, int> fds;
+
+    // completes a read, finishing short ones synchronously
+    auto complete = [&](io_uring_cqe* cqe) {
+        auto index = reinterpret_cast<size_t>(io_uring_cqe_get_data(cqe));
+        auto res   = cqe->res;
+        io_uring_cqe_seen(&ring_, cqe);
+
+        const auto& request = batch.requests[index];
+        if (res >= 0 && (static_cast<uint32_t>(res) == request.size ||
+                         PreadFull(fdOf[index], buffers[index].data() + res, request.size - res,
+                                   request.pos.nOffset + res))) {
+            done[index] = true;
+        }
+    };
+
+    size_t inflight = 0;
+    {
+        std::lock_guard<std::mutex> lock(ringLock_);
+
+        // a batch that waited for the lock while the ring failed must not submit the entries left in it;
+        // queued counts the reads prepared in the submission queue, inflight the ones submitted
+        size_t next = ringEnabled_ ? 0 : nRequests, queued = 0;
+        bool failed = false;
+        while (next < nRequests || queued + inflight > 0) {
+            // Keep the submission queue full
+            while (next < nRequests && queued + inflight < queueDepth_) {
+                const auto& request = batch.requests[next];
+                if (request.size == 0) {
+                    ++next;
+                    continue;
+                }
+
+                auto path = file::GetFilePath(request.type, request.pos);
+                auto fd   = fds.find(path);
+                if (fd == fds.end()) {
+                    fd = fds.emplace(path, OpenForRead(request)).first;
+                }
+                if (fd->second < 0) {
+                    ++next;
+                    continue;
+                }
+
+                auto sqe = io_uring_get_sqe(&ring_);
+                if (!sqe) {
+                    break;
+                }
+
+                fdOf[next] = fd->second;
+                buffers[next].resize(request.size);
+                io_uring_prep_read(sqe, fd->second, buffers[next].data(), request.size, request.pos.nOffset);
+                io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(next));
+                ++next;
+                ++queued;
+            }
+
+            if (queued > 0) {
+                int ret = io_uring_submit(&ring_);
+                if (ret > 0) {
+                    queued -= ret;
+                    inflight += ret;
+                } else if (ret != -EINTR && inflight == 0) {
+                    // with nothing in flight, no completion frees the resources lacked
+                    spdlog::error("[STORE] io_uring failed to submit with error {}", ret);
+                    failed = true;
+                    break;
+                }
+            }
+
+            if (inflight == 0) {
+                if (queued == 0 && next < nRequests) {
+                    // the submission queue is full without any read of this batch in it
+                    spdlog::error("[STORE] io_uring has no submission queue entry available");
+                    failed = true;
+                    break;
+                }
+                continue;
+            }
+
+            io_uring_cqe* cqe;
+            int ret = io_uring_wait_cqe(&ring_, &cqe);
+            if (ret == -EINTR) {
+                continue;
+            }
+            if (ret < 0) {
+                spdlog::error("[STORE] io_uring failed with error {}", ret);
+                failed = true;
+                break;
+            }
+            complete(cqe);
+            --inflight;
+        }
+
+        if (failed) {
+            // the reads submitted are waited for before their buffers are released,
+            // and the ones left are read with pread below
+            while (inflight > 0) {
+                io_uring_cqe* cqe;
+                int ret = io_uring_wait_cqe(&ring_, &cqe);
+                if (ret == -EINTR) {
+                    continue;
+                }
+                if (ret < 0) {
+                    break;
+                }
+                complete(cqe);
+                --inflight;
+            }
+
+            // the reads prepared but not submitted are left in the ring, which is no longer used
+            ringEnabled_ = false;
+            spdlog::warn("[STORE] Reading files with a thread pool from now on");
+        }
+    }
+
+    for (size_t i = 0; i < nRequests; ++i) {
+        if (done[i]) {
+            Finish(batch, i, std::move(buffers[i]));
+        } else {
+            ReadOne(batch, i);
+        }
+    }
+
+    if (inflight > 0) {
+        std::lock_guard<std::mutex> lock(ringLock_);
+        abandoned_.push_back(std::move(buffers));
+    }
+
+    for (const auto& [path, fd] : fds) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+#endif
@@ -0,0 +1,83 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_ASYNC_READER_H
+#define EPIC_ASYNC_READER_H
+
+#include "file_utils.h"
+#include "threadpool.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+struct ReadRequest {
+    file::FileType type;
+    FilePos pos;
+    uint32_t size;
+};
+
+/**
+ * Reads batches of file regions asynchronously. With liburing, the reads
+ * of a batch are submitted to an io_uring instance so that they overlap
+ * in the disk queue; otherwise they are spread over a thread pool doing
+ * blocking preads.
+ */
+class AsyncReader {
+public:
+    using Transform = std::function<VStream(VStream&&)>;
+
+    explicit AsyncReader(size_t nThreads, unsigned queueDepth = 64);
+    AsyncReader() = delete;
+    ~AsyncReader();
+
+    void Start();
+    void Stop();
+
+    /**
+     * Reads the requests and returns the results in the same order.
+     * A result is empty if the request fails or has size 0.
+     * The transform, if any, is applied to each result in the
+     * reader threads.
+     */
+    std::future<std::vector<VStream>> Read(std::vector<ReadRequest> requests, Transform transform = nullptr);
+
+private:
+    struct Batch {
+        std::vector<ReadRequest> requests;
+        std::vector<VStream> results;
+        Transform transform;
+        std::atomic_size_t remaining;
+        std::promise<std::vector<VStream>> promise;
+    };
+
+    ThreadPool pool_;
+    unsigned queueDepth_;
+    std::atomic<bool> running_;
+
+#ifdef HAVE_LIBURING
+    std::mutex ringLock_;
+    io_uring ring_;
+    bool ringInitialized_;
+
+    // cleared once the ring fails, after which the batches are read with the thread pool
+    std::atomic<bool> ringEnabled_;
+
+    // buffers of the reads left in flight by a failed ring, which the kernel may still write into
+    std::vector<std::vector<VStream>> abandoned_;
+
+    void ReadWithRing(Batch& batch);
+#endif
+
+    void ReadOne(Batch& batch, size_t index);
+    void Finish(Batch& batch, size_t index, VStream&& result);
+};
+
+#endif // EPIC_ASYNC_READER_H
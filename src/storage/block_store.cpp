@@ -4,8 +4,10 @@
 
 #include "block_store.h"
 #include "crc32.h"
+#include "wallet.h"
 
 #include <filesystem>
+#include <thread>
 
 template <typename P>
 std::vector<std::shared_ptr<P>> DeserializeRawLvs(VStream&& vs) {
@@ -32,8 +34,67 @@ std::vector<std::shared_ptr<P>> DeserializeRawLvs(VStream&& vs) {
 template std::vector<ConstBlockPtr> DeserializeRawLvs(VStream&&);
 template std::vector<VertexPtr> DeserializeRawLvs(VStream&&);
 
+static const uint64_t kIndexCatchUpStep = 100;
+
+// Number of times a failed catch-up step is retried before indexing stops
+static const size_t kIndexMaxRetries = 5;
+
+// Level sets are stored with headers since this layout revision
+static const uint32_t kLvsLayoutHeader = 1;
+
+// Number of blocks deserialized by a task of lvsThread_
+static const size_t kLvsChunkSize = 32;
+
+/**
+ * Removes level set headers from consecutive level sets read from files
+ */
+VStream StripLvsHeaders(VStream&& raw) {
+    VStream result;
+    result.reserve(raw.size());
+
+    try {
+        while (raw.in_avail()) {
+            uint32_t count;
+            raw >> count;
+
+            uint32_t offset = 0, length = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                raw >> offset >> length;
+            }
+            raw.ignore(count * Hash::SIZE);
+
+            auto bodySize = offset + length;
+            result.write(raw.data(), bodySize);
+            raw.ignore(bodySize);
+        }
+    } catch (const std::exception&) {
+        spdlog::error("Error occurs stripping level set headers: {} {}", __FILE__, __LINE__);
+    }
+
+    return result;
+}
+
+std::optional<CKeyID> ParseIndexAddr(const TxOutput& output) {
+    try {
+        return ParseAddrFromScript(output.listingContent);
+    } catch (const std::exception&) {
+        return {};
+    }
+}
+
 BlockStore::BlockStore(const std::string& dbPath)
-    : obcThread_(1), obcEnabled_(false), checksumCalThread_(1), lastUpdateTaskTime_(time(nullptr)), dbStore_(dbPath) {
+    : obcThread_(1),
+      obcEnabled_(false),
+      indexThread_(1),
+      indexEnabled_(false),
+      indexCatchingUp_(false),
+      indexTarget_(0),
+      indexStopping_(false),
+      lvsThread_(std::max(std::thread::hardware_concurrency(), 1u)),
+      asyncReader_(4),
+      checksumCalThread_(1),
+      lastUpdateTaskTime_(time(nullptr)),
+      dbStore_(dbPath) {
     obcThread_.Start();
     obcTimeout_.AddPeriodTask(300, [this]() {
         obcThread_.Execute([this]() {
@@ -44,7 +105,17 @@ BlockStore::BlockStore(const std::string& dbPath)
         });
     });
     obcTimeout_.Start();
+    indexThread_.Start();
+    lvsThread_.Start();
+    asyncReader_.Start();
     checksumCalThread_.Start();
+
+    // A new store writes level sets with headers, while an
+    // existing one keeps the layout it was created with
+    if (!dbStore_.GetMsPos(uint64_t{0})) {
+        dbStore_.WriteInfo("lvsLayout", kLvsLayoutHeader);
+    }
+    lvsHeader_ = dbStore_.GetInfo<uint32_t>("lvsLayout") >= kLvsLayoutHeader;
 }
 
 void BlockStore::AddBlockToOBC(ConstBlockPtr&& blk, const uint8_t& mask) {
@@ -59,10 +130,7 @@ void BlockStore::AddBlockToOBC(ConstBlockPtr&& blk, const uint8_t& mask) {
 
 void BlockStore::ReleaseBlocks(const uint256& blkHash) {
     obcThread_.Execute([blkHash, this]() {
-        auto releasedBlocks = obc_.SubmitHash(blkHash);
-        for (auto& blk : releasedBlocks) {
-            DAG->AddNewBlock(std::move(blk), nullptr);
-        }
+        DAG->AddNewBlocks(obc_.SubmitHash(blkHash), nullptr);
     });
 }
 
@@ -111,6 +179,10 @@ VertexPtr BlockStore::GetMilestoneAt(size_t height) const {
     return vtx;
 }
 
+uint256 BlockStore::GetMilestoneHashAt(size_t height) const {
+    return dbStore_.GetMsHashAt(height);
+}
+
 VertexPtr BlockStore::GetVertex(const uint256& blkHash, bool withBlock) const {
     VertexPtr vtx = ConstructNRFromFile(dbStore_.GetVertexPos(blkHash), withBlock);
     if (vtx && vtx->isMilestone) {
@@ -121,7 +193,14 @@ VertexPtr BlockStore::GetVertex(const uint256& blkHash, bool withBlock) const {
 
 std::vector<VertexPtr> BlockStore::GetLevelSetVtcsAt(size_t height, bool withBlock) const {
     // Get vertices
-    auto result = DeserializeRawLvs<Vertex>(GetRawLevelSetAt(height, file::FileType::VTX));
+    std::vector<VertexPtr> result;
+    if (lvsHeader_) {
+        if (auto lvs = ReadLevelSet(height, file::FileType::VTX)) {
+            result = DeserializeLvs<Vertex>(lvs->first, lvs->second);
+        }
+    } else {
+        result = DeserializeRawLvs<Vertex>(GetRawLevelSetAt(height, file::FileType::VTX));
+    }
     assert(!result.empty());
 
     const auto& ms = result.back();
@@ -165,7 +244,163 @@ VertexPtr BlockStore::ConstructNRFromFile(std::optional<std::pair<FilePos, FileP
 }
 
 std::vector<ConstBlockPtr> BlockStore::GetLevelSetBlksAt(size_t height) const {
-    return DeserializeRawLvs<const Block>(GetRawLevelSetAt(height));
+    if (!lvsHeader_) {
+        return DeserializeRawLvs<const Block>(GetRawLevelSetAt(height));
+    }
+
+    auto lvs = ReadLevelSet(height, file::FileType::BLK);
+    if (!lvs) {
+        return {};
+    }
+    return DeserializeLvs<const Block>(lvs->first, lvs->second);
+}
+
+std::optional<LvsHeader> BlockStore::GetLevelSetHeaderAt(size_t height, file::FileType fType) const {
+    auto nBlocks = dbStore_.GetLvsSize(height);
+    auto pos     = GetLvsPos(height);
+    if (!lvsHeader_ || !pos || nBlocks == 0) {
+        return {};
+    }
+
+    try {
+        FileReader reader(fType, fType == file::FileType::BLK ? pos->first : pos->second);
+        VStream vs;
+        reader.read(LvsHeader::Size(nBlocks), vs);
+
+        LvsHeader header;
+        vs >> header;
+        return header;
+    } catch (const std::exception&) {
+        spdlog::error("Error occurs reading level set header at height {}", height);
+        return {};
+    }
+}
+
+std::vector<uint256> BlockStore::GetLevelSetHashesAt(size_t height) const {
+    std::vector<uint256> hashes;
+
+    auto nBlocks = dbStore_.GetLvsSize(height);
+    auto pos     = GetLvsPos(height);
+    if (!lvsHeader_ || !pos || nBlocks == 0) {
+        auto blocks = GetLevelSetBlksAt(height);
+        hashes.reserve(blocks.size());
+        for (const auto& b : blocks) {
+            hashes.emplace_back(b->GetHash());
+        }
+        return hashes;
+    }
+
+    try {
+        // Read the hash list only
+        auto blkPos = pos->first;
+        blkPos.nOffset += LvsHeader::HashesOffset(nBlocks);
+        FileReader reader(file::FileType::BLK, blkPos);
+        VStream vs;
+        reader.read(nBlocks * Hash::SIZE, vs);
+
+        hashes.resize(nBlocks);
+        for (auto& h : hashes) {
+            vs >> h;
+        }
+    } catch (const std::exception&) {
+        spdlog::error("Error occurs reading level set hashes at height {}", height);
+        return {};
+    }
+
+    // file order has the ms at first
+    std::rotate(hashes.begin(), hashes.begin() + 1, hashes.end());
+    return hashes;
+}
+
+std::optional<std::pair<FilePos, FilePos>> BlockStore::GetLvsPos(size_t height) const {
+    auto pos = dbStore_.GetMsPos(height);
+    if (pos && lvsHeader_) {
+        auto headerSize = LvsHeader::Size(dbStore_.GetLvsSize(height));
+        pos->first.nOffset -= headerSize;
+        pos->second.nOffset -= headerSize;
+    }
+    return pos;
+}
+
+std::optional<std::pair<LvsHeader, VStream>> BlockStore::ReadLevelSet(size_t height, file::FileType fType) const {
+    auto nBlocks = dbStore_.GetLvsSize(height);
+    auto pos     = GetLvsPos(height);
+    if (!pos || nBlocks == 0) {
+        return {};
+    }
+
+    try {
+        FileReader reader(fType, fType == file::FileType::BLK ? pos->first : pos->second);
+        VStream vs;
+        reader.read(LvsHeader::Size(nBlocks), vs);
+
+        LvsHeader header;
+        vs >> header;
+
+        VStream body;
+        reader.read(header.BodySize(), body);
+        return std::make_pair(std::move(header), std::move(body));
+    } catch (const std::exception&) {
+        spdlog::error("Error occurs reading level set at height {}", height);
+        return {};
+    }
+}
+
+template <typename P>
+std::vector<std::shared_ptr<P>> BlockStore::DeserializeLvs(const LvsHeader& header, const VStream& body) const {
+    const auto nBlocks = header.entries.size();
+    if (nBlocks == 0) {
+        return {};
+    }
+
+    std::vector<std::shared_ptr<P>> blocks(nBlocks);
+    std::atomic<bool> failed = false;
+
+    // Every block is deserialized from its own slice of the body
+    auto deserialize = [&](size_t begin, size_t end) {
+        try {
+            for (size_t i = begin; i < end; ++i) {
+                const auto& [offset, length] = header.entries[i];
+                if (offset + length > body.size()) {
+                    throw std::ios_base::failure("level set body is truncated");
+                }
+
+                VStream vs(body.data() + offset, body.data() + offset + length);
+                blocks[i] = std::make_shared<P>(vs);
+            }
+        } catch (const std::exception&) {
+            failed = true;
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    for (size_t begin = kLvsChunkSize; begin < nBlocks; begin += kLvsChunkSize) {
+        auto end = std::min(nBlocks, begin + kLvsChunkSize);
+        if (auto f = lvsThread_.Submit([&deserialize, begin, end]() { deserialize(begin, end); })) {
+            futures.emplace_back(std::move(*f));
+        } else {
+            deserialize(begin, end);
+        }
+    }
+    deserialize(0, std::min(nBlocks, kLvsChunkSize));
+
+    for (auto& f : futures) {
+        try {
+            f.get();
+        } catch (const std::future_error&) {
+            // the task is dropped by a stopped pool
+            failed = true;
+        }
+    }
+
+    if (failed) {
+        spdlog::error("Error occurs deserializing level set: {} {}", __FILE__, __LINE__);
+        return {};
+    }
+
+    // file order has the ms at first
+    std::rotate(blocks.begin(), blocks.begin() + 1, blocks.end());
+    return blocks;
 }
 
 VStream BlockStore::GetRawLevelSetAt(size_t height, file::FileType fType) const {
@@ -173,10 +408,61 @@ VStream BlockStore::GetRawLevelSetAt(size_t height, file::FileType fType) const
 }
 
 VStream BlockStore::GetRawLevelSetBetween(size_t height1, size_t height2, file::FileType fType) const {
+    if (lvsHeader_) {
+        return StripLvsHeaders(ReadRawLevelSets(height1, height2, fType));
+    }
+    return ReadRawLevelSets(height1, height2, fType);
+}
+
+std::future<std::vector<VStream>> BlockStore::GetRawLevelSetsAsync(const std::vector<size_t>& heights,
+                                                                   file::FileType fType) const {
+    std::vector<ReadRequest> requests;
+    requests.reserve(heights.size());
+
+    for (const auto& height : heights) {
+        auto region = GetLevelSetRegionAt(height, fType);
+        if (!region) {
+            requests.push_back({fType, FilePos{}, 0});
+            continue;
+        }
+        requests.push_back({fType, region->first, region->second});
+    }
+
+    if (lvsHeader_) {
+        return asyncReader_.Read(std::move(requests), [](VStream&& raw) { return StripLvsHeaders(std::move(raw)); });
+    }
+    return asyncReader_.Read(std::move(requests));
+}
+
+std::optional<std::pair<FilePos, uint32_t>> BlockStore::GetLevelSetRegionAt(size_t height, file::FileType fType) const {
+    auto pos = GetLvsPos(height);
+    if (!pos) {
+        return {};
+    }
+
+    // A level set ends where the next one starts, or at the end of file
+    auto begin = fType == file::FileType::BLK ? pos->first : pos->second;
+    auto next  = GetLvsPos(height + 1);
+    auto end   = file::GetFileSize(fType, begin);
+    if (next) {
+        auto nextPos = fType == file::FileType::BLK ? next->first : next->second;
+        if (begin.SameFileAs(nextPos)) {
+            end = nextPos.nOffset;
+        }
+    }
+
+    return std::make_pair(begin, static_cast<uint32_t>(end - begin.nOffset));
+}
+
+bool BlockStore::HasLvsHeader() const {
+    return lvsHeader_;
+}
+
+VStream BlockStore::ReadRawLevelSets(size_t height1, size_t height2, file::FileType fType) const {
     assert(height1 <= height2);
 
-    auto left  = dbStore_.GetMsPos(height1);
-    auto right = dbStore_.GetMsPos(height2 + 1);
+    auto left  = GetLvsPos(height1);
+    auto right = GetLvsPos(height2 + 1);
 
     std::optional<FilePos> leftPos = {}, rightPos = {};
 
@@ -328,22 +614,214 @@ bool BlockStore::UpdateRedemptionStatus(const uint256& key) const {
     return true;
 }
 
+void BlockStore::EnableIndex() {
+    bool flag = false;
+    if (!indexEnabled_.compare_exchange_strong(flag, true)) {
+        return;
+    }
+
+    // Level sets flushed from now on are indexed by IndexLevelSet,
+    // and the ones already in db are indexed in background
+    auto indexed = dbStore_.GetInfo<uint64_t>("indexHeight");
+    auto target  = GetHeadHeight();
+    spdlog::info("Index enabled. Indexed height {}, head height {}", indexed, target);
+    if (indexed < target) {
+        ScheduleCatchUpIndex(indexed == 0 ? 0 : indexed + 1, target);
+    }
+}
+
+bool BlockStore::IsIndexEnabled() const {
+    return indexEnabled_.load();
+}
+
+bool BlockStore::IndexLevelSet(const std::vector<VertexWPtr>& lvs,
+                               const std::unordered_map<uint256, UTXOPtr>& created,
+                               const std::unordered_set<uint256>& spent) {
+    if (!indexEnabled_.load() || lvs.empty()) {
+        return true;
+    }
+
+    IndexBatch batch;
+    for (const auto& wvtx : lvs) {
+        const auto& blk  = (*wvtx.lock()).cblock;
+        const auto& txns = blk->GetTransactions();
+        for (size_t i = 0; i < txns.size(); ++i) {
+            batch.txs.emplace_back(txns[i]->GetHash(), std::make_pair(blk->GetHash(), i));
+        }
+    }
+
+    for (const auto& [key, utxo] : created) {
+        if (auto addr = ParseIndexAddr(utxo->GetOutput())) {
+            auto [txIndex, outIndex] = utxo->GetIndices();
+            batch.created.emplace_back(*addr, TxOutPoint{utxo->GetContainingBlkHash(), txIndex, outIndex});
+        }
+    }
+
+    for (const auto& key : spent) {
+        auto utxo = dbStore_.GetUTXO(key);
+        if (!utxo) {
+            continue;
+        }
+        if (auto addr = ParseIndexAddr(utxo->GetOutput())) {
+            batch.spent.emplace_back(*addr, key);
+        }
+    }
+
+    if (!dbStore_.WriteIndexBatch(batch)) {
+        // the index head stays below the level set until the catch-up has indexed it
+        const auto height = lvs.back().lock()->height;
+        spdlog::error("[STORE] Failed to write index of level set {}, leaving it to the catch-up", height);
+        ScheduleCatchUpIndex(height, height);
+        return false;
+    }
+
+    if (!indexCatchingUp_.load()) {
+        dbStore_.WriteInfo("indexHeight", lvs.back().lock()->height);
+    }
+    return true;
+}
+
+void BlockStore::ScheduleCatchUpIndex(uint64_t height, uint64_t target) {
+    std::lock_guard<std::mutex> lk(indexLock_);
+    indexTarget_ = std::max(indexTarget_, target);
+    if (!indexCatchingUp_.exchange(true)) {
+        indexThread_.Execute([this, height]() { CatchUpIndex(height); });
+    }
+}
+
+void BlockStore::CatchUpIndex(uint64_t height, size_t retries) {
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> lk(indexLock_);
+        target = indexTarget_;
+    }
+
+    // a level set left to the catch-up when it failed to be indexed on flush
+    // is indexed once its utxos are stored, i.e. once the head has reached it
+    const auto head = GetHeadHeight();
+    if (head < height) {
+        if (WaitToCatchUpIndex(std::chrono::seconds(1))) {
+            indexThread_.Execute([this, height, retries]() { CatchUpIndex(height, retries); });
+        }
+        return;
+    }
+
+    const auto start = height;
+    auto end         = std::min({target, head, height + kIndexCatchUpStep - 1});
+    for (; height <= end; ++height) {
+        IndexBatch batch;
+        for (const auto& vtx : GetLevelSetVtcsAt(height)) {
+            const auto& blkHash = vtx->cblock->GetHash();
+            const auto& txns    = vtx->cblock->GetTransactions();
+            for (size_t i = 0; i < txns.size(); ++i) {
+                batch.txs.emplace_back(txns[i]->GetHash(), std::make_pair(blkHash, i));
+                if (vtx->validity[i] != Vertex::VALID) {
+                    continue;
+                }
+
+                // Only index outputs that are still unspent; the ones spent after
+                // the index is enabled are removed from the index by IndexLevelSet
+                const auto& outs = txns[i]->GetOutputs();
+                for (size_t j = 0; j < outs.size(); ++j) {
+                    TxOutPoint outpoint{blkHash, static_cast<uint32_t>(i), static_cast<uint32_t>(j)};
+                    if (!dbStore_.ExistsUTXO(outpoint.GetOutKey())) {
+                        continue;
+                    }
+                    if (auto addr = ParseIndexAddr(outs[j])) {
+                        batch.created.emplace_back(*addr, outpoint);
+                    }
+                }
+            }
+        }
+
+        if (!dbStore_.WriteIndexBatch(batch)) {
+            // keep the index head at the last level set indexed, and keep indexCatchingUp_
+            // set so that IndexLevelSet does not move it past the gap
+            if (height > start) {
+                dbStore_.WriteInfo("indexHeight", height - 1);
+            }
+            if (retries == kIndexMaxRetries) {
+                spdlog::error("[STORE] Failed to write index of level set {}, stop indexing until restart", height);
+                return;
+            }
+
+            spdlog::warn("[STORE] Failed to write index of level set {}, retrying", height);
+            if (WaitToCatchUpIndex(std::chrono::seconds(1 << retries))) {
+                indexThread_.Execute([this, height, retries]() { CatchUpIndex(height, retries + 1); });
+            }
+            return;
+        }
+    }
+
+    dbStore_.WriteInfo("indexHeight", end);
+
+    // the target may have been raised by a level set that failed to be indexed when flushed
+    std::lock_guard<std::mutex> lk(indexLock_);
+    if (end < indexTarget_) {
+        indexThread_.Execute([this, end]() { CatchUpIndex(end + 1); });
+    } else {
+        indexCatchingUp_ = false;
+        spdlog::info("[STORE] Finished indexing level sets up to height {}", end);
+    }
+}
+
+bool BlockStore::WaitToCatchUpIndex(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lk(indexLock_);
+    return !indexStop_.wait_for(lk, duration, [this] { return indexStopping_; });
+}
+
+std::optional<std::pair<uint256, uint32_t>> BlockStore::GetTxPos(const uint256& txHash) const {
+    return dbStore_.GetTxPos(txHash);
+}
+
+std::vector<TxOutPoint> BlockStore::GetAddrOutPoints(const CKeyID& addr) const {
+    return dbStore_.GetAddrOutPoints(addr);
+}
+
 std::unordered_map<uint256, uint256> BlockStore::GetAllReg() const {
     return dbStore_.GetAllReg();
 }
 
 bool BlockStore::StoreLevelSet(const std::vector<VertexWPtr>& lvs) {
     try {
-        // Function to sum up storage sizes for blk and vtx in this lvs
-        auto sumSize = [](const std::pair<uint32_t, uint32_t>& prevSum,
-                          const VertexWPtr& vtx) -> std::pair<uint32_t, uint32_t> {
-            return std::make_pair(prevSum.first + (*vtx.lock()).cblock->GetOptimalEncodingSize(),
-                                  prevSum.second + (*vtx.lock()).GetOptimalStorageSize());
+        const auto& ms  = (*lvs.back().lock());
+        uint64_t height = ms.height;
+
+        // Serialize the lvs in the order of files, i.e., ms goes the first,
+        // recording offsets relative to the ms for both the header and db
+        LvsHeader blkHeader, vtxHeader;
+        VStream blkBody, vtxBody;
+        std::vector<uint256> hashes;
+        std::vector<uint32_t> blkOffsets, vtxOffsets;
+        hashes.reserve(lvs.size());
+        blkOffsets.reserve(lvs.size());
+        vtxOffsets.reserve(lvs.size());
+
+        auto append = [&](const Vertex& vtx) {
+            uint32_t blkOffset = blkBody.size();
+            uint32_t vtxOffset = vtxBody.size();
+            blkBody << *(vtx.cblock);
+            vtxBody << vtx;
+
+            hashes.emplace_back(vtx.cblock->GetHash());
+            blkOffsets.emplace_back(blkOffset);
+            vtxOffsets.emplace_back(vtxOffset);
+            blkHeader.entries.emplace_back(blkOffset, blkBody.size() - blkOffset);
+            vtxHeader.entries.emplace_back(vtxOffset, vtxBody.size() - vtxOffset);
         };
 
+        append(ms);
+        for (size_t i = 0; i < lvs.size() - 1; ++i) {
+            append(*lvs[i].lock());
+        }
+        blkHeader.hashes = hashes;
+        vtxHeader.hashes = hashes;
+
+        uint32_t headerSize = lvsHeader_ ? LvsHeader::Size(lvs.size()) : 0;
+
         // pair of (total block size, total vertex size)
         std::pair<uint32_t, uint32_t> totalSize =
-            std::accumulate(lvs.begin(), lvs.end(), std::make_pair(0, 0), sumSize);
+            std::make_pair(headerSize + blkBody.size(), headerSize + vtxBody.size());
 
         CarryOverFileName(totalSize);
 
@@ -365,35 +843,26 @@ bool BlockStore::StoreLevelSet(const std::vector<VertexWPtr>& lvs) {
             vtxFs << init_checksum;
         }
 
-        const auto& ms  = (*lvs.back().lock());
-        uint64_t height = ms.height;
-
-        // Store ms to file
-        blkFs << *ms.cblock;
-        vtxFs << ms;
-        dbStore_.WriteVtxPos(ms.cblock->GetHash(), height, 0, 0);
-        uint32_t blkOffset;
-        uint32_t vtxOffset;
-
-        for (size_t i = 0; i < lvs.size() - 1; ++i) {
-            // Write to file
-            const auto& vtx = (*lvs[i].lock());
-            blkOffset       = blkFs.GetOffsetP() - msBlkPos.nOffset;
-            vtxOffset       = vtxFs.GetOffsetP() - msVtxPos.nOffset;
-            blkFs << *(vtx.cblock);
-            vtxFs << vtx;
-
-            // Write positions to db
-            dbStore_.WriteVtxPos(vtx.cblock->GetHash(), height, blkOffset, vtxOffset);
+        // Store the header and the lvs to file
+        if (lvsHeader_) {
+            blkFs << blkHeader;
+            vtxFs << vtxHeader;
+            msBlkPos.nOffset += headerSize;
+            msVtxPos.nOffset += headerSize;
         }
+        blkFs << blkBody;
+        vtxFs << vtxBody;
 
         blkFs.Flush();
         blkFs.Close();
         vtxFs.Flush();
         vtxFs.Close();
 
+        // Write positions to db
+        dbStore_.WriteVtxPoses(hashes, std::vector<uint64_t>(hashes.size(), height), blkOffsets, vtxOffsets);
+
         // Write ms position at last to enable search for all blocks in the lvs
-        dbStore_.WriteMsPos(height, ms.cblock->GetHash(), msBlkPos, msVtxPos);
+        dbStore_.WriteMsPos(height, ms.cblock->GetHash(), msBlkPos, msVtxPos, lvsHeader_ ? lvs.size() : 0);
         STORE->SaveBestChainWork(ArithToUint256(ms.snapshot->chainwork));
 
         AddCurrentSize(totalSize);
@@ -463,6 +932,15 @@ void BlockStore::Stop() {
     obcThread_.Abort();
     obcThread_.Stop();
     obcTimeout_.Stop();
+    {
+        std::lock_guard<std::mutex> lk(indexLock_);
+        indexStopping_ = true;
+    }
+    indexStop_.notify_all();
+    indexThread_.Abort();
+    indexThread_.Stop();
+    lvsThread_.Stop();
+    asyncReader_.Stop();
     while (!checksumTasks_.empty()) {
         spdlog::info("{} checksum tasks left, executing...", checksumTasks_.size());
         ExecuteChecksumTask();
@@ -634,11 +1112,11 @@ bool BlockStore::CheckFileSanity(bool prune) {
 
     // try to locate the actual position at the min invalid height in DB
     minInvalidHeight = std::min(minInvalidHeight, headHeight + 1);
-    auto pos_pair    = dbStore_.GetMsPos(minInvalidHeight);
+    auto pos_pair    = GetLvsPos(minInvalidHeight);
     while (!pos_pair && minInvalidHeight > 0) {
         spdlog::debug("Failed to get the ms pos from the invalid height {}", minInvalidHeight);
         --minInvalidHeight;
-        pos_pair = dbStore_.GetMsPos(minInvalidHeight);
+        pos_pair = GetLvsPos(minInvalidHeight);
     }
     spdlog::debug("The min invalid height is {}", minInvalidHeight);
 
@@ -702,6 +1180,12 @@ bool BlockStore::CheckFileSanity(bool prune) {
 size_t BlockStore::GetlatestHeightFromFile(FilePos search_pos, file::FileType type) {
     FileReader reader(type, search_pos);
     reader.SetOffsetP(file::checksum_size, std::ios_base::beg);
+    if (lvsHeader_) {
+        // skip the header of the first level set in file
+        uint32_t nBlocks;
+        reader >> nBlocks;
+        reader.SetOffsetP(file::checksum_size + LvsHeader::Size(nBlocks), std::ios_base::beg);
+    }
     if (type == file::BLK) {
         Block block;
         reader >> block;
@@ -798,6 +1282,12 @@ bool BlockStore::RebuildConsensus(uint64_t height) {
     if (!statusU || !statusR) {
         return false;
     }
+
+    // the index follows the utxos, so it has to be rebuilt as well
+    if (!dbStore_.ClearColumn("addr") || !dbStore_.ClearColumn("tx") ||
+        !dbStore_.WriteInfo("indexHeight", uint64_t{0})) {
+        return false;
+    }
     if (height <= 1) {
         return true;
     }
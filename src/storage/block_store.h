@@ -5,6 +5,7 @@
 #ifndef EPIC_STORAGE_H
 #define EPIC_STORAGE_H
 
+#include "async_reader.h"
 #include "circular_queue.h"
 #include "dag_manager.h"
 #include "db.h"
@@ -14,6 +15,7 @@
 #include "threadpool.h"
 
 #include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <numeric>
 #include <vector>
@@ -24,6 +26,61 @@ struct FileCheckInfo {
     uint32_t name;
 };
 
+/**
+ * Header written right before each level set in both blk and vtx files,
+ * so that a single block or the hash list of a level set can be read
+ * without parsing the whole level set. Entries are in file order
+ * (i.e., ms goes the first), and offsets are relative to the ms.
+ *
+ * Layout: {uint32 count, count * {uint32 offset, uint32 length}, count * hash}
+ *
+ * It has a fixed width so that it can be located from the ms position
+ * and the lvs size recorded in db.
+ */
+struct LvsHeader {
+    std::vector<std::pair<uint32_t, uint32_t>> entries;
+    std::vector<uint256> hashes;
+
+    static size_t Size(size_t nBlocks) {
+        return HashesOffset(nBlocks) + nBlocks * Hash::SIZE;
+    }
+
+    static size_t HashesOffset(size_t nBlocks) {
+        return sizeof(uint32_t) + nBlocks * 2 * sizeof(uint32_t);
+    }
+
+    uint32_t BodySize() const {
+        return entries.empty() ? 0 : entries.back().first + entries.back().second;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        ::Serialize(s, static_cast<uint32_t>(entries.size()));
+        for (const auto& [offset, length] : entries) {
+            ::Serialize(s, offset);
+            ::Serialize(s, length);
+        }
+        for (const auto& h : hashes) {
+            ::Serialize(s, h);
+        }
+    }
+
+    template <typename Stream>
+    void Deserialize(Stream& s) {
+        uint32_t count;
+        ::Deserialize(s, count);
+        entries.resize(count);
+        hashes.resize(count);
+        for (auto& [offset, length] : entries) {
+            ::Deserialize(s, offset);
+            ::Deserialize(s, length);
+        }
+        for (auto& h : hashes) {
+            ::Deserialize(s, h);
+        }
+    }
+};
+
 class BlockStore {
 public:
     BlockStore() = delete;
@@ -34,14 +91,46 @@ public:
      * DB API for other modules
      */
     VertexPtr GetMilestoneAt(size_t height) const;
+    uint256 GetMilestoneHashAt(size_t height) const;
     VertexPtr GetVertex(const uint256&, bool withBlock = true) const;
     ConstBlockPtr GetBlockCache(const uint256&) const;
     ConstBlockPtr FindBlock(const uint256&) const;
     VStream GetRawLevelSetAt(size_t height, file::FileType = file::FileType::BLK) const;
     VStream GetRawLevelSetBetween(size_t height1, size_t height2, file::FileType = file::FileType::BLK) const;
     std::vector<ConstBlockPtr> GetLevelSetBlksAt(size_t height) const;
+
+    /**
+     * Reads the level sets at heights with overlapped asynchronous reads.
+     * Each result is in the same format as GetRawLevelSetAt, and is
+     * empty if the level set is not found in files.
+     */
+    std::future<std::vector<VStream>> GetRawLevelSetsAsync(const std::vector<size_t>& heights,
+                                                           file::FileType = file::FileType::BLK) const;
     std::vector<VertexPtr> GetLevelSetVtcsAt(size_t height, bool withBlock = true) const;
 
+    /**
+     * Reads the header of the level set at height with one read.
+     * Returns nothing if the level set is stored without a header.
+     */
+    std::optional<LvsHeader> GetLevelSetHeaderAt(size_t height, file::FileType = file::FileType::BLK) const;
+
+    /**
+     * Returns {position, size} of the level set at height in files,
+     * including its header if any, for tools reading files directly
+     */
+    std::optional<std::pair<FilePos, uint32_t>> GetLevelSetRegionAt(size_t height, file::FileType) const;
+
+    /**
+     * Returns true if level sets are stored with headers
+     */
+    bool HasLvsHeader() const;
+
+    /**
+     * Returns the block hashes of the level set at height in the
+     * same order as GetLevelSetBlksAt (i.e., ms goes the last)
+     */
+    std::vector<uint256> GetLevelSetHashesAt(size_t height) const;
+
     size_t GetHeight(const uint256&) const;
     uint64_t GetHeadHeight() const;
     bool SaveHeadHeight(uint64_t height) const;
@@ -63,6 +152,33 @@ public:
 
     bool UpdateRedemptionStatus(const uint256&) const;
 
+    /**
+     * Optional tx and address indexes for block explorers.
+     * Once enabled, each level set is indexed when it is flushed,
+     * and the level sets stored before are indexed in background.
+     */
+    void EnableIndex();
+    bool IsIndexEnabled() const;
+
+    /**
+     * Indexes a flushed level set in one batch.
+     * Note that this method has to be called before
+     * the spent utxos are removed from db.
+     */
+    bool IndexLevelSet(const std::vector<VertexWPtr>& lvs,
+                       const std::unordered_map<uint256, UTXOPtr>& created,
+                       const std::unordered_set<uint256>& spent);
+
+    /**
+     * Returns {block hash, tx index} of the transaction
+     */
+    std::optional<std::pair<uint256, uint32_t>> GetTxPos(const uint256&) const;
+
+    /**
+     * Returns outpoints of the indexed utxos of the address
+     */
+    std::vector<TxOutPoint> GetAddrOutPoints(const CKeyID&) const;
+
     /**
      * Flushes a level set to db.
      * Note that this method assumes that the milestone is
@@ -133,6 +249,22 @@ private:
     OrphanBlocksContainer obc_;
     Scheduler obcTimeout_;
 
+    ThreadPool indexThread_;
+    std::atomic<bool> indexEnabled_;
+    std::atomic<bool> indexCatchingUp_;
+
+    // guards the catch-up target and wakes up a catch-up waiting to retry when the store stops
+    std::mutex indexLock_;
+    std::condition_variable indexStop_;
+    uint64_t indexTarget_;
+    bool indexStopping_;
+
+    // parallel deserialization of level sets with headers
+    mutable ThreadPool lvsThread_;
+    bool lvsHeader_;
+
+    mutable AsyncReader asyncReader_;
+
     ThreadPool checksumCalThread_;
     ConcurrentHashSet<FilePos> checksumTasks_;
     uint64_t lastUpdateTaskTime_;
@@ -163,6 +295,25 @@ private:
     void CarryOverFileName(std::pair<uint32_t, uint32_t>);
     void AddCurrentSize(std::pair<uint32_t, uint32_t>);
 
+    /**
+     * Returns the positions of the level set at height, i.e.,
+     * the header positions if it has one, or the ms positions
+     */
+    std::optional<std::pair<FilePos, FilePos>> GetLvsPos(size_t height) const;
+
+    /**
+     * Reads the header and the blocks of the level set at height
+     */
+    std::optional<std::pair<LvsHeader, VStream>> ReadLevelSet(size_t height, file::FileType) const;
+
+    /**
+     * Deserializes blocks of a level set in parallel with its header
+     */
+    template <typename P>
+    std::vector<std::shared_ptr<P>> DeserializeLvs(const LvsHeader&, const VStream&) const;
+
+    VStream ReadRawLevelSets(size_t height1, size_t height2, file::FileType) const;
+
     VertexPtr ConstructNRFromFile(std::optional<std::pair<FilePos, FilePos>>&&, bool withBlock = true) const;
     FilePos& NextFile(FilePos&) const;
 
@@ -183,6 +334,26 @@ private:
     bool ConstructUTXOAndRegFromLvs(std::vector<VertexPtr>& levelset);
 
     bool ConstructUTXOAndRegFromVtx(const VertexPtr& vtx);
+
+    /**
+     * Indexes stored level sets from height to indexTarget_, at most
+     * kIndexCatchUpStep level sets per task of indexThread_.
+     * A failed step is retried a few times; if it keeps failing, the
+     * index head stays below the gap and is caught up after restart
+     */
+    void CatchUpIndex(uint64_t height, size_t retries = 0);
+
+    /**
+     * Has the catch-up index the level sets up to target,
+     * starting it from height if it is not running
+     */
+    void ScheduleCatchUpIndex(uint64_t height, uint64_t target);
+
+    /**
+     * Waits before the catch-up goes on, unless the store stops
+     * @return false if the store stops
+     */
+    bool WaitToCatchUpIndex(std::chrono::milliseconds duration);
 };
 
 extern std::unique_ptr<BlockStore> STORE;
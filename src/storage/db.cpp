@@ -31,7 +31,9 @@ static const std::vector<std::string> COLUMN_NAMES = {
                // the milestone contained in the same level set
 
     "ms", // (key) level set height
-          // (value) {blk FilePos, vtx FilePos}
+          // (value) {ms hash, blk FilePos, vtx FilePos, [lvs size]}
+          // Note: lvs size is only present for level sets
+          // stored with a header in files
 
     "utxo", // (key) outpoint hash ^ outpoint index
             // (value) utxo
@@ -39,6 +41,14 @@ static const std::vector<std::string> COLUMN_NAMES = {
     "reg", // (key) hash of peer chain head
            // (value) hash of the last registration block on this peer chain
 
+    "tx", // (key) tx hash
+          // (value) {block hash, tx index}
+          // Note: only written if the index is enabled
+
+    "addr", // (key) {address, utxo key}
+            // (value) outpoint of the utxo
+            // Note: only written if the index is enabled
+
     "info" // Stores necessary info to recover the system,
            // e.g., lastest ms head in db
 };
@@ -94,6 +104,28 @@ optional<pair<FilePos, FilePos>> DBStore::GetMsPos(const uint64_t& height) const
     }
 }
 
+uint32_t DBStore::GetLvsSize(const uint64_t& height) const {
+    MAKE_KEY_SLICE(height)
+    GET_VALUE(handleMap_.at("ms"), 0)
+
+    try {
+        VStream value(valueSlice.data(), valueSlice.data() + valueSlice.size());
+        valueSlice.Reset();
+
+        value.ignore(Hash::SIZE);
+        FilePos blkPos(value);
+        FilePos vtxPos(value);
+
+        uint32_t lvsSize = 0;
+        if (value.in_avail()) {
+            value >> VARINT(lvsSize);
+        }
+        return lvsSize;
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
 optional<pair<FilePos, FilePos>> DBStore::GetMsPos(const uint256& blkHash) const {
     return GetMsPos(GetHeight(blkHash));
 }
@@ -163,8 +195,20 @@ bool DBStore::WriteVtxPoses(const std::vector<uint256>& keys,
 bool DBStore::WriteMsPos(const uint64_t& key,
                          const uint256& msHash,
                          const FilePos& blkPos,
-                         const FilePos& vtxPos) const {
-    return WritePosImpl("ms", key, msHash, blkPos, vtxPos);
+                         const FilePos& vtxPos,
+                         uint32_t lvsSize) const {
+    if (lvsSize == 0) {
+        return WritePosImpl("ms", key, msHash, blkPos, vtxPos);
+    }
+
+    MAKE_KEY_SLICE(key)
+
+    VStream value;
+    value.reserve(Hash::SIZE + 2 * sizeof(FilePos) + sizeof(uint32_t));
+    value << msHash << blkPos << vtxPos << VARINT(lvsSize);
+    Slice valueSlice(value.data(), value.size());
+
+    return db_->Put(WriteOptions(), handleMap_.at("ms"), keySlice, valueSlice).ok();
 }
 
 
@@ -266,6 +310,81 @@ bool DBStore::DeleteMsPos(const uint64_t height) const {
     return status;
 }
 
+optional<pair<uint256, uint32_t>> DBStore::GetTxPos(const uint256& txHash) const {
+    MAKE_KEY_SLICE(txHash)
+    GET_VALUE(handleMap_.at("tx"), {})
+
+    try {
+        VStream value(valueSlice.data(), valueSlice.data() + valueSlice.size());
+        valueSlice.Reset();
+
+        uint256 blkHash;
+        uint32_t txIndex;
+        value >> blkHash >> VARINT(txIndex);
+        return std::make_pair(blkHash, txIndex);
+    } catch (const std::exception&) {
+        return {};
+    }
+}
+
+std::vector<TxOutPoint> DBStore::GetAddrOutPoints(const CKeyID& addr) const {
+    std::vector<TxOutPoint> results;
+
+    VStream prefixStream{addr};
+    Slice prefix(prefixStream.data(), prefixStream.size());
+
+    Iterator* iter = db_->NewIterator(ReadOptions(), handleMap_.at("addr"));
+    for (iter->Seek(prefix); iter->Valid() && iter->key().starts_with(prefix); iter->Next()) {
+        try {
+            VStream value{iter->value().data(), iter->value().data() + iter->value().size()};
+            results.emplace_back();
+            value >> results.back();
+        } catch (std::exception& e) {
+            spdlog::error("Exception happened when getting outpoints of address, {}", e.what());
+            results.pop_back();
+            break;
+        }
+    }
+    assert(iter->status().ok());
+    delete iter;
+
+    return results;
+}
+
+bool DBStore::WriteIndexBatch(const IndexBatch& batch) const {
+    class WriteBatch wb;
+    VStream keyStream;
+    keyStream.reserve(Hash::SIZE + 20);
+    VStream valueStream;
+    valueStream.reserve(Hash::SIZE + 16);
+
+    for (const auto& [txHash, pos] : batch.txs) {
+        keyStream << txHash;
+        valueStream << pos.first << VARINT(pos.second);
+        wb.Put(handleMap_.at("tx"), Slice(keyStream.data(), keyStream.size()),
+               Slice(valueStream.data(), valueStream.size()));
+        keyStream.clear();
+        valueStream.clear();
+    }
+
+    for (const auto& [addr, outpoint] : batch.created) {
+        keyStream << addr << outpoint.GetOutKey();
+        valueStream << outpoint;
+        wb.Put(handleMap_.at("addr"), Slice(keyStream.data(), keyStream.size()),
+               Slice(valueStream.data(), valueStream.size()));
+        keyStream.clear();
+        valueStream.clear();
+    }
+
+    for (const auto& [addr, utxoKey] : batch.spent) {
+        keyStream << addr << utxoKey;
+        wb.Delete(handleMap_.at("addr"), Slice(keyStream.data(), keyStream.size()));
+        keyStream.clear();
+    }
+
+    return db_->Write(WriteOptions(), &wb).ok();
+}
+
 uint256 DBStore::GetLastReg(const uint256& key) const {
     MAKE_KEY_SLICE(key)
     GET_VALUE(handleMap_.at("reg"), uint256{})
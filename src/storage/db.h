@@ -5,6 +5,7 @@
 #ifndef EPIC_DB_H
 #define EPIC_DB_H
 
+#include "pubkey.h"
 #include "rocksdb.h"
 #include "vertex.h"
 
@@ -13,6 +14,23 @@
 
 struct FilePos;
 
+/**
+ * Secondary index entries of a level set, which are
+ * written to db in one batch by DBStore::WriteIndexBatch
+ */
+struct IndexBatch {
+    // {tx hash, {block hash, tx index}}
+    std::vector<std::pair<uint256, std::pair<uint256, uint32_t>>> txs;
+    // {address, outpoint of the utxo created}
+    std::vector<std::pair<CKeyID, TxOutPoint>> created;
+    // {address, key of the utxo spent}
+    std::vector<std::pair<CKeyID, uint256>> spent;
+
+    bool Empty() const {
+        return txs.empty() && created.empty() && spent.empty();
+    }
+};
+
 class DBStore : public RocksDB {
 public:
     explicit DBStore(std::string dbPath);
@@ -27,6 +45,7 @@ public:
      */
     std::optional<std::pair<FilePos, FilePos>> GetMsPos(const uint64_t& height) const;
     std::optional<FilePos> GetMsBlockPos(const uint64_t& height) const;
+    uint256 GetMsHashAt(const uint64_t& height) const;
 
     /**
      * Gets the milesonte file posisionts at height of blk
@@ -40,11 +59,19 @@ public:
      */
     std::optional<std::pair<FilePos, FilePos>> GetVertexPos(const uint256&) const;
 
+    /**
+     * Gets the number of blocks in the level set at height, which
+     * locates the level set header preceding the ms in files.
+     * Returns 0 if the level set is stored without a header.
+     */
+    uint32_t GetLvsSize(const uint64_t& height) const;
+
     /**
      * Writes the file offsets of the milestone hash
-     * key = ms height, value = {ms hash, ms blk FilePos, ms vtx FilePos}
+     * key = ms height, value = {ms hash, ms blk FilePos, ms vtx FilePos[, lvs size]}
+     * where lvs size is only written if the level set has a header
      */
-    bool WriteMsPos(const uint64_t&, const uint256&, const FilePos&, const FilePos&) const;
+    bool WriteMsPos(const uint64_t&, const uint256&, const FilePos&, const FilePos&, uint32_t lvsSize = 0) const;
 
     /**
      * Writes the file offsets of the hash with
@@ -67,6 +94,24 @@ public:
     bool WriteUTXO(const uint256&, const UTXOPtr&) const;
     bool RemoveUTXO(const uint256&) const;
 
+    /**
+     * Gets the position of a transaction from the tx index.
+     * Returns {block hash, tx index}
+     */
+    std::optional<std::pair<uint256, uint32_t>> GetTxPos(const uint256&) const;
+
+    /**
+     * Gets the outpoints of the utxos indexed under the address
+     */
+    std::vector<TxOutPoint> GetAddrOutPoints(const CKeyID&) const;
+
+    /**
+     * Writes tx and address index entries with
+     * key = tx hash, value = {block hash, tx index} and
+     * key = {address, utxo key}, value = outpoint
+     */
+    bool WriteIndexBatch(const IndexBatch&) const;
+
     uint256 GetLastReg(const uint256&) const;
     std::unordered_map<uint256, uint256> GetAllReg() const;
     bool UpdateReg(const RegChange&) const;
@@ -80,7 +125,6 @@ public:
     bool ClearColumn(std::string columnName);
 
 private:
-    uint256 GetMsHashAt(const uint64_t& height) const;
     std::optional<std::tuple<uint64_t, uint32_t, uint32_t>> GetVertexOffsets(const uint256&) const;
 
     bool WriteRegSet(const std::unordered_set<std::pair<uint256, uint256>>&) const;
@@ -3,8 +3,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "obc.h"
-#include <memory>
+#include <algorithm>
 #include <queue>
+#include <unordered_set>
 
 #define READER_LOCK(mu) std::shared_lock<std::shared_mutex> reader(mu);
 #define WRITER_LOCK(mu) std::unique_lock<std::shared_mutex> writer(mu);
@@ -35,42 +36,22 @@ void OrphanBlocksContainer::AddBlock(ConstBlockPtr&& block, uint8_t missing_mask
     auto prevHash = block->GetPrevHash();
     auto tipHash  = block->GetTipHash();
 
-    // construct new dependency for the new block
-    obc_dep_ptr dep;
-
-    READER_LOCK(mutex_)
-    auto entry = block_dep_map_.find(bHash);
-    if (entry != block_dep_map_.end()) {
-        dep = entry->second;
-    } else {
-        dep = std::make_shared<obc_dep>();
+    WRITER_LOCK(mutex_)
+    DepNode* node = GetOrCreateNode(bHash);
+    if (node->block) {
+        // already in the OBC
+        return;
     }
-    reader.unlock();
-
-    dep->block = std::move(block);
-
-    // insert new dependency into block_dep_map_
-    std::unordered_set<uint256> unique_missing_hashes;
+    node->block = std::move(block);
 
     auto common_insert = [&](const uint256& parent_hash) {
-        auto it = block_dep_map_.find(parent_hash);
-        unique_missing_hashes.insert(parent_hash);
-
-        if (it == block_dep_map_.end()) {
-            // if the dependency is not in this OBC then the dep is a lose end
-            auto parent_dep = std::make_shared<obc_dep>();
-            parent_dep->deps.emplace(dep);
-            block_dep_map_.emplace(parent_hash, std::move(parent_dep));
-        } else {
-            // if the dependency is in the OBC the dep is linked to the dependency dep
-            it->second->deps.emplace(dep);
+        DepNode* parent = GetOrCreateNode(parent_hash);
+        auto end        = node->parents.begin() + node->nparents;
+        if (std::find(node->parents.begin(), end, parent) == end) {
+            LinkChild(parent, node);
         }
     };
 
-    WRITER_LOCK(mutex_)
-    block_dep_map_.insert_or_assign(bHash, dep);
-    obcBlockSize_++;
-
     if (missing_mask & M_MISSING) {
         spdlog::trace("[OBC] Block {} is missing milestone link {}", bHash.to_substr(), msHash.to_substr());
         common_insert(msHash);
@@ -86,7 +67,9 @@ void OrphanBlocksContainer::AddBlock(ConstBlockPtr&& block, uint8_t missing_mask
         common_insert(prevHash);
     }
 
-    dep->ndeps = unique_missing_hashes.size();
+    node->ndeps = node->nparents;
+    InsertIntoBucket(node);
+    obcBlockSize_++;
 }
 
 std::vector<ConstBlockPtr> OrphanBlocksContainer::SubmitHash(const uint256& hash) {
@@ -95,56 +78,95 @@ std::vector<ConstBlockPtr> OrphanBlocksContainer::SubmitHash(const uint256& hash
     if (entry == block_dep_map_.end()) {
         return {};
     }
+
+    DepNode* root = entry->second;
+    if (root->block) {
+        // the block is no longer an orphan by itself
+        std::vector<DepNode*> voids;
+        DetachFromParents(root, voids);
+        for (auto v : voids) {
+            FreeNode(v);
+        }
+        RemoveFromBucket(root);
+        obcBlockSize_--;
+    }
+
+    // release the whole subtree that gets tied up in BFS order,
+    // so that parents are always handed out before their children
     std::vector<ConstBlockPtr> result;
-    // release only one level of blocks(its children blocks)
-    for (auto& n : entry->second->deps) {
-        n->ndeps--;
+    std::queue<DepNode*> released;
+    released.push(root);
+
+    while (!released.empty()) {
+        DepNode* cursor = released.front();
+        released.pop();
+
+        for (DepEdge* edge = cursor->children; edge;) {
+            DepNode* child = edge->child;
+            auto end       = child->parents.begin() + child->nparents;
+            std::remove(child->parents.begin(), end, cursor);
+            child->nparents--;
+
+            if (--child->ndeps == 0) {
+                result.push_back(child->block);
+                RemoveFromBucket(child);
+                obcBlockSize_--;
+                released.push(child);
+            }
 
-        if (n->ndeps > 0) {
-            continue;
+            DepEdge* next = edge->next;
+            edgePool_.Release(edge);
+            edge = next;
         }
+        cursor->children = nullptr;
 
-        result.push_back(n->block);
-        n->block = nullptr;
-        obcBlockSize_--;
+        FreeNode(cursor);
     }
 
-    block_dep_map_.erase(entry);
     return result;
 }
 
 size_t OrphanBlocksContainer::Prune(uint32_t secs) {
-    std::vector<uint256> pruned_block;
-    std::unordered_set<uint256> old_dependency;
-
-    // to find the obc_dependency which doesn't have a block instance
-    auto check_old_dependency = [&](const uint256& parent_hash, std::unordered_set<uint256>& hashes) {
-        auto it = block_dep_map_.find(parent_hash);
-        if (it != block_dep_map_.end() && !it->second->block) {
-            hashes.insert(parent_hash);
-        }
-    };
+    uint64_t current_time = time(nullptr);
+    if (current_time < secs) {
+        return 0;
+    }
+    uint64_t cutoff = current_time - secs;
 
-    {
-        READER_LOCK(mutex_)
-        uint64_t current_time = time(nullptr);
-        for (auto& it : block_dep_map_) {
-            if (it.second->block && it.second->block->GetTime() + secs <= current_time) {
-                pruned_block.push_back(it.first);
-                check_old_dependency(it.second->block->GetMilestoneHash(), old_dependency);
-                check_old_dependency(it.second->block->GetPrevHash(), old_dependency);
-                check_old_dependency(it.second->block->GetTipHash(), old_dependency);
+    WRITER_LOCK(mutex_)
+
+    // collect the expired blocks from the buckets that
+    // start no later than the cutoff; only the last one
+    // of them may hold blocks that are still fresh
+    std::vector<uint256> expired;
+    for (const auto& [bucket, head] : timeBuckets_) {
+        if (bucket * kBucketSeconds > cutoff) {
+            break;
+        }
+        for (DepNode* node = head; node; node = node->nextInBucket) {
+            if (node->block->GetTime() <= cutoff) {
+                expired.push_back(node->hash);
             }
         }
     }
 
-    for (const auto& blk_hash : old_dependency) {
-        DeleteBlockTree(blk_hash);
+    size_t nBlocks = obcBlockSize_;
+    size_t nNodes  = block_dep_map_.size();
+
+    for (const auto& hash : expired) {
+        // the block may be gone along with an earlier subtree
+        auto entry = block_dep_map_.find(hash);
+        if (entry != block_dep_map_.end()) {
+            EraseSubtree(entry->second);
+        }
     }
 
-    spdlog::debug("Pruned {} block(s) and {} void block(s) in obc", pruned_block.size(), old_dependency.size());
+    nBlocks -= obcBlockSize_;
+    nNodes -= block_dep_map_.size();
 
-    return pruned_block.size() + old_dependency.size();
+    spdlog::debug("Pruned {} block(s) and {} void block(s) in obc", nBlocks, nNodes - nBlocks);
+
+    return nNodes;
 }
 
 size_t OrphanBlocksContainer::GetDepNodeSize() const {
@@ -159,29 +181,134 @@ void OrphanBlocksContainer::DeleteBlockTree(const uint256& hash) {
         return;
     }
 
-    std::queue<obc_dep_ptr> toBeDeleted;
-    for (auto& n : entry->second->deps) {
-        toBeDeleted.push(n);
+    EraseSubtree(entry->second);
+}
+
+OrphanBlocksContainer::DepNode* OrphanBlocksContainer::GetOrCreateNode(const uint256& hash) {
+    auto [it, inserted] = block_dep_map_.try_emplace(hash, nullptr);
+    if (inserted) {
+        it->second       = nodePool_.Acquire();
+        it->second->hash = hash;
     }
+    return it->second;
+}
 
+void OrphanBlocksContainer::FreeNode(DepNode* node) {
+    block_dep_map_.erase(node->hash);
+    nodePool_.Release(node);
+}
 
-    if (entry->second->block) {
-        obcBlockSize_--;
+void OrphanBlocksContainer::LinkChild(DepNode* parent, DepNode* child) {
+    DepEdge* edge    = edgePool_.Acquire();
+    edge->child      = child;
+    edge->next       = parent->children;
+    parent->children = edge;
+
+    child->parents[child->nparents++] = parent;
+}
+
+void OrphanBlocksContainer::UnlinkChild(DepNode* parent, DepNode* child) {
+    for (DepEdge** link = &parent->children; *link; link = &(*link)->next) {
+        if ((*link)->child == child) {
+            DepEdge* edge = *link;
+            *link         = edge->next;
+            edgePool_.Release(edge);
+            return;
+        }
     }
-    block_dep_map_.erase(entry);
+}
 
-    // delete the tree starting from the root using BFS
-    obc_dep_ptr cursor;
-    while (!toBeDeleted.empty()) {
-        cursor = toBeDeleted.front();
-        toBeDeleted.pop();
+void OrphanBlocksContainer::DetachFromParents(DepNode* node, std::vector<DepNode*>& voids) {
+    for (uint_fast8_t i = 0; i < node->nparents; ++i) {
+        DepNode* parent = node->parents[i];
+        UnlinkChild(parent, node);
 
-        if (block_dep_map_.erase(cursor->block->GetHash())) {
-            obcBlockSize_--;
+        // a missing block nobody waits for any more
+        if (!parent->block && !parent->children) {
+            voids.push_back(parent);
+        }
+    }
+    node->nparents = 0;
+}
+
+void OrphanBlocksContainer::InsertIntoBucket(DepNode* node) {
+    node->bucket = node->block->GetTime() / kBucketSeconds;
+
+    auto& head         = timeBuckets_[node->bucket];
+    node->prevInBucket = nullptr;
+    node->nextInBucket = head;
+    if (head) {
+        head->prevInBucket = node;
+    }
+    head = node;
+}
+
+void OrphanBlocksContainer::RemoveFromBucket(DepNode* node) {
+    if (node->nextInBucket) {
+        node->nextInBucket->prevInBucket = node->prevInBucket;
+    }
+
+    if (node->prevInBucket) {
+        node->prevInBucket->nextInBucket = node->nextInBucket;
+    } else {
+        auto it = timeBuckets_.find(node->bucket);
+        if (node->nextInBucket) {
+            it->second = node->nextInBucket;
+        } else {
+            timeBuckets_.erase(it);
+        }
+    }
+
+    node->prevInBucket = nullptr;
+    node->nextInBucket = nullptr;
+}
+
+size_t OrphanBlocksContainer::EraseSubtree(DepNode* root) {
+    // collect the tree starting from the root using BFS
+    std::vector<DepNode*> subtree{root};
+    std::unordered_set<DepNode*> visited{root};
+    for (size_t i = 0; i < subtree.size(); ++i) {
+        for (DepEdge* edge = subtree[i]->children; edge; edge = edge->next) {
+            if (visited.insert(edge->child).second) {
+                subtree.push_back(edge->child);
+            }
         }
+    }
 
-        for (const obc_dep_ptr& dep : cursor->deps) {
-            toBeDeleted.push(dep);
+    // cut the edges coming from outside of the tree
+    std::vector<DepNode*> voids;
+    for (DepNode* node : subtree) {
+        for (uint_fast8_t i = 0; i < node->nparents; ++i) {
+            DepNode* parent = node->parents[i];
+            if (visited.count(parent)) {
+                continue;
+            }
+            UnlinkChild(parent, node);
+            if (!parent->block && !parent->children) {
+                voids.push_back(parent);
+            }
         }
+        node->nparents = 0;
     }
+
+    for (DepNode* node : subtree) {
+        for (DepEdge* edge = node->children; edge;) {
+            DepEdge* next = edge->next;
+            edgePool_.Release(edge);
+            edge = next;
+        }
+        node->children = nullptr;
+
+        if (node->block) {
+            RemoveFromBucket(node);
+            obcBlockSize_--;
+        }
+        FreeNode(node);
+    }
+
+    for (DepNode* node : voids) {
+        FreeNode(node);
+    }
+
+    return subtree.size() + voids.size();
 }
@@ -3,10 +3,11 @@
 
 #include "block.h"
 
+#include <array>
 #include <map>
+#include <memory>
 #include <shared_mutex>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 /* bitmask for indicating missing dependencies */
@@ -18,11 +19,6 @@ enum OBC_DEP_STATUS : uint8_t {
 
 class OrphanBlocksContainer {
 public:
-    /**
-     * constructs:
-     * 1: initializes block_dep_map
-     * 2: initializes lose_ends map
-     */
     OrphanBlocksContainer() = default;
 
     /**
@@ -43,44 +39,115 @@ public:
     /**
      * Submits the information that a new block with given hash is available
      * to the OBC solver which then ties up as many lose ends as possible
-     * with this information
+     * with this information.
+     *
+     * The whole subtree that becomes free of missing dependencies is released
+     * at once, ordered such that every block comes after all of its parents.
      */
     std::vector<ConstBlockPtr> SubmitHash(const uint256& hash);
 
     void DeleteBlockTree(const uint256& hash);
 
     /**
-     * Iterate block_dep_map_ and delete outdated entries that have timestamps
-     * before the current time - specified seconds.
+     * Deletes the blocks that have timestamps before the current time -
+     * specified seconds, together with the blocks depending on them.
+     * Only the expired time buckets are visited.
      */
     size_t Prune(uint32_t seconds);
 
     size_t GetDepNodeSize() const;
 
 private:
-    size_t obcBlockSize_ = 0;
-    struct obc_dependency {
+    /* granularity of the time buckets used for expiry */
+    static constexpr uint64_t kBucketSeconds = 60;
+
+    struct DepNode;
+
+    struct DepEdge {
+        DepNode* child = nullptr;
+        DepEdge* next  = nullptr;
+    };
+
+    struct DepNode {
+        uint256 hash;
+        // pointer to the block that is the actual orphan;
+        // null if the node only stands for a missing block
+        ConstBlockPtr block = nullptr;
         // number of dependencies that must be
         // found in order for this dependency
         // to be resolved; max: 3 & min: 0
-        uint_fast8_t ndeps = 0;
+        uint_fast8_t ndeps    = 0;
+        uint_fast8_t nparents = 0;
+        std::array<DepNode*, 3> parents{};
         // links to other dependencies that wait
         // for this one to be resolved
-        std::unordered_set<std::shared_ptr<struct obc_dependency>> deps;
-        // pointer to the block that is the actual orphan
-        ConstBlockPtr block = nullptr;
+        DepEdge* children = nullptr;
+        // intrusive links in the time bucket
+        uint64_t bucket       = 0;
+        DepNode* prevInBucket = nullptr;
+        DepNode* nextInBucket = nullptr;
     };
 
-    using obc_dep     = struct obc_dependency;
-    using obc_dep_ptr = std::shared_ptr<obc_dep>;
+    /**
+     * Hands out objects from chunks allocated in bulk and
+     * recycles the released ones through a free list
+     */
+    template <typename T>
+    class Pool {
+    public:
+        T* Acquire() {
+            if (!free_.empty()) {
+                T* obj = free_.back();
+                free_.pop_back();
+                return obj;
+            }
+            if (used_ == kChunkSize) {
+                chunks_.emplace_back(new T[kChunkSize]);
+                used_ = 0;
+            }
+            return &chunks_.back()[used_++];
+        }
+
+        void Release(T* obj) {
+            *obj = T{};
+            free_.push_back(obj);
+        }
+
+    private:
+        static constexpr size_t kChunkSize = 256;
+        std::vector<std::unique_ptr<T[]>> chunks_;
+        std::vector<T*> free_;
+        size_t used_ = kChunkSize;
+    };
+
+    size_t obcBlockSize_ = 0;
 
     mutable std::shared_mutex mutex_;
 
     /**
      * this container maps the hash of the orphan block
-     * to its dependency struct
+     * to its dependency node
+     */
+    std::unordered_map<uint256, DepNode*> block_dep_map_;
+
+    /**
+     * maps the block time / kBucketSeconds to the head
+     * of the list of orphan blocks falling into it
      */
-    std::unordered_map<uint256, obc_dep_ptr> block_dep_map_;
+    std::map<uint64_t, DepNode*> timeBuckets_;
+
+    Pool<DepNode> nodePool_;
+    Pool<DepEdge> edgePool_;
+
+    // The following methods require the writer lock to be held
+    DepNode* GetOrCreateNode(const uint256& hash);
+    void FreeNode(DepNode* node);
+    void LinkChild(DepNode* parent, DepNode* child);
+    void UnlinkChild(DepNode* parent, DepNode* child);
+    void DetachFromParents(DepNode* node, std::vector<DepNode*>& voids);
+    void InsertIntoBucket(DepNode* node);
+    void RemoveFromBucket(DepNode* node);
+    size_t EraseSubtree(DepNode* root);
 };
 
 #endif // EPIC_OBC_H
@@ -4,19 +4,47 @@
 
 #include "block_store.h"
 #include "cxxopts.h"
+#include "tinyformat.h"
 #include "toml_specifacation.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <fcntl.h>
 #include <iostream>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
 
-int ParseArg(int argc, char** argv, std::string& root, std::string& type) {
+enum class ExportFormat { TOML, CSV, NDJSON };
+
+struct ExportOptions {
+    std::string root;
+    std::string type;
+    std::string format = "toml";
+    std::string out;
+    size_t threads     = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t shardSize   = 10000;
+    uint64_t begin     = 1;
+    uint64_t end       = 0;
+    size_t reportEvery = 5;
+};
+
+int ParseArg(int argc, char** argv, ExportOptions& opts) {
     cxxopts::Options options("tools", "epic tools");
     options.positional_help("Please specify root path and network type").show_positional_help();
 
     // clang-format off
     options.add_options()
     ("h,help", "print this message", cxxopts::value<bool>())
-    ("r,root", "root path of data, example: data",cxxopts::value<std::string>(root))
-    ("t,type", "network type, one of Mainnet, Diamond (Testnet), Spade (Testnet), and Unittest",cxxopts::value<std::string>(type));
+    ("r,root", "root path of data, example: data",cxxopts::value<std::string>(opts.root))
+    ("t,type", "network type, one of Mainnet, Diamond (Testnet), Spade (Testnet), and Unittest",cxxopts::value<std::string>(opts.type))
+    ("f,format", "output format, one of toml, csv and ndjson",cxxopts::value<std::string>(opts.format))
+    ("o,out", "output directory, default is tools/vertices/ for toml and tools/export/ otherwise",cxxopts::value<std::string>(opts.out))
+    ("j,threads", "number of exporting threads",cxxopts::value<size_t>(opts.threads))
+    ("s,shard", "number of heights in each output shard",cxxopts::value<size_t>(opts.shardSize))
+    ("b,begin", "first height to export",cxxopts::value<uint64_t>(opts.begin))
+    ("e,end", "last height to export, default is the head height",cxxopts::value<uint64_t>(opts.end))
+    ("report", "seconds between throughput reports",cxxopts::value<size_t>(opts.reportEvery));
     // clang-format on
 
     try {
@@ -25,9 +53,12 @@ int ParseArg(int argc, char** argv, std::string& root, std::string& type) {
             std::cout << options.help() << std::endl;
             return -1;
         }
-        if (root.empty() || type.empty()) {
+        if (opts.root.empty() || opts.type.empty()) {
             throw cxxopts::OptionException("Please specify the params");
         }
+        if (opts.threads == 0 || opts.shardSize == 0) {
+            throw cxxopts::OptionException("Number of threads and shard size should be positive");
+        }
     } catch (const cxxopts::OptionException& e) {
         std::cerr << "error parsing options: " << e.what() << std::endl;
         std::cout << options.help() << std::endl;
@@ -36,44 +67,421 @@ int ParseArg(int argc, char** argv, std::string& root, std::string& type) {
     return 0;
 }
 
+/**
+ * Read-only mapping of a whole BLK or VTX file. Pages are loaded on demand
+ * and can be dropped by the kernel, so chains larger than RAM can be read.
+ */
+class MappedFile {
+public:
+    MappedFile(file::FileType type, const FilePos& pos) : pos_(pos) {
+        auto path = file::GetFilePath(type, pos);
+        int fd    = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::ios_base::failure("Failed to open " + path);
+        }
+
+        size_ = file::GetFileSize(type, pos);
+        data_ = size_ > 0 ? ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (data_ == MAP_FAILED) {
+            throw std::ios_base::failure("Failed to map " + path);
+        }
+        ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        ::munmap(data_, size_);
+    }
+
+    bool SameFileAs(const FilePos& pos) const {
+        return pos_.nEpoch == pos.nEpoch && pos_.nName == pos.nName;
+    }
+
+    const char* Data() const {
+        return static_cast<const char*>(data_);
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+private:
+    FilePos pos_;
+    void* data_;
+    size_t size_;
+};
+
+/**
+ * Decodes a level set from its region in a mapped file, in file order
+ */
+template <typename P>
+std::vector<std::shared_ptr<P>> DecodeLvs(const char* data, size_t size, bool hasHeader) {
+    std::vector<std::shared_ptr<P>> result;
+    if (!hasHeader) {
+        VStream vs(data, data + size);
+        while (vs.in_avail()) {
+            result.emplace_back(std::make_shared<P>(vs));
+        }
+        return result;
+    }
+
+    VStream headerStream(data, data + std::min(size, sizeof(uint32_t)));
+    uint32_t count;
+    headerStream >> count;
+
+    auto headerSize = LvsHeader::Size(count);
+    if (headerSize > size) {
+        throw std::ios_base::failure("Level set header is truncated");
+    }
+    headerStream = VStream(data, data + headerSize);
+    LvsHeader header;
+    headerStream >> header;
+
+    const char* body = data + headerSize;
+    result.reserve(count);
+    for (const auto& [offset, length] : header.entries) {
+        if (headerSize + offset + length > size) {
+            throw std::ios_base::failure("Level set body is truncated");
+        }
+        VStream vs(body + offset, body + offset + length);
+        result.emplace_back(std::make_shared<P>(vs));
+    }
+    return result;
+}
+
+struct Field {
+    std::string value;
+    bool quoted;
+};
+
+Field Str(std::string value) {
+    return {std::move(value), true};
+}
+
+template <typename T>
+Field Num(const T& value) {
+    return {std::to_string(value), false};
+}
+
+Field Bool(bool value) {
+    return {value ? "true" : "false", false};
+}
+
+enum Table : uint8_t { BLOCKS = 0, TXS, INPUTS, OUTPUTS, TABLE_SIZE };
+
+static const std::array<std::string, TABLE_SIZE> kTableNames = {"blocks", "transactions", "inputs", "outputs"};
+static const std::array<std::vector<std::string>, TABLE_SIZE> kColumns = {{
+    {"height", "block_hash", "is_milestone", "prev_hash", "milestone_hash", "tip_hash", "time", "diff_target", "nonce",
+     "tx_count", "cumulative_reward", "miner_chain_height"},
+    {"height", "block_hash", "tx_index", "tx_hash", "status", "is_registration", "is_first_reg", "input_count",
+     "output_count"},
+    {"tx_hash", "input_index", "outpoint_block_hash", "outpoint_tx_index", "outpoint_output_index"},
+    {"tx_hash", "output_index", "address", "value"},
+}};
+
+/**
+ * Writes the rows of one shard into a file per table
+ */
+class ShardWriter {
+public:
+    ShardWriter(const std::string& dir, size_t shard, ExportFormat format) : format_(format) {
+        static const size_t kBufferSize = 1 << 20;
+
+        auto suffix = tfm::format("-%06d.%s", shard, format == ExportFormat::CSV ? "csv" : "ndjson");
+        for (size_t t = 0; t < TABLE_SIZE; ++t) {
+            buffers_[t].resize(kBufferSize);
+            files_[t].rdbuf()->pubsetbuf(buffers_[t].data(), buffers_[t].size());
+            files_[t].open(dir + kTableNames[t] + suffix, std::ios::out | std::ios::trunc);
+            if (!files_[t].is_open()) {
+                throw std::ios_base::failure("Failed to create shard " + dir + kTableNames[t] + suffix);
+            }
+
+            if (format_ == ExportFormat::CSV) {
+                for (size_t i = 0; i < kColumns[t].size(); ++i) {
+                    files_[t] << (i ? "," : "") << kColumns[t][i];
+                }
+                files_[t] << '\n';
+            }
+        }
+    }
+
+    void Write(Table t, const std::vector<Field>& row) {
+        auto& f = files_[t];
+        if (format_ == ExportFormat::CSV) {
+            for (size_t i = 0; i < row.size(); ++i) {
+                f << (i ? "," : "") << row[i].value;
+            }
+            f << '\n';
+            return;
+        }
+
+        f << '{';
+        for (size_t i = 0; i < row.size(); ++i) {
+            f << (i ? ",\"" : "\"") << kColumns[t][i] << "\":";
+            if (row[i].quoted) {
+                f << '"' << row[i].value << '"';
+            } else {
+                f << row[i].value;
+            }
+        }
+        f << "}\n";
+    }
+
+private:
+    ExportFormat format_;
+
+    // buffers have to outlive the files flushing into them
+    std::array<std::vector<char>, TABLE_SIZE> buffers_;
+    std::array<std::ofstream, TABLE_SIZE> files_;
+};
+
+struct ExportStats {
+    std::atomic_uint64_t heights = 0;
+    std::atomic_uint64_t blocks  = 0;
+    std::atomic_uint64_t txs     = 0;
+    std::atomic_uint64_t bytes   = 0;
+};
+
+class Exporter {
+public:
+    Exporter(const ExportOptions& opts, ExportFormat format) : opts_(opts), format_(format) {}
+
+    /**
+     * Exports heights in [begin, end] with a pool of threads, each of
+     * which takes the next shard of heights when it is done with one
+     */
+    bool Run(uint64_t begin, uint64_t end) {
+        begin_   = begin;
+        end_     = end;
+        nShards_ = (end - begin) / opts_.shardSize + 1;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < std::min(opts_.threads, nShards_); ++i) {
+            workers.emplace_back([this]() { Work(); });
+        }
+
+        // throughput report
+        auto last = stats_.heights.load();
+        while (finished_.load() < workers.size()) {
+            std::unique_lock<std::mutex> lock(reportLock_);
+            reportCv_.wait_for(lock, std::chrono::seconds(opts_.reportEvery));
+            if (finished_.load() < workers.size()) {
+                auto heights = stats_.heights.load();
+                Report(start, heights - last);
+                last = heights;
+            }
+        }
+
+        for (auto& w : workers) {
+            w.join();
+        }
+
+        std::cout << "Finished: ";
+        Report(start, 0);
+        return !failed_.load();
+    }
+
+private:
+    const ExportOptions& opts_;
+    ExportFormat format_;
+    uint64_t begin_    = 0;
+    uint64_t end_      = 0;
+    size_t nShards_    = 0;
+    bool hasLvsHeader_ = STORE->HasLvsHeader();
+
+    ExportStats stats_;
+    std::atomic_size_t nextShard_ = 0;
+    std::atomic_size_t finished_  = 0;
+    std::atomic<bool> failed_     = false;
+    std::mutex reportLock_;
+    std::condition_variable reportCv_;
+
+    void Report(std::chrono::steady_clock::time_point start, uint64_t recentHeights) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        elapsed        = std::max(elapsed, 1e-3);
+
+        std::cout << tfm::format("%d/%d heights, %d blocks, %d txs, %.1f MB in %.1fs | %.1f heights/s, %.1f blocks/s, "
+                                 "%.1f txs/s, %.1f MB/s",
+                                 stats_.heights.load(), end_ - begin_ + 1, stats_.blocks.load(), stats_.txs.load(),
+                                 stats_.bytes.load() / 1e6, elapsed, stats_.heights.load() / elapsed,
+                                 stats_.blocks.load() / elapsed, stats_.txs.load() / elapsed,
+                                 stats_.bytes.load() / 1e6 / elapsed);
+        if (recentHeights > 0) {
+            std::cout << tfm::format(" (recent %.1f heights/s)", double(recentHeights) / opts_.reportEvery);
+        }
+        std::cout << std::endl;
+    }
+
+    void Work() {
+        try {
+            std::unique_ptr<MappedFile> blkFile, vtxFile;
+            for (size_t shard = nextShard_++; shard < nShards_ && !failed_.load(); shard = nextShard_++) {
+                auto first = begin_ + shard * opts_.shardSize;
+                auto last  = std::min(end_, first + opts_.shardSize - 1);
+
+                if (format_ == ExportFormat::TOML) {
+                    for (auto h = first; h <= last; ++h) {
+                        ExportToml(h);
+                    }
+                    continue;
+                }
+
+                ShardWriter writer(opts_.out, shard, format_);
+                for (auto h = first; h <= last; ++h) {
+                    ExportLvs(h, writer, blkFile, vtxFile);
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "error exporting: " << e.what() << std::endl;
+            failed_ = true;
+        }
+
+        finished_++;
+        reportCv_.notify_one();
+    }
+
+    void ExportToml(uint64_t height) {
+        std::ofstream file;
+        file.open(opts_.out + std::to_string(height) + ".toml", std::ios::out | std::ios::trunc);
+
+        auto set = STORE->GetLevelSetVtcsAt(height);
+        auto res = LvsWithVtxToToml(set);
+        file << *res;
+        file.close();
+
+        stats_.heights++;
+        stats_.blocks += set.size();
+    }
+
+    const char* Map(std::unique_ptr<MappedFile>& mapped,
+                    file::FileType type,
+                    const std::pair<FilePos, uint32_t>& region) {
+        if (!mapped || !mapped->SameFileAs(region.first)) {
+            mapped.reset();
+            mapped = std::make_unique<MappedFile>(type, region.first);
+        }
+        if (region.first.nOffset + region.second > mapped->Size()) {
+            throw std::ios_base::failure("Level set exceeds the end of file " + std::to_string(region.first));
+        }
+        return mapped->Data() + region.first.nOffset;
+    }
+
+    void ExportLvs(uint64_t height,
+                   ShardWriter& writer,
+                   std::unique_ptr<MappedFile>& blkFile,
+                   std::unique_ptr<MappedFile>& vtxFile) {
+        auto blkRegion = STORE->GetLevelSetRegionAt(height, file::BLK);
+        auto vtxRegion = STORE->GetLevelSetRegionAt(height, file::VTX);
+        if (!blkRegion || !vtxRegion) {
+            throw std::ios_base::failure("Level set at height " + std::to_string(height) + " is not found");
+        }
+
+        auto blocks   = DecodeLvs<const Block>(Map(blkFile, file::BLK, *blkRegion), blkRegion->second, hasLvsHeader_);
+        auto vertices = DecodeLvs<Vertex>(Map(vtxFile, file::VTX, *vtxRegion), vtxRegion->second, hasLvsHeader_);
+        if (blocks.size() != vertices.size()) {
+            throw std::ios_base::failure("Inconsistent level set at height " + std::to_string(height));
+        }
+
+        uint64_t nTxs = 0;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            const auto& blk     = blocks[i];
+            const auto& vtx     = vertices[i];
+            const auto blkHash  = std::to_string(blk->GetHash());
+            const auto& txns    = blk->GetTransactions();
+
+            writer.Write(BLOCKS, {Num(vtx->height), Str(blkHash), Bool(vtx->isMilestone),
+                                  Str(std::to_string(blk->GetPrevHash())), Str(std::to_string(blk->GetMilestoneHash())),
+                                  Str(std::to_string(blk->GetTipHash())), Num(blk->GetTime()),
+                                  Num(blk->GetDifficultyTarget()), Num(blk->GetNonce()), Num(txns.size()),
+                                  Num(vtx->cumulativeReward.GetValue()), Num(vtx->minerChainHeight)});
+
+            for (size_t j = 0; j < txns.size(); ++j) {
+                const auto& tx    = *txns[j];
+                const auto txHash = std::to_string(tx.GetHash());
+                const auto status = j < vtx->validity.size() ? vtx->validity[j] : Vertex::UNKNOWN;
+
+                writer.Write(TXS, {Num(vtx->height), Str(blkHash), Num(j), Str(txHash),
+                                   Str(status == Vertex::VALID ? "VALID" :
+                                                                 status == Vertex::INVALID ? "INVALID" : "UNKNOWN"),
+                                   Bool(tx.IsRegistration()), Bool(tx.IsFirstRegistration()),
+                                   Num(tx.GetInputs().size()), Num(tx.GetOutputs().size())});
+
+                const auto& inputs = tx.GetInputs();
+                for (size_t k = 0; k < inputs.size(); ++k) {
+                    const auto& outpoint = inputs[k].outpoint;
+                    writer.Write(INPUTS, {Str(txHash), Num(k), Str(std::to_string(outpoint.bHash)),
+                                          Num(outpoint.txIndex), Num(outpoint.outIndex)});
+                }
+
+                const auto& outputs = tx.GetOutputs();
+                for (size_t k = 0; k < outputs.size(); ++k) {
+                    writer.Write(OUTPUTS, {Str(txHash), Num(k), Str(parseCKeyID(outputs[k].listingContent)),
+                                           Num(outputs[k].value.GetValue())});
+                }
+            }
+            nTxs += txns.size();
+        }
+
+        stats_.heights++;
+        stats_.blocks += blocks.size();
+        stats_.txs += nTxs;
+        stats_.bytes += blkRegion->second + vtxRegion->second;
+    }
+};
+
 int main(int argc, char** argv) {
-    std::string rootpath;
-    std::string net_type;
-    auto init_res = ParseArg(argc, argv, rootpath, net_type);
+    ExportOptions opts;
+    auto init_res = ParseArg(argc, argv, opts);
     if (!init_res) {
         const std::map<std::string, ParamsType> parseType = {{"Mainnet", ParamsType::MAINNET},
                                                              {"Spade", ParamsType::SPADE},
                                                              {"Diamond", ParamsType::DIAMOND},
                                                              {"Unittest", ParamsType::UNITTEST}};
+        const std::map<std::string, ExportFormat> parseFormat = {
+            {"toml", ExportFormat::TOML}, {"csv", ExportFormat::CSV}, {"ndjson", ExportFormat::NDJSON}};
+        ExportFormat format;
         try {
-            SelectParams(parseType.at(net_type));
+            SelectParams(parseType.at(opts.type));
+            format = parseFormat.at(opts.format);
         } catch (const std::out_of_range& err) {
-            std::cerr << "wrong format of network type" << std::endl;
+            std::cerr << "wrong format of network type or output format" << std::endl;
             return -1;
         } catch (const std::invalid_argument& err) {
             std::cerr << "error choosing params: " << err.what() << std::endl;
             return -1;
         }
-        file::SetDataDirPrefix(rootpath);
-        STORE = std::make_unique<BlockStore>(rootpath + "/db/");
+        file::SetDataDirPrefix(opts.root);
+        STORE = std::make_unique<BlockStore>(opts.root + "/db/");
+        if (!STORE->CheckFileSanity(false)) {
+            std::cerr << "data files are broken, please run epic to recover them first" << std::endl;
+            STORE->Stop();
+            return -1;
+        }
 
-        auto height = STORE->GetHeadHeight();
-        for (int i = 1; i < height; i++) {
-            std::ofstream file;
-            std::string dir = "tools/vertices/";
-            if (!CheckDirExist(dir)) {
-                MkdirRecursive(dir);
-            }
-            file.open(dir + std::to_string(i) + ".toml", std::ios::out | std::ios::trunc);
+        if (opts.out.empty()) {
+            opts.out = format == ExportFormat::TOML ? "tools/vertices/" : "tools/export/";
+        } else if (opts.out.back() != '/') {
+            opts.out += '/';
+        }
+        if (!CheckDirExist(opts.out)) {
+            MkdirRecursive(opts.out);
+        }
 
-            auto set = STORE->GetLevelSetVtcsAt(i);
-            auto ms  = STORE->GetMilestoneAt(i);
-            auto res = LvsWithVtxToToml(set);
-            file << *res;
-            file.close();
+        auto end = opts.end > 0 ? std::min(opts.end, STORE->GetHeadHeight()) : STORE->GetHeadHeight();
+        bool ok  = true;
+        if (opts.begin <= end) {
+            ok = Exporter(opts, format).Run(opts.begin, end);
         }
 
+        STORE->Stop();
         STORE.reset();
+        if (!ok) {
+            return -1;
+        }
     }
 
     return 0;
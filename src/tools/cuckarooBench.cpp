@@ -0,0 +1,125 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cxxopts.h"
+#include "lean.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+
+/*
+ * Measures how many proofs per second VerifyProof checks, against hashing the block of each edge
+ * on its own; the proofs are random ascending edges, which fail only after all of them are hashed
+ */
+static void BenchVerify(uint32_t edgebits, uint32_t cyclelen, uint32_t nproofs) {
+    std::mt19937_64 rng(nproofs);
+    std::vector<siphash_keys> keys(nproofs);
+    std::vector<uint32_t> proofs(nproofs * cyclelen);
+    for (uint32_t p = 0; p < nproofs; ++p) {
+        keys[p] = {rng(), rng(), rng(), rng()};
+        auto proof = proofs.begin() + p * cyclelen;
+        do {
+            std::generate(proof, proof + cyclelen, [&] { return rng() & (((uint64_t) 1 << edgebits) - 1); });
+            std::sort(proof, proof + cyclelen);
+        } while (std::adjacent_find(proof, proof + cyclelen) != proof + cyclelen);
+    }
+
+    auto start   = std::chrono::steady_clock::now();
+    uint32_t nok = 0;
+    for (uint32_t p = 0; p < nproofs; ++p) {
+        nok += VerifyProof(&proofs[p * cyclelen], keys[p], cyclelen, edgebits) == POW_OK;
+    }
+    double batched = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start        = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    uint64_t sips[EDGE_BLOCK_SIZE];
+    for (uint32_t p = 0; p < nproofs; ++p) {
+        for (uint32_t n = 0; n < cyclelen; ++n) {
+            sum ^= sipblock(keys[p], proofs[p * cyclelen + n], sips);
+        }
+    }
+    double scalar = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    spdlog::info("{} proofs of {} edges ({} valid): VerifyProof {:.0f} proofs/s, hashing each edge {:.0f} proofs/s "
+                 "({:x}), {:.2f}x",
+                 nproofs, cyclelen, nok, nproofs / batched, nproofs / scalar, sum & 0xf, scalar / batched);
+}
+
+/*
+ * Measures how many graphs per second the cpu solver trims and searches for cycles,
+ * on headers differing in their last 4 bytes as the nonces of the miner do
+ */
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("cuckarooBench", "graphs/s of the cpu cuckaroo solver, or proofs/s of the verifier");
+    // clang-format off
+    options.add_options()
+    ("h,help", "print help message", cxxopts::value<bool>())
+    ("edgebits", "2-log of the number of edges", cxxopts::value<uint32_t>()->default_value(std::to_string(EDGEBITS)))
+    ("cycle", "length of the cycles", cxxopts::value<uint32_t>()->default_value("42"))
+    ("threads", "number of trimming threads",
+     cxxopts::value<uint32_t>()->default_value(std::to_string(std::thread::hardware_concurrency())))
+    ("trims", "max number of trimming rounds", cxxopts::value<uint32_t>()->default_value(std::to_string(LEAN_NTRIMS)))
+    ("graphs", "number of graphs", cxxopts::value<uint32_t>()->default_value("4"))
+    ("verify", "number of proofs to verify instead of solving graphs", cxxopts::value<uint32_t>()->default_value("0"));
+    // clang-format on
+
+    auto parsed_options = options.parse(argc, argv);
+    if (parsed_options["help"].as<bool>()) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    const auto edgebits = parsed_options["edgebits"].as<uint32_t>();
+    const auto cyclelen = parsed_options["cycle"].as<uint32_t>();
+    const auto nthreads = parsed_options["threads"].as<uint32_t>();
+    const auto ntrims   = parsed_options["trims"].as<uint32_t>();
+    const auto ngraphs  = parsed_options["graphs"].as<uint32_t>();
+    if (edgebits < EDGE_BLOCK_BITS || edgebits > EDGEBITS || cyclelen == 0 || cyclelen > MAXCYCLELEN) {
+        spdlog::error("edgebits must be within [{}, {}] and cycle within [1, {}]", EDGE_BLOCK_BITS, EDGEBITS,
+                      MAXCYCLELEN);
+        return -1;
+    }
+
+    if (parsed_options["verify"].as<uint32_t>()) {
+        BenchVerify(edgebits, cyclelen, parsed_options["verify"].as<uint32_t>());
+        return 0;
+    }
+
+    spdlog::info("Looking for {}-cycles on cuckaroo{} with {} thread(s) and up to {} trimming rounds", cyclelen,
+                 edgebits, nthreads, ntrims);
+    LeanSolverCtx ctx(nthreads, cyclelen, edgebits, ntrims);
+
+    // the size of a block header
+    char header[142] = {};
+    uint64_t nalive  = 0;
+    uint32_t nsols = 0, nfailed = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t nonce = 0; nonce < ngraphs; ++nonce) {
+        memcpy(header + sizeof(header) - sizeof(nonce), &nonce, sizeof(nonce));
+        ctx.SetHeader(header, sizeof(header));
+
+        auto graphStart = std::chrono::steady_clock::now();
+        int n           = ctx.solve();
+        double seconds  = std::chrono::duration<double>(std::chrono::steady_clock::now() - graphStart).count();
+        spdlog::info("nonce {}: {} edges left after {} rounds, {} solution(s) in {:.3f} s", nonce, ctx.nalive,
+                     ctx.nrounds, n, seconds);
+
+        for (int s = 0; s < n; ++s) {
+            if (VerifyProof(&ctx.sols[s * cyclelen], ctx.sipkeys, cyclelen, edgebits) != POW_OK) {
+                nfailed++;
+            }
+        }
+        nalive += ctx.nalive;
+        nsols += n;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    spdlog::info("{} graphs in {:.3f} s: {:.4f} graphs/s, {} edges left on average, {} solution(s), {} invalid",
+                 ngraphs, seconds, ngraphs / seconds, ngraphs ? nalive / ngraphs : 0, nsols, nfailed);
+    return nfailed ? 1 : 0;
+}
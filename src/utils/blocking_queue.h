@@ -94,6 +94,19 @@ public:
         return queue_.front();
     }
 
+    /* copies the elements in the order they are taken, leaving the queue as it is */
+    std::vector<T> Snapshot() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::queue<T> copy = queue_;
+        std::vector<T> elements;
+        elements.reserve(copy.size());
+        while (!copy.empty()) {
+            elements.push_back(std::move(copy.front()));
+            copy.pop();
+        }
+        return elements;
+    }
+
 private:
     mutable std::mutex mtx_;
     std::condition_variable full_;
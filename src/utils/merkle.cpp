@@ -5,6 +5,8 @@
 #include "merkle.h"
 #include "hash.h"
 
+#include <cassert>
+
 uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated) {
     bool mutation = false;
     while (hashes.size() > 1) {
@@ -33,3 +35,48 @@ uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated) {
 
     return hashes[0];
 }
+
+void MerkleTree::Append(const uint256& leaf) {
+    if (levels_.empty()) {
+        levels_.emplace_back();
+    }
+    levels_[0].push_back(leaf);
+    Update(levels_[0].size() - 1);
+}
+
+void MerkleTree::Remove(size_t index) {
+    auto& leaves = levels_[0];
+    assert(index < leaves.size());
+
+    const size_t last = leaves.size() - 1;
+    leaves[index]     = leaves[last];
+    leaves.pop_back();
+    if (leaves.empty()) {
+        levels_.clear();
+        return;
+    }
+
+    if (index < last) {
+        Update(index);
+    }
+    Update(leaves.size() - 1);
+}
+
+void MerkleTree::Update(size_t index) {
+    size_t level = 0;
+    for (; levels_[level].size() > 1; ++level, index /= 2) {
+        if (levels_.size() == level + 1) {
+            levels_.emplace_back();
+        }
+        const auto& nodes = levels_[level];
+        levels_[level + 1].resize((nodes.size() + 1) / 2);
+
+        // an odd node is paired with itself
+        const size_t left = index & ~(size_t) 1;
+        uint256 pair[2]   = {nodes[left], left + 1 < nodes.size() ? nodes[left + 1] : nodes[left]};
+        SHA256D64(levels_[level + 1][index / 2].begin(), pair[0].begin(), 1);
+    }
+
+    // the levels above a single node are gone
+    levels_.resize(level + 1);
+}
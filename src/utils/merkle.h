@@ -7,6 +7,39 @@
 
 #include "big_uint.h"
 
+#include <vector>
+
 uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated = nullptr);
 
+/*
+ * Merkle tree of the same root as ComputeMerkleRoot, keeping all its levels
+ * so that adding or removing a leaf rehashes only the paths to the root
+ */
+class MerkleTree {
+public:
+    void Append(const uint256& leaf);
+
+    // removes the leaf at the index by moving the last leaf in its place
+    void Remove(size_t index);
+
+    void Clear() {
+        levels_.clear();
+    }
+
+    size_t Size() const {
+        return levels_.empty() ? 0 : levels_[0].size();
+    }
+
+    uint256 Root() const {
+        return levels_.empty() ? uint256() : levels_.back()[0];
+    }
+
+private:
+    // the leaves, then the nodes of each level up to the root
+    std::vector<std::vector<uint256>> levels_;
+
+    // resizes the levels above the leaves and rehashes the path from the leaf at the index
+    void Update(size_t index);
+};
+
 #endif // SRC_MERKLE_H
@@ -0,0 +1,83 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rolling_bloom_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+RollingBloomFilter::RollingBloomFilter(uint32_t nElements, double fpRate) {
+    double logFpRate = std::log(fpRate);
+
+    // the optimal number of hash functions is log(fpRate) / log(0.5)
+    nHashFuncs_            = std::max(1, std::min<int>(std::round(logFpRate / std::log(0.5)), 50));
+    nEntriesPerGeneration_ = (nElements + 1) / 2;
+
+    // with k hash functions and m bits holding n elements, fpRate ~ (1 - exp(-k * n / m))^k
+    uint32_t nMaxElements = nEntriesPerGeneration_ * 3;
+    nFilterBits_ =
+        std::ceil(-1.0 * nHashFuncs_ * nMaxElements / std::log(1.0 - std::exp(logFpRate / nHashFuncs_)));
+
+    data_.resize(((nFilterBits_ + 63) / 64) << 1);
+    Reset();
+}
+
+void RollingBloomFilter::Insert(const uint256& hash) {
+    if (nEntriesThisGeneration_ == nEntriesPerGeneration_) {
+        nEntriesThisGeneration_ = 0;
+        if (++nGeneration_ == 4) {
+            nGeneration_ = 1;
+        }
+
+        // wipe the positions belonging to the generation being reused
+        uint64_t nGenerationMask1 = 0 - (uint64_t)(nGeneration_ & 1);
+        uint64_t nGenerationMask2 = 0 - (uint64_t)(nGeneration_ >> 1);
+        for (size_t p = 0; p < data_.size(); p += 2) {
+            uint64_t p1 = data_[p], p2 = data_[p + 1];
+            uint64_t mask = (p1 ^ nGenerationMask1) | (p2 ^ nGenerationMask2);
+            data_[p]      = p1 & mask;
+            data_[p + 1]  = p2 & mask;
+        }
+    }
+    nEntriesThisGeneration_++;
+
+    for (uint32_t n = 0; n < nHashFuncs_; ++n) {
+        uint32_t h   = PositionOf(hash, n);
+        int bit      = h & 0x3f;
+        uint32_t pos = (h >> 6) << 1;
+        data_[pos]     = (data_[pos] & ~(((uint64_t) 1) << bit)) | ((uint64_t)(nGeneration_ & 1)) << bit;
+        data_[pos + 1] = (data_[pos + 1] & ~(((uint64_t) 1) << bit)) | ((uint64_t)(nGeneration_ >> 1)) << bit;
+    }
+}
+
+bool RollingBloomFilter::Contains(const uint256& hash) const {
+    for (uint32_t n = 0; n < nHashFuncs_; ++n) {
+        uint32_t h   = PositionOf(hash, n);
+        int bit      = h & 0x3f;
+        uint32_t pos = (h >> 6) << 1;
+        if (!(((data_[pos] | data_[pos + 1]) >> bit) & 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RollingBloomFilter::Reset() {
+    std::random_device rd;
+    tweak_                  = ((uint64_t) rd() << 32) | rd();
+    nEntriesThisGeneration_ = 0;
+    nGeneration_            = 1;
+    std::fill(data_.begin(), data_.end(), 0);
+}
+
+uint32_t RollingBloomFilter::PositionOf(const uint256& hash, uint32_t n) const {
+    // the hashes are already uniform, so the positions are derived by double
+    // hashing two of their words mixed with the tweak of this filter
+    uint64_t h1 = (hash.GetUint64(0) ^ tweak_) * 0x9e3779b97f4a7c15ULL;
+    uint64_t h2 = (hash.GetUint64(1) + tweak_) * 0xc2b2ae3d27d4eb4fULL;
+    uint64_t h  = h1 + n * (h2 | 1);
+    h ^= h >> 32;
+    return h % nFilterBits_;
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPIC_ROLLING_BLOOM_FILTER_H
+#define EPIC_ROLLING_BLOOM_FILTER_H
+
+#include "big_uint.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * A probabilistic set of the most recently inserted hashes.
+ *
+ * The elements are inserted in generations of nElements / 2; once three
+ * generations are full, the oldest one is dropped. Hence at least the last
+ * nElements hashes are always contained, and older ones are forgotten.
+ * Not thread safe.
+ */
+class RollingBloomFilter {
+public:
+    RollingBloomFilter(uint32_t nElements, double fpRate);
+
+    void Insert(const uint256& hash);
+
+    bool Contains(const uint256& hash) const;
+
+    void Reset();
+
+private:
+    uint32_t PositionOf(const uint256& hash, uint32_t n) const;
+
+    uint32_t nEntriesPerGeneration_;
+    uint32_t nEntriesThisGeneration_;
+    uint32_t nGeneration_;
+    uint32_t nHashFuncs_;
+    uint32_t nFilterBits_;
+    uint64_t tweak_;
+
+    // each position of the filter stores the generation (1 to 3, 0 means
+    // empty) in two bits, which are spread over a pair of words
+    std::vector<uint64_t> data_;
+};
+
+#endif // EPIC_ROLLING_BLOOM_FILTER_H
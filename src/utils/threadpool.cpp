@@ -101,3 +101,39 @@ void ThreadPool::Abort() {
     }
     task_queue_enabled_ = true;
 }
+
+Strand::DrainTask::~DrainTask() {
+    // a moved-from task holds no strand
+    if (self) {
+        std::lock_guard<std::mutex> lk(self->mutex_);
+        self->running_ = false;
+    }
+}
+
+void Strand::DrainTask::operator()() {
+    auto strand = std::move(self);
+    strand->Drain();
+}
+
+void Strand::Drain() {
+    for (size_t i = 0; i < kMaxBatch; ++i) {
+        CallableWrapper task;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            if (tasks_.empty()) {
+                running_ = false;
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        try {
+            task();
+        } catch (std::exception& e) {
+            spdlog::error("\"{}\" thrown in strand", e.what());
+        }
+    }
+
+    pool_.Execute(DrainTask{shared_from_this()});
+}
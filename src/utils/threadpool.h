@@ -7,6 +7,7 @@
 
 #include "blocking_queue.h"
 
+#include <deque>
 #include <exception>
 #include <future>
 #include <optional>
@@ -111,4 +112,53 @@ private:
     void WorkerThread(uint32_t id);
 };
 
+/**
+ * Runs the tasks executed on it one at a time and in FIFO order on a shared ThreadPool,
+ * occupying at most one worker of the pool at any time. It must be owned by a
+ * shared_ptr as the pending tasks in the pool keep the strand alive.
+ */
+class Strand : public std::enable_shared_from_this<Strand> {
+public:
+    explicit Strand(ThreadPool& pool) : pool_(pool) {}
+
+    template <typename FunctionType>
+    void Execute(FunctionType&& f) {
+        std::unique_lock<std::mutex> lk(mutex_);
+        tasks_.emplace_back(std::forward<FunctionType>(f));
+        if (running_) {
+            return;
+        }
+        running_ = true;
+        lk.unlock();
+
+        pool_.Execute(DrainTask{shared_from_this()});
+    }
+
+private:
+    /* the number of tasks run before yielding the worker to other strands */
+    static constexpr size_t kMaxBatch = 16;
+
+    /*
+     * Drains the strand on a worker of the pool. If the pool drops it without running it,
+     * e.g. when the pool is disabled, the strand is marked idle so that the next task executed
+     * on it is scheduled again instead of waiting forever
+     */
+    struct DrainTask {
+        std::shared_ptr<Strand> self;
+
+        explicit DrainTask(std::shared_ptr<Strand> strand) : self(std::move(strand)) {}
+        DrainTask(DrainTask&& other) noexcept = default;
+        ~DrainTask();
+
+        void operator()();
+    };
+
+    ThreadPool& pool_;
+    std::mutex mutex_;
+    std::deque<CallableWrapper> tasks_;
+    bool running_ = false;
+
+    void Drain();
+};
+
 #endif // EPIC_THREADPOOL_H
@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <array>
+#include <numeric>
 #include <random>
 #include <string>
 
@@ -358,6 +359,57 @@ TEST_F(TestConsensus, flush_single_chain_to_cat) {
     }
 }
 
+TEST_F(TestConsensus, RawLevelSetsCappedInBytes) {
+    constexpr size_t FLUSHED = 10;
+    const size_t HEIGHT      = GetParams().punctualityThred + FLUSHED;
+    TestRawChain chain;
+    std::tie(chain, std::ignore) = fac.CreateRawChain(GENESIS_VERTEX, HEIGHT);
+
+    for (size_t i = 0; i < chain.size(); i++) {
+        if (i > GetParams().punctualityThred) {
+            usleep(50000);
+        }
+        for (auto& blkptr : chain[i]) {
+            DAG->AddNewBlock(blkptr, nullptr);
+        }
+    }
+
+    usleep(50000);
+    STORE->Wait();
+    DAG->Wait();
+    ASSERT_EQ(STORE->GetHeadHeight(), FLUSHED);
+
+    // the range spans stored and cached level sets
+    const size_t start = FLUSHED - 3;
+    const size_t end   = FLUSHED + 3;
+    VStream expected;
+    std::vector<size_t> sizes;
+    for (size_t height = start; height <= end; ++height) {
+        auto lvs = DAG->GetMainChainRawLevelSets(height, height, SIZE_MAX).first;
+        ASSERT_FALSE(lvs.empty());
+        sizes.push_back(lvs.size());
+        expected.write(lvs.data(), lvs.size());
+    }
+
+    auto [all, nAll] = DAG->GetMainChainRawLevelSets(start, end, expected.size());
+    EXPECT_EQ(nAll, end - start + 1);
+    EXPECT_EQ(all, expected);
+
+    // cut at the last level set that fits, among the stored and among the cached ones
+    for (size_t n : {2, 5}) {
+        size_t bytes       = std::accumulate(sizes.begin(), sizes.begin() + n, size_t(0));
+        auto [part, nPart] = DAG->GetMainChainRawLevelSets(start, end, bytes + sizes[n] - 1);
+        EXPECT_EQ(nPart, n);
+        ASSERT_EQ(part.size(), bytes);
+        EXPECT_TRUE(std::equal(part.begin(), part.end(), expected.begin()));
+    }
+
+    // the first level set is taken even if it does not fit
+    auto [first, nFirst] = DAG->GetMainChainRawLevelSets(start, end, 1);
+    EXPECT_EQ(nFirst, 1);
+    EXPECT_EQ(first.size(), sizes.front());
+}
+
 TEST_F(TestConsensus, delete_fork_and_flush_multiple_chains) {
     const size_t HEIGHT    = GetParams().punctualityThred + 3;
     constexpr size_t hfork = 15;
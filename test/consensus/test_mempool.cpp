@@ -8,6 +8,8 @@
 #include "mempool.h"
 #include "test_env.h"
 
+#include <fstream>
+
 class TestMemPool : public testing::Test {
 public:
     std::vector<ConstTxPtr> transactions;
@@ -94,6 +96,148 @@ TEST_F(TestMemPool, ExtractTransactions) {
     ASSERT_TRUE(pool.Empty());
 }
 
+TEST_F(TestMemPool, FindByShortIDs) {
+    MemPool pool;
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_TRUE(pool.Insert(transactions[i]));
+    }
+
+    // transactions 1 and 2 share a short ID
+    auto shortID = [&](const uint256& h) -> uint64_t {
+        if (h == transactions[0]->GetHash()) {
+            return 10;
+        }
+        return h == transactions[3]->GetHash() ? 30 : 20;
+    };
+
+    auto found = pool.FindByShortIDs({30, 10, 20}, shortID);
+    ASSERT_EQ(found.size(), 3);
+    EXPECT_FALSE(found[0]);
+    EXPECT_EQ(found[1], transactions[0]);
+    EXPECT_FALSE(found[2]);
+}
+
+TEST_F(TestMemPool, ExtractTransactionsByDistance) {
+    MemPool pool;
+    std::vector<ConstTxPtr> txns;
+    for (int i = 0; i < 200; ++i) {
+        txns.push_back(std::make_shared<const Transaction>(fac.CreateTx(1, 1)));
+        ASSERT_TRUE(pool.Insert(txns.back()));
+    }
+
+    uint256 blkHash = fac.CreateRandomHash();
+    auto distance   = [&](const ConstTxPtr& tx) {
+        return (UintToArith256(tx->GetHash()) ^ UintToArith256(blkHash)).GetDouble();
+    };
+    std::sort(txns.begin(), txns.end(),
+              [&](const ConstTxPtr& a, const ConstTxPtr& b) { return distance(a) < distance(b); });
+
+    // a threshold between the 50th and the 51st closest transactions
+    double threshold = (distance(txns[49]) + distance(txns[50])) / 2;
+
+    auto pool_cpy = pool;
+    auto limited  = pool_cpy.ExtractTransactions(blkHash, threshold, 10);
+    ASSERT_EQ(limited.size(), 10);
+    for (const auto& tx : limited) {
+        EXPECT_LT(distance(tx), threshold);
+        EXPECT_FALSE(pool_cpy.Contains(tx));
+    }
+    EXPECT_EQ(pool_cpy.Size(), 190);
+
+    auto extracted = pool.ExtractTransactions(blkHash, threshold);
+    ASSERT_EQ(extracted.size(), 50);
+    std::sort(extracted.begin(), extracted.end(),
+              [&](const ConstTxPtr& a, const ConstTxPtr& b) { return distance(a) < distance(b); });
+    for (size_t i = 0; i < extracted.size(); ++i) {
+        EXPECT_EQ(extracted[i]->GetHash(), txns[i]->GetHash());
+    }
+    EXPECT_EQ(pool.Size(), 150);
+    EXPECT_TRUE(pool.ExtractTransactions(blkHash, threshold).empty());
+}
+
+TEST_F(TestMemPool, ReleaseConfirmedInBatch) {
+    auto [privkey, pubkey] = fac.CreateKeyPair();
+    auto [hashMsg, sig]    = fac.CreateSig(privkey);
+    const auto addr        = pubkey.GetID();
+    const auto blkHash     = fac.CreateRandomHash();
+
+    auto spend = [&](std::vector<uint32_t> outputs, uint64_t value) {
+        Transaction tx;
+        for (auto index : outputs) {
+            tx.AddInput(TxInput{TxOutPoint{blkHash, 0, index}, pubkey, hashMsg, sig});
+        }
+        tx.AddOutput(value, addr);
+        return std::make_shared<const Transaction>(std::move(tx));
+    };
+
+    auto confirmed = spend({0, 1}, 1);
+    auto conflict0 = spend({0}, 2);
+    auto conflict1 = spend({1, 2}, 3);
+    auto invalid   = spend({3}, 4);
+    auto conflict3 = spend({3}, 5);
+    auto unrelated = spend({4}, 6);
+
+    MemPool pool;
+    for (const auto& tx : {confirmed, conflict0, conflict1, invalid, conflict3, unrelated}) {
+        ASSERT_TRUE(pool.Insert(tx));
+    }
+
+    // an invalid transaction does not evict the ones spending the same outputs
+    pool.ReleaseTxsFromConfirmed({{confirmed, true}, {invalid, false}});
+    EXPECT_EQ(pool.Size(), 2);
+    EXPECT_TRUE(pool.Contains(conflict3));
+    EXPECT_TRUE(pool.Contains(unrelated));
+
+    // the index follows the erased transactions
+    ASSERT_TRUE(pool.Erase(conflict3));
+    pool.ReleaseTxFromConfirmed(spend({3}, 7), true);
+    pool.ReleaseTxFromConfirmed(spend({4}, 8), true);
+    EXPECT_TRUE(pool.Empty());
+}
+
+TEST_F(TestMemPool, EvictByFeeRate) {
+    std::vector<ConstTxPtr> txns;
+    size_t totalBytes = 0;
+    for (int i = 0; i < 10; ++i) {
+        txns.push_back(std::make_shared<const Transaction>(fac.CreateTx(1, 1)));
+        totalBytes += GetSerializeSize(*txns.back());
+    }
+
+    // room for about half of the transactions
+    MemPool pool(totalBytes / 2);
+    for (size_t i = 0; i < txns.size(); ++i) {
+        pool.Insert(txns[i], (i + 1) * 1000);
+    }
+
+    auto stats = pool.GetStats();
+    EXPECT_LE(stats.bytes, totalBytes / 2);
+    EXPECT_EQ(stats.count, pool.Size());
+    EXPECT_GT(stats.nEvicted, 0);
+    EXPECT_EQ(stats.count + stats.nEvicted, txns.size());
+
+    // the ones paying the least are evicted
+    for (size_t i = 0; i < txns.size(); ++i) {
+        EXPECT_EQ(pool.Contains(txns[i]), i >= stats.nEvicted);
+    }
+
+    // the min fee rate is raised to about the evicted ones and decays from then on
+    auto lastEvicted = txns[stats.nEvicted - 1];
+    auto evictedRate = GetFeeRate(stats.nEvicted * 1000, GetSerializeSize(*lastEvicted));
+    EXPECT_GT(stats.minFeeRate, evictedRate * 99 / 100);
+    EXPECT_LE(stats.minFeeRate, evictedRate + MemPool::kIncrementalFeeRate);
+
+    // a transaction paying less than all the others is evicted at once
+    auto cheap = std::make_shared<const Transaction>(fac.CreateTx(1, 1));
+    EXPECT_FALSE(pool.Insert(cheap, 0));
+    EXPECT_EQ(pool.GetStats().nEvicted, stats.nEvicted + 1);
+
+    // the accounting follows the removal
+    for (const auto& tx : pool.GetTransactions()) {
+        pool.Erase(tx);
+    }
+    EXPECT_EQ(pool.GetStats().bytes, 0);
+}
+
 TEST_F(TestMemPool, receive_and_release) {
     // prepare dag
     EpicTestEnvironment::SetUpDAG(dir, true);
@@ -196,5 +340,34 @@ TEST_F(TestMemPool, receive_and_release) {
     pool.ReleaseTxFromConfirmed(ptx_normal_1, true);
     ASSERT_TRUE(pool.Empty());
 
+    // a batch is admitted with the same results as one by one
+    ThreadPool threads(2);
+    threads.Start();
+    MemPool batchPool;
+    auto admitted = batchPool.ReceiveTxs({ptx_reg, ptx_conflict, ptx_normal_1, ptx_normal_2, ptx_normal_3}, threads);
+    EXPECT_EQ(admitted, (std::vector<uint8_t>{false, false, true, true, true}));
+    EXPECT_EQ(batchPool.Size(), 3);
+
+    // the transactions and the redemptions are kept across restarts
+    const std::string dumpPath = dir + "mempool.dat";
+    batchPool.PushRedemptionTx(redemption);
+    ASSERT_TRUE(batchPool.Dump(dumpPath));
+    MemPool restarted;
+    EXPECT_EQ(restarted.Load(dumpPath, threads), 3);
+    EXPECT_EQ(restarted.Size(), 3);
+    EXPECT_TRUE(restarted.Contains(ptx_normal_1));
+    ASSERT_NE(restarted.GetRedemptionTx(), nullptr);
+
+    // a corrupted file is discarded
+    {
+        std::fstream file{dumpPath, std::ios::in | std::ios::out | std::ios::binary};
+        file.seekp(8);
+        file.put('\xff');
+    }
+    MemPool corrupted;
+    EXPECT_EQ(corrupted.Load(dumpPath, threads), 0);
+    EXPECT_TRUE(corrupted.Empty());
+    threads.Stop();
+
     EpicTestEnvironment::TearDownDAG(dir);
 }
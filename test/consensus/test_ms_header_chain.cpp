@@ -0,0 +1,107 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <gtest/gtest.h>
+
+#include "ms_header_chain.h"
+#include "test_factory.h"
+
+#include <ctime>
+
+class TestMsHeaderChain : public testing::Test {
+public:
+    TestFactory fac;
+    ThreadPool pool{4};
+
+    std::vector<VertexPtr> milestones;
+    std::vector<MsHeader> headers;
+
+    void SetUp() override {
+        pool.Start();
+
+        // long enough to pass a difficulty transition
+        std::tie(std::ignore, milestones) = fac.CreateRawChain(GENESIS_VERTEX, GetParams().interval + 7);
+        headers.reserve(milestones.size());
+        for (const auto& ms : milestones) {
+            headers.emplace_back(*ms->cblock);
+        }
+    }
+
+    void TearDown() override {
+        pool.Stop();
+    }
+
+    MsHeaderState GenesisState() const {
+        const auto& genesisMs = GENESIS_VERTEX->snapshot;
+        return MsHeaderState(GENESIS->GetHash(), 0, genesisMs->milestoneTarget, genesisMs->lastUpdateTime);
+    }
+};
+
+TEST_F(TestMsHeaderChain, VerifyHeaders) {
+    auto state = GenesisState();
+    std::vector<uint256> hashes;
+    ASSERT_TRUE(VerifyMsHeaders(headers, state, pool, hashes));
+
+    ASSERT_EQ(hashes.size(), milestones.size());
+    for (size_t i = 0; i < milestones.size(); ++i) {
+        EXPECT_EQ(hashes[i], milestones[i]->cblock->GetHash());
+    }
+
+    // the targets derived from the headers are the same as the ones of the milestones
+    const auto& last = milestones.back();
+    EXPECT_EQ(state.hash, last->cblock->GetHash());
+    EXPECT_EQ(state.height, last->height);
+    EXPECT_EQ(state.milestoneTarget, last->snapshot->milestoneTarget);
+    EXPECT_GT(state.work, 0);
+
+    // headers can be verified in several batches
+    auto batched = GenesisState();
+    std::vector<uint256> batchedHashes;
+    size_t half = headers.size() / 2;
+    ASSERT_TRUE(VerifyMsHeaders({headers.begin(), headers.begin() + half}, batched, pool, batchedHashes));
+    ASSERT_TRUE(VerifyMsHeaders({headers.begin() + half, headers.end()}, batched, pool, batchedHashes));
+    EXPECT_EQ(batchedHashes, hashes);
+    EXPECT_EQ(batched.milestoneTarget, state.milestoneTarget);
+    EXPECT_EQ(batched.work, state.work);
+
+    // serialization keeps the headers valid
+    MsHeaders msg(7);
+    msg.headers = headers;
+    VStream stream(msg);
+    MsHeaders msg1(stream);
+    ASSERT_EQ(msg1.headers.size(), headers.size());
+    EXPECT_EQ(msg1.nonce, 7);
+    EXPECT_EQ(msg1.headers.back().GetHeaderBlock().GetHash(), last->cblock->GetHash());
+}
+
+TEST_F(TestMsHeaderChain, RejectInvalidHeaders) {
+    const auto initial = GenesisState();
+
+    // broken linkage
+    auto unlinked = headers;
+    unlinked.erase(unlinked.begin() + 1);
+    auto state = initial;
+    std::vector<uint256> hashes;
+    EXPECT_FALSE(VerifyMsHeaders(unlinked, state, pool, hashes));
+    EXPECT_EQ(state.hash, initial.hash);
+    EXPECT_TRUE(hashes.empty());
+
+    // proof of work not meeting the target
+    auto tampered = headers;
+    tampered.back().header.diffTarget = 0x03000001;
+    EXPECT_FALSE(VerifyMsHeaders(tampered, state, pool, hashes));
+    EXPECT_EQ(state.hash, initial.hash);
+    EXPECT_TRUE(hashes.empty());
+
+    // too far in the future
+    auto future = headers;
+    future.back().header.timestamp = std::time(nullptr) + ALLOWED_TIME_DRIFT + 60;
+    EXPECT_FALSE(VerifyMsHeaders(future, state, pool, hashes));
+    EXPECT_TRUE(hashes.empty());
+
+    // not following the state
+    auto shifted = GenesisState();
+    shifted.hash = fac.CreateRandomHash();
+    EXPECT_FALSE(VerifyMsHeaders(headers, shifted, pool, hashes));
+}
@@ -116,10 +116,15 @@ TEST_F(OBCTest, complex_secondary_deps_test) {
     /* check if there were exactly three
      * values returned as the lose end 9
      * is not tied since it has two deps */
-    EXPECT_EQ(result.size(), 1);
+    EXPECT_EQ(result.size(), 3);
+
+    /* check if parents are released before their children: 7 <- 1 <- 0 */
+    EXPECT_TRUE(result[0]->GetHash() == blocks[7].GetHash());
+    EXPECT_TRUE(result[1]->GetHash() == blocks[1].GetHash());
+    EXPECT_TRUE(result[2]->GetHash() == blocks[0].GetHash());
 
     /* check if the OBC has one element left */
-    EXPECT_EQ(obc.Size(), 3);
+    EXPECT_EQ(obc.Size(), 1);
 
     /* check if that remaining block is 9*/
     EXPECT_TRUE(obc.Contains(rem_hash));
@@ -155,3 +160,29 @@ TEST_F(OBCTest, test_prune) {
 
     ASSERT_EQ(obc.Size(), 1);
 }
+
+TEST_F(OBCTest, delete_block_tree) {
+    OrphanBlocksContainer obc;
+
+    obc.AddBlock(std::make_shared<const Block>(blocks[7]), T_MISSING);
+    obc.AddBlock(std::make_shared<const Block>(blocks[1]), P_MISSING);
+    obc.AddBlock(std::make_shared<const Block>(blocks[0]), P_MISSING);
+    obc.AddBlock(std::make_shared<const Block>(blocks[9]), T_MISSING | P_MISSING);
+
+    ASSERT_EQ(obc.GetDepNodeSize(), 6);
+
+    // 1 is removed together with 0 and 9 that wait for it,
+    // which leaves the missing block 3 without any children
+    obc.DeleteBlockTree(blocks[1].GetHash());
+    EXPECT_EQ(obc.Size(), 1);
+    EXPECT_EQ(obc.GetDepNodeSize(), 2);
+    EXPECT_TRUE(obc.Contains(blocks[7].GetHash()));
+
+    // nodes are recycled by the pool after being deleted
+    obc.AddBlock(std::make_shared<const Block>(blocks[1]), P_MISSING);
+    auto result = obc.SubmitHash(blocks[8].GetHash());
+    ASSERT_EQ(result.size(), 2);
+    EXPECT_TRUE(result[1]->GetHash() == blocks[1].GetHash());
+    EXPECT_TRUE(obc.Empty());
+    EXPECT_EQ(obc.GetDepNodeSize(), 0);
+}
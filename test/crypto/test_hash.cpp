@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>
 
+#include "blake2bxN.h"
 #include "hash.h"
 #include "sha256.h"
 #include "stream.h"
@@ -58,3 +59,31 @@ TEST_F(TestHash, BLAKE2) {
                          "805d79de268f4145660cc5bf85a116b68ac218f219c877f3550b65d0c13bd234"),
               hash512);
 }
+
+TEST_F(TestHash, BLAKE2Midstate) {
+    constexpr size_t lanes = BLAKE2BMidstate::LANES;
+
+    // messages ending within, at the end of and right after a block
+    for (size_t len : {0, 14, 128, 142, 256, 300}) {
+        std::vector<unsigned char> msg(data.begin(), data.begin() + len);
+        std::vector<std::vector<unsigned char>> msgs(lanes, msg);
+        BLAKE2BMidstate midstate(256 / 8, msgs[0].data(), len);
+        ASSERT_LE(midstate.TailSize(), len);
+
+        const unsigned char* tails[lanes];
+        uint256 hashes[lanes];
+        unsigned char* outs[lanes];
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            if (len > 0) {
+                msgs[lane].back() ^= lane;
+            }
+            tails[lane] = msgs[lane].data() + len - midstate.TailSize();
+            outs[lane]  = hashes[lane].begin();
+        }
+        midstate.Hash(tails, outs);
+
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            EXPECT_EQ(hashes[lane], HashBLAKE2<256>(msgs[lane].data(), len)) << BLAKE2BMidstate::KernelName();
+        }
+    }
+}
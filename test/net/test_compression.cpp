@@ -0,0 +1,72 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <gtest/gtest.h>
+
+#include "compression.h"
+#include "version_message.h"
+
+#include <string>
+#include <vector>
+
+class TestCompression : public testing::Test {};
+
+TEST_F(TestCompression, Negotiate) {
+    EXPECT_EQ(NegotiateCodec(0), CODEC_NONE);
+
+    uint64_t local = GetCompressionServices();
+    EXPECT_EQ(bool(local & SERVICE_COMPRESS_LZ4), IsCodecAvailable(CODEC_LZ4));
+    EXPECT_EQ(bool(local & SERVICE_COMPRESS_ZSTD), IsCodecAvailable(CODEC_ZSTD));
+
+    uint16_t codec = NegotiateCodec(SERVICE_COMPRESS_LZ4 | SERVICE_COMPRESS_ZSTD);
+    if (local == 0) {
+        EXPECT_EQ(codec, CODEC_NONE);
+    } else {
+        EXPECT_TRUE(IsCodecAvailable(codec));
+    }
+
+    // a peer never gets a codec it does not announce
+    if (IsCodecAvailable(CODEC_LZ4)) {
+        EXPECT_EQ(NegotiateCodec(SERVICE_COMPRESS_LZ4), CODEC_LZ4);
+    }
+    EXPECT_FALSE(IsCodecAvailable(CODEC_NONE));
+    EXPECT_FALSE(IsCodecAvailable(CODEC_NUM));
+}
+
+TEST_F(TestCompression, RoundTrip) {
+    std::string raw;
+    for (int i = 0; i < 2000; ++i) {
+        raw += "level set " + std::to_string(i % 17) + ";";
+    }
+
+    for (uint16_t codec = CODEC_LZ4; codec < CODEC_NUM; ++codec) {
+        if (!IsCodecAvailable(codec)) {
+            EXPECT_EQ(CompressBound(codec, raw.size()), 0);
+            EXPECT_EQ(DecompressBound(codec, raw.size()), 0);
+            continue;
+        }
+
+        std::vector<char> compressed(CompressBound(codec, raw.size()));
+        size_t size = Compress(codec, raw.data(), raw.size(), compressed.data(), compressed.size());
+        ASSERT_GT(size, 0);
+        EXPECT_LT(size, raw.size());
+        EXPECT_GE(DecompressBound(codec, size), raw.size());
+
+        std::string restored(raw.size(), 0);
+        ASSERT_TRUE(Decompress(codec, compressed.data(), size, &restored[0], raw.size()));
+        EXPECT_EQ(restored, raw);
+
+        // a wrong raw size or corrupted data is rejected
+        EXPECT_FALSE(Decompress(codec, compressed.data(), size, &restored[0], raw.size() - 1));
+        std::vector<char> corrupted(compressed.begin(), compressed.begin() + size / 2);
+        EXPECT_FALSE(Decompress(codec, corrupted.data(), corrupted.size(), &restored[0], raw.size()));
+
+        // the bound holds for data compressed at the max ratio as well
+        std::string zeros(1 << 22, 0);
+        compressed.resize(CompressBound(codec, zeros.size()));
+        size = Compress(codec, zeros.data(), zeros.size(), compressed.data(), compressed.size());
+        ASSERT_GT(size, 0);
+        EXPECT_GE(DecompressBound(codec, size), zeros.size());
+    }
+}
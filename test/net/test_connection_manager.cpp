@@ -5,11 +5,14 @@
 #include <gtest/gtest.h>
 #include <random>
 
+#include "compression.h"
 #include "connection_manager.h"
+#include "hash.h"
 #include "message_header.h"
 #include "sync_messages.h"
 
 #include <atomic>
+#include <chrono>
 
 class TestConnectionManager : public testing::Test {
 public:
@@ -320,6 +323,158 @@ TEST_F(TestConnectionManager, MultiClient) {
     EXPECT_EQ(server.GetConnectionNum(), 0);
 }
 
+TEST_F(TestConnectionManager, Broadcast) {
+    server.RegisterNewConnectionCallback(
+        std::bind(&TestConnectionManager::TestMultiClientNewCallback, this, std::placeholders::_1));
+
+    uint16_t port = GetFreePort();
+    ASSERT_TRUE(server.Bind(0x7f000001));
+    ASSERT_TRUE(server.Listen(port));
+
+    int client_num = 3;
+    ConnectionManager client[client_num];
+
+    for (int i = 0; i < client_num; i++) {
+        client[i].Start();
+        ASSERT_TRUE(client[i].Connect(0x7f000001, port));
+    }
+
+    usleep(50000);
+    ASSERT_EQ(handle_vector.size(), client_num);
+
+    size_t size    = 1000;
+    uint32_t nonce = 0x55555555;
+    uint256 h      = uintS<256>(std::string(64, 'a'));
+    std::vector<uint256> data(size, h);
+    auto message = std::make_shared<const Inv>(data, nonce);
+    message->SetCount(3);
+
+    // the message is serialized once and shared by all the connections
+    server.Broadcast(handle_vector, message);
+    usleep(50000);
+
+    for (int i = 0; i < client_num; i++) {
+        connection_message_t receive_message;
+        ASSERT_TRUE(client[i].ReceiveMessage(receive_message));
+        Inv* msg = dynamic_cast<Inv*>(receive_message.second.get());
+        ASSERT_TRUE(msg != nullptr);
+        ASSERT_EQ(msg->GetCount(), 3);
+        ASSERT_EQ(msg->nonce, nonce);
+        ASSERT_EQ(msg->hashes.size(), size);
+    }
+
+    EXPECT_EQ(server.GetBroadcastNum(NetMessage::INV), 1);
+    EXPECT_EQ(server.GetBroadcastFanout(NetMessage::INV), client_num);
+
+    for (int i = 0; i < client_num; i++) {
+        handle_vector.at(i)->Disconnect();
+        client[i].Stop();
+    }
+    handle_vector.clear();
+}
+
+TEST_F(TestConnectionManager, CompressedMessage) {
+    uint16_t codec = NegotiateCodec(GetCompressionServices());
+    if (codec == CODEC_NONE) {
+        GTEST_SKIP();
+    }
+
+    client.RegisterNewConnectionCallback(
+        std::bind(&TestConnectionManager::TestNewConnectionCallback, this, std::placeholders::_1));
+
+    uint16_t port = GetFreePort();
+    ASSERT_TRUE(server.Bind(0x7f000001));
+    ASSERT_TRUE(server.Listen(port));
+    ASSERT_TRUE(client.Connect(0x7f000001, port));
+
+    usleep(50000);
+    ASSERT_TRUE(test_connect_run);
+    test_connect_handle->SetCodec(codec);
+
+    size_t size = 1000;
+    uint256 h   = uintS<256>(std::string(64, 'a'));
+    std::vector<uint256> data(size, h);
+    test_connect_handle->SendMessage(std::make_unique<Inv>(data, 0x55555555));
+
+    // a small message is not compressed
+    test_connect_handle->SendMessage(std::make_unique<Inv>(std::vector<uint256>{h}, 0x66666666));
+    usleep(50000);
+
+    connection_message_t receive_message;
+    ASSERT_TRUE(server.ReceiveMessage(receive_message));
+    Inv* msg = dynamic_cast<Inv*>(receive_message.second.get());
+    ASSERT_TRUE(msg != nullptr);
+    ASSERT_EQ(msg->nonce, 0x55555555);
+    ASSERT_EQ(msg->hashes.size(), size);
+    for (auto hash : msg->hashes) {
+        ASSERT_EQ(h, hash);
+    }
+
+    ASSERT_TRUE(server.ReceiveMessage(receive_message));
+    msg = dynamic_cast<Inv*>(receive_message.second.get());
+    ASSERT_TRUE(msg != nullptr);
+    ASSERT_EQ(msg->nonce, 0x66666666);
+
+    auto sent = client.GetCompressionStats();
+    EXPECT_EQ(sent.compressedFrames, 1);
+    EXPECT_LT(sent.compressedBytes, sent.rawBytes);
+    EXPECT_LT(sent.Ratio(), 1.0);
+
+    auto received = server.GetCompressionStats();
+    EXPECT_EQ(received.decompressedFrames, 1);
+    EXPECT_EQ(received.decompressFailures, 0);
+
+    test_connect_handle->Disconnect();
+}
+
+TEST_F(TestConnectionManager, TrafficAndRateLimit) {
+    // the server accepts at most 128 KiB per second from each peer
+    ConnectionManager::RateLimits limits;
+    limits.peerDownload = 128 * 1024;
+    server.SetRateLimits(limits);
+
+    server.RegisterNewConnectionCallback(
+        std::bind(&TestConnectionManager::TestMultiClientNewCallback, this, std::placeholders::_1));
+    client.RegisterNewConnectionCallback(
+        std::bind(&TestConnectionManager::TestNewConnectionCallback, this, std::placeholders::_1));
+
+    uint16_t port = GetFreePort();
+    ASSERT_TRUE(server.Bind(0x7f000001));
+    ASSERT_TRUE(server.Listen(port));
+    ASSERT_TRUE(client.Connect(0x7f000001, port));
+
+    usleep(50000);
+    ASSERT_TRUE(test_connect_run);
+    ASSERT_EQ(handle_vector.size(), 1);
+
+    // about 320 KiB of random hashes, which takes more than two seconds to get through
+    size_t size = 10000;
+    std::vector<uint256> data;
+    for (size_t i = 0; i < size; ++i) {
+        data.push_back(HashSHA2<1>(&i, sizeof(i)));
+    }
+    auto start = std::chrono::steady_clock::now();
+    test_connect_handle->SendMessage(std::make_unique<Inv>(data, 0x55555555));
+
+    connection_message_t receive_message;
+    ASSERT_TRUE(server.ReceiveMessage(receive_message));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    Inv* msg = dynamic_cast<Inv*>(receive_message.second.get());
+    ASSERT_TRUE(msg != nullptr);
+    ASSERT_EQ(msg->hashes.size(), size);
+
+    const auto& sent     = test_connect_handle->GetTraffic();
+    const auto& received = handle_vector.front()->GetTraffic();
+    EXPECT_EQ(sent.sentMessages[NetMessage::INV], 1);
+    EXPECT_EQ(received.receivedMessages[NetMessage::INV], 1);
+    EXPECT_GT(sent.sentBytes[NetMessage::INV], size * 32);
+    EXPECT_EQ(sent.sentBytes[NetMessage::INV], received.receivedBytes[NetMessage::INV]);
+    EXPECT_EQ(received.sentMessages[NetMessage::INV], 0);
+
+    test_connect_handle->Disconnect();
+    handle_vector.clear();
+}
+
 TEST_F(TestConnectionManager, Bind_fail) {
     ASSERT_FALSE(server.Bind(0x5A5A5A5A));
 }
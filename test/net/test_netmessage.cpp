@@ -5,12 +5,14 @@
 #include <gtest/gtest.h>
 
 #include "address_message.h"
+#include "compact_block.h"
 #include "net_message.h"
 #include "ping.h"
 #include "pong.h"
 #include "sync_messages.h"
 #include "task.h"
 #include "test_factory.h"
+#include "tx_inventory.h"
 #include "version_message.h"
 
 #include <ostream>
@@ -146,3 +148,137 @@ TEST_F(TestNetMsg, GetData) {
         EXPECT_EQ(getData.bundleNonce[i], getData1.bundleNonce[i]);
     }
 }
+
+TEST_F(TestNetMsg, CompactBlock) {
+    auto block = factory.CreateBlock(1, 1, true, 10);
+    const auto& txns = block.GetTransactions();
+    ASSERT_EQ(txns.size(), 10);
+
+    CompactBlock compact(block, 7877);
+    ASSERT_EQ(compact.GetTransactionSize(), txns.size());
+    EXPECT_EQ(compact.prefilledIndexes[0], 0);
+    EXPECT_EQ(compact.GetHeaderBlock().GetHash(), block.GetHash());
+
+    VStream stream(compact);
+    CompactBlock compact1(stream);
+    EXPECT_EQ(compact1.salt, compact.salt);
+    EXPECT_EQ(compact1.shortIDs, compact.shortIDs);
+    EXPECT_EQ(compact1.prefilledIndexes, compact.prefilledIndexes);
+    ASSERT_EQ(compact1.prefilledTxns.size(), compact.prefilledTxns.size());
+    EXPECT_EQ(compact1.GetHeaderBlock().GetHash(), block.GetHash());
+
+    // short IDs are 48 bits, keyed on the header and the salt
+    for (size_t i = 1, k = 0; i < txns.size(); ++i) {
+        auto id = compact1.GetShortID(txns[i]->GetHash());
+        EXPECT_EQ(id >> 48, 0);
+        EXPECT_EQ(id, compact1.shortIDs[k++]);
+    }
+    CompactBlock salted(block, 7878);
+    EXPECT_NE(salted.shortIDs, compact.shortIDs);
+
+    // rebuild the block from the transactions the short IDs refer to
+    Block rebuilt = compact1.GetHeaderBlock();
+    rebuilt.AddTransactions(std::vector<ConstTxPtr>(txns.begin(), txns.end()));
+    rebuilt.FinalizeHash();
+    EXPECT_EQ(rebuilt.GetHash(), block.GetHash());
+}
+
+TEST_F(TestNetMsg, BlockTxn) {
+    auto block = factory.CreateBlock(1, 1, true, 5);
+
+    GetBlockTxn request(block.GetHash(), {1, 3});
+    VStream stream(request);
+    GetBlockTxn request1(stream);
+    EXPECT_EQ(request1.blockHash, block.GetHash());
+    EXPECT_EQ(request1.indexes, request.indexes);
+
+    BlockTxn response(block.GetHash(), {block.GetTransactions()[1], block.GetTransactions()[3]});
+    VStream stream1(response);
+    BlockTxn response1(stream1);
+    EXPECT_EQ(response1.blockHash, block.GetHash());
+    ASSERT_EQ(response1.txns.size(), 2);
+    EXPECT_EQ(response1.txns[0]->GetHash(), block.GetTransactions()[1]->GetHash());
+    EXPECT_EQ(response1.txns[1]->GetHash(), block.GetTransactions()[3]->GetHash());
+}
+
+TEST_F(TestNetMsg, TxInventory) {
+    std::vector<uint256> hashes;
+    for (int i = 0; i < 100; i++) {
+        hashes.push_back(factory.CreateRandomHash());
+    }
+
+    TxInv txInv(hashes);
+    VStream stream(txInv);
+    TxInv txInv1(stream);
+    EXPECT_EQ(txInv1.GetType(), NetMessage::TX_INV);
+    EXPECT_EQ(txInv1.hashes, hashes);
+
+    GetTxData getTxData(hashes);
+    VStream stream1(getTxData);
+    GetTxData getTxData1(stream1);
+    EXPECT_EQ(getTxData1.GetType(), NetMessage::GET_TX_DATA);
+    EXPECT_EQ(getTxData1.hashes, hashes);
+
+    std::vector<ConstTxPtr> txns;
+    for (int i = 0; i < 3; i++) {
+        txns.push_back(std::make_shared<Transaction>(factory.CreateTx(2, 2)));
+    }
+    TxData txData(txns);
+    VStream stream2(txData);
+    TxData txData1(stream2);
+    EXPECT_EQ(txData1.GetType(), NetMessage::TX_DATA);
+    ASSERT_EQ(txData1.txns.size(), txns.size());
+    for (size_t i = 0; i < txns.size(); i++) {
+        EXPECT_EQ(txData1.txns[i]->GetHash(), txns[i]->GetHash());
+    }
+}
+
+TEST_F(TestNetMsg, LvsRange) {
+    auto start = factory.CreateRandomHash();
+    auto end   = factory.CreateRandomHash();
+    GetLvsRange getRange(start, end, 7);
+    VStream stream(getRange);
+    GetLvsRange getRange1(stream);
+    EXPECT_EQ(getRange1.startHash, start);
+    EXPECT_EQ(getRange1.endHash, end);
+    EXPECT_EQ(getRange1.nonce, 7);
+
+    // the raw level sets are concatenated blocks
+    std::vector<ConstBlockPtr> blocks;
+    VStream payload;
+    for (int i = 0; i < 5; i++) {
+        blocks.push_back(factory.CreateBlockPtr(1, 1, true));
+        payload << blocks.back();
+    }
+
+    LvsRange range(7);
+    range.SetPayload(std::move(payload));
+    VStream stream1(range);
+    LvsRange range1(stream1);
+    EXPECT_EQ(range1.nonce, 7);
+    ASSERT_EQ(range1.blocks.size(), blocks.size());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        EXPECT_EQ(*range1.blocks[i], *blocks[i]);
+    }
+}
+
+TEST_F(TestNetMsg, MsHeaders) {
+    std::vector<uint256> locator{factory.CreateRandomHash(), GENESIS->GetHash()};
+    GetMsHeaders getHeaders(locator, 9);
+    VStream stream(getHeaders);
+    GetMsHeaders getHeaders1(stream);
+    EXPECT_EQ(getHeaders1.locator, locator);
+    EXPECT_EQ(getHeaders1.nonce, 9);
+
+    MsHeaders headers(9);
+    for (int i = 0; i < 3; i++) {
+        headers.headers.emplace_back(factory.CreateBlock(1, 1, true));
+    }
+    VStream stream1(headers);
+    MsHeaders headers1(stream1);
+    EXPECT_EQ(headers1.nonce, 9);
+    ASSERT_EQ(headers1.headers.size(), headers.headers.size());
+    for (size_t i = 0; i < headers.headers.size(); i++) {
+        EXPECT_EQ(headers1.headers[i].GetHeaderBlock().GetHash(), headers.headers[i].GetHeaderBlock().GetHash());
+    }
+}
@@ -0,0 +1,456 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <gtest/gtest.h>
+
+#include "level_set_downloader.h"
+#include "peer_manager.h"
+#include "test_env.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+
+class TestLevelSetDownloader : public testing::Test {
+public:
+    ConnectionManager server;
+    ConnectionManager client;
+    AddressManager* addressManager;
+
+    std::mutex peersLock;
+    std::vector<PeerPtr> peers;
+
+    // level sets handed over by the downloader
+    std::vector<std::shared_ptr<Bundle>> delivered;
+
+    TestFactory fac;
+
+    static void SetUpTestCase() {
+        CONFIG = std::make_unique<Config>();
+        EpicTestEnvironment::SetUpDAG("test_lvs_downloader/");
+    }
+
+    static void TearDownTestCase() {
+        EpicTestEnvironment::TearDownDAG("test_lvs_downloader/");
+        CONFIG.reset();
+    }
+
+    void SetUp() {
+        addressManager = new AddressManager();
+        addressManager->Init();
+        server.Start();
+        client.Start();
+        server.RegisterNewConnectionCallback([this](shared_connection_t connection) {
+            std::optional<NetAddress> address = NetAddress::GetByIP(connection->GetRemote());
+            auto peer = std::make_shared<Peer>(*address, connection, false, addressManager, 100);
+            peer->SetWeakPeer(peer);
+            std::lock_guard<std::mutex> lk(peersLock);
+            peers.push_back(peer);
+        });
+    }
+
+    void TearDown() {
+        for (auto& p : peers) {
+            p->Disconnect();
+        }
+        server.Stop();
+        client.Stop();
+        delete addressManager;
+    }
+
+    LevelSetDownloader::DeliverFunc Deliver() {
+        return [this](const std::shared_ptr<Bundle>& bundle, const PeerPtr&) { delivered.push_back(bundle); };
+    }
+
+    /**
+     * connects n peers to the server, announcing GetLvsRange support if range
+     */
+    void Connect(uint16_t port, size_t n, bool range = false) {
+        ASSERT_TRUE(server.Bind(0x7f000001));
+        ASSERT_TRUE(server.Listen(port));
+        for (size_t i = 0; i < n; ++i) {
+            ASSERT_TRUE(client.Connect(0x7f000001, port));
+        }
+        auto connected = [&]() {
+            std::lock_guard<std::mutex> lk(peersLock);
+            return peers.size();
+        };
+        for (int i = 0; i < 100 && connected() < n; ++i) {
+            usleep(10000);
+        }
+        ASSERT_EQ(connected(), n);
+
+        if (range) {
+            for (size_t i = 0; i < n; ++i) {
+                VersionMessage version(peers[i]->address, peers[i]->address, 0, i + 1, "version_info", 0,
+                                       SERVICE_LVS_RANGE);
+                peers[i]->ProcessVersionMessage(version);
+            }
+        }
+    }
+
+    std::vector<ConstBlockPtr> CreateMilestones(size_t n) {
+        std::vector<ConstBlockPtr> blocks;
+        for (size_t i = 0; i < n; ++i) {
+            blocks.push_back(fac.CreateBlockPtr(1, 1, true));
+        }
+        return blocks;
+    }
+
+    static std::vector<uint256> Hashes(const std::vector<ConstBlockPtr>& blocks) {
+        std::vector<uint256> hashes;
+        for (const auto& b : blocks) {
+            hashes.push_back(b->GetHash());
+        }
+        return hashes;
+    }
+
+    /**
+     * reads the GetData sent to the peers until n level sets are requested
+     * @return the hashes requested with the nonces of the responses
+     */
+    std::vector<std::pair<uint256, uint32_t>> ReadGetData(size_t n) {
+        std::vector<std::pair<uint256, uint32_t>> requests;
+        connection_message_t message;
+        while (requests.size() < n && client.ReceiveMessage(message)) {
+            if (message.second->GetType() != NetMessage::GET_DATA) {
+                continue;
+            }
+            auto getData = dynamic_cast<GetData*>(message.second.get());
+            for (size_t i = 0; i < getData->hashes.size(); ++i) {
+                requests.emplace_back(getData->hashes[i], getData->bundleNonce[i]);
+            }
+        }
+        return requests;
+    }
+
+    /**
+     * reads the GetLvsRange sent to the peers until n ranges are requested
+     */
+    std::vector<GetLvsRange> ReadRanges(size_t n) {
+        std::vector<GetLvsRange> ranges;
+        connection_message_t message;
+        while (ranges.size() < n && client.ReceiveMessage(message)) {
+            if (message.second->GetType() == NetMessage::GET_LVS_RANGE) {
+                ranges.push_back(*dynamic_cast<GetLvsRange*>(message.second.get()));
+            }
+        }
+        return ranges;
+    }
+
+    /**
+     * creates a range of the level sets of the milestones, the i-th of which holds i more blocks
+     */
+    std::shared_ptr<LvsRange> CreateRange(const std::vector<ConstBlockPtr>& milestones, uint32_t nonce) {
+        auto range = std::make_shared<LvsRange>(nonce);
+        for (size_t i = 0; i < milestones.size(); ++i) {
+            range->blocks.push_back(milestones[i]);
+            for (size_t j = 0; j < i; ++j) {
+                range->blocks.push_back(fac.CreateBlockPtr(1, 1));
+            }
+        }
+        return range;
+    }
+
+    /**
+     * answers a range request, from whichever peer it was sent to
+     * @return the peer, null if the downloader does not take the range
+     */
+    PeerPtr RespondRange(LevelSetDownloader& downloader, const std::shared_ptr<LvsRange>& range) {
+        for (auto& p : peers) {
+            if (downloader.OnLvsRange(range, p)) {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * answers a request with the level set of the milestone, from whichever peer it was sent to
+     * @return the peer, null if the downloader does not take the bundle
+     */
+    PeerPtr Respond(LevelSetDownloader& downloader, const ConstBlockPtr& milestone, uint32_t nonce) {
+        auto bundle = std::make_shared<Bundle>(nonce);
+        bundle->AddBlock(milestone);
+        for (auto& p : peers) {
+            if (downloader.OnBundle(bundle, p)) {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    static LevelSetDownloader::PeerStats StatsOf(const LevelSetDownloader& downloader, const PeerPtr& peer) {
+        for (const auto& s : downloader.GetStats()) {
+            if (s.address == peer->address.ToString()) {
+                return s;
+            }
+        }
+        return {};
+    }
+};
+
+TEST_F(TestLevelSetDownloader, SpreadAcrossPeers) {
+    Connect(43300, 3);
+    LevelSetDownloader downloader(2, Deliver());
+
+    auto milestones = CreateMilestones(12);
+    downloader.Enqueue(Hashes(milestones), std::vector<bool>(12, true), peers[0], {peers[1], peers[2]});
+
+    size_t inflight = 0;
+    for (const auto& p : peers) {
+        auto stats = StatsOf(downloader, p);
+        EXPECT_GT(stats.inflight, 0);
+        inflight += stats.inflight;
+    }
+    EXPECT_EQ(inflight, 12);
+
+    auto requests = ReadGetData(12);
+    ASSERT_EQ(requests.size(), 12);
+    std::map<uint256, ConstBlockPtr> byHash;
+    for (const auto& b : milestones) {
+        byHash[b->GetHash()] = b;
+    }
+    for (const auto& [hash, nonce] : requests) {
+        ASSERT_TRUE(Respond(downloader, byHash.at(hash), nonce));
+    }
+
+    EXPECT_TRUE(downloader.Empty());
+    ASSERT_EQ(delivered.size(), 12);
+    for (size_t i = 0; i < 12; ++i) {
+        EXPECT_EQ(delivered[i]->blocks.front()->GetHash(), milestones[i]->GetHash());
+    }
+}
+
+TEST_F(TestLevelSetDownloader, DeliverInOrder) {
+    Connect(43305, 1);
+    LevelSetDownloader downloader(1, Deliver());
+
+    auto milestones = CreateMilestones(3);
+    downloader.Enqueue(Hashes(milestones), std::vector<bool>(3, true), peers[0], {});
+    auto requests = ReadGetData(3);
+    ASSERT_EQ(requests.size(), 3);
+    std::map<uint256, uint32_t> nonces(requests.begin(), requests.end());
+
+    // the later level sets are held until the first one arrives
+    ASSERT_TRUE(Respond(downloader, milestones[2], nonces[milestones[2]->GetHash()]));
+    ASSERT_TRUE(Respond(downloader, milestones[1], nonces[milestones[1]->GetHash()]));
+    EXPECT_TRUE(delivered.empty());
+    EXPECT_FALSE(downloader.Empty());
+
+    ASSERT_TRUE(Respond(downloader, milestones[0], nonces[milestones[0]->GetHash()]));
+    EXPECT_TRUE(downloader.Empty());
+    ASSERT_EQ(delivered.size(), 3);
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(delivered[i]->blocks.front()->GetHash(), milestones[i]->GetHash());
+    }
+
+    // a response is taken only once
+    EXPECT_FALSE(Respond(downloader, milestones[0], nonces[milestones[0]->GetHash()]));
+}
+
+TEST_F(TestLevelSetDownloader, RequeueOnTimeout) {
+    Connect(43310, 2);
+    LevelSetDownloader downloader(1, Deliver(), std::chrono::milliseconds(1));
+
+    auto milestones = CreateMilestones(1);
+    downloader.Enqueue(Hashes(milestones), {true}, peers[0], {peers[1]});
+    auto first = ReadGetData(1);
+    ASSERT_EQ(first.size(), 1);
+    auto slow = StatsOf(downloader, peers[0]).inflight ? peers[0] : peers[1];
+    auto fast = slow == peers[0] ? peers[1] : peers[0];
+
+    // the request timed out is moved to the other peer
+    usleep(10000);
+    downloader.Expire(peers);
+    EXPECT_EQ(StatsOf(downloader, slow).timeouts, 1);
+    EXPECT_EQ(StatsOf(downloader, slow).inflight, 0);
+    EXPECT_EQ(StatsOf(downloader, fast).inflight, 1);
+
+    // the late response of the slow peer is no longer taken
+    auto second = ReadGetData(1);
+    ASSERT_EQ(second.size(), 1);
+    EXPECT_FALSE(Respond(downloader, milestones[0], first[0].second));
+    EXPECT_EQ(Respond(downloader, milestones[0], second[0].second), fast);
+    EXPECT_TRUE(downloader.Empty());
+    EXPECT_EQ(delivered.size(), 1);
+}
+
+TEST_F(TestLevelSetDownloader, DisconnectAfterStrikes) {
+    Connect(43315, 1);
+    LevelSetDownloader downloader(1, Deliver(), std::chrono::milliseconds(1));
+
+    // each of the requests times out, striking the peer as many times as it takes to disconnect it
+    auto milestones = CreateMilestones(3);
+    downloader.Enqueue(Hashes(milestones), std::vector<bool>(3, true), peers[0], {});
+    ASSERT_EQ(ReadGetData(3).size(), 3);
+
+    usleep(10000);
+    downloader.Expire(peers);
+    EXPECT_FALSE(peers[0]->IsVaild());
+
+    // no one is left to provide the level sets, which are given up
+    EXPECT_TRUE(downloader.Empty());
+    EXPECT_TRUE(delivered.empty());
+}
+
+TEST_F(TestLevelSetDownloader, GiveUpUnavailable) {
+    Connect(43320, 2);
+    LevelSetDownloader downloader(1, Deliver());
+
+    auto milestones = CreateMilestones(2);
+    downloader.Enqueue(Hashes(milestones), {false, true}, peers[0], {peers[1]});
+    auto requests = ReadGetData(2);
+    ASSERT_EQ(requests.size(), 2);
+
+    // the first level set is not found by either peer
+    auto notFound = [&](uint32_t nonce) {
+        for (auto& p : peers) {
+            if (downloader.OnNotFound(nonce, p)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto hashIt = std::find_if(requests.begin(), requests.end(),
+                               [&](const auto& r) { return r.first == milestones[0]->GetHash(); });
+    ASSERT_NE(hashIt, requests.end());
+    ASSERT_TRUE(notFound(hashIt->second));
+
+    auto retry = ReadGetData(1);
+    ASSERT_EQ(retry.size(), 1);
+    EXPECT_EQ(retry[0].first, milestones[0]->GetHash());
+    ASSERT_TRUE(notFound(retry[0].second));
+    EXPECT_FALSE(downloader.Empty());
+
+    // the second one is delivered right after, skipping the first
+    auto other = std::find_if(requests.begin(), requests.end(),
+                              [&](const auto& r) { return r.first == milestones[1]->GetHash(); });
+    ASSERT_TRUE(Respond(downloader, milestones[1], other->second));
+    EXPECT_TRUE(downloader.Empty());
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_EQ(delivered[0]->blocks.front()->GetHash(), milestones[1]->GetHash());
+}
+
+TEST_F(TestLevelSetDownloader, UnexpectedBundle) {
+    Connect(43325, 2);
+    LevelSetDownloader downloader(1, Deliver());
+
+    auto milestones = CreateMilestones(1);
+    downloader.Enqueue(Hashes(milestones), {true}, peers[0], {peers[1]});
+    auto first = ReadGetData(1);
+    ASSERT_EQ(first.size(), 1);
+
+    // a level set other than the one requested is taken as not found and requested from the other peer
+    auto sender = Respond(downloader, fac.CreateBlockPtr(1, 1, true), first[0].second);
+    ASSERT_TRUE(sender);
+    EXPECT_TRUE(delivered.empty());
+
+    auto second = ReadGetData(1);
+    ASSERT_EQ(second.size(), 1);
+    EXPECT_EQ(second[0].first, milestones[0]->GetHash());
+    auto provider = Respond(downloader, milestones[0], second[0].second);
+    ASSERT_TRUE(provider);
+    EXPECT_NE(provider, sender);
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_EQ(delivered[0]->blocks.front()->GetHash(), milestones[0]->GetHash());
+}
+
+TEST_F(TestLevelSetDownloader, RemovePeer) {
+    Connect(43330, 2);
+    LevelSetDownloader downloader(1, Deliver());
+
+    auto milestones = CreateMilestones(2);
+    downloader.Enqueue(Hashes(milestones), std::vector<bool>(2, true), peers[0], {peers[1]});
+    ASSERT_EQ(StatsOf(downloader, peers[0]).inflight, 1);
+    ASSERT_EQ(StatsOf(downloader, peers[1]).inflight, 1);
+    ASSERT_EQ(ReadGetData(2).size(), 2);
+
+    // the request to the removed peer goes to the one left
+    downloader.RemovePeer(peers[0].get());
+    ASSERT_EQ(downloader.GetStats().size(), 1);
+    EXPECT_EQ(StatsOf(downloader, peers[1]).inflight, 2);
+
+    auto requeued = ReadGetData(1);
+    ASSERT_EQ(requeued.size(), 1);
+    auto index = requeued[0].first == milestones[0]->GetHash() ? 0 : 1;
+    EXPECT_EQ(Respond(downloader, milestones[index], requeued[0].second), peers[1]);
+}
+
+TEST_F(TestLevelSetDownloader, SplitRange) {
+    Connect(43335, 1, true);
+    LevelSetDownloader downloader(1, Deliver());
+
+    auto milestones = CreateMilestones(3);
+    downloader.Enqueue(Hashes(milestones), std::vector<bool>(3, true), peers[0], {});
+    auto ranges = ReadRanges(1);
+    ASSERT_EQ(ranges.size(), 1);
+    EXPECT_EQ(ranges[0].startHash, milestones[0]->GetHash());
+    EXPECT_EQ(ranges[0].endHash, milestones[2]->GetHash());
+
+    // the range is split at the milestones requested
+    ASSERT_EQ(RespondRange(downloader, CreateRange(milestones, ranges[0].nonce)), peers[0]);
+    EXPECT_TRUE(downloader.Empty());
+    ASSERT_EQ(delivered.size(), 3);
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(delivered[i]->blocks.front()->GetHash(), milestones[i]->GetHash());
+        EXPECT_EQ(delivered[i]->blocks.size(), i + 1);
+    }
+    EXPECT_EQ(StatsOf(downloader, peers[0]).received, 3);
+}
+
+TEST_F(TestLevelSetDownloader, RangeCutShort) {
+    Connect(43340, 1, true);
+    LevelSetDownloader downloader(1, Deliver());
+
+    auto milestones = CreateMilestones(3);
+    downloader.Enqueue(Hashes(milestones), std::vector<bool>(3, true), peers[0], {});
+    auto first = ReadRanges(1);
+    ASSERT_EQ(first.size(), 1);
+
+    // the rest of a range cut short is asked again from the same peer rather than given up
+    ASSERT_TRUE(RespondRange(downloader, CreateRange({milestones[0]}, first[0].nonce)));
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_FALSE(downloader.Empty());
+
+    auto rest = ReadRanges(1);
+    ASSERT_EQ(rest.size(), 1);
+    EXPECT_EQ(rest[0].startHash, milestones[1]->GetHash());
+    EXPECT_EQ(rest[0].endHash, milestones[2]->GetHash());
+
+    ASSERT_EQ(RespondRange(downloader, CreateRange({milestones[1], milestones[2]}, rest[0].nonce)), peers[0]);
+    EXPECT_TRUE(downloader.Empty());
+    ASSERT_EQ(delivered.size(), 3);
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(delivered[i]->blocks.front()->GetHash(), milestones[i]->GetHash());
+    }
+}
+
+TEST_F(TestLevelSetDownloader, RangeMissingFirstMilestone) {
+    Connect(43345, 2, true);
+    LevelSetDownloader downloader(1, Deliver());
+
+    auto milestones = CreateMilestones(2);
+    downloader.Enqueue(Hashes(milestones), std::vector<bool>(2, true), peers[0], {peers[1]});
+    auto first = ReadRanges(1);
+    ASSERT_EQ(first.size(), 1);
+
+    // a range not starting with the first milestone is taken as not found and requested from the other peer
+    auto other  = fac.CreateBlockPtr(1, 1, true);
+    auto sender = RespondRange(downloader, CreateRange({other, milestones[1]}, first[0].nonce));
+    ASSERT_TRUE(sender);
+    EXPECT_TRUE(delivered.empty());
+
+    auto second = ReadRanges(1);
+    ASSERT_EQ(second.size(), 1);
+    EXPECT_EQ(second[0].startHash, milestones[0]->GetHash());
+    EXPECT_EQ(second[0].endHash, milestones[1]->GetHash());
+
+    auto provider = RespondRange(downloader, CreateRange(milestones, second[0].nonce));
+    ASSERT_TRUE(provider);
+    EXPECT_NE(provider, sender);
+    EXPECT_TRUE(downloader.Empty());
+    EXPECT_EQ(delivered.size(), 2);
+}
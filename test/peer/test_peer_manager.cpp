@@ -42,6 +42,25 @@ TEST_F(TestPeerManager, CallBack) {
     EXPECT_EQ(client.GetFullyConnectedPeerSize(), 1);
 }
 
+TEST_F(TestPeerManager, DispatchLanes) {
+    ASSERT_TRUE(server.Bind("127.0.0.1"));
+    ASSERT_TRUE(server.Listen(43255));
+    ASSERT_TRUE(client.ConnectTo("127.0.0.1:43255"));
+    usleep(50000);
+    ASSERT_EQ(server.GetFullyConnectedPeerSize(), 1);
+
+    // the version handshake goes through the sync lane, in order with the sync messages of the peer
+    auto stats = server.GetDispatchStats();
+    ASSERT_EQ(stats.size(), 5);
+    EXPECT_EQ(stats[0].name, "control");
+    EXPECT_EQ(stats[1].name, "sync");
+    EXPECT_GE(stats[1].processed, 2);
+    EXPECT_EQ(stats[1].depth, 0);
+    EXPECT_EQ(stats[2].processed, 0);
+    EXPECT_EQ(stats[3].name, "admission");
+    EXPECT_EQ(stats[3].processed, 0);
+}
+
 TEST_F(TestPeerManager, CheckHaveConnectedSameIP) {
     ASSERT_TRUE(server.Bind("127.0.0.1"));
     ASSERT_TRUE(server.Listen(43260));
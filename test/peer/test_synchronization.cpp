@@ -168,6 +168,14 @@ TEST_F(TestSync, test_basic_sync_workflow) {
     STORE->Wait();
     DAG->Wait();
 
+    // the bundles received out of order have all been handed to the dag
+    ASSERT_TRUE(DAG->GetDownloader().Empty());
+    auto downloadStats = DAG->GetDownloader().GetStats();
+    ASSERT_EQ(downloadStats.size(), 1);
+    EXPECT_EQ(downloadStats[0].received, testChainHeight);
+    EXPECT_EQ(downloadStats[0].inflight, 0);
+    EXPECT_GE(downloadStats[0].window, 1);
+
     peer_server->StartSync();
     usleep(50000);
 
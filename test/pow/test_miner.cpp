@@ -37,6 +37,49 @@ TEST_F(TestMiner, Solve) {
     EXPECT_TRUE(block.Verify());
 }
 
+TEST_F(TestMiner, UpdateSolvingBlock) {
+    Block block = fac.CreateBlock(1, 1);
+    // a target no hash meets
+    block.SetDifficultyTarget(0x03000001);
+
+    CPUSolver solver(2);
+    solver.Start();
+    uint32_t ret;
+    std::thread solving([&] { ret = solver.Solve(block); });
+
+    const uint32_t easiest = GetParams().maxTarget.GetCompact();
+    while (!solver.UpdateTemplate([&] {
+        block.SetDifficultyTarget(easiest);
+        return true;
+    })) {
+        usleep(1000);
+    }
+    solving.join();
+    solver.Stop();
+
+    EXPECT_EQ(ret, SolverResult::ErrorCode::SUCCESS);
+    EXPECT_EQ(block.GetDifficultyTarget(), easiest);
+    EXPECT_TRUE(block.Verify());
+}
+
+TEST_F(TestMiner, BlockTemplate) {
+    BlockTemplate blockTemplate(GetParams().version);
+    for (int i = 0; i < 9; ++i) {
+        blockTemplate.AddTransaction(std::make_shared<const Transaction>(fac.CreateTx(1, 1)));
+        EXPECT_EQ(blockTemplate.GetBlock().GetMerkleRoot(), blockTemplate.GetBlock().ComputeMerkleRoot());
+    }
+
+    size_t n     = 0;
+    auto removed = blockTemplate.RemoveTransactionsIf(1, [&n](const ConstTxPtr&) { return n++ % 3 == 0; });
+    EXPECT_FALSE(removed.empty());
+    EXPECT_EQ(removed.size() + blockTemplate.GetBlock().GetTransactionSize(), 9);
+    EXPECT_EQ(blockTemplate.GetBlock().GetMerkleRoot(), blockTemplate.GetBlock().ComputeMerkleRoot());
+
+    blockTemplate.AddTransactions(std::move(removed));
+    EXPECT_EQ(blockTemplate.GetBlock().GetTransactionSize(), 9);
+    EXPECT_EQ(blockTemplate.GetBlock().GetMerkleRoot(), blockTemplate.GetBlock().ComputeMerkleRoot());
+}
+
 #ifdef __CUDA_ENABLED__
 TEST_F(TestMiner, SolveCuckaroo) {
     SetLogLevel(SPDLOG_LEVEL_DEBUG);
@@ -67,6 +110,43 @@ TEST_F(TestMiner, SolveCuckaroo) {
 }
 #endif
 
+TEST_F(TestMiner, PreemptStaleTask) {
+    SolverManager solverManager(1, true);
+    solverManager.Start();
+
+    // tasks of a target no cycle meets, which run until canceled
+    auto newTask = [](uint32_t id) {
+        auto task          = std::make_shared<SolverTask>();
+        task->id           = id;
+        task->miner        = "miner";
+        task->step         = 1;
+        task->cycle_length = 42;
+        task->blockHeader  = VStream(GENESIS->GetHeader());
+        return task;
+    };
+
+    auto stale = newTask(1);
+    TaskStatus staleStatus;
+    std::thread staleThread([&] { staleStatus = solverManager.ProcessTask(stale); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto latest = newTask(2);
+    TaskStatus latestStatus;
+    std::thread latestThread([&] { latestStatus = solverManager.ProcessTask(latest); });
+
+    staleThread.join();
+    EXPECT_EQ(staleStatus.second, SolverResult::ErrorCode::TASK_CANCELED_BY_CLIENT);
+    EXPECT_GT(stale->solveMicros, 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    solverManager.AbortTask(latest->id);
+    latestThread.join();
+    EXPECT_EQ(latestStatus.second, SolverResult::ErrorCode::TASK_CANCELED_BY_CLIENT);
+    EXPECT_GT(latest->solveMicros, 0);
+
+    solverManager.Stop();
+}
+
 TEST_F(TestMiner, Run) {
     Miner m(2);
     m.Run();
@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 
+#include "lean.h"
+#include "siphashxN.h"
 #include "test_env.h"
 #include "trimmer.h"
 #include "utilstrencodings.h"
@@ -22,6 +24,64 @@ public:
     }
 };
 
+TEST_F(TestTrimmer, CPU) {
+    // a small graph with short cycles keeps the search quick
+    constexpr uint32_t edgeBits = 18;
+    constexpr uint32_t cycleLen = 8;
+    LeanSolverCtx ctx(2, cycleLen, edgeBits);
+    VStream header(GENESIS);
+
+    uint32_t nsols = 0;
+    for (nonce = 0; nonce < 100 && nsols == 0; ++nonce) {
+        memcpy(header.data() + header.size() - sizeof(nonce), &nonce, sizeof(nonce));
+        ctx.SetHeader(header.data(), header.size());
+        nsols = ctx.solve();
+    }
+    ASSERT_GT(nsols, 0);
+    ASSERT_EQ(ctx.sols.size(), nsols * cycleLen);
+
+    for (uint32_t s = 0; s < nsols; s++) {
+        EXPECT_EQ(VerifyProof(&ctx.sols[s * cycleLen], ctx.sipkeys, cycleLen, edgeBits), POW_OK);
+    }
+
+    // the batched hashing rejects proofs as the hashing of each edge did
+    std::vector<uint32_t> proof(ctx.sols.begin(), ctx.sols.begin() + cycleLen);
+    std::swap(proof[0], proof[1]);
+    EXPECT_EQ(VerifyProof(proof.data(), ctx.sipkeys, cycleLen, edgeBits), POW_TOO_SMALL);
+    std::swap(proof[0], proof[1]);
+    proof.back() = 1 << edgeBits;
+    EXPECT_EQ(VerifyProof(proof.data(), ctx.sipkeys, cycleLen, edgeBits), POW_TOO_BIG);
+
+    // the proof is bound to the header
+    siphash_keys otherKeys;
+    header.data()[0] ^= 1;
+    SetHeader(header.data(), header.size(), &otherKeys);
+    EXPECT_NE(VerifyProof(ctx.sols.data(), otherKeys, cycleLen, edgeBits), POW_OK);
+
+    // an aborted context gives up the graph
+    ctx.abort();
+    EXPECT_EQ(ctx.solve(), 0);
+}
+
+TEST_F(TestTrimmer, SipBlockXN) {
+    siphash_keys keys{0x0123456789abcdef, 0xfedcba9876543210, 0x0f1e2d3c4b5a6978, 0x8796a5b4c3d2e1f0};
+
+    alignas(32) uint64_t edges[NSIPHASH];
+    for (uint32_t b = 0; b < NSIPHASH; b++) {
+        edges[b] = (b * 1000003 + 17) & EDGEMASK;
+    }
+    alignas(32) uint64_t hashes[NSIPHASH * EDGE_BLOCK_SIZE];
+    sipblockxN(keys, edges, hashes);
+
+    uint64_t sips[EDGE_BLOCK_SIZE];
+    for (uint32_t b = 0; b < NSIPHASH; b++) {
+        sipblock(keys, edges[b], sips);
+        for (uint32_t i = 0; i < EDGE_BLOCK_SIZE; i++) {
+            ASSERT_EQ(hashes[i * NSIPHASH + b], sips[i]);
+        }
+    }
+}
+
 #ifdef __CUDA_ENABLED__
 #undef checkCudaErrors
 #define checkCudaErrors(ans)                          \
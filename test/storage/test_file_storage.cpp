@@ -153,6 +153,18 @@ TEST_F(TestFileStorage, cat_store_and_get_vertices_and_get_lvs) {
         }
     }
 
+    // Recover level sets with asynchronous reads
+    std::vector<size_t> heights(nLvs);
+    std::iota(heights.begin(), heights.end(), 1);
+    auto async_blks = STORE->GetRawLevelSetsAsync(heights).get();
+    auto async_vtcs = STORE->GetRawLevelSetsAsync(heights, file::FileType::VTX).get();
+    ASSERT_EQ(async_blks.size(), nLvs);
+    ASSERT_EQ(async_vtcs.size(), nLvs);
+    for (size_t i = 0; i < heights.size(); ++i) {
+        ASSERT_EQ(STORE->GetRawLevelSetAt(heights[i]), async_blks[i]);
+        ASSERT_EQ(STORE->GetRawLevelSetAt(heights[i], file::FileType::VTX), async_vtcs[i]);
+    }
+
     // Recover a single level set
     const auto& lvs = levelsets.back();
     auto height     = lvs.front()->height;
@@ -175,6 +187,18 @@ TEST_F(TestFileStorage, cat_store_and_get_vertices_and_get_lvs) {
         ASSERT_EQ(*lvs[i], *recovered_vtcs_blks[i]);
         ASSERT_EQ(*lvs[i], *recovered_vtcs[i]);
     }
+
+    // Read the level set header and the hash list only
+    auto header = STORE->GetLevelSetHeaderAt(height, file::FileType::VTX);
+    ASSERT_TRUE(header);
+    ASSERT_EQ(header->entries.size(), lvs.size());
+    ASSERT_EQ(header->hashes.front(), lvs.back()->cblock->GetHash());
+
+    auto hashes = STORE->GetLevelSetHashesAt(height);
+    ASSERT_EQ(hashes.size(), lvs.size());
+    for (size_t i = 0; i < lvs.size(); ++i) {
+        ASSERT_EQ(lvs[i]->cblock->GetHash(), hashes[i]);
+    }
 }
 
 TEST_F(TestFileStorage, test_checksum) {
@@ -185,3 +185,36 @@ TEST_F(TestRocksDB, headheight) {
         ASSERT_EQ(i, read_height);
     }
 }
+
+TEST_F(TestRocksDB, tx_and_addr_index) {
+    auto block      = fac.CreateBlock(1, 10);
+    auto blkHash    = block.GetHash();
+    const auto addr = fac.CreateKeyPair().second.GetID();
+
+    IndexBatch batch;
+    std::vector<TxOutPoint> outpoints;
+    for (uint32_t i = 0; i < 10; i++) {
+        batch.txs.emplace_back(fac.CreateRandomHash(), std::make_pair(blkHash, i));
+        outpoints.emplace_back(blkHash, 0, i);
+        batch.created.emplace_back(addr, outpoints.back());
+    }
+    ASSERT_TRUE(db->WriteIndexBatch(batch));
+
+    for (const auto& [txHash, pos] : batch.txs) {
+        ASSERT_EQ(pos, *db->GetTxPos(txHash));
+    }
+    ASSERT_FALSE(db->GetTxPos(fac.CreateRandomHash()));
+
+    auto indexed = db->GetAddrOutPoints(addr);
+    ASSERT_EQ(outpoints.size(), indexed.size());
+    for (const auto& outpoint : outpoints) {
+        ASSERT_NE(indexed.end(), std::find(indexed.begin(), indexed.end(), outpoint));
+    }
+
+    IndexBatch removal;
+    for (const auto& outpoint : outpoints) {
+        removal.spent.emplace_back(addr, outpoint.GetOutKey());
+    }
+    ASSERT_TRUE(db->WriteIndexBatch(removal));
+    ASSERT_TRUE(db->GetAddrOutPoints(addr).empty());
+}
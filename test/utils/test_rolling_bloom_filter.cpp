@@ -0,0 +1,71 @@
+// Copyright (c) 2019 EPI-ONE Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <gtest/gtest.h>
+
+#include "rolling_bloom_filter.h"
+
+#include <cstring>
+#include <random>
+
+class TestRollingBloomFilter : public testing::Test {
+public:
+    std::mt19937_64 gen{7877};
+
+    uint256 RandomHash() {
+        uint256 hash;
+        for (auto it = hash.begin(); it < hash.end(); it += 8) {
+            uint64_t word = gen();
+            std::memcpy(it, &word, 8);
+        }
+        return hash;
+    }
+};
+
+TEST_F(TestRollingBloomFilter, InsertAndContains) {
+    RollingBloomFilter filter(1000, 0.000001);
+
+    std::vector<uint256> hashes;
+    for (int i = 0; i < 1000; ++i) {
+        hashes.push_back(RandomHash());
+        filter.Insert(hashes.back());
+    }
+
+    for (const auto& h : hashes) {
+        EXPECT_TRUE(filter.Contains(h));
+    }
+
+    size_t falsePositives = 0;
+    for (int i = 0; i < 10000; ++i) {
+        falsePositives += filter.Contains(RandomHash());
+    }
+    EXPECT_LE(falsePositives, 1);
+
+    filter.Reset();
+    for (const auto& h : hashes) {
+        EXPECT_FALSE(filter.Contains(h));
+    }
+}
+
+TEST_F(TestRollingBloomFilter, ForgetOldest) {
+    RollingBloomFilter filter(100, 0.001);
+
+    std::vector<uint256> hashes;
+    for (int i = 0; i < 400; ++i) {
+        hashes.push_back(RandomHash());
+        filter.Insert(hashes.back());
+    }
+
+    // the latest 100 are always kept
+    for (int i = 300; i < 400; ++i) {
+        EXPECT_TRUE(filter.Contains(hashes[i]));
+    }
+
+    // while the first ones have been rolled out
+    size_t remained = 0;
+    for (int i = 0; i < 100; ++i) {
+        remained += filter.Contains(hashes[i]);
+    }
+    EXPECT_LE(remained, 5);
+}
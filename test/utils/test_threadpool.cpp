@@ -88,3 +88,48 @@ TEST_F(TestThreadPool, TestlambaFunction) {
     auto result = threadPool.Submit([]() { return "lambda function"; });
     EXPECT_EQ("lambda function", result->get());
 }
+
+TEST_F(TestThreadPool, TestStrand) {
+    auto strand1 = std::make_shared<Strand>(threadPool);
+    auto strand2 = std::make_shared<Strand>(threadPool);
+
+    const int n = 1000;
+    std::vector<int> order1, order2;
+    for (int i = 0; i < n; i++) {
+        strand1->Execute([&order1, i]() { order1.push_back(i); });
+        strand2->Execute([&order2, i]() { order2.push_back(i); });
+    }
+
+    // the vectors are read only after the last tasks of both strands have run
+    std::promise<void> done1, done2;
+    strand1->Execute([&done1]() { done1.set_value(); });
+    strand2->Execute([&done2]() { done2.set_value(); });
+    done1.get_future().wait();
+    done2.get_future().wait();
+
+    // tasks of the same strand run one at a time and in order
+    ASSERT_EQ(order1.size(), n);
+    ASSERT_EQ(order2.size(), n);
+    for (int i = 0; i < n; i++) {
+        ASSERT_EQ(order1[i], i);
+        ASSERT_EQ(order2[i], i);
+    }
+}
+
+TEST_F(TestThreadPool, TestStrandDroppedByPool) {
+    // the pool is not started, so the strand waits in its queue until it is cleared
+    ThreadPool pool(1);
+    auto strand = std::make_shared<Strand>(pool);
+
+    bool ran = false;
+    strand->Execute([&ran]() { ran = true; });
+    pool.Abort();
+
+    // the strand is scheduled again by the next task once the pool runs
+    pool.Start();
+    std::promise<void> done;
+    strand->Execute([&done]() { done.set_value(); });
+    EXPECT_EQ(done.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_TRUE(ran);
+    pool.Stop();
+}